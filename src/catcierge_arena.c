@@ -0,0 +1,153 @@
+//
+// This file is part of the Catcierge project.
+//
+// Copyright (c) Joakim Soderberg 2013-2014
+//
+//    Catcierge is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    Catcierge is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Catcierge.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <catcierge_config.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include "catcierge_platform.h"
+#include "catcierge_arena.h"
+#include "catcierge_log.h"
+
+static catcierge_arena_block_t *catcierge_arena_add_block(catcierge_arena_t *a, size_t size)
+{
+	catcierge_arena_block_t *block;
+	assert(a);
+
+	if (size < CATCIERGE_ARENA_BLOCK_SIZE)
+		size = CATCIERGE_ARENA_BLOCK_SIZE;
+
+	if (!(block = (catcierge_arena_block_t *)malloc(sizeof(catcierge_arena_block_t) + size)))
+	{
+		CATERR("Out of memory!\n");
+		return NULL;
+	}
+
+	block->size = size;
+	block->used = 0;
+	block->next = a->blocks;
+	a->blocks = block;
+
+	return block;
+}
+
+void catcierge_arena_init(catcierge_arena_t *a)
+{
+	assert(a);
+	memset(a, 0, sizeof(catcierge_arena_t));
+}
+
+static void catcierge_arena_free_blocks(catcierge_arena_t *a)
+{
+	catcierge_arena_block_t *next;
+	assert(a);
+
+	while (a->blocks)
+	{
+		next = a->blocks->next;
+		free(a->blocks);
+		a->blocks = next;
+	}
+}
+
+void catcierge_arena_destroy(catcierge_arena_t *a)
+{
+	assert(a);
+	catcierge_arena_free_blocks(a);
+	a->total = 0;
+}
+
+void catcierge_arena_reset(catcierge_arena_t *a)
+{
+	size_t total;
+	assert(a);
+
+	if (a->blocks && a->blocks->next)
+	{
+		// Replace the blocks with one that fits everything.
+		total = a->total;
+		catcierge_arena_free_blocks(a);
+		catcierge_arena_add_block(a, total);
+	}
+
+	if (a->blocks)
+		a->blocks->used = 0;
+
+	a->total = 0;
+}
+
+const char *catcierge_arena_vprintf(catcierge_arena_t *a, const char *fmt, va_list args)
+{
+	int required = -1;
+	size_t left = 0;
+	char *s = NULL;
+	catcierge_arena_block_t *block;
+	va_list my_args;
+	assert(a);
+	assert(fmt);
+
+	// Usually fits in what is left of the current block.
+	if ((block = a->blocks))
+	{
+		left = block->size - block->used;
+		s = &block->data[block->used];
+
+		va_copy(my_args, args);
+		required = vsnprintf(s, left, fmt, my_args);
+		va_end(my_args);
+	}
+
+	if ((required < 0) || ((size_t)required >= left))
+	{
+		va_copy(my_args, args);
+		#ifdef _MSC_VER
+		required = _vscprintf(fmt, my_args);
+		#else
+		required = vsnprintf(NULL, 0, fmt, my_args);
+		#endif
+		va_end(my_args);
+
+		if (required < 0)
+			return NULL;
+
+		if (!(block = catcierge_arena_add_block(a, (size_t)required + 1)))
+			return NULL;
+
+		s = block->data;
+		va_copy(my_args, args);
+		vsnprintf(s, (size_t)required + 1, fmt, my_args);
+		va_end(my_args);
+	}
+
+	block->used += (size_t)required + 1;
+	a->total += (size_t)required + 1;
+
+	return s;
+}
+
+const char *catcierge_arena_printf(catcierge_arena_t *a, const char *fmt, ...)
+{
+	const char *s;
+	va_list args;
+	va_start(args, fmt);
+	s = catcierge_arena_vprintf(a, fmt, args);
+	va_end(args);
+
+	return s;
+}
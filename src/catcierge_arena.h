@@ -0,0 +1,56 @@
+//
+// This file is part of the Catcierge project.
+//
+// Copyright (c) Joakim Soderberg 2013-2014
+//
+//    Catcierge is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    Catcierge is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Catcierge.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef __CATCIERGE_ARENA_H__
+#define __CATCIERGE_ARENA_H__
+
+#include <stddef.h>
+#include <stdarg.h>
+
+#define CATCIERGE_ARENA_BLOCK_SIZE 4096
+
+typedef struct catcierge_arena_block_s
+{
+	struct catcierge_arena_block_s *next;
+	size_t size;
+	size_t used;
+	char data[1];
+} catcierge_arena_block_t;
+
+//
+// Strings that live until the arena is reset, so that they can be
+// handed out as plain pointers. A block is never moved once allocated,
+// when one is full another is added. On reset the blocks are merged
+// into one large enough for everything used, so after the first few
+// resets no more allocations are made.
+//
+typedef struct catcierge_arena_s
+{
+	catcierge_arena_block_t *blocks;	// The block being filled first.
+	size_t total;						// Bytes used in all blocks.
+} catcierge_arena_t;
+
+void catcierge_arena_init(catcierge_arena_t *a);
+void catcierge_arena_destroy(catcierge_arena_t *a);
+void catcierge_arena_reset(catcierge_arena_t *a);
+
+// Returns NULL when out of memory.
+const char *catcierge_arena_vprintf(catcierge_arena_t *a, const char *fmt, va_list args);
+const char *catcierge_arena_printf(catcierge_arena_t *a, const char *fmt, ...);
+
+#endif // __CATCIERGE_ARENA_H__
@@ -17,6 +17,8 @@
 #include "catcierge_template_matcher.h"
 #include "catcierge_haar_matcher.h"
 #include "catcierge_strftime.h"
+#include "catcierge_capture_thread.h"
+#include "catcierge_recorder.h"
 
 #ifdef WITH_RFID
 int catcierge_create_rfid_allowed_list(catcierge_args_t *args, const char *allowed)
@@ -77,6 +79,18 @@ int catcierge_parse_setting(catcierge_args_t *args, const char *key, char **valu
 	if (ret < 0) return -1;
 	else if (!ret) return 0;
 
+	ret = catcierge_frame_source_parse_args(&args->source, key, values, value_count);
+	if (ret < 0) return -1;
+	else if (!ret) return 0;
+
+	ret = catcierge_idle_parse_args(&args->idle, key, values, value_count);
+	if (ret < 0) return -1;
+	else if (!ret) return 0;
+
+	ret = catcierge_motion_parse_args(&args->motion, key, values, value_count);
+	if (ret < 0) return -1;
+	else if (!ret) return 0;
+
 	if (!strcmp(key, "show"))
 	{
 		args->show = 1;
@@ -91,9 +105,9 @@ int catcierge_parse_setting(catcierge_args_t *args, const char *key, char **valu
 			args->ok_matches_needed = atoi(values[0]);
 
 			if ((args->ok_matches_needed < 0)
-				|| (args->ok_matches_needed > MATCH_MAX_COUNT))
+				|| (args->ok_matches_needed > MAX_MATCH_GROUP_SIZE))
 			{
-				fprintf(stderr, "--ok_matches_needed must be between 0 and %d\n", MATCH_MAX_COUNT);
+				fprintf(stderr, "--ok_matches_needed must be between 0 and %d\n", MAX_MATCH_GROUP_SIZE);
 				return -1;
 			}
 
@@ -104,6 +118,26 @@ int catcierge_parse_setting(catcierge_args_t *args, const char *key, char **valu
 		return -1;
 	}
 
+	if (!strcmp(key, "match_group_size"))
+	{
+		if (value_count == 1)
+		{
+			args->match_group_size = atoi(values[0]);
+
+			if ((args->match_group_size < 1)
+				|| (args->match_group_size > MAX_MATCH_GROUP_SIZE))
+			{
+				fprintf(stderr, "--match_group_size must be between 1 and %d\n", MAX_MATCH_GROUP_SIZE);
+				return -1;
+			}
+
+			return 0;
+		}
+
+		fprintf(stderr, "--match_group_size missing an integer value\n");
+		return -1;
+	}
+
 	if (!strcmp(key, "lockout_method"))
 	{
 		if (value_count == 1)
@@ -206,6 +240,39 @@ int catcierge_parse_setting(catcierge_args_t *args, const char *key, char **valu
 		return 0;
 	}
 
+	if (!strcmp(key, "early_decision"))
+	{
+		args->early_decision = 1;
+		if (value_count == 1) args->early_decision = atoi(values[0]);
+		return 0;
+	}
+
+	if (!strcmp(key, "burst"))
+	{
+		args->burst = 1;
+		if (value_count == 1) args->burst = atoi(values[0]);
+		return 0;
+	}
+
+	if (!strcmp(key, "burst_workers"))
+	{
+		if (value_count == 1)
+		{
+			args->burst_workers = atoi(values[0]);
+
+			if (args->burst_workers < 0)
+			{
+				fprintf(stderr, "--burst_workers cannot be negative\n");
+				return -1;
+			}
+
+			return 0;
+		}
+
+		fprintf(stderr, "--burst_workers missing an integer value\n");
+		return -1;
+	}
+
 	#ifdef WITH_ZMQ
 	if (!strcmp(key, "zmq"))
 	{
@@ -522,6 +589,77 @@ int catcierge_parse_setting(catcierge_args_t *args, const char *key, char **valu
 		return 0;
 	}
 
+	if (!strcmp(key, "cpu_report"))
+	{
+		if (value_count == 1)
+		{
+			args->cpu_report = atof(values[0]);
+			return 0;
+		}
+
+		fprintf(stderr, "--cpu_report missing value\n");
+		return -1;
+	}
+
+	if (!strcmp(key, "capture_thread"))
+	{
+		args->capture_thread = 1;
+		if (value_count == 1) args->capture_thread = atoi(values[0]);
+		return 0;
+	}
+
+	if (!strcmp(key, "capture_buffers"))
+	{
+		if (value_count == 1)
+		{
+			args->capture_buffers = atoi(values[0]);
+
+			if ((args->capture_buffers < CATCIERGE_CAPTURE_MIN_BUFFERS)
+				|| (args->capture_buffers > CATCIERGE_CAPTURE_MAX_BUFFERS))
+			{
+				fprintf(stderr, "--capture_buffers must be between %d and %d\n",
+					CATCIERGE_CAPTURE_MIN_BUFFERS, CATCIERGE_CAPTURE_MAX_BUFFERS);
+				return -1;
+			}
+
+			return 0;
+		}
+
+		fprintf(stderr, "--capture_buffers missing an integer value\n");
+		return -1;
+	}
+
+	if (!strcmp(key, "record"))
+	{
+		if (value_count == 1)
+		{
+			args->record_path = values[0];
+			return 0;
+		}
+
+		fprintf(stderr, "--record missing value\n");
+		return -1;
+	}
+
+	if (!strcmp(key, "record_size"))
+	{
+		if (value_count == 1)
+		{
+			args->record_size = atoi(values[0]);
+
+			if (args->record_size <= 0)
+			{
+				fprintf(stderr, "--record_size must be a positive number of megabytes\n");
+				return -1;
+			}
+
+			return 0;
+		}
+
+		fprintf(stderr, "--record_size missing an integer value\n");
+		return -1;
+	}
+
 	if (!strcmp(key, "save_steps"))
 	{
 		args->save_steps = 1;
@@ -696,6 +834,20 @@ void catcierge_show_usage(catcierge_args_t *args, const char *prog)
 	fprintf(stderr, " --lockout_dummy        Do everything as normal, but don't actually\n");
 	fprintf(stderr, "                        lock the door. This is useful for testing.\n");
 	fprintf(stderr, "\n");
+	fprintf(stderr, "Camera settings:\n");
+	fprintf(stderr, "----------------\n");
+	fprintf(stderr, " --capture_thread       Grab camera frames in a separate thread so that the\n");
+	fprintf(stderr, "                        camera is never stalled while matching. When the matcher\n");
+	fprintf(stderr, "                        falls behind the oldest unprocessed frame is dropped.\n");
+	fprintf(stderr, " --capture_buffers <n>  Number of frame buffers used by --capture_thread.\n");
+	fprintf(stderr, "                        Must be between %d and %d. Default %d.\n",
+		CATCIERGE_CAPTURE_MIN_BUFFERS, CATCIERGE_CAPTURE_MAX_BUFFERS, CATCIERGE_CAPTURE_DEFAULT_BUFFERS);
+	catcierge_frame_source_usage();
+	catcierge_idle_usage();
+	catcierge_motion_usage();
+	fprintf(stderr, " --cpu_report <seconds> Log the time and CPU used in each state this often.\n");
+	fprintf(stderr, "                        0 only logs it at exit. Default 0.\n");
+	fprintf(stderr, "\n");
 	fprintf(stderr, "Presentation settings:\n");
 	fprintf(stderr, "----------------------\n");
 	fprintf(stderr, " --show                 Show GUI of the camera feed (X11 only).\n");
@@ -709,6 +861,10 @@ void catcierge_show_usage(catcierge_args_t *args, const char *prog)
 	fprintf(stderr, " --save_obstruct        Save the image that triggered the \"frame obstructed\" event.\n");
 	fprintf(stderr, " --save_steps           Save each step of the matching algorithm.\n");
 	fprintf(stderr, "                        (--save must also be turned on)\n");
+	fprintf(stderr, " --record <path>        Continuously record every frame as raw grayscale into a\n");
+	fprintf(stderr, "                        memory mapped ring file. Once full, the oldest frames are\n");
+	fprintf(stderr, "                        overwritten. Replay it using --frame_source rec.\n");
+	fprintf(stderr, " --record_size <MB>     Size of the --record file. Default %d MB.\n", DEFAULT_RECORD_SIZE_MB);
 	fprintf(stderr, " --template <path>      Path to one or more template files generated on specified events.\n");
 	fprintf(stderr, "                        (Not to be confused with the template matcher)\n");
 	fprintf(stderr, " --output_path <path>   Path to where the match images and generated templates should be saved.\n");
@@ -737,9 +893,13 @@ void catcierge_show_usage(catcierge_args_t *args, const char *prog)
 	fprintf(stderr, "Matcher settings:\n");
 	fprintf(stderr, "-----------------\n");
 	fprintf(stderr, " --ok_matches_needed <number>\n");
-	fprintf(stderr, "                        The number of matches out of %d matches\n", MATCH_MAX_COUNT);
+	fprintf(stderr, "                        The number of matches out of \"--match_group_size\" matches\n");
 	fprintf(stderr, "                        that need to be OK for the match to be considered\n");
-	fprintf(stderr, "                        an over all OK match.\n");
+	fprintf(stderr, "                        an over all OK match. Default %d.\n", DEFAULT_OK_MATCHES_NEEDED);
+	fprintf(stderr, " --match_group_size <number>\n");
+	fprintf(stderr, "                        The number of matches to make before deciding the lock\n");
+	fprintf(stderr, "                        state. More matches are more accurate but take longer.\n");
+	fprintf(stderr, "                        Must be between 1 and %d. Default %d.\n", MAX_MATCH_GROUP_SIZE, DEFAULT_MATCH_GROUP_SIZE);
 	fprintf(stderr, " --matchtime <seconds>  The time to wait after a match. Default %d seconds.\n", DEFAULT_MATCH_WAIT);
 	fprintf(stderr, " --matcher <template|haar>\n");
 	fprintf(stderr, "                        The type of matcher to use. Haar cascade is more\n");
@@ -750,6 +910,16 @@ void catcierge_show_usage(catcierge_args_t *args, const char *prog)
 	fprintf(stderr, "                        the matcher algorithm gets to do a final decision based on\n");
 	fprintf(stderr, "                        the entire group of matches which overrides the \"--ok_matches_needed\"\n");
 	fprintf(stderr, "                        setting. This flag turns this behavior off.\n");
+	fprintf(stderr, " --early_decision       Decide as soon as the rest of the matches cannot change\n");
+	fprintf(stderr, "                        the outcome, instead of always making all the matches.\n");
+	fprintf(stderr, "                        For instance when \"--ok_matches_needed\" has been reached.\n");
+	fprintf(stderr, " --burst                When the frame gets obstructed, grab all the frames of\n");
+	fprintf(stderr, "                        the match group back to back and match them in parallel,\n");
+	fprintf(stderr, "                        instead of matching one frame at a time. This gets the\n");
+	fprintf(stderr, "                        lock decision sooner on multi core hardware.\n");
+	fprintf(stderr, " --burst_workers <count>\n");
+	fprintf(stderr, "                        Threads used for matching with --burst, 0 for one per CPU.\n");
+	fprintf(stderr, "                        Default %d.\n", DEFAULT_BURST_WORKERS);
 	fprintf(stderr, "Haar cascade matcher:\n");
 	fprintf(stderr, "---------------------\n");
 	catcierge_haar_matcher_usage();
@@ -811,6 +981,7 @@ void catcierge_show_usage(catcierge_args_t *args, const char *prog)
 	fprintf(stderr, "                        to disk.\n");
 	fprintf(stderr, "                        (This is most likely what you want to use in most cases)\n");
 	EPRINT_CMD_HELP("                         %%0 = [0/1]    Match success.\n");
+	EPRINT_CMD_HELP("                         With the default match group size of 4:\n");
 	EPRINT_CMD_HELP("                         %%1 = [string] Image path for first match.\n");
 	EPRINT_CMD_HELP("                         %%2 = [string] Image path for second match.\n");
 	EPRINT_CMD_HELP("                         %%3 = [string] Image path for third match.\n");
@@ -819,11 +990,16 @@ void catcierge_show_usage(catcierge_args_t *args, const char *prog)
 	EPRINT_CMD_HELP("                         %%6 = [float]  Second image result.\n");
 	EPRINT_CMD_HELP("                         %%7 = [float]  Third image result.\n");
 	EPRINT_CMD_HELP("                         %%8 = [float]  Fourth image result.\n");
+	EPRINT_CMD_HELP("                         %%9-%%12 = [int] Image directions.\n");
+	EPRINT_CMD_HELP("                         %%13 = [int]   Total direction.\n");
+	EPRINT_CMD_HELP("                         For N matches there are N paths, results and\n");
+	EPRINT_CMD_HELP("                         directions, followed by the total direction.\n");
 	EPRINT_CMD_HELP("\n");
 	fprintf(stderr, " --match_done_cmd <cmd> Command to run when a match is done.\n");
 	EPRINT_CMD_HELP("                         %%0 = [0/1]    Match success.\n");
 	EPRINT_CMD_HELP("                         %%1 = [int]    Successful match count.\n");
 	EPRINT_CMD_HELP("                         %%2 = [int]    Max matches.\n");
+	EPRINT_CMD_HELP("                         %%3 = [int]    Matches made before deciding.\n");
 	EPRINT_CMD_HELP("\n");
 	#ifdef WITH_RFID
 	fprintf(stderr, " --rfid_detect_cmd <cmd> Command to run when one of the RFID readers detects a tag.\n");
@@ -1077,7 +1253,22 @@ void catcierge_print_settings(catcierge_args_t *args)
 	printf("            Log file: %s\n", args->log_path ? args->log_path : "-");
 	printf("            No color: %d\n", args->nocolor);
 	printf("        No animation: %d\n", args->noanim);
+	printf("      Capture thread: %d\n", args->capture_thread);
+	if (args->capture_thread)
+	printf("     Capture buffers: %d\n", args->capture_buffers);
+	catcierge_frame_source_print_settings(&args->source);
+	catcierge_idle_print_settings(&args->idle);
+	catcierge_motion_print_settings(&args->motion);
+	printf("          CPU report: %0.1f %s\n", args->cpu_report, (args->cpu_report <= 0.0) ? "(at exit)" : "seconds");
+	printf("           Recording: %s\n", args->record_path ? args->record_path : "-");
+	if (args->record_path)
+	printf("      Recording size: %d MB\n", args->record_size);
 	printf("   Ok matches needed: %d\n", args->ok_matches_needed);
+	printf("    Match group size: %d\n", args->match_group_size);
+	printf("      Early decision: %d\n", args->early_decision);
+	printf("         Burst match: %d\n", args->burst);
+	if (args->burst)
+	printf("       Burst workers: %d\n", args->burst_workers);
 	printf("         Output path: %s\n", args->output_path);
 	if (args->match_output_path && strcmp(args->output_path, args->match_output_path))
 	printf("   Match output path: %s\n", args->match_output_path);
@@ -1121,6 +1312,9 @@ int catcierge_args_init(catcierge_args_t *args)
 
 	catcierge_template_matcher_args_init(&args->templ);
 	catcierge_haar_matcher_args_init(&args->haar);
+	catcierge_frame_source_args_init(&args->source);
+	catcierge_idle_args_init(&args->idle);
+	catcierge_motion_args_init(&args->motion);
 	args->saveimg = 1;
 	args->save_obstruct_img = 0;
 	args->match_time = DEFAULT_MATCH_WAIT;
@@ -1128,7 +1322,11 @@ int catcierge_args_init(catcierge_args_t *args)
 	args->lockout_time = DEFAULT_LOCKOUT_TIME;
 	args->consecutive_lockout_delay = DEFAULT_CONSECUTIVE_LOCKOUT_DELAY;
 	args->ok_matches_needed = DEFAULT_OK_MATCHES_NEEDED;
+	args->match_group_size = DEFAULT_MATCH_GROUP_SIZE;
+	args->burst_workers = DEFAULT_BURST_WORKERS;
 	args->output_path = ".";
+	args->capture_buffers = CATCIERGE_CAPTURE_DEFAULT_BUFFERS;
+	args->record_size = DEFAULT_RECORD_SIZE_MB;
 
 	#ifdef RPI
 	{
@@ -11,6 +11,9 @@
 #include "catcierge_matcher.h"
 #include "catcierge_template_matcher.h"
 #include "catcierge_haar_matcher.h"
+#include "catcierge_frame_source.h"
+#include "catcierge_idle.h"
+#include "catcierge_motion.h"
 #include "catcierge_types.h"
 
 #define DEFAULT_LOCKOUT_TIME 30		// The default lockout length after a none-match
@@ -18,6 +21,7 @@
 #define DEFAULT_CONSECUTIVE_LOCKOUT_DELAY 3.0 // The time in seconds between lockouts that is considered consecutive.
 #define MAX_TEMP_CONFIG_VALUES 128
 #define DEFAULT_OK_MATCHES_NEEDED 2
+#define DEFAULT_BURST_WORKERS 0			// Threads used with --burst, 0 is one per CPU.
 #define MAX_INPUT_TEMPLATES 32
 #ifdef WITH_ZMQ
 #define DEFAULT_ZMQ_PORT 5556
@@ -48,8 +52,12 @@ typedef struct catcierge_args_s
 	char *obstruct_output_path;
 	char *template_output_path;
 	int ok_matches_needed;
+	int match_group_size;
 	int save_steps;
 	int no_final_decision;
+	int early_decision;
+	int burst;
+	int burst_workers;
 
 	const char *matcher;
 	catcierge_matcher_type_t matcher_type;
@@ -72,6 +80,14 @@ typedef struct catcierge_args_s
 	char *temp_config_values[MAX_TEMP_CONFIG_VALUES];
 	int nocolor;
 	int noanim;
+	int capture_thread;
+	int capture_buffers;
+	catcierge_frame_source_args_t source;
+	catcierge_idle_args_t idle;
+	catcierge_motion_args_t motion;
+	double cpu_report;
+	char *record_path;
+	int record_size;
 	char *inputs[MAX_INPUT_TEMPLATES];
 	size_t input_count;
 
@@ -0,0 +1,353 @@
+//
+// This file is part of the Catcierge project.
+//
+// Copyright (c) Joakim Soderberg 2013-2014
+//
+//    Catcierge is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    Catcierge is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Catcierge.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <catcierge_config.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <assert.h>
+#include "catcierge_platform.h"
+#include "catcierge_binary_match.h"
+#include "catcierge_log.h"
+
+#ifdef CATCIERGE_HAVE_AVX2
+#include <immintrin.h>
+#endif
+
+#ifdef CATCIERGE_HAVE_NEON
+#include <arm_neon.h>
+#endif
+
+#if defined(_MSC_VER) && defined(_M_X64)
+#include <intrin.h>
+#endif
+
+static unsigned int catcierge_popcount64(uint64_t v)
+{
+	#if defined(__GNUC__)
+	return (unsigned int)__builtin_popcountll(v);
+	#elif defined(_MSC_VER) && defined(_M_X64)
+	return (unsigned int)__popcnt64(v);
+	#else
+	v = v - ((v >> 1) & 0x5555555555555555ULL);
+	v = (v & 0x3333333333333333ULL) + ((v >> 2) & 0x3333333333333333ULL);
+	v = (v + (v >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+	return (unsigned int)((v * 0x0101010101010101ULL) >> 56);
+	#endif
+}
+
+unsigned int catcierge_binary_and_count_scalar(const uint64_t *a, const uint64_t *b, int count)
+{
+	int i;
+	unsigned int n = 0;
+
+	for (i = 0; i < count; i++)
+	{
+		n += catcierge_popcount64(a[i] & b[i]);
+	}
+
+	return n;
+}
+
+unsigned int catcierge_binary_and_count(const uint64_t *a, const uint64_t *b, int count)
+{
+	int i = 0;
+	unsigned int n = 0;
+	#if defined(CATCIERGE_HAVE_AVX2)
+	// Popcount of each nibble by table lookup, summed per 64 bits.
+	const __m256i lookup = _mm256_setr_epi8(
+		0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+		0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+	const __m256i low_mask = _mm256_set1_epi8(0x0f);
+	__m256i acc = _mm256_setzero_si256();
+	__m256i v;
+	__m256i cnt;
+
+	for (; (i + 4) <= count; i += 4)
+	{
+		v = _mm256_and_si256(
+			_mm256_loadu_si256((const __m256i *)(a + i)),
+			_mm256_loadu_si256((const __m256i *)(b + i)));
+		cnt = _mm256_add_epi8(
+			_mm256_shuffle_epi8(lookup, _mm256_and_si256(v, low_mask)),
+			_mm256_shuffle_epi8(lookup, _mm256_and_si256(_mm256_srli_epi16(v, 4), low_mask)));
+		acc = _mm256_add_epi64(acc, _mm256_sad_epu8(cnt, _mm256_setzero_si256()));
+	}
+
+	n = (unsigned int)(_mm256_extract_epi64(acc, 0) + _mm256_extract_epi64(acc, 1)
+		+ _mm256_extract_epi64(acc, 2) + _mm256_extract_epi64(acc, 3));
+	#elif defined(CATCIERGE_HAVE_NEON)
+	uint16x8_t acc;
+	uint64x2_t s;
+	int chunk;
+
+	while ((i + 2) <= count)
+	{
+		// 16-bit lanes hold up to 2048 * 16 set bits without overflowing.
+		acc = vdupq_n_u16(0);
+
+		for (chunk = 0; (chunk < 2048) && ((i + 2) <= count); chunk++, i += 2)
+		{
+			acc = vpadalq_u8(acc, vcntq_u8(vandq_u8(
+				vld1q_u8((const uint8_t *)(a + i)),
+				vld1q_u8((const uint8_t *)(b + i)))));
+		}
+
+		s = vpaddlq_u32(vpaddlq_u16(acc));
+		n += (unsigned int)(vgetq_lane_u64(s, 0) + vgetq_lane_u64(s, 1));
+	}
+	#endif
+
+	return n + catcierge_binary_and_count_scalar(a + i, b + i, count - i);
+}
+
+const char *catcierge_binary_simd_str()
+{
+	#if defined(CATCIERGE_HAVE_AVX2)
+	return "avx2";
+	#elif defined(CATCIERGE_HAVE_NEON)
+	return "neon";
+	#else
+	return "none";
+	#endif
+}
+
+static void catcierge_binary_pack_row(const unsigned char *src, int width, uint64_t *dst)
+{
+	int x;
+
+	for (x = 0; x < width; x++)
+	{
+		if (src[x])
+			dst[x >> 6] |= ((uint64_t)1 << (x & 63));
+	}
+}
+
+int catcierge_binary_frame_init(catcierge_binary_frame_t *f, int width, int height)
+{
+	assert(f);
+
+	memset(f, 0, sizeof(catcierge_binary_frame_t));
+	f->width = width;
+	f->height = height;
+	f->words = ((width + 63) >> 6) + 1;
+
+	if (!(f->bits = (uint64_t *)calloc((size_t)f->words * height, sizeof(uint64_t)))
+	 || !(f->ones = (int *)calloc((size_t)(width + 1) * (height + 1), sizeof(int))))
+	{
+		CATERR("Out of memory!\n");
+		catcierge_binary_frame_destroy(f);
+		return -1;
+	}
+
+	return 0;
+}
+
+void catcierge_binary_frame_destroy(catcierge_binary_frame_t *f)
+{
+	assert(f);
+
+	free(f->bits);
+	f->bits = NULL;
+	free(f->ones);
+	f->ones = NULL;
+}
+
+int catcierge_binary_frame_set(catcierge_binary_frame_t *f, IplImage *img)
+{
+	int x;
+	int y;
+	int row_sum;
+	const unsigned char *row;
+	int *ones;
+	int *ones_above;
+	assert(f);
+	assert(img);
+
+	if ((img->width != f->width) || (img->height != f->height)
+		|| (img->nChannels != 1) || (img->depth != IPL_DEPTH_8U))
+	{
+		CATERR("Binary match needs a %dx%d 8-bit gray image\n", f->width, f->height);
+		return -1;
+	}
+
+	memset(f->bits, 0, (size_t)f->words * f->height * sizeof(uint64_t));
+
+	for (y = 0; y < f->height; y++)
+	{
+		row = (const unsigned char *)img->imageData + y * img->widthStep;
+		catcierge_binary_pack_row(row, f->width, f->bits + y * f->words);
+
+		ones_above = f->ones + y * (f->width + 1);
+		ones = ones_above + (f->width + 1);
+		row_sum = 0;
+
+		for (x = 0; x < f->width; x++)
+		{
+			row_sum += (row[x] != 0);
+			ones[x + 1] = ones_above[x + 1] + row_sum;
+		}
+	}
+
+	return 0;
+}
+
+int catcierge_binary_template_init(catcierge_binary_template_t *t,
+		catcierge_binary_frame_t *f, IplImage *templ)
+{
+	int y;
+	int i;
+	const unsigned char *row;
+	assert(t);
+	assert(f);
+	assert(templ);
+
+	memset(t, 0, sizeof(catcierge_binary_template_t));
+
+	if ((templ->nChannels != 1) || (templ->depth != IPL_DEPTH_8U)
+		|| (templ->width > f->width) || (templ->height > f->height))
+	{
+		CATERR("Binary match template must be 8-bit gray and fit in %dx%d\n",
+			f->width, f->height);
+		return -1;
+	}
+
+	t->width = templ->width;
+	t->height = templ->height;
+	t->words = (t->width + 63) >> 6;
+
+	if (!(t->bits = (uint64_t *)calloc((size_t)t->words * t->height, sizeof(uint64_t)))
+	 || !(t->window = (uint64_t *)calloc((size_t)t->words * f->height, sizeof(uint64_t))))
+	{
+		CATERR("Out of memory!\n");
+		catcierge_binary_template_destroy(t);
+		return -1;
+	}
+
+	for (y = 0; y < t->height; y++)
+	{
+		row = (const unsigned char *)templ->imageData + y * templ->widthStep;
+		catcierge_binary_pack_row(row, t->width, t->bits + y * t->words);
+	}
+
+	for (i = 0; i < (t->words * t->height); i++)
+	{
+		t->ones += catcierge_popcount64(t->bits[i]);
+	}
+
+	t->flat = (t->ones == 0) || (t->ones == (t->width * t->height));
+
+	return 0;
+}
+
+void catcierge_binary_template_destroy(catcierge_binary_template_t *t)
+{
+	assert(t);
+
+	free(t->bits);
+	t->bits = NULL;
+	free(t->window);
+	t->window = NULL;
+}
+
+int catcierge_binary_match(catcierge_binary_frame_t *f,
+		catcierge_binary_template_t *t, IplImage *result)
+{
+	int x;
+	int y;
+	int k;
+	int rw;
+	int rh;
+	int shift;
+	int stride;
+	double n;
+	double a;
+	double both;
+	double var_t;
+	double var_a;
+	double num;
+	double denom;
+	const uint64_t *src;
+	uint64_t *dst;
+	const int *ones0;
+	const int *ones1;
+	assert(f);
+	assert(t);
+	assert(result);
+
+	rw = f->width - t->width + 1;
+	rh = f->height - t->height + 1;
+
+	if ((result->width != rw) || (result->height != rh)
+		|| (result->depth != IPL_DEPTH_32F) || (result->nChannels != 1))
+	{
+		CATERR("Binary match result must be a %dx%d 32F image\n", rw, rh);
+		return -1;
+	}
+
+	if (t->flat)
+	{
+		cvSet(result, cvScalarAll(1.0), NULL);
+		return 0;
+	}
+
+	n = (double)t->width * t->height;
+	var_t = n * t->ones - (double)t->ones * t->ones;
+	stride = f->width + 1;
+
+	for (x = 0; x < rw; x++)
+	{
+		// Shift every frame row so that column x ends up at bit 0.
+		// Then each placement in this column is a contiguous run of
+		// template height rows in the window buffer.
+		shift = x & 63;
+
+		for (y = 0; y < f->height; y++)
+		{
+			src = f->bits + y * f->words + (x >> 6);
+			dst = t->window + y * t->words;
+
+			for (k = 0; k < t->words; k++)
+			{
+				dst[k] = shift ? ((src[k] >> shift) | (src[k + 1] << (64 - shift))) : src[k];
+			}
+		}
+
+		for (y = 0; y < rh; y++)
+		{
+			ones0 = f->ones + y * stride + x;
+			ones1 = ones0 + t->height * stride;
+			a = ones1[t->width] - ones1[0] - ones0[t->width] + ones0[0];
+
+			both = catcierge_binary_and_count(t->window + y * t->words,
+					t->bits, t->words * t->height);
+
+			num = n * both - a * t->ones;
+			var_a = n * a - a * a;
+			denom = sqrt(var_a * var_t);
+
+			// A window with a single value has no correlation,
+			// the same as cvMatchTemplate.
+			*(float *)(result->imageData + y * result->widthStep + x * sizeof(float)) =
+				(denom > 0.0) ? (float)(num / denom) : 0.0f;
+		}
+	}
+
+	return 0;
+}
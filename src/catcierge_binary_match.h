@@ -0,0 +1,84 @@
+//
+// This file is part of the Catcierge project.
+//
+// Copyright (c) Joakim Soderberg 2013-2014
+//
+//    Catcierge is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    Catcierge is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Catcierge.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef __CATCIERGE_BINARY_MATCH_H__
+#define __CATCIERGE_BINARY_MATCH_H__
+
+#include <opencv2/imgproc/imgproc_c.h>
+#include <stdint.h>
+
+//
+// Template matching of binary (thresholded) images, giving the same
+// scores as cvMatchTemplate with CV_TM_CCOEFF_NORMED.
+//
+// Every pixel is one bit, rows are packed into 64-bit words. For a
+// binary window A and template T with n pixels the correlation
+// coefficient only depends on the number of set pixels:
+//
+//          n * |A & T| - |A| * |T|
+//   ---------------------------------------
+//   sqrt((n|A| - |A|^2) * (n|T| - |T|^2))
+//
+// |T| is fixed, |A| comes from an integral image of the frame, so the
+// only per placement work is an AND and a popcount over the window.
+//
+
+typedef struct catcierge_binary_frame_s
+{
+	int width;			// Size of the frames to match.
+	int height;
+	int words;			// 64-bit words per packed row, including a zero word for shifting.
+	uint64_t *bits;		// Packed rows of the current frame.
+	int *ones;			// Integral image of the set pixels, (width + 1) x (height + 1).
+} catcierge_binary_frame_t;
+
+typedef struct catcierge_binary_template_s
+{
+	int width;
+	int height;
+	int words;			// 64-bit words per packed row.
+	int ones;			// Number of set pixels.
+	int flat;			// All pixels have the same value, everything matches.
+	uint64_t *bits;		// Packed rows, the bits past the width are zero.
+	uint64_t *window;	// Frame rows shifted to line up with the template, for
+						// one placement column. Per template so that templates
+						// can be matched in parallel.
+} catcierge_binary_template_t;
+
+int catcierge_binary_frame_init(catcierge_binary_frame_t *f, int width, int height);
+void catcierge_binary_frame_destroy(catcierge_binary_frame_t *f);
+
+// Packs an 8-bit gray image, any non-zero pixel is set.
+int catcierge_binary_frame_set(catcierge_binary_frame_t *f, IplImage *img);
+
+int catcierge_binary_template_init(catcierge_binary_template_t *t,
+		catcierge_binary_frame_t *f, IplImage *templ);
+void catcierge_binary_template_destroy(catcierge_binary_template_t *t);
+
+// Writes the score for every placement of the template to
+// result, a 32F image of size (W - w + 1) x (H - h + 1).
+int catcierge_binary_match(catcierge_binary_frame_t *f,
+		catcierge_binary_template_t *t, IplImage *result);
+
+// Number of set bits in a[i] & b[i] for i < count.
+unsigned int catcierge_binary_and_count(const uint64_t *a, const uint64_t *b, int count);
+unsigned int catcierge_binary_and_count_scalar(const uint64_t *a, const uint64_t *b, int count);
+
+const char *catcierge_binary_simd_str();
+
+#endif // __CATCIERGE_BINARY_MATCH_H__
@@ -0,0 +1,335 @@
+//
+// This file is part of the Catcierge project.
+//
+// Copyright (c) Joakim Soderberg 2013-2014
+//
+//    Catcierge is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    Catcierge is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Catcierge.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <catcierge_config.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <opencv2/imgproc/imgproc_c.h>
+#include "catcierge_capture_thread.h"
+#include "catcierge_timer.h"
+#include "catcierge_log.h"
+
+// Sequence numbers are allowed to wrap around.
+#define SEQ_BEFORE(a, b) ((long)((a) - (b)) < 0)
+
+int catcierge_capture_thread_init(catcierge_capture_thread_t *ct, size_t frame_count,
+		catcierge_capture_grab_f grab, void *user)
+{
+	assert(ct);
+	assert(grab);
+
+	memset(ct, 0, sizeof(catcierge_capture_thread_t));
+
+	if ((frame_count < CATCIERGE_CAPTURE_MIN_BUFFERS)
+	 || (frame_count > CATCIERGE_CAPTURE_MAX_BUFFERS))
+	{
+		CATERR("Capture thread: Buffer count must be between %d and %d\n",
+			CATCIERGE_CAPTURE_MIN_BUFFERS, CATCIERGE_CAPTURE_MAX_BUFFERS);
+		return -1;
+	}
+
+	if (!(ct->frames = calloc(frame_count, sizeof(catcierge_capture_frame_t))))
+	{
+		CATERR("Out of memory!\n");
+		return -1;
+	}
+
+	ct->frame_count = frame_count;
+	ct->grab = grab;
+	ct->user = user;
+
+	return 0;
+}
+
+void catcierge_capture_thread_destroy(catcierge_capture_thread_t *ct)
+{
+	size_t i;
+	assert(ct);
+
+	catcierge_capture_thread_stop(ct);
+
+	if (ct->frames)
+	{
+		for (i = 0; i < ct->frame_count; i++)
+		{
+			if (ct->frames[i].img)
+			{
+				cvReleaseImage(&ct->frames[i].img);
+			}
+		}
+
+		free(ct->frames);
+		ct->frames = NULL;
+	}
+
+	ct->frame_count = 0;
+}
+
+static int catcierge_capture_thread_frame_fits(IplImage *img, IplImage *src)
+{
+	CvSize size = cvGetSize(src);
+
+	return img
+		&& (img->width == size.width)
+		&& (img->height == size.height)
+		&& (img->depth == src->depth)
+		&& (img->nChannels == src->nChannels);
+}
+
+static int catcierge_capture_thread_alloc_frame(catcierge_capture_frame_t *frame, IplImage *src)
+{
+	if (catcierge_capture_thread_frame_fits(frame->img, src))
+		return 0;
+
+	if (frame->img)
+	{
+		cvReleaseImage(&frame->img);
+	}
+
+	if (!(frame->img = cvCreateImage(cvGetSize(src), src->depth, src->nChannels)))
+	{
+		return -1;
+	}
+
+	return 0;
+}
+
+static int catcierge_capture_thread_alloc_frames(catcierge_capture_thread_t *ct, IplImage *src)
+{
+	size_t i;
+
+	// Only done before the first frame is published,
+	// so none of the buffers can be read yet.
+	for (i = 0; i < ct->frame_count; i++)
+	{
+		if (catcierge_capture_thread_alloc_frame(&ct->frames[i], src))
+		{
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+static catcierge_capture_frame_t *catcierge_capture_thread_claim(catcierge_capture_thread_t *ct)
+{
+	size_t i;
+	int state;
+	catcierge_capture_frame_t *frame;
+	catcierge_capture_frame_t *oldest;
+
+	while (1)
+	{
+		oldest = NULL;
+
+		for (i = 0; i < ct->frame_count; i++)
+		{
+			frame = &ct->frames[i];
+			state = catcierge_atomic_load(&frame->state);
+
+			// Only the producer moves a frame out of FREE,
+			// so this can't fail.
+			if ((state == CAPTURE_FRAME_FREE)
+			 && catcierge_atomic_cas(&frame->state, CAPTURE_FRAME_FREE, CAPTURE_FRAME_WRITING))
+			{
+				return frame;
+			}
+
+			if ((state == CAPTURE_FRAME_READY)
+			 && (!oldest || SEQ_BEFORE(frame->seq, oldest->seq)))
+			{
+				oldest = frame;
+			}
+		}
+
+		if (!oldest)
+		{
+			return NULL;
+		}
+
+		// The consumer is too slow, overwrite the oldest unread frame.
+		// If the consumer grabs it before us, simply look again.
+		if (catcierge_atomic_cas(&oldest->state, CAPTURE_FRAME_READY, CAPTURE_FRAME_WRITING))
+		{
+			catcierge_atomic_add(&ct->overwritten, 1);
+			return oldest;
+		}
+	}
+}
+
+static void *catcierge_capture_thread_run(void *arg)
+{
+	IplImage *src;
+	double timestamp;
+	catcierge_capture_frame_t *frame;
+	catcierge_capture_thread_t *ct = (catcierge_capture_thread_t *)arg;
+	assert(ct);
+
+	while (catcierge_atomic_load(&ct->running))
+	{
+		src = ct->grab(ct->user);
+		timestamp = catcierge_timer_now();
+
+		if (!src)
+		{
+			// The grab callback can end the capture.
+			if (!catcierge_atomic_load(&ct->running))
+				break;
+
+			catcierge_atomic_add(&ct->dropped, 1);
+			catcierge_thread_sleep_ms(1);
+			continue;
+		}
+
+		if (!ct->frames[0].img && catcierge_capture_thread_alloc_frames(ct, src))
+		{
+			CATERR("Capture thread: Failed to allocate frame buffers\n");
+			break;
+		}
+
+		if (!(frame = catcierge_capture_thread_claim(ct)))
+		{
+			catcierge_atomic_add(&ct->dropped, 1);
+			continue;
+		}
+
+		// The camera was reopened or a replay changed resolution. Only
+		// the claimed buffer belongs to the producer, so the buffers are
+		// replaced one at a time as they are claimed. The frames already
+		// in the ring keep their old size until they are read.
+		if (catcierge_capture_thread_alloc_frame(frame, src))
+		{
+			CATERR("Capture thread: Failed to allocate a %dx%d frame buffer\n",
+				cvGetSize(src).width, cvGetSize(src).height);
+			catcierge_atomic_store(&frame->state, CAPTURE_FRAME_FREE);
+			break;
+		}
+
+		cvCopy(src, frame->img, NULL);
+		frame->seq = ++ct->next_seq;
+		frame->timestamp = timestamp;
+
+		catcierge_atomic_add(&ct->captured, 1);
+		catcierge_atomic_store(&frame->state, CAPTURE_FRAME_READY);
+	}
+
+	return NULL;
+}
+
+int catcierge_capture_thread_start(catcierge_capture_thread_t *ct)
+{
+	assert(ct);
+	assert(ct->frames);
+
+	catcierge_atomic_store(&ct->running, 1);
+
+	if (catcierge_thread_create(&ct->thread, catcierge_capture_thread_run, ct))
+	{
+		CATERR("Failed to start capture thread\n");
+		catcierge_atomic_store(&ct->running, 0);
+		return -1;
+	}
+
+	return 0;
+}
+
+void catcierge_capture_thread_stop(catcierge_capture_thread_t *ct)
+{
+	assert(ct);
+
+	catcierge_atomic_store(&ct->running, 0);
+	catcierge_thread_join(&ct->thread);
+}
+
+catcierge_capture_frame_t *catcierge_capture_thread_acquire(catcierge_capture_thread_t *ct, double timeout)
+{
+	size_t i;
+	unsigned long seq;
+	double start = catcierge_timer_now();
+	catcierge_capture_frame_t *frame;
+	catcierge_capture_frame_t *oldest;
+	assert(ct);
+
+	while (1)
+	{
+		oldest = NULL;
+
+		for (i = 0; i < ct->frame_count; i++)
+		{
+			frame = &ct->frames[i];
+
+			if ((catcierge_atomic_load(&frame->state) == CAPTURE_FRAME_READY)
+			 && (!oldest || SEQ_BEFORE(frame->seq, oldest->seq)))
+			{
+				oldest = frame;
+			}
+		}
+
+		if (oldest)
+		{
+			seq = oldest->seq;
+
+			if (catcierge_atomic_cas(&oldest->state, CAPTURE_FRAME_READY, CAPTURE_FRAME_READING))
+			{
+				// The producer might have overwritten the frame with a
+				// newer one between the scan and the CAS. In that case
+				// give it back, so that we always consume in order.
+				if (oldest->seq == seq)
+				{
+					catcierge_atomic_add(&ct->consumed, 1);
+					return oldest;
+				}
+
+				catcierge_atomic_store(&oldest->state, CAPTURE_FRAME_READY);
+			}
+
+			continue;
+		}
+
+		if (!catcierge_atomic_load(&ct->running)
+		 || ((timeout >= 0.0) && ((catcierge_timer_now() - start) >= timeout)))
+		{
+			return NULL;
+		}
+
+		catcierge_thread_sleep_ms(1);
+	}
+}
+
+void catcierge_capture_thread_release(catcierge_capture_thread_t *ct, catcierge_capture_frame_t *frame)
+{
+	assert(ct);
+
+	if (!frame)
+		return;
+
+	assert(catcierge_atomic_load(&frame->state) == CAPTURE_FRAME_READING);
+	catcierge_atomic_store(&frame->state, CAPTURE_FRAME_FREE);
+}
+
+void catcierge_capture_thread_get_stats(catcierge_capture_thread_t *ct, catcierge_capture_stats_t *stats)
+{
+	assert(ct);
+	assert(stats);
+
+	stats->captured = catcierge_atomic_load(&ct->captured);
+	stats->consumed = catcierge_atomic_load(&ct->consumed);
+	stats->overwritten = catcierge_atomic_load(&ct->overwritten);
+	stats->dropped = catcierge_atomic_load(&ct->dropped);
+}
@@ -0,0 +1,94 @@
+//
+// This file is part of the Catcierge project.
+//
+// Copyright (c) Joakim Soderberg 2013-2014
+//
+//    Catcierge is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    Catcierge is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Catcierge.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef __CATCIERGE_CAPTURE_THREAD_H__
+#define __CATCIERGE_CAPTURE_THREAD_H__
+
+#include <opencv2/imgproc/imgproc_c.h>
+#include "catcierge_thread.h"
+
+#define CATCIERGE_CAPTURE_DEFAULT_BUFFERS 4
+#define CATCIERGE_CAPTURE_MIN_BUFFERS 3	// One being written, one being read and one ready.
+#define CATCIERGE_CAPTURE_MAX_BUFFERS 32
+
+// Gets a frame from the camera. The returned image is owned by the
+// callback and is copied into the ring before the next call.
+// To end the capture, clear running and return NULL.
+typedef IplImage *(*catcierge_capture_grab_f)(void *user);
+
+typedef enum catcierge_capture_frame_state_e
+{
+	CAPTURE_FRAME_FREE = 0,
+	CAPTURE_FRAME_WRITING = 1,
+	CAPTURE_FRAME_READY = 2,
+	CAPTURE_FRAME_READING = 3
+} catcierge_capture_frame_state_t;
+
+typedef struct catcierge_capture_frame_s
+{
+	IplImage *img;			// Preallocated on the first captured frame, replaced if the frame size changes.
+	unsigned long seq;		// Sequence number, increases by 1 for each captured frame.
+	double timestamp;		// Monotonic capture time in seconds (see catcierge_timer_now).
+	volatile int state;		// catcierge_capture_frame_state_t, only changed atomically.
+} catcierge_capture_frame_t;
+
+typedef struct catcierge_capture_stats_s
+{
+	unsigned int captured;		// Frames put into the ring.
+	unsigned int consumed;		// Frames handed to the consumer.
+	unsigned int overwritten;	// Frames overwritten before the consumer got to them.
+	unsigned int dropped;		// Failed grabs from the camera.
+} catcierge_capture_stats_t;
+
+//
+// Single-producer/single-consumer frame ring. The capture thread
+// is the only producer and the state machine loop the only consumer.
+// When the consumer falls behind, the oldest unread frame is overwritten
+// so that the ring always contains the most recent frames in order.
+//
+typedef struct catcierge_capture_thread_s
+{
+	catcierge_capture_frame_t *frames;
+	size_t frame_count;
+
+	catcierge_capture_grab_f grab;
+	void *user;
+
+	catcierge_thread_t thread;
+	volatile int running;
+	unsigned long next_seq;
+
+	volatile unsigned int captured;
+	volatile unsigned int consumed;
+	volatile unsigned int overwritten;
+	volatile unsigned int dropped;
+} catcierge_capture_thread_t;
+
+int catcierge_capture_thread_init(catcierge_capture_thread_t *ct, size_t frame_count,
+		catcierge_capture_grab_f grab, void *user);
+void catcierge_capture_thread_destroy(catcierge_capture_thread_t *ct);
+
+int catcierge_capture_thread_start(catcierge_capture_thread_t *ct);
+void catcierge_capture_thread_stop(catcierge_capture_thread_t *ct);
+
+catcierge_capture_frame_t *catcierge_capture_thread_acquire(catcierge_capture_thread_t *ct, double timeout);
+void catcierge_capture_thread_release(catcierge_capture_thread_t *ct, catcierge_capture_frame_t *frame);
+
+void catcierge_capture_thread_get_stats(catcierge_capture_thread_t *ct, catcierge_capture_stats_t *stats);
+
+#endif // __CATCIERGE_CAPTURE_THREAD_H__
@@ -0,0 +1,550 @@
+//
+// This file is part of the Catcierge project.
+//
+// Copyright (c) Joakim Soderberg 2013-2014
+//
+//    Catcierge is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    Catcierge is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Catcierge.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <catcierge_config.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <stdint.h>
+#include "catcierge_ccl.h"
+#include "catcierge_log.h"
+
+#define CATCIERGE_CCL_INITIAL_LABELS 1024
+
+int catcierge_ccl_init(catcierge_ccl_t *ccl)
+{
+	assert(ccl);
+	memset(ccl, 0, sizeof(catcierge_ccl_t));
+
+	if (!(ccl->labels = malloc(CATCIERGE_CCL_INITIAL_LABELS * sizeof(catcierge_ccl_label_t)))
+	 || !(ccl->candidates = malloc(CATCIERGE_CCL_INITIAL_LABELS * sizeof(int))))
+	{
+		CATERR("Out of memory!\n");
+		catcierge_ccl_destroy(ccl);
+		return -1;
+	}
+
+	ccl->label_capacity = CATCIERGE_CCL_INITIAL_LABELS;
+
+	return 0;
+}
+
+void catcierge_ccl_destroy(catcierge_ccl_t *ccl)
+{
+	if (!ccl)
+		return;
+
+	free(ccl->labels);
+	free(ccl->runs);
+	free(ccl->candidates);
+	memset(ccl, 0, sizeof(catcierge_ccl_t));
+}
+
+size_t catcierge_ccl_memory(catcierge_ccl_t *ccl)
+{
+	assert(ccl);
+
+	return ccl->label_capacity * (sizeof(catcierge_ccl_label_t) + sizeof(int))
+		+ 2 * ccl->run_capacity * sizeof(catcierge_ccl_run_t);
+}
+
+static int catcierge_ccl_grow(catcierge_ccl_t *ccl)
+{
+	int capacity = ccl->label_capacity * 2;
+	catcierge_ccl_label_t *labels = NULL;
+	int *candidates = NULL;
+
+	if (!(labels = realloc(ccl->labels, capacity * sizeof(catcierge_ccl_label_t))))
+		return -1;
+
+	ccl->labels = labels;
+
+	if (!(candidates = realloc(ccl->candidates, capacity * sizeof(int))))
+		return -1;
+
+	ccl->candidates = candidates;
+	ccl->label_capacity = capacity;
+
+	return 0;
+}
+
+static int catcierge_ccl_find(catcierge_ccl_t *ccl, int l)
+{
+	int root = l;
+	int next;
+	catcierge_ccl_label_t *labels = ccl->labels;
+
+	while (labels[root].parent != root)
+		root = labels[root].parent;
+
+	while (labels[l].parent != root)
+	{
+		next = labels[l].parent;
+		labels[l].parent = root;
+		l = next;
+	}
+
+	return root;
+}
+
+static void catcierge_ccl_check_candidate(catcierge_ccl_t *ccl, int r, double min2)
+{
+	catcierge_ccl_label_t *label = &ccl->labels[r];
+
+	if (!label->candidate && (label->area2 > min2))
+	{
+		label->candidate = 1;
+		ccl->candidates[ccl->candidate_count++] = r;
+	}
+}
+
+static void catcierge_ccl_add_area(catcierge_ccl_t *ccl, int l, int area2, double min2)
+{
+	int r = catcierge_ccl_find(ccl, l);
+	ccl->labels[r].area2 += area2;
+	catcierge_ccl_check_candidate(ccl, r, min2);
+}
+
+static int catcierge_ccl_union(catcierge_ccl_t *ccl, int a, int b, double min2)
+{
+	int tmp;
+	catcierge_ccl_label_t *labels = ccl->labels;
+
+	a = catcierge_ccl_find(ccl, a);
+	b = catcierge_ccl_find(ccl, b);
+
+	if (a == b)
+		return a;
+
+	// Keep the oldest label as the root, it is the one that was
+	// created at the first pixel of the region.
+	if (b < a)
+	{
+		tmp = a;
+		a = b;
+		b = tmp;
+	}
+
+	labels[b].parent = a;
+	labels[a].area2 += labels[b].area2;
+	labels[a].border |= labels[b].border;
+
+	if (labels[b].last_y > labels[a].last_y)
+		labels[a].last_y = labels[b].last_y;
+
+	catcierge_ccl_check_candidate(ccl, a, min2);
+
+	return a;
+}
+
+static int catcierge_ccl_new_label(catcierge_ccl_t *ccl, int fg, int border, int encloser, int y)
+{
+	catcierge_ccl_label_t *label = NULL;
+
+	if ((ccl->label_count == ccl->label_capacity) && catcierge_ccl_grow(ccl))
+	{
+		CATERR("Out of memory!\n");
+		return -1;
+	}
+
+	label = &ccl->labels[ccl->label_count];
+	label->parent = ccl->label_count;
+	label->encloser = encloser;
+	label->area2 = 0;
+	label->last_y = y;
+	label->fg = (unsigned char)fg;
+	label->border = (unsigned char)border;
+	label->candidate = 0;
+	label->counted = 0;
+
+	return ccl->label_count++;
+}
+
+//
+// Adds how much of the 2x2 block with the current pixel in the lower
+// right corner is inside the contours of the regions in it, in halves.
+// For a non-zero region the block is inside if all 4 pixels are in
+// it, and half of it if 3 are. For a hole, where the contour goes
+// through the pixels around it, the block is half inside if 1 pixel
+// is in the hole and completely inside otherwise.
+//
+static void catcierge_ccl_add_block(catcierge_ccl_t *ccl, const int *fg, const int *l, double min2)
+{
+	int i;
+	int nfg = fg[0] + fg[1] + fg[2] + fg[3];
+	int bg = -1;
+
+	if ((nfg == 4) || (nfg == 0))
+	{
+		catcierge_ccl_add_area(ccl, l[3], 2, min2);
+		return;
+	}
+
+	if (nfg == 3)
+	{
+		for (i = 0; fg[i] == 0; i++);
+		catcierge_ccl_add_area(ccl, l[i], 1, min2);
+	}
+
+	for (i = 0; i < 4; i++)
+	{
+		if (!fg[i]) bg = i;
+	}
+
+	if (nfg == 3)
+	{
+		catcierge_ccl_add_area(ccl, l[bg], 1, min2);
+	}
+	else if ((nfg == 2) && !fg[0] && !fg[3])
+	{
+		// Diagonal pixels, these might be two different holes.
+		catcierge_ccl_add_area(ccl, l[0], 1, min2);
+		catcierge_ccl_add_area(ccl, l[3], 1, min2);
+	}
+	else if ((nfg == 2) && !fg[1] && !fg[2])
+	{
+		catcierge_ccl_add_area(ccl, l[1], 1, min2);
+		catcierge_ccl_add_area(ccl, l[2], 1, min2);
+	}
+	else
+	{
+		catcierge_ccl_add_area(ccl, l[bg], 2, min2);
+	}
+}
+
+//
+// Counts the candidates that are finished, that is regions that
+// have no pixels on row y, and drops those from the list.
+//
+static int catcierge_ccl_count_finished(catcierge_ccl_t *ccl, int y, int *count, int max_count)
+{
+	int i;
+	int r;
+	int n = 0;
+	catcierge_ccl_label_t *label = NULL;
+
+	for (i = 0; i < ccl->candidate_count; i++)
+	{
+		r = catcierge_ccl_find(ccl, ccl->candidates[i]);
+		label = &ccl->labels[r];
+
+		if (label->counted)
+			continue;
+
+		if (label->last_y < y)
+		{
+			// Regions of zeros touching the border are not holes.
+			if (label->fg || !label->border)
+			{
+				label->counted = 1;
+
+				if (++(*count) >= max_count)
+					return 1;
+			}
+
+			continue;
+		}
+
+		ccl->candidates[n++] = r;
+	}
+
+	ccl->candidate_count = n;
+
+	return 0;
+}
+
+//
+// Splits a row into runs of zero and non-zero pixels.
+//
+static int catcierge_ccl_find_runs(catcierge_ccl_run_t *runs,
+		const unsigned char *row, int y, int width, int height)
+{
+	int x;
+	int n = 0;
+	int fg;
+	uint64_t word;
+
+	runs[0].start = 0;
+	runs[0].fg = 0;
+
+	if ((y > 0) && (y < (height - 1)))
+	{
+		for (x = 1; x < (width - 1); x++)
+		{
+			// Skip 8 pixels at a time inside long runs. Non-zero
+			// pixels are only skipped like this if they are 255,
+			// which they are in a thresholded image.
+			while ((x + 8) <= (width - 1))
+			{
+				memcpy(&word, row + x, sizeof(word));
+
+				if (word != (runs[n].fg ? ~(uint64_t)0 : 0))
+					break;
+
+				x += 8;
+			}
+
+			if (x >= (width - 1))
+				break;
+
+			fg = (row[x] != 0);
+
+			if (fg != runs[n].fg)
+			{
+				runs[n].end = x - 1;
+				n++;
+				runs[n].start = x;
+				runs[n].fg = fg;
+			}
+		}
+
+		// The last pixel is always zero.
+		if (runs[n].fg)
+		{
+			runs[n].end = width - 2;
+			n++;
+			runs[n].start = width - 1;
+			runs[n].fg = 0;
+		}
+	}
+
+	runs[n].end = width - 1;
+
+	return n + 1;
+}
+
+//
+// Labels the runs of the current row, connecting them to the
+// runs of the same kind in the row above.
+//
+static int catcierge_ccl_label_runs(catcierge_ccl_t *ccl,
+		catcierge_ccl_run_t *prev, int prev_count,
+		catcierge_ccl_run_t *cur, int cur_count,
+		int y, int width, int height, double min2)
+{
+	int i = 0;
+	int j;
+	int k;
+	int l;
+	int ext;
+	int border;
+	catcierge_ccl_label_t *label = NULL;
+
+	for (j = 0; j < cur_count; j++)
+	{
+		l = -1;
+
+		// Non-zero pixels are 8-connected, so they connect diagonally
+		// as well, the zero pixels are 4-connected.
+		ext = cur[j].fg ? 1 : 0;
+
+		if (prev)
+		{
+			while (prev[i].end < (cur[j].start - ext))
+				i++;
+
+			for (k = i; (k < prev_count) && (prev[k].start <= (cur[j].end + ext)); k++)
+			{
+				if (prev[k].fg != cur[j].fg)
+					continue;
+
+				l = (l < 0) ? prev[k].label : catcierge_ccl_union(ccl, l, prev[k].label, min2);
+			}
+		}
+
+		border = !cur[j].fg && ((y == 0) || (y == (height - 1))
+				|| (cur[j].start == 0) || (cur[j].end == (width - 1)));
+
+		if (l < 0)
+		{
+			// First pixel of a new region, the pixel above it
+			// belongs to the region around it.
+			if ((l = catcierge_ccl_new_label(ccl, cur[j].fg, border, prev ? prev[i].label : -1, y)) < 0)
+				return -1;
+		}
+		else
+		{
+			label = &ccl->labels[catcierge_ccl_find(ccl, l)];
+			label->last_y = y;
+			label->border |= border;
+		}
+
+		cur[j].label = l;
+	}
+
+	return 0;
+}
+
+//
+// Adds the area of all the 2x2 blocks between the previous and
+// current row. Within the overlap of two runs every block is the
+// same, so only the blocks where a run starts are added one by one.
+//
+static void catcierge_ccl_add_blocks(catcierge_ccl_t *ccl,
+		catcierge_ccl_run_t *prev, int prev_count,
+		catcierge_ccl_run_t *cur, int cur_count, double min2)
+{
+	int i = 0;
+	int j = 0;
+	int last_i = -1;
+	int last_j = -1;
+	int start;
+	int end;
+	int fg[4];
+	int lbl[4];
+
+	while ((i < prev_count) && (j < cur_count))
+	{
+		start = (prev[i].start > cur[j].start) ? prev[i].start : cur[j].start;
+		end = (prev[i].end < cur[j].end) ? prev[i].end : cur[j].end;
+
+		if (last_i >= 0)
+		{
+			fg[0] = prev[last_i].fg;
+			fg[1] = prev[i].fg;
+			fg[2] = cur[last_j].fg;
+			fg[3] = cur[j].fg;
+			lbl[0] = prev[last_i].label;
+			lbl[1] = prev[i].label;
+			lbl[2] = cur[last_j].label;
+			lbl[3] = cur[j].label;
+			catcierge_ccl_add_block(ccl, fg, lbl, min2);
+		}
+
+		if (end > start)
+		{
+			// Both rows the same, or one zero and one non-zero
+			// row where the zeros are completely inside.
+			catcierge_ccl_add_area(ccl,
+				(prev[i].fg == cur[j].fg) ? cur[j].label : (cur[j].fg ? prev[i].label : cur[j].label),
+				2 * (end - start), min2);
+		}
+
+		last_i = i;
+		last_j = j;
+
+		if (prev[i].end == end) i++;
+		if (cur[j].end == end) j++;
+	}
+}
+
+int catcierge_ccl_count(catcierge_ccl_t *ccl, const unsigned char *data,
+		int step, int width, int height, double min_area, int max_count)
+{
+	int y;
+	int i;
+	int count = 0;
+	int prev_count = 0;
+	int cur_count = 0;
+	catcierge_ccl_run_t *runs = NULL;
+	catcierge_ccl_run_t *prev = NULL;
+	catcierge_ccl_run_t *cur = NULL;
+	catcierge_ccl_run_t *tmp = NULL;
+	catcierge_ccl_label_t *label = NULL;
+	double min2 = 2.0 * min_area;
+	assert(ccl);
+	assert(ccl->labels);
+
+	if (!data || (width <= 0) || (height <= 0) || (step < width))
+		return -1;
+
+	if (width > ccl->run_capacity)
+	{
+		if (!(runs = realloc(ccl->runs, 2 * width * sizeof(catcierge_ccl_run_t))))
+		{
+			CATERR("Out of memory!\n");
+			return -1;
+		}
+
+		ccl->runs = runs;
+		ccl->run_capacity = width;
+	}
+
+	cur = ccl->runs;
+	tmp = ccl->runs + width;
+	ccl->label_count = 0;
+	ccl->candidate_count = 0;
+
+	for (y = 0; y < height; y++)
+	{
+		cur_count = catcierge_ccl_find_runs(cur, data + y * step, y, width, height);
+
+		if (catcierge_ccl_label_runs(ccl, prev, prev_count, cur, cur_count, y, width, height, min2))
+			return -1;
+
+		if (prev)
+		{
+			catcierge_ccl_add_blocks(ccl, prev, prev_count, cur, cur_count, min2);
+
+			if ((max_count > 0) && ccl->candidate_count
+				&& catcierge_ccl_count_finished(ccl, y, &count, max_count))
+			{
+				return count;
+			}
+		}
+
+		prev = cur;
+		prev_count = cur_count;
+		cur = tmp;
+		tmp = prev;
+	}
+
+	// A region always has a higher label than the one around it, so
+	// going backwards the enclosed area is complete before it is added.
+	for (i = ccl->label_count - 1; i >= 0; i--)
+	{
+		label = &ccl->labels[i];
+
+		if ((label->parent == i) && (label->encloser >= 0))
+		{
+			ccl->labels[catcierge_ccl_find(ccl, label->encloser)].area2 += label->area2;
+		}
+	}
+
+	count = 0;
+
+	for (i = 0; i < ccl->label_count; i++)
+	{
+		label = &ccl->labels[i];
+
+		if ((label->parent == i) && (label->fg || !label->border) && (label->area2 > min2))
+		{
+			count++;
+		}
+	}
+
+	return count;
+}
+
+int catcierge_ccl_count_image(catcierge_ccl_t *ccl, IplImage *img,
+		double min_area, int max_count)
+{
+	CvRect roi;
+	assert(ccl);
+	assert(img);
+
+	if ((img->depth != IPL_DEPTH_8U) || (img->nChannels != 1))
+		return -1;
+
+	roi = cvGetImageROI(img);
+
+	return catcierge_ccl_count(ccl,
+		(const unsigned char *)img->imageData + roi.y * img->widthStep + roi.x,
+		img->widthStep, roi.width, roi.height, min_area, max_count);
+}
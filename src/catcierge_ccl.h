@@ -0,0 +1,95 @@
+//
+// This file is part of the Catcierge project.
+//
+// Copyright (c) Joakim Soderberg 2013-2014
+//
+//    Catcierge is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    Catcierge is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Catcierge.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef __CATCIERGE_CCL_H__
+#define __CATCIERGE_CCL_H__
+
+#include <opencv2/imgproc/imgproc_c.h>
+
+//
+// Connected component labeling for counting the contours in a binary
+// image, without tracing them.
+//
+// Gives the same count as cvFindContours with CV_RETR_LIST followed by
+// cvContourArea on each contour: every 8-connected region of non-zero
+// pixels is one contour, and so is every 4-connected hole inside one.
+// Like cvFindContours the outermost pixels of the image count as zero.
+//
+// The image is labeled in a single pass using union-find, one run of
+// equal pixels at a time, keeping only two rows of runs. The contour area is the area of the polygon
+// through the border pixel centers. It is accumulated per label as the
+// image is scanned, from how much of each 2x2 pixel block is inside
+// the polygon, and the area of the regions enclosed by a contour is
+// added at the end.
+//
+
+typedef struct catcierge_ccl_label_s
+{
+	int parent;				// Union-find parent.
+	int encloser;			// Label of the region around this one, -1 for none.
+	int area2;				// Twice the area, not counting enclosed regions.
+	int last_y;				// Last row with a pixel in the region.
+	unsigned char fg;		// Non-zero pixels.
+	unsigned char border;	// Touches the image border, not a hole.
+	unsigned char candidate;
+	unsigned char counted;
+} catcierge_ccl_label_t;
+
+typedef struct catcierge_ccl_run_s
+{
+	int start;
+	int end;				// Last pixel in the run.
+	int fg;
+	int label;
+} catcierge_ccl_run_t;
+
+typedef struct catcierge_ccl_s
+{
+	catcierge_ccl_label_t *labels;
+	int label_count;
+	int label_capacity;
+	catcierge_ccl_run_t *runs;	// Runs of the previous and current row.
+	int run_capacity;
+	int *candidates;		// Labels large enough to count once finished.
+	int candidate_count;
+} catcierge_ccl_t;
+
+int catcierge_ccl_init(catcierge_ccl_t *ccl);
+void catcierge_ccl_destroy(catcierge_ccl_t *ccl);
+
+// Bytes allocated for labels and runs.
+size_t catcierge_ccl_memory(catcierge_ccl_t *ccl);
+
+//
+// Counts the contours with an area larger than min_area in a width x
+// height 8-bit image, where data points at the first pixel and step is
+// the row size in bytes.
+//
+// If max_count > 0 the counting stops as soon as that many contours
+// have been found, so the result is only exact below max_count.
+//
+// Returns -1 on error.
+//
+int catcierge_ccl_count(catcierge_ccl_t *ccl, const unsigned char *data,
+		int step, int width, int height, double min_area, int max_count);
+
+// Same as above for the ROI of an 8-bit single channel image.
+int catcierge_ccl_count_image(catcierge_ccl_t *ccl, IplImage *img,
+		double min_area, int max_count);
+
+#endif // __CATCIERGE_CCL_H__
@@ -0,0 +1,239 @@
+//
+// This file is part of the Catcierge project.
+//
+// Copyright (c) Joakim Soderberg 2013-2014
+//
+//    Catcierge is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    Catcierge is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Catcierge.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <catcierge_config.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <float.h>
+#include <assert.h>
+#include "catcierge_fft_match.h"
+#include "catcierge_log.h"
+
+int catcierge_fft_frame_init(catcierge_fft_frame_t *f, int width, int height)
+{
+	CvSize dft_size;
+	assert(f);
+
+	memset(f, 0, sizeof(catcierge_fft_frame_t));
+	f->width = width;
+	f->height = height;
+
+	dft_size = cvSize(cvGetOptimalDFTSize(width), cvGetOptimalDFTSize(height));
+
+	if (!(f->padded = cvCreateImage(dft_size, IPL_DEPTH_32F, 1))
+	 || !(f->spectrum = cvCreateImage(dft_size, IPL_DEPTH_32F, 1))
+	 || !(f->sum = cvCreateImage(cvSize(width + 1, height + 1), IPL_DEPTH_64F, 1))
+	 || !(f->sqsum = cvCreateImage(cvSize(width + 1, height + 1), IPL_DEPTH_64F, 1)))
+	{
+		CATERR("Out of memory!\n");
+		catcierge_fft_frame_destroy(f);
+		return -1;
+	}
+
+	// Only the frame part is written, the padding stays zero.
+	cvSetZero(f->padded);
+
+	return 0;
+}
+
+void catcierge_fft_frame_destroy(catcierge_fft_frame_t *f)
+{
+	assert(f);
+
+	if (f->padded) cvReleaseImage(&f->padded);
+	if (f->spectrum) cvReleaseImage(&f->spectrum);
+	if (f->sum) cvReleaseImage(&f->sum);
+	if (f->sqsum) cvReleaseImage(&f->sqsum);
+}
+
+int catcierge_fft_frame_set(catcierge_fft_frame_t *f, IplImage *img)
+{
+	assert(f);
+	assert(img);
+
+	if ((img->width != f->width) || (img->height != f->height)
+		|| (img->nChannels != 1) || (img->depth != IPL_DEPTH_8U))
+	{
+		CATERR("FFT match needs a %dx%d 8-bit gray image\n", f->width, f->height);
+		return -1;
+	}
+
+	cvSetImageROI(f->padded, cvRect(0, 0, f->width, f->height));
+	cvConvert(img, f->padded);
+	cvResetImageROI(f->padded);
+
+	cvDFT(f->padded, f->spectrum, CV_DXT_FORWARD, f->height);
+	cvIntegral(img, f->sum, f->sqsum, NULL);
+
+	return 0;
+}
+
+int catcierge_fft_template_init(catcierge_fft_template_t *t,
+		catcierge_fft_frame_t *f, IplImage *templ)
+{
+	int x;
+	int y;
+	double area;
+	double sum = 0.0;
+	double sqsum = 0.0;
+	double mean;
+	double var;
+	const unsigned char *row;
+	IplImage *padded = NULL;
+	assert(t);
+	assert(f);
+	assert(f->padded);
+	assert(templ);
+
+	memset(t, 0, sizeof(catcierge_fft_template_t));
+
+	if ((templ->nChannels != 1) || (templ->depth != IPL_DEPTH_8U)
+		|| (templ->width > f->width) || (templ->height > f->height))
+	{
+		CATERR("FFT match template must be 8-bit gray and fit in %dx%d\n",
+			f->width, f->height);
+		return -1;
+	}
+
+	t->width = templ->width;
+	t->height = templ->height;
+	area = (double)t->width * t->height;
+
+	for (y = 0; y < t->height; y++)
+	{
+		row = (const unsigned char *)templ->imageData + y * templ->widthStep;
+
+		for (x = 0; x < t->width; x++)
+		{
+			sum += row[x];
+			sqsum += (double)row[x] * row[x];
+		}
+	}
+
+	mean = sum / area;
+	var = sqsum - sum * mean;
+	t->norm = (var > 0.0) ? sqrt(var) : 0.0;
+	t->flat = (t->norm < DBL_EPSILON);
+
+	if (!(padded = cvCreateImage(cvGetSize(f->padded), IPL_DEPTH_32F, 1))
+	 || !(t->spectrum = cvCreateImage(cvGetSize(f->padded), IPL_DEPTH_32F, 1))
+	 || !(t->product = cvCreateImage(cvGetSize(f->padded), IPL_DEPTH_32F, 1)))
+	{
+		CATERR("Out of memory!\n");
+		if (padded) cvReleaseImage(&padded);
+		catcierge_fft_template_destroy(t);
+		return -1;
+	}
+
+	// With a zero mean template the correlation is directly the
+	// numerator of the correlation coefficient.
+	cvSetZero(padded);
+	cvSetImageROI(padded, cvRect(0, 0, t->width, t->height));
+	cvConvertScale(templ, padded, 1.0, -mean);
+	cvResetImageROI(padded);
+
+	cvDFT(padded, t->spectrum, CV_DXT_FORWARD, t->height);
+	cvReleaseImage(&padded);
+
+	return 0;
+}
+
+void catcierge_fft_template_destroy(catcierge_fft_template_t *t)
+{
+	assert(t);
+
+	if (t->spectrum) cvReleaseImage(&t->spectrum);
+	if (t->product) cvReleaseImage(&t->product);
+}
+
+int catcierge_fft_match(catcierge_fft_frame_t *f,
+		catcierge_fft_template_t *t, IplImage *result)
+{
+	int x;
+	int y;
+	int rw;
+	int rh;
+	double area;
+	double s;
+	double s2;
+	double var;
+	double denom;
+	double num;
+	const double *sum0;
+	const double *sum1;
+	const double *sqsum0;
+	const double *sqsum1;
+	const float *corr;
+	float *res;
+	assert(f);
+	assert(t);
+	assert(result);
+
+	rw = f->width - t->width + 1;
+	rh = f->height - t->height + 1;
+
+	if ((result->width != rw) || (result->height != rh)
+		|| (result->depth != IPL_DEPTH_32F) || (result->nChannels != 1))
+	{
+		CATERR("FFT match result must be a %dx%d 32F image\n", rw, rh);
+		return -1;
+	}
+
+	if (t->flat)
+	{
+		cvSet(result, cvScalarAll(1.0), NULL);
+		return 0;
+	}
+
+	cvMulSpectrums(f->spectrum, t->spectrum, t->product, CV_DXT_MUL_CONJ);
+	cvDFT(t->product, t->product, CV_DXT_INV_SCALE, rh);
+
+	area = (double)t->width * t->height;
+
+	for (y = 0; y < rh; y++)
+	{
+		sum0 = (const double *)(f->sum->imageData + y * f->sum->widthStep);
+		sum1 = (const double *)(f->sum->imageData + (y + t->height) * f->sum->widthStep);
+		sqsum0 = (const double *)(f->sqsum->imageData + y * f->sqsum->widthStep);
+		sqsum1 = (const double *)(f->sqsum->imageData + (y + t->height) * f->sqsum->widthStep);
+		corr = (const float *)(t->product->imageData + y * t->product->widthStep);
+		res = (float *)(result->imageData + y * result->widthStep);
+
+		for (x = 0; x < rw; x++)
+		{
+			s = sum1[x + t->width] - sum0[x + t->width] - sum1[x] + sum0[x];
+			s2 = sqsum1[x + t->width] - sqsum0[x + t->width] - sqsum1[x] + sqsum0[x];
+			var = s2 - s * s / area;
+			denom = (var > 0.0) ? (sqrt(var) * t->norm) : 0.0;
+			num = corr[x];
+
+			// Same handling of (nearly) flat windows as cvMatchTemplate.
+			if (fabs(num) < denom)
+				num /= denom;
+			else if (fabs(num) < denom * 1.125)
+				num = (num > 0.0) ? 1.0 : -1.0;
+			else
+				num = 0.0;
+
+			res[x] = (float)num;
+		}
+	}
+
+	return 0;
+}
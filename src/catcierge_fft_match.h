@@ -0,0 +1,76 @@
+//
+// This file is part of the Catcierge project.
+//
+// Copyright (c) Joakim Soderberg 2013-2014
+//
+//    Catcierge is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    Catcierge is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Catcierge.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef __CATCIERGE_FFT_MATCH_H__
+#define __CATCIERGE_FFT_MATCH_H__
+
+#include <opencv2/imgproc/imgproc_c.h>
+
+//
+// Template matching in the frequency domain, giving the same scores as
+// cvMatchTemplate with CV_TM_CCOEFF_NORMED (within float precision).
+//
+// The templates are fixed, so their spectrum is calculated once up
+// front. For each frame only the frame itself is transformed, once,
+// and then reused for every template. The normalization uses integral
+// images of the frame that are shared by all the templates as well.
+//
+// All the transforms have the same size, the smallest fast DFT size
+// that fits the frame. Since only the correlation positions where the
+// template is completely inside the frame are used, the circular
+// correlation never wraps into the result.
+//
+
+typedef struct catcierge_fft_frame_s
+{
+	int width;			// Size of the frames to match.
+	int height;
+	IplImage *padded;	// 32F frame padded to the DFT size.
+	IplImage *spectrum;	// Spectrum of the current frame.
+	IplImage *sum;		// 64F integral images of the current frame.
+	IplImage *sqsum;
+} catcierge_fft_frame_t;
+
+typedef struct catcierge_fft_template_s
+{
+	int width;
+	int height;
+	int flat;			// Template has a single value, everything matches.
+	double norm;		// sqrt(sum((T - mean(T))^2))
+	IplImage *spectrum;	// Spectrum of the zero mean template.
+	IplImage *product;	// Correlation buffer, so templates can be matched in parallel.
+} catcierge_fft_template_t;
+
+int catcierge_fft_frame_init(catcierge_fft_frame_t *f, int width, int height);
+void catcierge_fft_frame_destroy(catcierge_fft_frame_t *f);
+
+// Transforms an 8-bit gray frame, must be done before matching any
+// templates against it.
+int catcierge_fft_frame_set(catcierge_fft_frame_t *f, IplImage *img);
+
+int catcierge_fft_template_init(catcierge_fft_template_t *t,
+		catcierge_fft_frame_t *f, IplImage *templ);
+void catcierge_fft_template_destroy(catcierge_fft_template_t *t);
+
+// Writes the normalized correlation coefficients to result, which must be
+// a 32F image of (width - template width + 1) x (height - template height + 1).
+// Different templates can be matched from different threads at the same time.
+int catcierge_fft_match(catcierge_fft_frame_t *f,
+		catcierge_fft_template_t *t, IplImage *result);
+
+#endif // __CATCIERGE_FFT_MATCH_H__
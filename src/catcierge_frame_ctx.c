@@ -0,0 +1,200 @@
+//
+// This file is part of the Catcierge project.
+//
+// Copyright (c) Joakim Soderberg 2013-2014
+//
+//    Catcierge is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    Catcierge is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Catcierge.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <catcierge_config.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include "catcierge_frame_ctx.h"
+#include "catcierge_log.h"
+
+void catcierge_frame_ctx_init(catcierge_frame_ctx_t *f)
+{
+	assert(f);
+	memset(f, 0, sizeof(catcierge_frame_ctx_t));
+}
+
+void catcierge_frame_ctx_destroy(catcierge_frame_ctx_t *f)
+{
+	assert(f);
+
+	if (f->gray) cvReleaseImage(&f->gray);
+	if (f->eq) cvReleaseImage(&f->eq);
+	if (f->thr) cvReleaseImage(&f->thr);
+	if (f->copy) cvReleaseImage(&f->copy);
+
+	f->img = NULL;
+	f->valid = 0;
+}
+
+void catcierge_frame_ctx_set(catcierge_frame_ctx_t *f, IplImage *img)
+{
+	assert(f);
+
+	f->img = img;
+	f->valid = 0;
+
+	if (img)
+		f->stats.frames++;
+}
+
+//
+// Makes sure *plane is an image of the given size and channel count,
+// keeping the old buffer when it already fits.
+//
+static IplImage *catcierge_frame_ctx_plane(IplImage **plane, CvSize size, int channels)
+{
+	if (*plane
+		&& (((*plane)->width != size.width)
+		 || ((*plane)->height != size.height)
+		 || ((*plane)->nChannels != channels)))
+	{
+		cvReleaseImage(plane);
+	}
+
+	if (!*plane && !(*plane = cvCreateImage(size, IPL_DEPTH_8U, channels)))
+	{
+		CATERR("Out of memory!\n");
+		return NULL;
+	}
+
+	cvResetImageROI(*plane);
+
+	return *plane;
+}
+
+IplImage *catcierge_frame_ctx_gray(catcierge_frame_ctx_t *f)
+{
+	assert(f);
+
+	if (!f->img)
+		return NULL;
+
+	if (f->img->nChannels == 1)
+		return f->img;
+
+	if (f->valid & CATCIERGE_PLANE_GRAY)
+	{
+		f->stats.gray_hits++;
+		cvResetImageROI(f->gray);
+		return f->gray;
+	}
+
+	if (!catcierge_frame_ctx_plane(&f->gray, cvGetSize(f->img), 1))
+		return NULL;
+
+	cvCvtColor(f->img, f->gray, (f->img->nChannels == 4) ? CV_BGRA2GRAY : CV_BGR2GRAY);
+	f->valid |= CATCIERGE_PLANE_GRAY;
+	f->stats.gray_computed++;
+
+	return f->gray;
+}
+
+IplImage *catcierge_frame_ctx_equalized(catcierge_frame_ctx_t *f)
+{
+	IplImage *gray;
+	assert(f);
+
+	if (f->valid & CATCIERGE_PLANE_EQ)
+	{
+		f->stats.eq_hits++;
+		cvResetImageROI(f->eq);
+		return f->eq;
+	}
+
+	if (!(gray = catcierge_frame_ctx_gray(f)))
+		return NULL;
+
+	if (!catcierge_frame_ctx_plane(&f->eq, cvGetSize(gray), 1))
+		return NULL;
+
+	cvEqualizeHist(gray, f->eq);
+	f->valid |= CATCIERGE_PLANE_EQ;
+	f->stats.eq_computed++;
+
+	return f->eq;
+}
+
+IplImage *catcierge_frame_ctx_threshold(catcierge_frame_ctx_t *f, int low, int high)
+{
+	IplImage *gray;
+	assert(f);
+
+	if ((f->valid & CATCIERGE_PLANE_THR)
+		&& (f->thr_low == low) && (f->thr_high == high))
+	{
+		f->stats.thr_hits++;
+		cvResetImageROI(f->thr);
+		return f->thr;
+	}
+
+	if (!(gray = catcierge_frame_ctx_gray(f)))
+		return NULL;
+
+	if (!catcierge_frame_ctx_plane(&f->thr, cvGetSize(gray), 1))
+		return NULL;
+
+	cvThreshold(gray, f->thr, low, high, CV_THRESH_BINARY);
+	f->thr_low = low;
+	f->thr_high = high;
+	f->valid |= CATCIERGE_PLANE_THR;
+	f->stats.thr_computed++;
+
+	return f->thr;
+}
+
+IplImage *catcierge_frame_ctx_luma(catcierge_frame_ctx_t *f)
+{
+	assert(f);
+
+	if (f->valid & CATCIERGE_PLANE_GRAY)
+	{
+		f->stats.gray_hits++;
+		cvResetImageROI(f->gray);
+		return f->gray;
+	}
+
+	return f->img;
+}
+
+IplImage *catcierge_frame_ctx_copy(catcierge_frame_ctx_t *f)
+{
+	assert(f);
+
+	if (!f->img)
+		return NULL;
+
+	if (!catcierge_frame_ctx_plane(&f->copy, cvGetSize(f->img), f->img->nChannels))
+		return NULL;
+
+	cvCopy(f->img, f->copy, NULL);
+
+	return f->copy;
+}
+
+void catcierge_frame_ctx_print_stats(catcierge_frame_ctx_t *f)
+{
+	assert(f);
+
+	CATLOG("Frame planes: %lu frames, gray %lu computed %lu reused, "
+		"equalized %lu computed %lu reused, threshold %lu computed %lu reused\n",
+		f->stats.frames,
+		f->stats.gray_computed, f->stats.gray_hits,
+		f->stats.eq_computed, f->stats.eq_hits,
+		f->stats.thr_computed, f->stats.thr_hits);
+}
@@ -0,0 +1,89 @@
+//
+// This file is part of the Catcierge project.
+//
+// Copyright (c) Joakim Soderberg 2013-2014
+//
+//    Catcierge is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    Catcierge is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Catcierge.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef __CATCIERGE_FRAME_CTX_H__
+#define __CATCIERGE_FRAME_CTX_H__
+
+#include <opencv2/imgproc/imgproc_c.h>
+
+typedef struct catcierge_frame_ctx_stats_s
+{
+	unsigned long frames;
+	unsigned long gray_computed;	// Times a plane was computed.
+	unsigned long eq_computed;
+	unsigned long thr_computed;
+	unsigned long gray_hits;		// Times a cached plane was reused.
+	unsigned long eq_hits;
+	unsigned long thr_hits;
+} catcierge_frame_ctx_stats_t;
+
+//
+// Per frame context shared by everything that looks at the current
+// frame (obstruction check, matchers, recorder and GUI). The derived
+// grayscale, equalized and thresholded planes are computed lazily,
+// at most once per frame, and cached until the next frame is set.
+// The plane buffers are owned by the context and reused between
+// frames of the same size, so the returned images must not be
+// released or modified. Setting an ROI is fine, it is reset the
+// next time the plane is handed out.
+//
+typedef struct catcierge_frame_ctx_s
+{
+	IplImage *img;		// The current frame, not owned.
+	IplImage *gray;
+	IplImage *eq;
+	IplImage *thr;
+	IplImage *copy;		// Scratch copy of the frame to draw on.
+	int valid;			// CATCIERGE_PLANE_* flags cached for the current frame.
+	int thr_low;		// Levels the cached threshold plane was made with.
+	int thr_high;
+	catcierge_frame_ctx_stats_t stats;
+} catcierge_frame_ctx_t;
+
+#define CATCIERGE_PLANE_GRAY	(1 << 0)
+#define CATCIERGE_PLANE_EQ		(1 << 1)
+#define CATCIERGE_PLANE_THR		(1 << 2)
+
+void catcierge_frame_ctx_init(catcierge_frame_ctx_t *f);
+void catcierge_frame_ctx_destroy(catcierge_frame_ctx_t *f);
+
+// Start working on a new frame, this drops all cached planes.
+void catcierge_frame_ctx_set(catcierge_frame_ctx_t *f, IplImage *img);
+
+// 8-bit grayscale version of the frame. This is the frame itself
+// if it already is grayscale.
+IplImage *catcierge_frame_ctx_gray(catcierge_frame_ctx_t *f);
+
+// Grayscale frame with an equalized histogram.
+IplImage *catcierge_frame_ctx_equalized(catcierge_frame_ctx_t *f);
+
+// Binary threshold (CV_THRESH_BINARY) of the grayscale frame.
+IplImage *catcierge_frame_ctx_threshold(catcierge_frame_ctx_t *f, int low, int high);
+
+// The grayscale plane if it is already available, otherwise the
+// frame itself. For consumers that can work on either, so that
+// they never trigger a conversion on their own.
+IplImage *catcierge_frame_ctx_luma(catcierge_frame_ctx_t *f);
+
+// Copy of the frame that can be drawn on, reuses the same buffer
+// every frame.
+IplImage *catcierge_frame_ctx_copy(catcierge_frame_ctx_t *f);
+
+void catcierge_frame_ctx_print_stats(catcierge_frame_ctx_t *f);
+
+#endif // __CATCIERGE_FRAME_CTX_H__
@@ -0,0 +1,365 @@
+//
+// This file is part of the Catcierge project.
+//
+// Copyright (c) Joakim Soderberg 2013-2014
+//
+//    Catcierge is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    Catcierge is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Catcierge.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <catcierge_config.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include "catcierge_frame_source.h"
+#include "catcierge_timer.h"
+#include "catcierge_thread.h"
+#include "catcierge_log.h"
+
+const char *catcierge_frame_source_type_str(catcierge_frame_source_type_t type)
+{
+	switch (type)
+	{
+		case FRAME_SOURCE_CAMERA: return "camera";
+		case FRAME_SOURCE_DIRECTORY: return "dir";
+		case FRAME_SOURCE_RAW: return "raw";
+		case FRAME_SOURCE_RECORDING: return "rec";
+	}
+
+	return "unknown";
+}
+
+int catcierge_frame_source_init(catcierge_frame_source_t *src, catcierge_frame_source_args_t *args)
+{
+	assert(src);
+	assert(args);
+
+	memset(src, 0, sizeof(catcierge_frame_source_t));
+	src->args = args;
+	src->type = args->type;
+
+	switch (args->type)
+	{
+		case FRAME_SOURCE_CAMERA: catcierge_camera_source_init(src); break;
+		case FRAME_SOURCE_DIRECTORY: catcierge_dir_source_init(src); break;
+		case FRAME_SOURCE_RAW: catcierge_raw_source_init(src); break;
+		case FRAME_SOURCE_RECORDING: catcierge_rec_source_init(src); break;
+		default:
+		{
+			CATERR("Invalid frame source type %d\n", args->type);
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+int catcierge_frame_source_open(catcierge_frame_source_t *src)
+{
+	assert(src);
+	assert(src->open);
+
+	src->eof = 0;
+	src->frame_count = 0;
+	src->next_frame_time = 0.0;
+
+	if (src->open(src))
+	{
+		CATERR("Failed to open %s frame source\n", src->name);
+		return -1;
+	}
+
+	src->is_open = 1;
+
+	return 0;
+}
+
+static void catcierge_frame_source_throttle(catcierge_frame_source_t *src)
+{
+	double now;
+	double wait;
+
+	// The camera sets its own pace.
+	if ((src->type == FRAME_SOURCE_CAMERA) || (src->args->fps <= 0.0))
+		return;
+
+	now = catcierge_timer_now();
+
+	if (src->next_frame_time > now)
+	{
+		wait = src->next_frame_time - now;
+		catcierge_thread_sleep_ms((int)(wait * 1000.0));
+	}
+	else
+	{
+		// We're behind, don't try to catch up.
+		src->next_frame_time = now;
+	}
+
+	src->next_frame_time += 1.0 / src->args->fps;
+}
+
+IplImage *catcierge_frame_source_next(catcierge_frame_source_t *src)
+{
+	IplImage *img;
+	assert(src);
+
+	if (!src->is_open || src->eof)
+		return NULL;
+
+	catcierge_frame_source_throttle(src);
+
+	if ((img = src->next_frame(src)))
+	{
+		src->frame_count++;
+	}
+
+	return img;
+}
+
+void catcierge_frame_source_release(catcierge_frame_source_t *src, IplImage *img)
+{
+	assert(src);
+
+	if (img && src->release)
+	{
+		src->release(src, img);
+	}
+}
+
+void catcierge_frame_source_close(catcierge_frame_source_t *src)
+{
+	assert(src);
+
+	if (src->is_open && src->close)
+	{
+		src->close(src);
+	}
+
+	src->is_open = 0;
+	src->ctx = NULL;
+}
+
+//
+// Camera source.
+//
+static int catcierge_camera_source_open(catcierge_frame_source_t *src)
+{
+	#ifdef RPI
+	RaspiCamCvCapture *capture;
+	assert(src->rpi_settings);
+
+	if (!(capture = raspiCamCvCreateCameraCaptureEx(0, src->rpi_settings)))
+	{
+		return -1;
+	}
+	#else
+	CvCapture *capture;
+
+	if (!(capture = cvCreateCameraCapture(0)))
+	{
+		return -1;
+	}
+
+	cvSetCaptureProperty(capture, CV_CAP_PROP_FRAME_WIDTH, 320);
+	cvSetCaptureProperty(capture, CV_CAP_PROP_FRAME_HEIGHT, 240);
+	#endif
+
+	src->ctx = capture;
+
+	return 0;
+}
+
+static IplImage *catcierge_camera_source_next_frame(catcierge_frame_source_t *src)
+{
+	#ifdef RPI
+	return raspiCamCvQueryFrame((RaspiCamCvCapture *)src->ctx);
+	#else
+	return cvQueryFrame((CvCapture *)src->ctx);
+	#endif
+}
+
+static void catcierge_camera_source_close(catcierge_frame_source_t *src)
+{
+	#ifdef RPI
+	RaspiCamCvCapture *capture = (RaspiCamCvCapture *)src->ctx;
+	raspiCamCvReleaseCapture(&capture);
+	#else
+	CvCapture *capture = (CvCapture *)src->ctx;
+	cvReleaseCapture(&capture);
+	#endif
+}
+
+void catcierge_camera_source_init(catcierge_frame_source_t *src)
+{
+	assert(src);
+
+	src->name = "camera";
+	src->open = catcierge_camera_source_open;
+	src->next_frame = catcierge_camera_source_next_frame;
+	src->release = NULL; // Frames are owned by the capture.
+	src->close = catcierge_camera_source_close;
+}
+
+//
+// Settings.
+//
+void catcierge_frame_source_args_init(catcierge_frame_source_args_t *args)
+{
+	assert(args);
+	memset(args, 0, sizeof(catcierge_frame_source_args_t));
+	args->type = FRAME_SOURCE_CAMERA;
+	args->fps = DEFAULT_FRAME_SOURCE_FPS;
+	args->width = DEFAULT_FRAME_SOURCE_WIDTH;
+	args->height = DEFAULT_FRAME_SOURCE_HEIGHT;
+	args->channels = DEFAULT_FRAME_SOURCE_CHANNELS;
+}
+
+void catcierge_frame_source_usage()
+{
+	fprintf(stderr, " --frame_source <camera|dir|raw|rec>\n");
+	fprintf(stderr, "                        Where to get frames from. Default is the camera.\n");
+	fprintf(stderr, "                         dir: Replay all images in --frame_source_path\n");
+	fprintf(stderr, "                              in alphabetical order.\n");
+	fprintf(stderr, "                         raw: Replay a file of headerless 8-bit frames of\n");
+	fprintf(stderr, "                              --frame_source_size in --frame_source_path.\n");
+	fprintf(stderr, "                         rec: Replay a recording made with --record.\n");
+	fprintf(stderr, " --frame_source_path <path>\n");
+	fprintf(stderr, "                        Directory, raw file or recording to replay.\n");
+	fprintf(stderr, " --frame_source_fps <fps>\n");
+	fprintf(stderr, "                        Frame rate of a replay. 0 replays as fast as possible.\n");
+	fprintf(stderr, "                        Default %.1f\n", DEFAULT_FRAME_SOURCE_FPS);
+	fprintf(stderr, " --frame_source_loop    Start the replay over when it reaches the end,\n");
+	fprintf(stderr, "                        instead of exiting.\n");
+	fprintf(stderr, " --frame_source_preload Decode all images of a dir replay at startup.\n");
+	fprintf(stderr, " --frame_source_size <width>x<height>[x<channels>]\n");
+	fprintf(stderr, "                        Frame size of a raw replay, channels is 1 or 3.\n");
+	fprintf(stderr, "                        Default %dx%dx%d\n",
+		DEFAULT_FRAME_SOURCE_WIDTH, DEFAULT_FRAME_SOURCE_HEIGHT, DEFAULT_FRAME_SOURCE_CHANNELS);
+}
+
+int catcierge_frame_source_parse_args(catcierge_frame_source_args_t *args, const char *key, char **values, size_t value_count)
+{
+	if (!strcmp(key, "frame_source"))
+	{
+		if (value_count == 1)
+		{
+			if (!strcmp(values[0], "camera"))
+				args->type = FRAME_SOURCE_CAMERA;
+			else if (!strcmp(values[0], "dir"))
+				args->type = FRAME_SOURCE_DIRECTORY;
+			else if (!strcmp(values[0], "raw"))
+				args->type = FRAME_SOURCE_RAW;
+			else if (!strcmp(values[0], "rec"))
+				args->type = FRAME_SOURCE_RECORDING;
+			else
+			{
+				fprintf(stderr, "Invalid frame source \"%s\"\n", values[0]);
+				return -1;
+			}
+
+			return 0;
+		}
+
+		fprintf(stderr, "--frame_source missing value\n");
+		return -1;
+	}
+
+	if (!strcmp(key, "frame_source_path"))
+	{
+		if (value_count == 1)
+		{
+			args->path = values[0];
+			return 0;
+		}
+
+		fprintf(stderr, "--frame_source_path missing value\n");
+		return -1;
+	}
+
+	if (!strcmp(key, "frame_source_fps"))
+	{
+		if (value_count == 1)
+		{
+			args->fps = atof(values[0]);
+
+			if (args->fps < 0.0)
+			{
+				fprintf(stderr, "--frame_source_fps cannot be negative\n");
+				return -1;
+			}
+
+			return 0;
+		}
+
+		fprintf(stderr, "--frame_source_fps missing value\n");
+		return -1;
+	}
+
+	if (!strcmp(key, "frame_source_loop"))
+	{
+		args->loop = 1;
+		if (value_count == 1) args->loop = atoi(values[0]);
+		return 0;
+	}
+
+	if (!strcmp(key, "frame_source_preload"))
+	{
+		args->preload = 1;
+		if (value_count == 1) args->preload = atoi(values[0]);
+		return 0;
+	}
+
+	if (!strcmp(key, "frame_source_size"))
+	{
+		if (value_count == 1)
+		{
+			args->channels = 1;
+
+			if ((sscanf(values[0], "%dx%dx%d", &args->width, &args->height, &args->channels) < 2)
+			 || (args->width <= 0) || (args->height <= 0)
+			 || ((args->channels != 1) && (args->channels != 3)))
+			{
+				fprintf(stderr, "--frame_source_size invalid size \"%s\"\n", values[0]);
+				return -1;
+			}
+
+			return 0;
+		}
+
+		fprintf(stderr, "--frame_source_size missing value\n");
+		return -1;
+	}
+
+	return 1;
+}
+
+void catcierge_frame_source_print_settings(catcierge_frame_source_args_t *args)
+{
+	assert(args);
+
+	printf("        Frame source: %s\n", catcierge_frame_source_type_str(args->type));
+
+	if (args->type == FRAME_SOURCE_CAMERA)
+		return;
+
+	printf("   Frame source path: %s\n", args->path ? args->path : "-");
+	printf("    Frame source fps: %0.1f %s\n", args->fps, (args->fps <= 0.0) ? "(unthrottled)" : "");
+	printf("   Frame source loop: %d\n", args->loop);
+
+	if (args->type == FRAME_SOURCE_DIRECTORY)
+	printf("Frame source preload: %d\n", args->preload);
+
+	if (args->type == FRAME_SOURCE_RAW)
+	printf("   Frame source size: %dx%dx%d\n", args->width, args->height, args->channels);
+}
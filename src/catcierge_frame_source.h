@@ -0,0 +1,105 @@
+//
+// This file is part of the Catcierge project.
+//
+// Copyright (c) Joakim Soderberg 2013-2014
+//
+//    Catcierge is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    Catcierge is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Catcierge.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef __CATCIERGE_FRAME_SOURCE_H__
+#define __CATCIERGE_FRAME_SOURCE_H__
+
+#include <opencv2/imgproc/imgproc_c.h>
+#include <opencv2/highgui/highgui_c.h>
+
+#ifdef RPI
+#include "RaspiCamCV.h"
+#endif
+
+#define DEFAULT_FRAME_SOURCE_FPS 30.0
+#define DEFAULT_FRAME_SOURCE_WIDTH 320
+#define DEFAULT_FRAME_SOURCE_HEIGHT 240
+#define DEFAULT_FRAME_SOURCE_CHANNELS 1
+
+typedef enum catcierge_frame_source_type_e
+{
+	FRAME_SOURCE_CAMERA = 0,
+	FRAME_SOURCE_DIRECTORY = 1,
+	FRAME_SOURCE_RAW = 2,
+	FRAME_SOURCE_RECORDING = 3
+} catcierge_frame_source_type_t;
+
+typedef struct catcierge_frame_source_args_s
+{
+	catcierge_frame_source_type_t type;
+	const char *path;		// Directory, raw file or recording to replay.
+	double fps;				// Replay frame rate, 0 means as fast as possible.
+	int loop;				// Start over when the end of the replay is reached.
+	int preload;			// Decode all images in a directory up front.
+	int width;				// Raw frame width.
+	int height;				// Raw frame height.
+	int channels;			// Raw frame channels.
+} catcierge_frame_source_args_t;
+
+struct catcierge_frame_source_s;
+
+typedef int (*catcierge_frame_source_open_f)(struct catcierge_frame_source_s *src);
+typedef IplImage *(*catcierge_frame_source_next_frame_f)(struct catcierge_frame_source_s *src);
+typedef void (*catcierge_frame_source_release_f)(struct catcierge_frame_source_s *src, IplImage *img);
+typedef void (*catcierge_frame_source_close_f)(struct catcierge_frame_source_s *src);
+
+//
+// A source of frames for the state machine. The image returned by
+// next_frame is owned by the source and is valid until it is given
+// back using release.
+//
+typedef struct catcierge_frame_source_s
+{
+	catcierge_frame_source_type_t type;
+	const char *name;
+
+	catcierge_frame_source_open_f open;
+	catcierge_frame_source_next_frame_f next_frame;
+	catcierge_frame_source_release_f release;
+	catcierge_frame_source_close_f close;
+
+	catcierge_frame_source_args_t *args;
+	#ifdef RPI
+	RASPIVID_SETTINGS *rpi_settings;
+	#endif
+
+	void *ctx;					// Source specific state.
+	int is_open;
+	int eof;					// Set when a replay has no more frames.
+	unsigned long frame_count;	// Number of frames returned so far.
+	double next_frame_time;		// Used for throttling replays.
+} catcierge_frame_source_t;
+
+int catcierge_frame_source_init(catcierge_frame_source_t *src, catcierge_frame_source_args_t *args);
+int catcierge_frame_source_open(catcierge_frame_source_t *src);
+IplImage *catcierge_frame_source_next(catcierge_frame_source_t *src);
+void catcierge_frame_source_release(catcierge_frame_source_t *src, IplImage *img);
+void catcierge_frame_source_close(catcierge_frame_source_t *src);
+const char *catcierge_frame_source_type_str(catcierge_frame_source_type_t type);
+
+void catcierge_camera_source_init(catcierge_frame_source_t *src);
+void catcierge_dir_source_init(catcierge_frame_source_t *src);
+void catcierge_raw_source_init(catcierge_frame_source_t *src);
+void catcierge_rec_source_init(catcierge_frame_source_t *src);
+
+void catcierge_frame_source_args_init(catcierge_frame_source_args_t *args);
+void catcierge_frame_source_usage();
+int catcierge_frame_source_parse_args(catcierge_frame_source_args_t *args, const char *key, char **values, size_t value_count);
+void catcierge_frame_source_print_settings(catcierge_frame_source_args_t *args);
+
+#endif // __CATCIERGE_FRAME_SOURCE_H__
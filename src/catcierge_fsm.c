@@ -39,11 +39,116 @@
 #include "catcierge_fsm.h"
 #include "catcierge_output.h"
 
+static void catcierge_record_frame(catcierge_grb_t *grb, catcierge_state_func_t state)
+{
+	catcierge_args_t *args = &grb->args;
+	IplImage *gray;
+
+	if (!grb->recorder.header)
+	{
+		if (catcierge_recorder_open(&grb->recorder, args->record_path,
+				(size_t)args->record_size * 1024 * 1024,
+				grb->img->width, grb->img->height))
+		{
+			CATERR("Failed to start recording, turning it off\n");
+			args->record_path = NULL;
+			return;
+		}
+	}
+
+	// Not every state checks if the frame is obstructed.
+	if (grb->obstruct_sum < 0)
+	{
+		grb->obstruct_sum = catcierge_get_obstruct_sum(catcierge_frame_ctx_luma(&grb->frame), 0);
+	}
+
+	// Frames are recorded in gray scale.
+	if (!(gray = catcierge_frame_ctx_gray(&grb->frame))
+		|| catcierge_recorder_write(&grb->recorder, gray, grb->frame_seq,
+			grb->frame_time, catcierge_get_record_state(state), grb->obstruct_sum))
+	{
+		CATERRFPS("Failed to record frame %lu\n", grb->frame_seq);
+	}
+}
+
+// Creates the buffers a match group needs at most with the current
+// settings, sized to the frame, so that nothing is allocated while matching.
+static void catcierge_reserve_match_images(catcierge_grb_t *grb)
+{
+	size_t frames = 0;
+	size_t steps = 0;
+	catcierge_args_t *args;
+	match_group_t *mg;
+	IplImage *img;
+	assert(grb);
+	assert(grb->img);
+	args = &grb->args;
+	mg = &grb->match_group;
+	img = grb->img;
+
+	mg->images_reserved = 1;
+
+	if (args->saveimg || args->burst)
+		frames += mg->max_count;
+
+	if (args->saveimg && args->save_obstruct_img)
+		frames++;
+
+	// The step images are always 8-bit grayscale.
+	if (args->save_steps && grb->matcher)
+		steps = mg->max_count * grb->matcher->step_img_max;
+
+	if ((img->depth == IPL_DEPTH_8U) && (img->nChannels == 1))
+	{
+		frames += steps;
+		steps = 0;
+	}
+
+	if (catcierge_image_pool_reserve(&mg->images, frames, cvGetSize(img), img->depth, img->nChannels)
+	 || catcierge_image_pool_reserve(&mg->images, steps, cvGetSize(img), IPL_DEPTH_8U, 1))
+	{
+		CATERR("Failed to reserve the match images, creating them when needed\n");
+	}
+}
+
+// Does the per frame bookkeeping of the main loop for a frame that a
+// state consumes by itself (a burst), before the next one replaces it.
+static void catcierge_inner_frame_done(catcierge_grb_t *grb, catcierge_state_func_t state)
+{
+	assert(grb);
+
+	if (grb->args.record_path && grb->img)
+	{
+		catcierge_record_frame(grb, state);
+	}
+
+	catcierge_state_times_add(grb, state);
+	catcierge_idle_update(&grb->idle, (state == catcierge_state_waiting), grb->obstruct_sum);
+	grb->obstruct_sum = -1;
+}
+
 void catcierge_run_state(catcierge_grb_t *grb)
 {
+	catcierge_state_func_t state;
 	assert(grb);
 	assert(grb->state);
+
+	state = grb->state;
+
+	if (grb->img && !grb->match_group.images_reserved)
+	{
+		catcierge_reserve_match_images(grb);
+	}
+
+	catcierge_frame_ctx_set(&grb->frame, grb->img);
+	grb->obstruct_sum = -1;
+	grb->motion.moved = 0;
 	grb->state(grb);
+
+	if (grb->args.record_path && grb->img)
+	{
+		catcierge_record_frame(grb, state);
+	}
 }
 
 const char *catcierge_get_state_string(catcierge_state_func_t state)
@@ -56,6 +161,93 @@ const char *catcierge_get_state_string(catcierge_state_func_t state)
 	return "Initial";
 }
 
+catcierge_record_state_t catcierge_get_record_state(catcierge_state_func_t state)
+{
+	if (state == catcierge_state_waiting) return RECORD_STATE_WAITING;
+	if (state == catcierge_state_matching) return RECORD_STATE_MATCHING;
+	if (state == catcierge_state_keepopen) return RECORD_STATE_KEEPOPEN;
+	if (state == catcierge_state_lockout) return RECORD_STATE_LOCKOUT;
+
+	return RECORD_STATE_UNKNOWN;
+}
+
+void catcierge_state_times_start(catcierge_grb_t *grb)
+{
+	assert(grb);
+	memset(grb->state_times, 0, sizeof(grb->state_times));
+	grb->state_times_wall = catcierge_timer_now();
+	grb->state_times_cpu = catcierge_timer_cpu_now();
+}
+
+void catcierge_state_times_add(catcierge_grb_t *grb, catcierge_state_func_t state)
+{
+	double wall = catcierge_timer_now();
+	double cpu = catcierge_timer_cpu_now();
+	catcierge_state_time_t *st;
+	assert(grb);
+
+	// Everything since the last update (waiting for the frame
+	// included) is counted towards the state that processed it.
+	st = &grb->state_times[catcierge_get_record_state(state)];
+	st->wall += wall - grb->state_times_wall;
+	st->cpu += cpu - grb->state_times_cpu;
+	st->frames++;
+
+	grb->state_times_wall = wall;
+	grb->state_times_cpu = cpu;
+}
+
+void catcierge_print_state_times(catcierge_grb_t *grb)
+{
+	int i;
+	catcierge_state_time_t *st;
+	catcierge_image_pool_stats_t pool;
+	assert(grb);
+
+	CATLOG("Time spent per state:\n");
+
+	for (i = 0; i < RECORD_STATE_COUNT; i++)
+	{
+		st = &grb->state_times[i];
+
+		if (st->frames == 0)
+			continue;
+
+		CATLOG("  %-9s %8lu frames %10.1f s %8.1f s CPU (%5.1f%%) %6.2f ms CPU/frame\n",
+			catcierge_record_state_str((catcierge_record_state_t)i),
+			st->frames, st->wall, st->cpu,
+			(st->wall > 0.0) ? (100.0 * st->cpu / st->wall) : 0.0,
+			1000.0 * st->cpu / st->frames);
+	}
+
+	catcierge_image_pool_get_stats(&grb->match_group.images, &pool);
+
+	CATLOG("Image pool: %u of %u buffers created, at most %u in use, %u images allocated outside the pool, %u buffers recreated\n",
+		pool.allocated, pool.capacity, pool.peak, pool.exhausted, pool.recreated);
+}
+
+static int catcierge_check_frame_obstructed(catcierge_grb_t *grb)
+{
+	if (!catcierge_motion_check(&grb->motion, grb->img, catcierge_timer_now()))
+	{
+		// Nothing has changed since the last checked frame.
+		grb->obstruct_sum = grb->last_obstruct_sum;
+		return grb->last_obstructed;
+	}
+
+	// The full sum is only needed when it is recorded. This never
+	// converts the frame itself, but uses the gray plane if some
+	// other consumer already needed it.
+	if ((grb->obstruct_sum = catcierge_get_obstruct_sum_limit(catcierge_frame_ctx_luma(&grb->frame),
+		grb->args.record_path ? -1 : CATCIERGE_OBSTRUCT_THRESHOLD, 0)) < 0)
+		return -1;
+
+	grb->last_obstruct_sum = grb->obstruct_sum;
+	grb->last_obstructed = (grb->obstruct_sum > CATCIERGE_OBSTRUCT_THRESHOLD);
+
+	return grb->last_obstructed;
+}
+
 void catcierge_print_state(catcierge_state_func_t state)
 {
 	log_printf(stdout, COLOR_NORMAL, "[");
@@ -286,84 +478,213 @@ void catcierge_do_unlock(catcierge_grb_t *grb)
 	}
 }
 
-static void catcierge_cleanup_match_steps(catcierge_grb_t *grb, match_result_t *result)
+static void catcierge_cleanup_match_steps(match_result_t *result, catcierge_image_pool_t *images)
 {
-	int j;
+	size_t j;
 	match_step_t *step = NULL;
-	assert(grb);
 	assert(result);
 
-	for (j = 0; j < MAX_MATCH_RECTS; j++)
+	// The matchers only add steps after step_img_count.
+	for (j = 0; j < result->step_img_count; j++)
 	{
 		step = &result->steps[j];
-
-		if (step->img)
-		{
-			cvReleaseImage(&step->img);
-			step->img = NULL;
-		}
+		catcierge_image_pool_release(images, &step->img);
 
 		step->description = NULL;
 		step->name = NULL;
-		step->path[0] = '\0';
+		step->path = "";
+		step->filename = "";
+		step->full_path = "";
 	}
 
 	result->step_img_count = 0;
 }
 
+// Clears what is left from the previous match, instead of the whole
+// struct. The rects and steps past rect_count and step_img_count
+// are never looked at.
+void catcierge_match_result_reset(match_result_t *result, catcierge_image_pool_t *images)
+{
+	assert(result);
+
+	catcierge_cleanup_match_steps(result, images);
+	result->result = 0.0;
+	result->success = 0;
+	result->description[0] = '\0';
+	result->rect_count = 0;
+	result->direction = MATCH_DIR_IN; // Same as a cleared struct.
+	result->hint_count = 0;
+	result->hint_direction = MATCH_DIR_UNKNOWN;
+	result->hint_hit = 0;
+	result->hint_miss = 0;
+	result->search_time = 0.0;
+	result->hint_time = 0.0;
+}
+
+static void catcierge_reset_match_paths(match_state_t *m)
+{
+	assert(m);
+
+	m->path = "";
+	m->filename = "";
+	m->full_path = "";
+}
+
+// Formats the filename of an image in the string arena of the match group,
+// together with the directory it is saved in and the full path. The strings
+// are valid until the next match group starts.
+static void catcierge_match_group_set_paths(match_group_t *mg, const char *dir,
+	const char **path, const char **filename, const char **full_path,
+	const char *fmt, ...)
+{
+	const char *name;
+	va_list args;
+	assert(mg);
+	assert(path);
+	assert(filename);
+	assert(full_path);
+
+	*path = "";
+	*filename = "";
+	*full_path = "";
+
+	va_start(args, fmt);
+	name = catcierge_arena_vprintf(&mg->strings, fmt, args);
+	va_end(args);
+
+	if (!name)
+	{
+		CATERR("Failed to format image path\n");
+		return;
+	}
+
+	*filename = name;
+	*path = catcierge_arena_printf(&mg->strings, "%s", dir ? dir : "");
+	*full_path = catcierge_arena_printf(&mg->strings, "%s%s%s",
+		(*path ? *path : ""), catcierge_path_sep(), name);
+
+	if (!*path || !*full_path)
+	{
+		CATERR("Failed to format image path\n");
+		*path = "";
+		*full_path = "";
+	}
+}
+
 static void catcierge_cleanup_imgs(catcierge_grb_t *grb)
 {
-	int i;
+	size_t i;
+	match_group_t *mg;
 	assert(grb);
+	mg = &grb->match_group;
 
-	for (i = 0; i < MATCH_MAX_COUNT; i++)
+	for (i = 0; i < mg->max_count; i++)
 	{
-		if (grb->match_group.matches[i].img)
-		{
-			cvReleaseImage(&grb->match_group.matches[i].img);
-			grb->match_group.matches[i].img = NULL;
-		}
+		catcierge_image_pool_release(&mg->images, &mg->matches[i].img);
+		catcierge_cleanup_match_steps(&mg->matches[i].result, &mg->images);
+	}
 
-		catcierge_cleanup_match_steps(grb, &grb->match_group.matches[i].result);
+	catcierge_image_pool_release(&mg->images, &mg->obstruct_img);
+}
+
+static IplImage *catcierge_capture_grab(void *user)
+{
+	catcierge_grb_t *grb = (catcierge_grb_t *)user;
+	IplImage *img = catcierge_get_frame(grb);
+
+	// A replay has ended, let the capture thread finish
+	// so that the consumer drains the remaining frames.
+	if (!img && grb->source.eof)
+	{
+		catcierge_atomic_store(&grb->capture_thread.running, 0);
 	}
 
-	if (grb->match_group.obstruct_img)
+	return img;
+}
+
+static void catcierge_start_capture_thread(catcierge_grb_t *grb)
+{
+	catcierge_args_t *args;
+	assert(grb);
+	args = &grb->args;
+
+	if (!args->capture_thread)
+		return;
+
+	if (catcierge_capture_thread_init(&grb->capture_thread,
+			args->capture_buffers, catcierge_capture_grab, grb)
+	 || catcierge_capture_thread_start(&grb->capture_thread))
 	{
-		cvReleaseImage(&grb->match_group.obstruct_img);
-		grb->match_group.obstruct_img = NULL;
+		CATERR("Failed to start capture thread, grabbing frames directly instead\n");
+		catcierge_capture_thread_destroy(&grb->capture_thread);
+		args->capture_thread = 0;
+		return;
 	}
+
+	CATLOG("Started capture thread with %d frame buffers\n", args->capture_buffers);
 }
 
-void catcierge_setup_camera(catcierge_grb_t *grb)
+static void catcierge_stop_capture_thread(catcierge_grb_t *grb)
 {
+	catcierge_capture_stats_t stats;
 	assert(grb);
 
+	if (!grb->args.capture_thread)
+		return;
+
+	catcierge_capture_thread_release(&grb->capture_thread, grb->capture_frame);
+	grb->capture_frame = NULL;
+
+	catcierge_capture_thread_stop(&grb->capture_thread);
+	catcierge_capture_thread_get_stats(&grb->capture_thread, &stats);
+
+	CATLOG("Capture thread: %u frames captured, %u consumed, %u overwritten, %u dropped\n",
+		stats.captured, stats.consumed, stats.overwritten, stats.dropped);
+
+	catcierge_capture_thread_destroy(&grb->capture_thread);
+}
+
+int catcierge_setup_camera(catcierge_grb_t *grb)
+{
+	assert(grb);
+
+	if (catcierge_frame_source_init(&grb->source, &grb->args.source))
+	{
+		return -1;
+	}
+
 	#ifdef RPI
-	grb->capture = raspiCamCvCreateCameraCaptureEx(0, &grb->args.rpi_settings);
-	#else
-	grb->capture = cvCreateCameraCapture(0);
-	cvSetCaptureProperty(grb->capture, CV_CAP_PROP_FRAME_WIDTH, 320);
-	cvSetCaptureProperty(grb->capture, CV_CAP_PROP_FRAME_HEIGHT, 240);
+	grb->source.rpi_settings = &grb->args.rpi_settings;
 	#endif
 
+	if (catcierge_frame_source_open(&grb->source))
+	{
+		return -1;
+	}
+
 	if (grb->args.show)
 	{
 		cvNamedWindow("catcierge", 1);
 	}
+
+	catcierge_start_capture_thread(grb);
+
+	return 0;
 }
 
 void catcierge_destroy_camera(catcierge_grb_t *grb)
 {
+	// The capture thread must be stopped before the camera goes away.
+	catcierge_stop_capture_thread(grb);
+
 	if (grb->args.show)
 	{
 		cvDestroyWindow("catcierge");
 	}
 
-	#ifdef RPI
-	raspiCamCvReleaseCapture(&grb->capture);
-	#else
-	cvReleaseCapture(&grb->capture);
-	#endif
+	catcierge_frame_source_release(&grb->source, grb->source_frame);
+	grb->source_frame = NULL;
+	catcierge_frame_source_close(&grb->source);
 }
 
 int catcierge_drop_root_privileges(const char *user)
@@ -444,11 +765,42 @@ IplImage *catcierge_get_frame(catcierge_grb_t *grb)
 {
 	assert(grb);
 
-	#ifdef RPI
-	return raspiCamCvQueryFrame(grb->capture);
-	#else
-	return cvQueryFrame(grb->capture);
-	#endif	
+	catcierge_frame_source_release(&grb->source, grb->source_frame);
+	grb->source_frame = catcierge_frame_source_next(&grb->source);
+
+	return grb->source_frame;
+}
+
+IplImage *catcierge_next_frame(catcierge_grb_t *grb)
+{
+	assert(grb);
+
+	if (!grb->args.capture_thread)
+	{
+		IplImage *img;
+
+		if ((img = catcierge_get_frame(grb)))
+		{
+			grb->frame_seq++;
+			grb->frame_time = catcierge_timer_now();
+		}
+
+		return img;
+	}
+
+	// Give back the frame we processed last, so the
+	// capture thread can reuse it.
+	catcierge_capture_thread_release(&grb->capture_thread, grb->capture_frame);
+
+	if (!(grb->capture_frame = catcierge_capture_thread_acquire(&grb->capture_thread, 1.0)))
+	{
+		return NULL;
+	}
+
+	grb->frame_seq = grb->capture_frame->seq;
+	grb->frame_time = grb->capture_frame->timestamp;
+
+	return grb->capture_frame->img;
 }
 
 static int catcierge_calculate_match_id(IplImage *img, match_state_t *m)
@@ -499,7 +851,7 @@ static void catcierge_process_match_result(catcierge_grb_t *grb, IplImage *img)
  	match_state_t *m = NULL;
 	assert(grb);
 	assert(img);
-	assert(grb->match_group.match_count <= MATCH_MAX_COUNT);
+	assert(grb->match_group.match_count < grb->match_group.max_count);
 	args = &grb->args;
 
 	m = &grb->match_group.matches[grb->match_group.match_count];
@@ -529,8 +881,7 @@ static void catcierge_process_match_result(catcierge_grb_t *grb, IplImage *img)
 		m->sha.Message_Digest[3],
 		m->sha.Message_Digest[4]);
 
-	m->path[0] = '\0';
-	m->filename[0] = '\0';
+	catcierge_reset_match_paths(m);
 
 	// Save match image.
 	// (We don't write to disk yet, that will slow down the matching).
@@ -557,17 +908,16 @@ static void catcierge_process_match_result(catcierge_grb_t *grb, IplImage *img)
 			m->time_str,
 			(int)grb->match_group.match_count);
 
-		snprintf(m->path, sizeof(m->path) - 1, "%s", match_gen_output_path);
-		snprintf(m->filename, sizeof(m->filename) - 1, "%s.png", base_path);
-		snprintf(m->full_path, sizeof(m->full_path) - 1, "%s%s%s",
-					m->path, catcierge_path_sep(), m->filename);
+		catcierge_match_group_set_paths(&grb->match_group, match_gen_output_path,
+			&m->path, &m->filename, &m->full_path, "%s.png", base_path);
 
 		if (match_gen_output_path)
 		{
 			free(match_gen_output_path);
 		}
 
-		m->img = cvCloneImage(img);
+		// Shared instead of copied when it is already in the pool.
+		m->img = catcierge_image_pool_clone(&grb->match_group.images, img);
 		// TODO: Add option to save the image right away also.
 
 		if (args->save_steps)
@@ -588,17 +938,9 @@ static void catcierge_process_match_result(catcierge_grb_t *grb, IplImage *img)
 				}
 
 				step = &m->result.steps[j];
-				snprintf(step->path, sizeof(step->path) - 1,
-					"%s", step_gen_output_path);
-
-				snprintf(step->filename, sizeof(step->filename) - 1,
-					"%s_%02d_%s.png",
-					base_path,
-					(int)j,
-					step->name);
-
-				snprintf(step->full_path, sizeof(step->full_path) - 1, "%s%s%s",
-					step->path, catcierge_path_sep(), step->filename);
+				catcierge_match_group_set_paths(&grb->match_group, step_gen_output_path,
+					&step->path, &step->filename, &step->full_path,
+					"%s_%02d_%s.png", base_path, (int)j, step->name);
 
 				if (step_gen_output_path)
 				{
@@ -637,11 +979,10 @@ static void catcierge_save_images(catcierge_grb_t *grb, match_direction_t direct
 		// TODO: Save obstruct step images as well?
 		// TODO: Add execute event for this?
 
-		cvReleaseImage(&mg->obstruct_img);
-		mg->obstruct_img = NULL;
+		catcierge_image_pool_release(&mg->images, &mg->obstruct_img);
 	}
 
-	for (i = 0; i < MATCH_MAX_COUNT; i++)
+	for (i = 0; i < (int)mg->match_count; i++)
 	{
 		m = &grb->match_group.matches[i];
 		res = &m->result;
@@ -678,8 +1019,7 @@ static void catcierge_save_images(catcierge_grb_t *grb, match_direction_t direct
 				res->direction);// %3 = Match direction.
 		}
 
-		cvReleaseImage(&m->img);
-		m->img = NULL;
+		catcierge_image_pool_release(&mg->images, &m->img);
 	}
 
 	if (args->new_execute)
@@ -688,22 +1028,30 @@ static void catcierge_save_images(catcierge_grb_t *grb, match_direction_t direct
 	}
 	else
 	{
-		catcierge_execute(args->match_group_done_cmd,
-			"%d %s %s %s %s %f %f %f %f %d %d %d %d %d",
-			grb->match_group.success, 						// %0 = Match success.
-			grb->match_group.matches[0].full_path,			// %1 = Image 1 path (of now saved image).
-			grb->match_group.matches[1].full_path,			// %2 = Image 2 path (of now saved image).
-			grb->match_group.matches[2].full_path,			// %3 = Image 3 path (of now saved image).
-			grb->match_group.matches[3].full_path,			// %4 = Image 4 path (of now saved image).
-			grb->match_group.matches[0].result.result,		// %5 = Image 1 result.
-			grb->match_group.matches[1].result.result,		// %6 = Image 2 result.
-			grb->match_group.matches[2].result.result,		// %7 = Image 3 result.
-			grb->match_group.matches[3].result.result,		// %8 = Image 4 result.
-			grb->match_group.matches[0].result.direction,	// %9 =  Image 1 direction.
-			grb->match_group.matches[1].result.direction,	// %10 = Image 2 direction.
-			grb->match_group.matches[2].result.direction,	// %11 = Image 3 direction.
-			grb->match_group.matches[3].result.direction,	// %12 = Image 4 direction.
-			direction); 									// %13 = Total direction.
+		// %0 = Match success.
+		// %1 to %N = Image paths (of now saved images).
+		// %N+1 to %2N = Image results.
+		// %2N+1 to %3N = Image directions.
+		// %3N+1 = Total direction.
+		// Where N is the match group size.
+		char cmd_args[2048];
+		size_t len;
+
+		len = snprintf(cmd_args, sizeof(cmd_args), "%d", mg->success);
+
+		for (i = 0; (i < (int)mg->max_count) && (len < sizeof(cmd_args)); i++)
+			len += snprintf(&cmd_args[len], sizeof(cmd_args) - len, " %s", mg->matches[i].full_path);
+
+		for (i = 0; (i < (int)mg->max_count) && (len < sizeof(cmd_args)); i++)
+			len += snprintf(&cmd_args[len], sizeof(cmd_args) - len, " %f", mg->matches[i].result.result);
+
+		for (i = 0; (i < (int)mg->max_count) && (len < sizeof(cmd_args)); i++)
+			len += snprintf(&cmd_args[len], sizeof(cmd_args) - len, " %d", mg->matches[i].result.direction);
+
+		if (len < sizeof(cmd_args))
+			snprintf(&cmd_args[len], sizeof(cmd_args) - len, " %d", direction);
+
+		catcierge_execute(args->match_group_done_cmd, "%s", cmd_args);
 	}
 }
 
@@ -869,14 +1217,15 @@ static void catcierge_show_image(catcierge_grb_t *grb)
 
 		// Only try to show the match rectangles when we're in match mode.
 		if ((grb->match_group.match_count > 0)
-			&& (grb->match_group.match_count <= MATCH_MAX_COUNT))
+			&& (grb->match_group.match_count <= grb->match_group.max_count))
 		{
 			size_t i;
 			CvScalar match_color;
 
 			// We don't want to mess with the original image when
 			// drawing the match rects since that might interfer with the match.
-			tmp_img = cvCloneImage(grb->img);
+			if (!(tmp_img = catcierge_frame_ctx_copy(&grb->frame)))
+				return;
 
 			m = &grb->match_group.matches[grb->match_group.match_count - 1];
 			res = &m->result;
@@ -898,11 +1247,6 @@ static void catcierge_show_image(catcierge_grb_t *grb)
 
 		cvShowImage("catcierge", img);
 		cvWaitKey(10);
-
-		if (tmp_img)
-		{
-			cvReleaseImage(&tmp_img);
-		}
 	}
 }
 
@@ -912,6 +1256,7 @@ double catcierge_do_match(catcierge_grb_t *grb)
 	catcierge_args_t *args;
 	match_group_t *mg = &grb->match_group;
 	match_result_t *result;
+	match_result_t *prev;
 	match_state_t *match;
 	assert(grb);
 	args = &grb->args;
@@ -919,10 +1264,27 @@ double catcierge_do_match(catcierge_grb_t *grb)
 	// Clear match structs before doing a new one.
 	match = &mg->matches[mg->match_count];
 	result = &match->result;
-	catcierge_cleanup_match_steps(grb, result);
-	memset(result, 0, sizeof(match_result_t));
+	catcierge_match_result_reset(result, &mg->images);
 
-	if ((match_res = grb->matcher->match(grb->matcher, grb->img, result, args->save_steps)) < 0.0)
+	// The step images are borrowed from the match group as well.
+	grb->matcher->images = &mg->images;
+
+	// The snout or head is usually close to where it was in the previous
+	// frame. A failed haar match can still have found the head, matchers
+	// that need a successful match look at the hint direction.
+	if (mg->match_count > 0)
+	{
+		prev = &mg->matches[mg->match_count - 1].result;
+
+		if (prev->success || ((prev->result >= 0.0) && (prev->rect_count > 0)))
+		{
+			result->hint_count = (prev->rect_count < MAX_MATCH_RECTS) ? prev->rect_count : MAX_MATCH_RECTS;
+			memcpy(result->hint_rects, prev->match_rects, result->hint_count * sizeof(CvRect));
+			result->hint_direction = prev->direction;
+		}
+	}
+
+	if ((match_res = grb->matcher->match(grb->matcher, &grb->frame, result, args->save_steps)) < 0.0)
 	{
 		CATERR("%s matcher: Error when matching frame!\n", grb->args.matcher);
 	}
@@ -930,9 +1292,24 @@ double catcierge_do_match(catcierge_grb_t *grb)
 	return match_res;
 }
 
+// The haar direction of a match group, given how many of its matches went each way.
+static match_direction_t catcierge_haar_group_direction(int in_count, int out_count, int unknown_count)
+{
+	if ((in_count > out_count) && (in_count > unknown_count))
+	{
+		return MATCH_DIR_IN;
+	}
+	else if (out_count > unknown_count)
+	{
+		return MATCH_DIR_OUT;
+	}
+
+	return MATCH_DIR_UNKNOWN;
+}
+
 static match_direction_t catcierge_guess_overall_direction(catcierge_grb_t *grb)
 {
-	int i;
+	size_t i;
 	match_direction_t direction = MATCH_DIR_UNKNOWN;
 	assert(grb);
 
@@ -942,7 +1319,7 @@ static match_direction_t catcierge_guess_overall_direction(catcierge_grb_t *grb)
 		// (It is very uncommon for 2 successful matches to give different
 		// direction with the template matcher, so we can be pretty sure
 		// this is correct).
-		for (i = 0; i < MATCH_MAX_COUNT; i++)
+		for (i = 0; i < grb->match_group.match_count; i++)
 		{
 			if (grb->match_group.matches[i].result.success)
 			{
@@ -957,7 +1334,7 @@ static match_direction_t catcierge_guess_overall_direction(catcierge_grb_t *grb)
 		int out_count = 0;
 		int unknown_count = 0;
 
-		for (i = 0; i < MATCH_MAX_COUNT; i++)
+		for (i = 0; i < grb->match_group.match_count; i++)
 		{
 			switch (grb->match_group.matches[i].result.direction)
 			{
@@ -967,21 +1344,143 @@ static match_direction_t catcierge_guess_overall_direction(catcierge_grb_t *grb)
 			}
 		}
 
-		if ((in_count > out_count) && (in_count > unknown_count))
-		{
-			direction = MATCH_DIR_IN;
-		}
-		else if (out_count > unknown_count)
+		direction = catcierge_haar_group_direction(in_count, out_count, unknown_count);
+	}
+
+	return direction;
+}
+
+//
+// Checks if the matches that are left in the match group can still
+// change the lock decision, used with --early_decision.
+//
+static int catcierge_match_group_is_decided(catcierge_grb_t *grb)
+{
+	size_t i;
+	int remaining;
+	int success_count = 0;
+	int head_count = 0;
+	int in_count = 0;
+	int out_count = 0;
+	int unknown_count = 0;
+	match_result_t *res;
+	match_group_t *mg = &grb->match_group;
+	catcierge_args_t *args = &grb->args;
+	assert(grb);
+
+	if ((remaining = (int)mg->max_count - (int)mg->match_count) <= 0)
+		return 1;
+
+	for (i = 0; i < mg->match_count; i++)
+	{
+		res = &mg->matches[i].result;
+		success_count += !!res->success;
+		head_count += (res->result != HAAR_SUCCESS_NO_HEAD);
+
+		switch (res->direction)
 		{
-			direction = MATCH_DIR_OUT;
+			case MATCH_DIR_IN: in_count++; break;
+			case MATCH_DIR_OUT: out_count++; break;
+			case MATCH_DIR_UNKNOWN: unknown_count++; break;
 		}
-		else
+	}
+
+	if (success_count >= args->ok_matches_needed)
+	{
+		// Going out is let through as well, so the direction doesn't matter.
+		// But the haar matcher vetoes the match group if there is no head in
+		// any of the images, which can happen as long as no head was found.
+		return (args->matcher_type != MATCHER_HAAR)
+			|| args->no_final_decision
+			|| (head_count > 0);
+	}
+
+	if ((success_count + remaining) < args->ok_matches_needed)
+	{
+		// Any successful template match that is left can still
+		// say that the cat is going out.
+		if (args->matcher_type == MATCHER_TEMPLATE)
+			return 0;
+
+		// Not going out, even if all the matches left do.
+		return (catcierge_haar_group_direction(in_count,
+			out_count + remaining, unknown_count) != MATCH_DIR_OUT);
+	}
+
+	return 0;
+}
+
+int catcierge_match_group_init(match_group_t *mg, size_t max_count)
+{
+	size_t i;
+	size_t j;
+	match_state_t *matches;
+	assert(mg);
+	assert(max_count > 0);
+
+	if (!(matches = (match_state_t *)calloc(max_count, sizeof(match_state_t))))
+	{
+		CATERR("Out of memory!\n");
+		return -1;
+	}
+
+	catcierge_match_group_destroy(mg);
+	catcierge_arena_init(&mg->strings);
+
+	// Every match can keep its frame (a burst frame is shared with its
+	// match) until the match group is saved, and there is the obstruct
+	// image. Room for the step images is added when the pool is reserved.
+	if (catcierge_image_pool_init(&mg->images, max_count + 1))
+	{
+		free(matches);
+		return -1;
+	}
+
+	for (i = 0; i < max_count; i++)
+	{
+		catcierge_reset_match_paths(&matches[i]);
+
+		for (j = 0; j < MAX_STEPS; j++)
 		{
-			direction = MATCH_DIR_UNKNOWN;
+			matches[i].result.steps[j].path = "";
+			matches[i].result.steps[j].filename = "";
+			matches[i].result.steps[j].full_path = "";
 		}
 	}
 
-	return direction;
+	mg->matches = matches;
+	mg->images_reserved = 0;
+	mg->max_count = max_count;
+	mg->match_count = 0;
+	mg->obstruct_path = "";
+	mg->obstruct_filename = "";
+	mg->obstruct_full_path = "";
+
+	return 0;
+}
+
+void catcierge_match_group_destroy(match_group_t *mg)
+{
+	size_t i;
+	assert(mg);
+
+	if (!mg->matches)
+		return;
+
+	for (i = 0; i < mg->max_count; i++)
+	{
+		catcierge_image_pool_release(&mg->images, &mg->matches[i].img);
+		catcierge_cleanup_match_steps(&mg->matches[i].result, &mg->images);
+	}
+
+	catcierge_image_pool_release(&mg->images, &mg->obstruct_img);
+
+	free(mg->matches);
+	mg->matches = NULL;
+	mg->max_count = 0;
+	mg->match_count = 0;
+	catcierge_arena_destroy(&mg->strings);
+	catcierge_image_pool_destroy(&mg->images);
 }
 
 void catcierge_match_group_start(match_group_t *mg, IplImage *img)
@@ -994,10 +1493,15 @@ void catcierge_match_group_start(match_group_t *mg, IplImage *img)
 	memset(&mg->end_tv, 0, sizeof(mg->end_tv));
 	mg->end_time = 0;
 
+	// The paths of the previous match group are not used anymore.
+	catcierge_arena_reset(&mg->strings);
 	mg->description[0] = '\0';
-	mg->obstruct_path[0] = '\0';
+	mg->obstruct_path = "";
+	mg->obstruct_filename = "";
+	mg->obstruct_full_path = "";
 	mg->match_count = 0;
 	mg->final_decision = 0;
+	mg->early_decision = 0;
 
 	// We base the matchgroup id on the obstruct image + timestamp.
 	caticerge_calculate_matchgroup_id(mg, img);
@@ -1011,11 +1515,7 @@ void catcierge_match_group_start(match_group_t *mg, IplImage *img)
 		mg->sha.Message_Digest[4]);
 	CATLOG("\n");
 
-	if (mg->obstruct_img)
-	{
-		cvReleaseImage(&mg->obstruct_img);
-		mg->obstruct_img = NULL;
-	}
+	catcierge_image_pool_release(&mg->images, &mg->obstruct_img);
 }
 
 void catcierge_match_group_end(match_group_t *mg)
@@ -1026,6 +1526,13 @@ void catcierge_match_group_end(match_group_t *mg)
 	mg->end_time = time(NULL);
 }
 
+// Burst matching is only used when it has been set up
+// for the frame source, not when frames are fed directly.
+static int catcierge_burst_enabled(catcierge_grb_t *grb)
+{
+	return grb->args.burst && grb->burst_matchers[0];
+}
+
 void catcierge_decide_lock_status(catcierge_grb_t *grb)
 {
 	match_group_t *mg = &grb->match_group;
@@ -1035,12 +1542,27 @@ void catcierge_decide_lock_status(catcierge_grb_t *grb)
 
 	mg->success = 0;
 	mg->success_count = 0;
+	mg->early_decision = (mg->match_count < mg->max_count);
 
-	for (i = 0; i < MATCH_MAX_COUNT; i++)
+	for (i = 0; i < (int)mg->match_count; i++)
 	{
 		mg->success_count += !!mg->matches[i].result.success;
 	}
 
+	// Matches that were never made, so that nothing
+	// from the previous match group is reported.
+	for (i = (int)mg->match_count; i < (int)mg->max_count; i++)
+	{
+		catcierge_match_result_reset(&mg->matches[i].result, &mg->images);
+		mg->matches[i].result.direction = MATCH_DIR_UNKNOWN;
+		catcierge_reset_match_paths(&mg->matches[i]);
+	}
+
+	if (mg->early_decision)
+	{
+		CATLOG("Decided early after %d of %d matches\n", (int)mg->match_count, (int)mg->max_count);
+	}
+
 	// Guess the direction.
 	mg->direction = catcierge_guess_overall_direction(grb);
 
@@ -1061,7 +1583,7 @@ void catcierge_decide_lock_status(catcierge_grb_t *grb)
 		{
 			snprintf(mg->description, sizeof(mg->description) - 1,
 				"Lockout %d of %d matches failed",
-				(MATCH_MAX_COUNT - mg->success_count), MATCH_MAX_COUNT);
+				((int)mg->match_count - mg->success_count), (int)mg->match_count);
 		}
 
 		// Let the matcher veto if the match group was successful.
@@ -1077,12 +1599,16 @@ void catcierge_decide_lock_status(catcierge_grb_t *grb)
 		}
 	}
 
+	mg->decision_latency = catcierge_timer_now() - mg->obstruct_frame_time;
+	CATLOG("Lock decision made %0.1fms after the frame was obstructed (%s matching)\n",
+		1000.0 * mg->decision_latency, catcierge_burst_enabled(grb) ? "burst" : "sequential");
+
 	if (mg->success)
 	{
 		snprintf(mg->description, sizeof(mg->description) - 1, "Everything OK!");
 
 		CATLOG("Everything OK! (%d out of %d matches succeeded)"
-				" Door kept open...\n", mg->success_count, MATCH_MAX_COUNT);
+				" Door kept open...\n", mg->success_count, (int)mg->match_count);
 
 		if (grb->consecutive_lockout_count > 0)
 		{
@@ -1105,7 +1631,7 @@ void catcierge_decide_lock_status(catcierge_grb_t *grb)
 	else
 	{
 		CATLOG("Lockout! %d out of %d matches failed.\n",
-				(MATCH_MAX_COUNT - mg->success_count), MATCH_MAX_COUNT);
+				((int)mg->match_count - mg->success_count), (int)mg->match_count);
 
 		catcierge_check_max_consecutive_lockouts(grb);
 		catcierge_state_transition_lockout(grb);
@@ -1119,10 +1645,11 @@ void catcierge_decide_lock_status(catcierge_grb_t *grb)
 	}
 	else
 	{
-		catcierge_execute(args->match_done_cmd, "%d %d %d", 
-			mg->success, 		// %0 = Match success.
-			mg->success_count,	// %1 = Successful match count.
-			MATCH_MAX_COUNT);	// %2 = Max matches.
+		catcierge_execute(args->match_done_cmd, "%d %d %d %d", 
+			mg->success, 			// %0 = Match success.
+			mg->success_count,		// %1 = Successful match count.
+			(int)mg->max_count,		// %2 = Max matches.
+			(int)mg->match_count);	// %3 = Matches made before deciding.
 	}
 
 	// Now we can save the images that we cached earlier 
@@ -1142,13 +1669,8 @@ void catcierge_save_obstruct_image(catcierge_grb_t *grb)
 		catcierge_args_t *args = &grb->args;
 		match_group_t *mg = &grb->match_group;
 
-		if (mg->obstruct_img)
-		{
-			cvReleaseImage(&mg->obstruct_img);
-			mg->obstruct_img = NULL;
-		}
-
-		mg->obstruct_img = cvCloneImage(grb->img);
+		catcierge_image_pool_release(&mg->images, &mg->obstruct_img);
+		mg->obstruct_img = catcierge_image_pool_clone(&mg->images, grb->img);
 
 		mg->obstruct_time = time(NULL);
 		gettimeofday(&mg->obstruct_tv, NULL);
@@ -1166,13 +1688,10 @@ void catcierge_save_obstruct_image(catcierge_grb_t *grb)
 			CATERR("Failed to generate output path from: \"%s\"\n", args->obstruct_output_path);
 		}
 
-		snprintf(mg->obstruct_path, sizeof(mg->obstruct_path) - 1, "%s", gen_output_path);
-		snprintf(mg->obstruct_filename, sizeof(mg->obstruct_filename) - 1,
+		catcierge_match_group_set_paths(mg, gen_output_path,
+			&mg->obstruct_path, &mg->obstruct_filename, &mg->obstruct_full_path,
 			"match_obstruct_%s.png", time_str);
 
-		snprintf(mg->obstruct_full_path, sizeof(mg->obstruct_full_path) - 1, "%s%s%s",
-			mg->obstruct_path, catcierge_path_sep(), mg->obstruct_filename);
-
 		if (gen_output_path)
 		{
 			free(gen_output_path);
@@ -1256,7 +1775,7 @@ int catcierge_state_keepopen(catcierge_grb_t *grb)
 		// We have successfully matched a valid cat :D
 		int frame_obstructed;
 
-		if ((frame_obstructed = catcierge_is_frame_obstructed(grb->img, 0)) < 0)
+		if ((frame_obstructed = catcierge_check_frame_obstructed(grb)) < 0)
 		{
 			CATERR("Failed to run check for obstructed frame\n");
 			return -1;
@@ -1303,7 +1822,7 @@ int catcierge_state_lockout(catcierge_grb_t *grb)
 		// Stop the lockout when frame is clear
 		// OR if the lockout timer ends.
 
-		if ((frame_obstructed = catcierge_is_frame_obstructed(grb->img, 0)) < 0)
+		if ((frame_obstructed = catcierge_check_frame_obstructed(grb)) < 0)
 		{
 			CATERR("Failed to run check for obstructed frame\n");
 			return -1;
@@ -1323,7 +1842,7 @@ int catcierge_state_lockout(catcierge_grb_t *grb)
 
 		if (!catcierge_timer_isactive(&grb->lockout_timer))
 		{
-			if ((frame_obstructed = catcierge_is_frame_obstructed(grb->img, 0)) < 0)
+			if ((frame_obstructed = catcierge_check_frame_obstructed(grb)) < 0)
 			{
 				CATERR("Failed to run check for obstructed frame\n");
 				return -1;
@@ -1375,23 +1894,13 @@ void catcierge_state_transition_lockout(catcierge_grb_t *grb)
 	catcierge_do_lockout(grb);
 }
 
-int catcierge_state_matching(catcierge_grb_t *grb)
+static void catcierge_execute_match_cmd(catcierge_grb_t *grb)
 {
 	catcierge_args_t *args;
 	match_group_t *mg = &grb->match_group;
 	assert(grb);
 	args = &grb->args;
 
-	// We have something to match against.
-	if (catcierge_do_match(grb) < 0)
-	{
-		CATERRFPS("Error when matching frame!\n");
-		return -1;
-	}
-
-	catcierge_process_match_result(grb, grb->img);
-	grb->match_group.match_count++;
-
 	// Runs the --match_cmd program specified.
 	if (args->new_execute)
 	{
@@ -1407,10 +1916,243 @@ int catcierge_state_matching(catcierge_grb_t *grb)
 				args->saveimg ? match->path : "",	// %2 = Image path if saveimg is turned on.
 				result->direction);					// %3 = Direction, 0 = in, 1 = out.
 	}
+}
+
+int catcierge_burst_init(catcierge_grb_t *grb)
+{
+	size_t i;
+	size_t count;
+	catcierge_args_t *args;
+	catcierge_matcher_args_t *matcher_args;
+	catcierge_template_matcher_args_t templ;
+	assert(grb);
+	assert(grb->matcher);
+	args = &grb->args;
+
+	if (!args->burst)
+		return 0;
+
+	matcher_args = catcierge_get_matcher_args(args);
+
+	// The frames are already matched in parallel, so each
+	// burst matcher doesn't start a worker per CPU on top of that.
+	if (args->matcher_type == MATCHER_TEMPLATE)
+	{
+		templ = args->templ;
+		templ.match_workers = 1;
+		matcher_args = (catcierge_matcher_args_t *)&templ;
+	}
+
+	count = grb->match_group.max_count;
+
+	if (!(grb->burst_matchers = (catcierge_matcher_t **)calloc(count, sizeof(catcierge_matcher_t *)))
+	 || !(grb->burst_imgs = (IplImage **)calloc(count, sizeof(IplImage *)))
+	 || !(grb->burst_frames = (catcierge_frame_ctx_t *)calloc(count, sizeof(catcierge_frame_ctx_t)))
+	 || !(grb->burst_results = (double *)calloc(count, sizeof(double))))
+	{
+		CATERR("Out of memory!\n");
+		goto fail;
+	}
+
+	grb->burst_count = count;
+	grb->burst_matchers[0] = grb->matcher;
+
+	for (i = 0; i < count; i++)
+	{
+		catcierge_frame_ctx_init(&grb->burst_frames[i]);
+	}
+
+	for (i = 1; i < count; i++)
+	{
+		if (catcierge_matcher_init(&grb->burst_matchers[i], matcher_args))
+		{
+			CATERR("Failed to init %s matcher %d for burst matching\n", args->matcher, (int)i);
+			goto fail;
+		}
+
+		grb->burst_matchers[i]->images = &grb->match_group.images;
+	}
+
+	if (catcierge_workers_init(&grb->burst_workers, args->burst_workers))
+	{
+		CATERR("Failed to start burst match workers\n");
+		goto fail;
+	}
+
+	CATLOG("Burst matching with %d threads\n", catcierge_workers_count(&grb->burst_workers));
+
+	return 0;
+
+fail:
+	catcierge_burst_destroy(grb);
+	args->burst = 0;
+	return -1;
+}
+
+void catcierge_burst_destroy(catcierge_grb_t *grb)
+{
+	size_t i;
+	assert(grb);
+
+	catcierge_workers_destroy(&grb->burst_workers);
+
+	for (i = 0; i < grb->burst_count; i++)
+	{
+		// The first one is the normal matcher.
+		if ((i > 0) && grb->burst_matchers[i])
+		{
+			catcierge_matcher_destroy(&grb->burst_matchers[i]);
+		}
+
+		catcierge_image_pool_release(&grb->match_group.images, &grb->burst_imgs[i]);
+		catcierge_frame_ctx_destroy(&grb->burst_frames[i]);
+	}
+
+	free(grb->burst_matchers);
+	free(grb->burst_imgs);
+	free(grb->burst_frames);
+	free(grb->burst_results);
+	grb->burst_matchers = NULL;
+	grb->burst_imgs = NULL;
+	grb->burst_frames = NULL;
+	grb->burst_results = NULL;
+	grb->burst_count = 0;
+}
+
+// Copies the current frame and the frames following it, so that they
+// stay valid while being matched. Every frame but the last is recorded
+// and counted here, since the main loop only sees the last one.
+static int catcierge_burst_capture(catcierge_grb_t *grb)
+{
+	size_t i;
+	catcierge_image_pool_t *images;
+	assert(grb);
+	images = &grb->match_group.images;
+
+	for (i = 0; i < grb->burst_count; i++)
+	{
+		if (i > 0)
+		{
+			if (!(grb->img = catcierge_next_frame(grb)))
+			{
+				CATERRFPS("Failed to get frame %d of %d for burst matching\n",
+					(int)i + 1, (int)grb->burst_count);
+				return -1;
+			}
+
+			// The rest of the state machine continues from the last frame.
+			catcierge_frame_ctx_set(&grb->frame, grb->img);
+		}
+
+		// The previous frame can still be shared with a match image,
+		// so a free buffer is borrowed instead of copying over it.
+		// The matchers change the ROI of the frame, so it must be
+		// a buffer of exactly the same size.
+		catcierge_image_pool_release(images, &grb->burst_imgs[i]);
+
+		if (!(grb->burst_imgs[i] = catcierge_image_pool_get_exact(images,
+			cvGetSize(grb->img), grb->img->depth, grb->img->nChannels)))
+		{
+			CATERR("Out of memory!\n");
+			return -1;
+		}
+
+		cvCopy(grb->img, grb->burst_imgs[i], NULL);
+		catcierge_frame_ctx_set(&grb->burst_frames[i], grb->burst_imgs[i]);
+
+		// The last frame is recorded and counted when the state returns.
+		if (i < (grb->burst_count - 1))
+		{
+			catcierge_inner_frame_done(grb, catcierge_state_matching);
+		}
+	}
+
+	return 0;
+}
+
+static void catcierge_burst_match_job(void *user, size_t job)
+{
+	catcierge_grb_t *grb = (catcierge_grb_t *)user;
+	catcierge_matcher_t *matcher = grb->burst_matchers[job];
 
+	grb->burst_results[job] = matcher->match(matcher, &grb->burst_frames[job],
+		&grb->match_group.matches[job].result, grb->args.save_steps);
+}
+
+static int catcierge_state_matching_burst(catcierge_grb_t *grb)
+{
+	size_t i;
+	double start;
+	match_result_t *result;
+	match_group_t *mg = &grb->match_group;
+	assert(grb);
+	assert(mg->match_count == 0);
+	assert(grb->burst_count == mg->max_count);
+
+	if (catcierge_burst_capture(grb))
+	{
+		return -1;
+	}
+
+	// There is no previous match to take a hint from,
+	// all the frames are matched at the same time.
+	for (i = 0; i < grb->burst_count; i++)
+	{
+		result = &mg->matches[i].result;
+		catcierge_match_result_reset(result, &mg->images);
+	}
+
+	start = catcierge_timer_now();
+	catcierge_workers_run(&grb->burst_workers, catcierge_burst_match_job, grb, 0, grb->burst_count);
+	CATLOG("Matched %d frames in %0.1fms\n", (int)grb->burst_count, 1000.0 * (catcierge_timer_now() - start));
+
+	for (i = 0; i < grb->burst_count; i++)
+	{
+		if (grb->burst_results[i] < 0.0)
+		{
+			CATERR("%s matcher: Error when matching frame!\n", grb->args.matcher);
+			return -1;
+		}
+	}
+
+	// The results are handled in order, just like when matching one frame at a time.
+	for (i = 0; i < grb->burst_count; i++)
+	{
+		catcierge_process_match_result(grb, grb->burst_imgs[i]);
+		mg->match_count++;
+		catcierge_execute_match_cmd(grb);
+	}
+
+	catcierge_show_image(grb);
+	catcierge_decide_lock_status(grb);
+
+	return 0;
+}
+
+int catcierge_state_matching(catcierge_grb_t *grb)
+{
+	match_group_t *mg = &grb->match_group;
+	assert(grb);
+
+	if (catcierge_burst_enabled(grb) && (mg->match_count == 0))
+	{
+		return catcierge_state_matching_burst(grb);
+	}
+
+	// We have something to match against.
+	if (catcierge_do_match(grb) < 0)
+	{
+		CATERRFPS("Error when matching frame!\n");
+		return -1;
+	}
+
+	catcierge_process_match_result(grb, grb->img);
+	grb->match_group.match_count++;
+	catcierge_execute_match_cmd(grb);
 	catcierge_show_image(grb);
 
-	if (mg->match_count < MATCH_MAX_COUNT)
+	if ((mg->match_count < mg->max_count)
+		&& !(grb->args.early_decision && catcierge_match_group_is_decided(grb)))
 	{
 		// Continue until we have enough matches for a decision.
 		return 0;
@@ -1434,7 +2176,7 @@ int catcierge_state_waiting(catcierge_grb_t *grb)
 
 	// Wait until the middle of the frame is black
 	// before we try to match anything.
-	if ((frame_obstructed = catcierge_is_frame_obstructed(grb->img, 0)) < 0)
+	if ((frame_obstructed = catcierge_check_frame_obstructed(grb)) < 0)
 	{
 		CATERRFPS("Failed to perform check for obstructed frame\n");
 		return -1;
@@ -1446,6 +2188,9 @@ int catcierge_state_waiting(catcierge_grb_t *grb)
 
 		catcierge_match_group_start(mg, grb->img);
 
+		// Frames that are fed to the state machine directly have no capture time.
+		mg->obstruct_frame_time = (grb->frame_time > 0.0) ? grb->frame_time : catcierge_timer_now();
+
 		// Save the obstruct image.
 		catcierge_save_obstruct_image(grb);
 
@@ -1524,11 +2269,24 @@ int catcierge_grabber_init(catcierge_grb_t *grb)
 		return -1;
 	}
 
+	// Resized when the settings say otherwise.
+	if (catcierge_match_group_init(&grb->match_group, grb->args.match_group_size))
+	{
+		return -1;
+	}
+
+	catcierge_motion_init(&grb->motion, &grb->args.motion);
+	catcierge_frame_ctx_init(&grb->frame);
+
 	return 0;
 }
 
 void catcierge_grabber_destroy(catcierge_grb_t *grb)
 {
+	catcierge_burst_destroy(grb);
+	catcierge_recorder_close(&grb->recorder);
+	catcierge_frame_ctx_destroy(&grb->frame);
 	catcierge_args_destroy(&grb->args);
 	catcierge_cleanup_imgs(grb);
+	catcierge_match_group_destroy(&grb->match_group);
 }
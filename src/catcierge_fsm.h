@@ -10,6 +10,12 @@
 #include "catcierge_template_matcher.h"
 #include "catcierge_haar_matcher.h"
 #include "catcierge_timer.h"
+#include "catcierge_capture_thread.h"
+#include "catcierge_frame_source.h"
+#include "catcierge_idle.h"
+#include "catcierge_motion.h"
+#include "catcierge_recorder.h"
+#include "catcierge_workers.h"
 #include "catcierge_args.h"
 #include "catcierge_types.h"
 #include "catcierge_output_types.h"
@@ -54,11 +60,16 @@ typedef struct rfid_match_s
 #define CATLOGFPS(fmt, ...) CATLOG(fmt, ##__VA_ARGS__)
 #define CATERRFPS(fmt, ...) CATLOG(fmt, ##__VA_ARGS__)
 
-#define MATCH_MAX_COUNT 4 // The number of matches to perform before deciding the lock state.
-
 struct catcierge_grb_s;
 typedef int (*catcierge_state_func_t)(struct catcierge_grb_s *);
 
+typedef struct catcierge_state_time_s
+{
+	double wall;			// Seconds spent in the state.
+	double cpu;				// Process CPU seconds used while in the state.
+	unsigned long frames;	// Frames processed in the state.
+} catcierge_state_time_t;
+
 typedef struct catcierge_grb_s
 {
 	catcierge_state_func_t state;
@@ -68,13 +79,30 @@ typedef struct catcierge_grb_s
 
 	int running;
 
-	#ifdef RPI
-	RaspiCamCvCapture *capture;
-	#else
-	CvCapture *capture;
-	#endif
+	catcierge_frame_source_t source; // The camera, or a replay.
+	IplImage *source_frame; // Last frame gotten from the source.
 
 	IplImage *img; // The current camera frame.
+	catcierge_frame_ctx_t frame; // Cached gray scale planes etc. of img, shared by all the frame consumers.
+	unsigned long frame_seq; // Sequence number of the current frame.
+	double frame_time; // Monotonic time the current frame was captured.
+
+	int obstruct_sum; // Obstruction sum of the current frame, -1 if not calculated.
+	catcierge_recorder_t recorder; // Used with --record.
+
+	catcierge_capture_thread_t capture_thread; // Used with --capture_thread.
+	catcierge_capture_frame_t *capture_frame; // Frame currently held from the capture thread.
+
+	catcierge_idle_t idle; // Lowers the frame rate when nothing happens, used with --idle.
+
+	catcierge_motion_t motion; // Skips the obstruction check for unchanged frames, used with --motion_gate.
+	int last_obstructed; // Result of the last frame that was checked for obstruction.
+	int last_obstruct_sum;
+
+	// Time spent in each state, indexed by catcierge_get_record_state().
+	catcierge_state_time_t state_times[RECORD_STATE_COUNT];
+	double state_times_wall; // When the state times were last updated.
+	double state_times_cpu;
 
 	catcierge_matcher_t *matcher;
 	
@@ -83,6 +111,16 @@ typedef struct catcierge_grb_s
 	// Consecutive matches decides lockout status.
 	match_group_t match_group;
 
+	// Used with --burst. The whole match group is grabbed up front and matched
+	// in parallel. Matchers are not thread safe, so each frame gets its own,
+	// the first one is the normal matcher.
+	size_t burst_count; // Frames in a burst, the match group size.
+	catcierge_matcher_t **burst_matchers;
+	IplImage **burst_imgs; // Copies of the frames, reused between match groups.
+	catcierge_frame_ctx_t *burst_frames;
+	double *burst_results;
+	catcierge_workers_t burst_workers;
+
 	catcierge_timer_t rematch_timer;
 	catcierge_timer_t lockout_timer;
 	catcierge_timer_t frame_timer;
@@ -114,10 +152,15 @@ typedef struct catcierge_grb_s
 } catcierge_grb_t;
 
 const char *catcierge_get_state_string(catcierge_state_func_t state);
+catcierge_record_state_t catcierge_get_record_state(catcierge_state_func_t state);
 void catcierge_do_lockout(catcierge_grb_t *grb);
 void catcierge_do_unlock(catcierge_grb_t *grb);
 IplImage *catcierge_get_frame(catcierge_grb_t *grb);
+IplImage *catcierge_next_frame(catcierge_grb_t *grb);
 void catcierge_run_state(catcierge_grb_t *grb);
+void catcierge_state_times_start(catcierge_grb_t *grb);
+void catcierge_state_times_add(catcierge_grb_t *grb, catcierge_state_func_t state);
+void catcierge_print_state_times(catcierge_grb_t *grb);
 void catcierge_print_spinner(catcierge_grb_t *grb);
 void catcierge_destroy_camera(catcierge_grb_t *grb);
 #ifdef RPI
@@ -125,10 +168,15 @@ int catcierge_setup_gpio(catcierge_grb_t *grb);
 #endif
 int catcierge_grabber_init(catcierge_grb_t *grb);
 void catcierge_grabber_destroy(catcierge_grb_t *grb);
+int catcierge_match_group_init(match_group_t *mg, size_t max_count);
+void catcierge_match_group_destroy(match_group_t *mg);
+void catcierge_match_result_reset(match_result_t *result, catcierge_image_pool_t *images);
+int catcierge_burst_init(catcierge_grb_t *grb);
+void catcierge_burst_destroy(catcierge_grb_t *grb);
 #ifdef WITH_RFID
 void catcierge_init_rfid_readers(catcierge_grb_t *grb);
 #endif
-void catcierge_setup_camera(catcierge_grb_t *grb);
+int catcierge_setup_camera(catcierge_grb_t *grb);
 void catcierge_set_state(catcierge_grb_t *grb, catcierge_state_func_t new_state);
 void catcierge_run_state(catcierge_grb_t *grb);
 int catcierge_drop_root_privileges(const char *user);
@@ -7,6 +7,8 @@
 #include "catcierge_config.h"
 #include "catcierge_args.h"
 #include "catcierge_output.h"
+#include "catcierge_recorder.h"
+#include "catcierge_thread.h"
 #include <opencv2/imgproc/imgproc_c.h>
 #include <opencv2/highgui/highgui_c.h>
 
@@ -19,6 +21,8 @@ typedef struct fsm_tester_ctx_s
 	char *img_paths[4];
 	size_t img_count;
 	double delay;
+	char *recording_path;
+	int realtime;
 } fsm_tester_ctx_t;
 
 static IplImage *load_image(const char *path)
@@ -49,9 +53,70 @@ static IplImage *create_clear_image()
 	return img;
 }
 
+static int run_recording(catcierge_grb_t *grb, fsm_tester_ctx_t *ctx)
+{
+	catcierge_record_reader_t reader;
+	catcierge_record_frame_t frame;
+	catcierge_record_state_t state;
+	unsigned long frame_count = 0;
+	unsigned long mismatch_count = 0;
+	double first_timestamp = 0.0;
+	double start = 0.0;
+	double wait;
+
+	if (catcierge_record_reader_open(&reader, ctx->recording_path))
+	{
+		fprintf(stderr, "Failed to open recording %s\n", ctx->recording_path);
+		return -1;
+	}
+
+	while (!catcierge_record_reader_next(&reader, &frame))
+	{
+		if (frame_count == 0)
+		{
+			first_timestamp = frame.timestamp;
+			start = catcierge_timer_now();
+		}
+		else if (ctx->realtime)
+		{
+			wait = (frame.timestamp - first_timestamp) - (catcierge_timer_now() - start);
+
+			if (wait > 0.0)
+				catcierge_thread_sleep_ms((int)(wait * 1000.0));
+		}
+
+		state = catcierge_get_record_state(grb->state);
+
+		if (state != frame.state)
+		{
+			printf("Frame %lu (recorded seq %lu): State %s, recorded %s\n",
+				frame_count, (unsigned long)frame.frame_seq,
+				catcierge_record_state_str(state),
+				catcierge_record_state_str(frame.state));
+			mismatch_count++;
+		}
+
+		grb->img = frame.img;
+		grb->frame_seq = (unsigned long)frame.frame_seq;
+		grb->frame_time = frame.timestamp;
+		catcierge_run_state(grb);
+		grb->img = NULL;
+
+		frame_count++;
+	}
+
+	printf("Replayed %lu frames, %lu with a different state than recorded\n",
+		frame_count, mismatch_count);
+
+	catcierge_record_reader_close(&reader);
+
+	return 0;
+}
+
 static void show_usage(const char *progname)
 {
 	fprintf(stderr, "Usage: %s [options] --images <4 images>\n", progname);
+	fprintf(stderr, "       %s [options] --recording <path>\n", progname);
 	fprintf(stderr, "\n");
 	fprintf(stderr, "[options] includes the arguments supported by the catcierge grabber as well.\n");
 	fprintf(stderr, "\n");
@@ -62,6 +127,11 @@ static void show_usage(const char *progname)
 	fprintf(stderr, " --delay <seconds>          Delay this long before passing the images.\n");
 	fprintf(stderr, " --base_time <date>         The base date time we should use instead of the current time.\n");
 	fprintf(stderr, "                            In the format YYYY-mm-ddTHH:MM:SS.\n");
+	fprintf(stderr, " --recording <path>         Feed all frames of a recording made with --record\n");
+	fprintf(stderr, "                            to catcierge instead of --images, and compare the\n");
+	fprintf(stderr, "                            state each frame was processed in with the recorded one.\n");
+	fprintf(stderr, " --realtime                 Replay --recording at the recorded pace instead of\n");
+	fprintf(stderr, "                            as fast as possible (for timer dependent behavior).\n");
 }
 
 int parse_args_callback(catcierge_args_t *args,
@@ -98,6 +168,23 @@ int parse_args_callback(catcierge_args_t *args,
 		ctx->delay = atof(values[0]);
 		return 0;
 	}
+	else if (!strcmp(key, "recording"))
+	{
+		if (value_count != 1)
+		{
+			fprintf(stderr, "Missing path for --recording\n");
+			return -1;
+		}
+
+		ctx->recording_path = values[0];
+		return 0;
+	}
+	else if (!strcmp(key, "realtime"))
+	{
+		ctx->realtime = 1;
+		if (value_count == 1) ctx->realtime = atoi(values[0]);
+		return 0;
+	}
 	else if (!strcmp(key, "help"))
 	{
 		fprintf(stderr, "\n###############################################################################\n\n");
@@ -131,13 +218,25 @@ int main(int argc, char **argv)
 		ret = -1; goto fail;
 	}
 
-	if (ctx.img_count == 0)
+	if ((ctx.img_count == 0) && !ctx.recording_path)
 	{
 		show_usage(argv[0]);
 		fprintf(stderr, "\nNo input images specified!\n\n");
 		ret = -1; goto fail;
 	}
 
+	if (catcierge_match_group_init(&grb.match_group, args->match_group_size))
+	{
+		ret = -1; goto fail;
+	}
+
+	if (ctx.recording_path && args->record_path
+		&& !strcmp(ctx.recording_path, args->record_path))
+	{
+		fprintf(stderr, "\nCannot --record to the same file as the --recording being replayed\n\n");
+		ret = -1; goto fail;
+	}
+
 	if (catcierge_matcher_init(&grb.matcher, catcierge_get_matcher_args(args)))
 	{
 		fprintf(stderr, "\n\nFailed to %s init matcher\n\n", grb.args.matcher);
@@ -165,6 +264,12 @@ int main(int argc, char **argv)
 	catcierge_timer_set(&grb.frame_timer, 1.0);
 	catcierge_timer_start(&grb.frame_timer);
 
+	if (ctx.recording_path)
+	{
+		ret = run_recording(&grb, &ctx);
+		goto fail;
+	}
+
 	// For delayed start we create a clear image that will
 	// be fed to the state machine until we're ready to obstruct the frame.
 	if (ctx.delay > 0.0)
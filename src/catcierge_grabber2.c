@@ -163,6 +163,13 @@ void setup_sig_handlers()
 int main(int argc, char **argv)
 {
 	catcierge_args_t *args;
+	unsigned long frame_count = 0;
+	double start_time;
+	double startup_time;
+	double phase_time;
+	double elapsed;
+	double last_cpu_report;
+	catcierge_state_func_t state;
 	args = &grb.args;
 
 	fprintf(stderr, "\nCatcierge Grabber v" CATCIERGE_VERSION_STR " (" CATCIERGE_GIT_HASH_SHORT "");
@@ -181,6 +188,8 @@ int main(int argc, char **argv)
 	fprintf(stderr, "   CZMQ v%d.%d.%d\n", CZMQ_VERSION_MAJOR, CZMQ_VERSION_MINOR, CZMQ_VERSION_PATCH);
 	#endif
 
+	startup_time = catcierge_timer_now();
+
 	#ifndef _WIN32
 	pid_fd = create_pid_file(argv[0], PID_PATH, FD_CLOEXEC);
 	#endif
@@ -212,6 +221,19 @@ int main(int argc, char **argv)
 
 		// TODO: Add verify function for settings. Make sure we have everything we need...
 
+		if (args->ok_matches_needed > args->match_group_size)
+		{
+			fprintf(stderr, "--ok_matches_needed cannot be larger than --match_group_size %d\n",
+				args->match_group_size);
+			return -1;
+		}
+
+		if (catcierge_match_group_init(&grb.match_group, args->match_group_size))
+		{
+			fprintf(stderr, "Failed to allocate %d matches\n", args->match_group_size);
+			return -1;
+		}
+
 		catcierge_print_settings(args);
 	}
 
@@ -238,13 +260,23 @@ int main(int argc, char **argv)
 	assert((args->matcher_type == MATCHER_TEMPLATE)
 		|| (args->matcher_type == MATCHER_HAAR));
 
+	phase_time = catcierge_timer_now();
+
 	if (catcierge_matcher_init(&grb.matcher, catcierge_get_matcher_args(args)))
 	{
 		CATERR("Failed to %s init matcher\n", grb.args.matcher);
 		return -1;
 	}
 
-	CATLOG("Initialized catcierge image recognition\n");
+	if (catcierge_burst_init(&grb))
+	{
+		CATERR("Failed to setup burst matching, matching one frame at a time instead\n");
+	}
+
+	CATLOG("Initialized catcierge image recognition in %0.1fms\n",
+		1000.0 * (catcierge_timer_now() - phase_time));
+
+	phase_time = catcierge_timer_now();
 
 	if (catcierge_output_init(&grb.output))
 	{
@@ -259,23 +291,40 @@ int main(int argc, char **argv)
 		return -1;
 	}
 
-	CATLOG("Initialized output templates\n");
+	CATLOG("Initialized output templates in %0.1fms\n",
+		1000.0 * (catcierge_timer_now() - phase_time));
 
 	#ifdef WITH_RFID
 	catcierge_init_rfid_readers(&grb);
 	#endif
 
-	catcierge_setup_camera(&grb);
+	phase_time = catcierge_timer_now();
+
+	if (catcierge_setup_camera(&grb))
+	{
+		CATERR("Failed to setup %s frame source\n",
+			catcierge_frame_source_type_str(args->source.type));
+		return -1;
+	}
+
+	CATLOG("Initialized %s frame source in %0.1fms\n",
+		catcierge_frame_source_type_str(args->source.type),
+		1000.0 * (catcierge_timer_now() - phase_time));
 
 	#ifdef WITH_ZMQ
 	catcierge_zmq_init(&grb);
 	#endif
 
-	CATLOG("Starting detection!\n");
+	CATLOG("Starting detection! Startup took %0.1fms\n",
+		1000.0 * (catcierge_timer_now() - startup_time));
 	// TODO: Create a catcierge_grb_start(grb) function that does this instead.
 	grb.running = 1;
 	catcierge_set_state(&grb, catcierge_state_waiting);
 	catcierge_timer_set(&grb.frame_timer, 1.0);
+	catcierge_idle_init(&grb.idle, &args->idle);
+	catcierge_state_times_start(&grb);
+	start_time = catcierge_timer_now();
+	last_cpu_report = start_time;
 
 	// Run the program state machine.
 	do
@@ -294,10 +343,52 @@ int main(int argc, char **argv)
 		}
 		#endif // WITH_RFID
 
-		grb.img = catcierge_get_frame(&grb);
+		// Lower the frame rate when nothing is going on.
+		catcierge_idle_wait(&grb.idle);
 
+		if (!(grb.img = catcierge_next_frame(&grb)))
+		{
+			if (grb.source.eof)
+			{
+				CATLOG("Reached the end of the %s replay\n", grb.source.name);
+				grb.running = 0;
+			}
+			else
+			{
+				CATERRFPS("Failed to get camera frame\n");
+			}
+
+			continue;
+		}
+
+		frame_count++;
+		state = grb.state;
 		catcierge_run_state(&grb);
+
+		if (frame_count == 1)
+		{
+			CATLOG("First frame processed %0.1fms after starting\n",
+				1000.0 * (catcierge_timer_now() - startup_time));
+		}
+		catcierge_state_times_add(&grb, state);
+		catcierge_idle_update(&grb.idle,
+			(grb.state == catcierge_state_waiting), grb.obstruct_sum);
+
+		if (grb.motion.moved)
+		{
+			catcierge_idle_activity(&grb.idle);
+		}
+
 		catcierge_print_spinner(&grb);
+
+		if ((args->cpu_report > 0.0)
+			&& ((catcierge_timer_now() - last_cpu_report) >= args->cpu_report))
+		{
+			catcierge_print_state_times(&grb);
+			catcierge_motion_print_stats(&grb.motion);
+			catcierge_frame_ctx_print_stats(&grb.frame);
+			last_cpu_report = catcierge_timer_now();
+		}
 	} while (
 		grb.running
 		#ifdef WITH_ZMQ
@@ -305,6 +396,14 @@ int main(int argc, char **argv)
 		#endif
 		);
 
+	elapsed = catcierge_timer_now() - start_time;
+	CATLOG("Processed %lu frames in %0.2f seconds (%0.1f fps)\n",
+		frame_count, elapsed, (elapsed > 0.0) ? (frame_count / elapsed) : 0.0);
+	catcierge_print_state_times(&grb);
+	catcierge_idle_print_stats(&grb.idle);
+	catcierge_motion_print_stats(&grb.motion);
+	catcierge_frame_ctx_print_stats(&grb.frame);
+
 	catcierge_matcher_destroy(&grb.matcher);
 	catcierge_output_destroy(&grb.output);
 	catcierge_destroy_camera(&grb);
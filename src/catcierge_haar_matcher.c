@@ -5,13 +5,30 @@
 #include "catcierge_types.h"
 #include "catcierge_util.h"
 #include "catcierge_log.h"
+#include "catcierge_timer.h"
 #include <opencv2/core/core_c.h>
 
+// Most step images saved by one match, depending on the prey detection.
+static size_t catcierge_haar_matcher_step_img_max(catcierge_haar_matcher_args_t *args)
+{
+	// Grayscale original, haar match, region of interest and global threshold.
+	size_t count = 4;
+
+	// The prey detection steps followed by the contours and final image.
+	if (args->prey_method == PREY_METHOD_ADAPTIVE)
+		count += 5 + 2;
+	else if (args->prey_method == PREY_METHOD_FAST)
+		count += 3 + 2;
+
+	return count;
+}
+
 int catcierge_haar_matcher_init(catcierge_matcher_t **octx,
 		catcierge_matcher_args_t *oargs)
 {
 	catcierge_haar_matcher_t *ctx = NULL;
 	catcierge_haar_matcher_args_t *args = (catcierge_haar_matcher_args_t *)oargs;
+	double start;
 	assert(args);
 	assert(octx);
 
@@ -37,17 +54,32 @@ int catcierge_haar_matcher_init(catcierge_matcher_t **octx,
 		return -1;
 	}
 
-	if (cv2CascadeClassifier_load(ctx->cascade, args->cascade))
+	start = catcierge_timer_now();
+
+	if (cv2CascadeClassifier_load_cached(ctx->cascade,
+			args->cascade, args->cascade_cache, &ctx->cascade_cache_hit))
 	{
 		CATERR("Failed to load cascade xml: %s\n", args->cascade);
 		return -1;
 	}
 
-	if (!(ctx->storage = cvCreateMemStorage(0)))
+	ctx->cascade_load_time = catcierge_timer_now() - start;
+	CATLOG("Haar matcher: Loaded cascade %s in %0.1fms%s\n",
+		args->cascade, 1000.0 * ctx->cascade_load_time,
+		ctx->cascade_cache_hit ? " (from cache)" : "");
+
+	if (!(ctx->storage = cvCreateMemStorage(CATCIERGE_HAAR_STORAGE_BLOCK)))
+	{
+		return -1;
+	}
+
+	if (catcierge_ccl_init(&ctx->ccl))
 	{
 		return -1;
 	}
 
+	catcierge_morph_init(&ctx->morph);
+
 	if (!(ctx->kernel2x2 = cvCreateStructuringElementEx(2, 2, 0, 0, CV_SHAPE_RECT, NULL)))
 	{
 		return -1;
@@ -68,6 +100,7 @@ int catcierge_haar_matcher_init(catcierge_matcher_t **octx,
 	ctx->super.match = catcierge_haar_matcher_match;
 	ctx->super.decide = catcierge_haar_matcher_decide;
 	ctx->super.translate = catcierge_haar_matcher_translate;
+	ctx->super.step_img_max = catcierge_haar_matcher_step_img_max(args);
 
 	return 0;
 }
@@ -111,6 +144,15 @@ void catcierge_haar_matcher_destroy(catcierge_matcher_t **octx)
 		ctx->storage = NULL;
 	}
 
+	if (ctx->prey_img)
+	{
+		cvReleaseImage(&ctx->prey_img);
+		ctx->prey_img = NULL;
+	}
+
+	catcierge_ccl_destroy(&ctx->ccl);
+	catcierge_morph_destroy(&ctx->morph);
+
 	free(ctx);
 	*octx = NULL;
 }
@@ -162,36 +204,6 @@ match_direction_t catcierge_haar_guess_direction(catcierge_haar_matcher_t *ctx,
 	}
 }
 
-size_t catcierge_haar_matcher_count_contours(catcierge_haar_matcher_t *ctx, CvSeq *contours)
-{
-	size_t contour_count = 0;
-	double area;
-	int big_enough = 0;
-	CvSeq *it = NULL;
-	assert(ctx);
-	assert(ctx->args);
-
-	if (!contours)
-		return 0;
-
-	it = contours;
-	while (it)
-	{
-		area = cvContourArea(it, CV_WHOLE_SEQ, 0);
-		big_enough = (area > 10.0);
-		if (ctx->super.debug) printf("Area: %f %s\n", area, big_enough ? "" : "(too small)");
-
-		if (big_enough)
-		{
-			contour_count++;
-		}
-
-		it = it->h_next;
-	}
-
-	return contour_count;
-}
-
 void catcierge_haar_matcher_save_step_image(catcierge_haar_matcher_t *ctx,
 											IplImage *img, match_result_t *result,
 											const char *name, const char *description,
@@ -207,11 +219,7 @@ void catcierge_haar_matcher_save_step_image(catcierge_haar_matcher_t *ctx,
 
 	step = &result->steps[result->step_img_count];
 
-	if (step->img)
-	{
-		cvReleaseImage(&step->img);
-		step->img = NULL;
-	}
+	catcierge_image_pool_release(ctx->super.images, &step->img);
 
 	// If saving steps is turned off, simply release
 	// any previous step image.
@@ -223,7 +231,7 @@ void catcierge_haar_matcher_save_step_image(catcierge_haar_matcher_t *ctx,
 	img_size.width = roi.width;
 	img_size.height = roi.height;
 
-	step->img = cvCreateImage(img_size, 8, img->nChannels);
+	step->img = catcierge_image_pool_get(ctx->super.images, img_size, 8, img->nChannels);
 	cvCopy(img, step->img, NULL);
 
 	step->name = name;
@@ -232,6 +240,110 @@ void catcierge_haar_matcher_save_step_image(catcierge_haar_matcher_t *ctx,
 	result->step_img_count++;
 }
 
+static size_t catcierge_haar_matcher_storage_size(CvMemStorage *storage)
+{
+	size_t bytes = 0;
+	CvMemBlock *block = NULL;
+
+	for (block = storage->bottom; block; block = block->next)
+	{
+		bytes += storage->block_size;
+	}
+
+	return bytes;
+}
+
+// Clear the contours of the previous frame. The storage keeps
+// its blocks, so nothing is allocated unless this frame needs more.
+static CvMemStorage *catcierge_haar_matcher_begin_contours(catcierge_haar_matcher_t *ctx)
+{
+	assert(ctx);
+	cvClearMemStorage(ctx->storage);
+	return ctx->storage;
+}
+
+//
+// Updates the memory usage after looking for prey. A very noisy frame
+// can produce a lot of contours, don't hold on to that memory for the
+// rest of the run.
+//
+static void catcierge_haar_matcher_update_memory(catcierge_haar_matcher_t *ctx)
+{
+	size_t storage_bytes;
+	size_t ccl_bytes;
+	CvMemStorage *storage = NULL;
+	catcierge_ccl_t ccl;
+	assert(ctx);
+
+	storage_bytes = catcierge_haar_matcher_storage_size(ctx->storage);
+	ccl_bytes = catcierge_ccl_memory(&ctx->ccl);
+	ctx->contour_bytes = storage_bytes + ccl_bytes;
+
+	if (ctx->contour_bytes > ctx->contour_peak)
+	{
+		ctx->contour_peak = ctx->contour_bytes;
+	}
+
+	if ((storage_bytes > CATCIERGE_HAAR_STORAGE_MAX)
+		&& (storage = cvCreateMemStorage(CATCIERGE_HAAR_STORAGE_BLOCK)))
+	{
+		cvReleaseMemStorage(&ctx->storage);
+		ctx->storage = storage;
+		ctx->contour_bytes -= storage_bytes;
+		ctx->contour_shrinks++;
+	}
+
+	if ((ccl_bytes > CATCIERGE_HAAR_STORAGE_MAX) && !catcierge_ccl_init(&ccl))
+	{
+		catcierge_ccl_destroy(&ctx->ccl);
+		ctx->ccl = ccl;
+		ctx->contour_bytes += catcierge_ccl_memory(&ctx->ccl) - ccl_bytes;
+		ctx->contour_shrinks++;
+	}
+}
+
+void catcierge_haar_matcher_memory(catcierge_haar_matcher_t *ctx, size_t *current, size_t *peak)
+{
+	assert(ctx);
+
+	if (current) *current = ctx->contour_bytes;
+	if (peak) *peak = ctx->contour_peak;
+}
+
+// Draws the prey contours and the final result as step images.
+static void catcierge_haar_matcher_save_prey_contours(catcierge_haar_matcher_t *ctx,
+	IplImage *img, IplImage *bin_img, int contour_count, match_result_t *result)
+{
+	IplImage *img_contour = cvCloneImage(img);
+	IplImage *img_final_color = NULL;
+	CvSeq *contours = NULL;
+	CvScalar color;
+	assert(ctx);
+
+	// Only trace the contours when they are drawn.
+	cvFindContours(bin_img, catcierge_haar_matcher_begin_contours(ctx), &contours,
+		sizeof(CvContour), CV_RETR_LIST, CV_CHAIN_APPROX_NONE, cvPoint(0, 0));
+
+	cvDrawContours(img_contour, contours, cvScalarAll(255), cvScalarAll(0), 1, 1, 8, cvPoint(0, 0));
+	catcierge_haar_matcher_save_step_image(ctx,
+		img_contour, result, "contours", "Background contours", 1);
+
+	// Draw a final color combined image with the Haar detection + contour.
+	cvResetImageROI(img_contour);
+
+	img_final_color =  cvCreateImage(cvGetSize(img_contour), 8, 3);
+
+	cvCvtColor(img_contour, img_final_color, CV_GRAY2BGR);
+	color = (contour_count > 1) ? CV_RGB(255, 0, 0) : CV_RGB(0, 255, 0);
+	cvRectangleR(img_final_color, result->match_rects[0], color, 2, 8, 0);
+
+	catcierge_haar_matcher_save_step_image(ctx,
+		img_final_color, result, "final", "Final image", 1);
+
+	cvReleaseImage(&img_contour);
+	cvReleaseImage(&img_final_color);
+}
+
 int catcierge_haar_matcher_find_prey_adaptive(catcierge_haar_matcher_t *ctx,
 											IplImage *img, IplImage *inv_thr_img,
 											match_result_t *result, int save_steps)
@@ -240,7 +352,6 @@ int catcierge_haar_matcher_find_prey_adaptive(catcierge_haar_matcher_t *ctx,
 	IplImage *inv_combined = NULL;
 	IplImage *open_combined = NULL;
 	IplImage *dilate_combined = NULL;
-	CvSeq *contours = NULL;
 	size_t contour_count = 0;
 	CvSize img_size;
 	assert(ctx);
@@ -283,42 +394,108 @@ int catcierge_haar_matcher_find_prey_adaptive(catcierge_haar_matcher_t *ctx,
 	catcierge_haar_matcher_save_step_image(ctx,
 		dilate_combined, result, "combined", "Combined binary image", save_steps);
 
-	cvFindContours(dilate_combined, ctx->storage, &contours,
-		sizeof(CvContour), CV_RETR_LIST, CV_CHAIN_APPROX_NONE, cvPoint(0, 0));
-
 	// If we get more than 1 contour we count it as a prey.
-	contour_count = catcierge_haar_matcher_count_contours(ctx, contours);
+	contour_count = catcierge_ccl_count_image(&ctx->ccl, dilate_combined,
+		CATCIERGE_HAAR_PREY_MIN_AREA, 2);
 
 	if (save_steps)
 	{
-		IplImage *img_contour = cvCloneImage(img);
-		IplImage *img_final_color = NULL;
-		CvScalar color;
+		catcierge_haar_matcher_save_prey_contours(ctx,
+			img, dilate_combined, contour_count, result);
+	}
 
-		cvDrawContours(img_contour, contours, cvScalarAll(255), cvScalarAll(0), 1, 1, 8, cvPoint(0, 0));
-		catcierge_haar_matcher_save_step_image(ctx,
-			img_contour, result, "contours", "Background contours", save_steps);
+	cvReleaseImage(&inv_adpthr_img);
+	cvReleaseImage(&inv_combined);
+	cvReleaseImage(&open_combined);
+	cvReleaseImage(&dilate_combined);
+	catcierge_haar_matcher_update_memory(ctx);
+
+	return (contour_count > 1);
+}
+
+//
+// Start of the region of interest of a 8-bit single channel image.
+//
+static unsigned char *catcierge_haar_matcher_roi_data(IplImage *img)
+{
+	CvRect roi = cvGetImageROI(img);
+	return (unsigned char *)img->imageData + roi.y * img->widthStep + roi.x;
+}
 
-		// Draw a final color combined image with the Haar detection + contour.
-		cvResetImageROI(img_contour);
+//
+// Same as the adaptive method, but with a mean instead of a gaussian
+// adaptive threshold that is combined with the global threshold in
+// the same pass. Opening twice with a 2x2 rectangle and dilating 3
+// times with a 3x3 rectangle is the same as eroding once with a 3x3
+// and dilating once with a 9x9 rectangle (apart from the 2 pixel
+// shift of the 2x2 anchor), so that is done instead, inverting the
+// result in the last step. Everything is done in buffers that are
+// kept between frames.
+//
+int catcierge_haar_matcher_find_prey_fast(catcierge_haar_matcher_t *ctx,
+										IplImage *img, IplImage *inv_thr_img,
+										match_result_t *result, int save_steps)
+{
+	int contour_count = 0;
+	unsigned char *data = NULL;
+	CvSize img_size;
+	assert(ctx);
+	assert(img);
+	assert(ctx->args);
 
-		img_final_color =  cvCreateImage(cvGetSize(img_contour), 8, 3);
+	img_size = cvGetSize(img);
 
-		cvCvtColor(img_contour, img_final_color, CV_GRAY2BGR);
-		color = (contour_count > 1) ? CV_RGB(255, 0, 0) : CV_RGB(0, 255, 0);
-		cvRectangleR(img_final_color, result->match_rects[0], color, 2, 8, 0);
+	if (!ctx->prey_img
+		|| (ctx->prey_img->width < img_size.width)
+		|| (ctx->prey_img->height < img_size.height))
+	{
+		if (ctx->prey_img)
+			cvReleaseImage(&ctx->prey_img);
 
-		catcierge_haar_matcher_save_step_image(ctx,
-			img_final_color, result, "final", "Final image", save_steps);
+		if (!(ctx->prey_img = cvCreateImage(img_size, 8, 1)))
+			return 0;
+	}
 
-		cvReleaseImage(&img_contour);
-		cvReleaseImage(&img_final_color);
+	cvSetImageROI(ctx->prey_img, cvRect(0, 0, img_size.width, img_size.height));
+	data = (unsigned char *)ctx->prey_img->imageData;
+
+	// Inverted adaptive threshold combined with the
+	// inverted global threshold (inv_thr_img).
+	if (catcierge_morph_adaptive_threshold(&ctx->morph,
+			catcierge_haar_matcher_roi_data(img), img->widthStep,
+			catcierge_haar_matcher_roi_data(inv_thr_img), inv_thr_img->widthStep,
+			data, ctx->prey_img->widthStep,
+			img_size.width, img_size.height, 11, 5))
+	{
+		return 0;
 	}
 
-	cvReleaseImage(&inv_adpthr_img);
-	cvReleaseImage(&inv_combined);
-	cvReleaseImage(&open_combined);
-	cvReleaseImage(&dilate_combined);
+	catcierge_haar_matcher_save_step_image(ctx,
+		ctx->prey_img, result, "inv_combined", "Combined global and adaptive threshold", save_steps);
+
+	// Get rid of noise from the adaptive threshold.
+	catcierge_morph_erode(&ctx->morph, data, ctx->prey_img->widthStep,
+		data, ctx->prey_img->widthStep, img_size.width, img_size.height, 3, 3, 0);
+	catcierge_haar_matcher_save_step_image(ctx,
+		ctx->prey_img, result, "eroded", "Eroded image", save_steps);
+
+	// Dilate and invert back the result so the background is white again.
+	catcierge_morph_dilate(&ctx->morph, data, ctx->prey_img->widthStep,
+		data, ctx->prey_img->widthStep, img_size.width, img_size.height, 9, 9, 1);
+	catcierge_haar_matcher_save_step_image(ctx,
+		ctx->prey_img, result, "combined", "Combined binary image", save_steps);
+
+	// If we get more than 1 contour we count it as a prey.
+	contour_count = catcierge_ccl_count_image(&ctx->ccl, ctx->prey_img,
+		CATCIERGE_HAAR_PREY_MIN_AREA, 2);
+
+	if (save_steps)
+	{
+		catcierge_haar_matcher_save_prey_contours(ctx,
+			img, ctx->prey_img, contour_count, result);
+	}
+
+	catcierge_haar_matcher_update_memory(ctx);
 
 	return (contour_count > 1);
 }
@@ -328,53 +505,54 @@ int catcierge_haar_matcher_find_prey(catcierge_haar_matcher_t *ctx,
 									match_result_t *result, int save_steps)
 {
 	catcierge_haar_matcher_args_t *args = ctx->args;
-	IplImage *thr_img2 = NULL;
-	CvSeq *contours = NULL;
-	size_t contour_count = 0;
+	int contour_count = 0;
 	assert(ctx);
 	assert(img);
 	assert(ctx->args);
 
-	// thr_img is modified by FindContours so we clone it first.
-	thr_img2 = cvCloneImage(thr_img);
-
-	cvFindContours(thr_img, ctx->storage, &contours,
-		sizeof(CvContour), CV_RETR_LIST, CV_CHAIN_APPROX_NONE, cvPoint(0, 0));
-
 	// If we get more than 1 contour we count it as a prey. At least something
 	// is intersecting the white are to split up the image.
-	contour_count = catcierge_haar_matcher_count_contours(ctx, contours);
+	contour_count = catcierge_ccl_count_image(&ctx->ccl, thr_img,
+		CATCIERGE_HAAR_PREY_MIN_AREA, 2);
 
 	// If we don't find any prey 
 	if ((args->prey_steps >= 2) && (contour_count == 1))
 	{
 		IplImage *erod_img = NULL;
 		IplImage *open_img = NULL;
-		CvSeq *contours2 = NULL;
 
-		erod_img = cvCreateImage(cvGetSize(thr_img2), 8, 1);
-		cvErode(thr_img2, erod_img, ctx->kernel3x3, 3);
+		erod_img = cvCreateImage(cvGetSize(thr_img), 8, 1);
+		cvErode(thr_img, erod_img, ctx->kernel3x3, 3);
 		if (ctx->super.debug) cvShowImage("haar eroded img", erod_img);
 
-		open_img = cvCreateImage(cvGetSize(thr_img2), 8, 1);
+		open_img = cvCreateImage(cvGetSize(thr_img), 8, 1);
 		cvMorphologyEx(erod_img, open_img, NULL, ctx->kernel5x1, CV_MOP_OPEN, 1);
 		if (ctx->super.debug) cvShowImage("haar opened img", erod_img);
 
-		cvFindContours(erod_img, ctx->storage, &contours2,
-			sizeof(CvContour), CV_RETR_LIST, CV_CHAIN_APPROX_NONE, cvPoint(0, 0));
+		contour_count = catcierge_ccl_count_image(&ctx->ccl, erod_img,
+			CATCIERGE_HAAR_PREY_MIN_AREA, 2);
+
 		cvReleaseImage(&erod_img);
 		cvReleaseImage(&open_img);
-
-		contour_count = catcierge_haar_matcher_count_contours(ctx, contours2);
 	}
 
 	if (ctx->super.debug)
 	{
-		cvDrawContours(img, contours, cvScalarAll(0), cvScalarAll(0), 1, 1, 8, cvPoint(0, 0));
-		cvShowImage("Haar Contours", img);
+		// Don't draw on img, it is shared with the other frame consumers.
+		// FindContours modifies the image so trace a copy.
+		IplImage *thr_img2 = cvCloneImage(thr_img);
+		IplImage *img_contour = cvCloneImage(img);
+		CvSeq *contours = NULL;
+
+		cvFindContours(thr_img2, catcierge_haar_matcher_begin_contours(ctx), &contours,
+			sizeof(CvContour), CV_RETR_LIST, CV_CHAIN_APPROX_NONE, cvPoint(0, 0));
+		cvDrawContours(img_contour, contours, cvScalarAll(0), cvScalarAll(0), 1, 1, 8, cvPoint(0, 0));
+		cvShowImage("Haar Contours", img_contour);
+		cvReleaseImage(&img_contour);
+		cvReleaseImage(&thr_img2);
 	}
 
-	cvReleaseImage(&thr_img2);
+	catcierge_haar_matcher_update_memory(ctx);
 
 	return (contour_count > 1);
 }
@@ -394,69 +572,197 @@ void catcierge_haar_matcher_calculate_roi(catcierge_haar_matcher_t *ctx, CvRect
 	if (roi->x < 0) roi->x = 0;
 }
 
+static int catcierge_haar_matcher_flags(catcierge_haar_matcher_args_t *args)
+{
+	return args->scale_image ? CV_HAAR_SCALE_IMAGE : 0;
+}
+
+CvRect catcierge_haar_matcher_track_window(catcierge_haar_matcher_t *ctx,
+		const CvRect *prev, CvSize img_size, CvSize *min_size, CvSize *max_size)
+{
+	int pad_x;
+	int pad_y;
+	int x1;
+	int y1;
+	CvRect window;
+	catcierge_haar_matcher_args_t *args = NULL;
+	assert(ctx);
+	assert(ctx->args);
+	assert(prev);
+	assert(min_size);
+	assert(max_size);
+	args = ctx->args;
+
+	pad_x = (prev->width * args->track_pad) / 100;
+	pad_y = (prev->height * args->track_pad) / 100;
+
+	window.x = prev->x - pad_x;
+	window.y = prev->y - pad_y;
+	x1 = prev->x + prev->width + pad_x;
+	y1 = prev->y + prev->height + pad_y;
+
+	if (window.x < 0) window.x = 0;
+	if (window.y < 0) window.y = 0;
+	if (x1 > img_size.width) x1 = img_size.width;
+	if (y1 > img_size.height) y1 = img_size.height;
+
+	window.width = (x1 > window.x) ? (x1 - window.x) : 0;
+	window.height = (y1 > window.y) ? (y1 - window.y) : 0;
+
+	// The head doesn't change size much between frames either.
+	min_size->width = (int)(prev->width / CATCIERGE_HAAR_TRACK_SCALE);
+	min_size->height = (int)(prev->height / CATCIERGE_HAAR_TRACK_SCALE);
+	max_size->width = (int)(prev->width * CATCIERGE_HAAR_TRACK_SCALE + 0.5);
+	max_size->height = (int)(prev->height * CATCIERGE_HAAR_TRACK_SCALE + 0.5);
+
+	if (min_size->width < args->min_width) min_size->width = args->min_width;
+	if (min_size->height < args->min_height) min_size->height = args->min_height;
+	if (max_size->width < min_size->width) max_size->width = min_size->width;
+	if (max_size->height < min_size->height) max_size->height = min_size->height;
+
+	return window;
+}
+
+//
+// Looks for the head only in a window around the head found in the
+// previous frame (the first hint rect). Returns 1 if it was found,
+// 0 if a full search is needed and -1 on error.
+//
+static int catcierge_haar_matcher_detect_tracked(catcierge_haar_matcher_t *ctx,
+		IplImage *img, match_result_t *result)
+{
+	size_t i;
+	size_t count;
+	int err;
+	double start;
+	CvRect window;
+	CvSize min_size;
+	CvSize max_size;
+	assert(ctx);
+	assert(img);
+	assert(result);
+
+	start = catcierge_timer_now();
+	window = catcierge_haar_matcher_track_window(ctx,
+		&result->hint_rects[0], cvGetSize(img), &min_size, &max_size);
+
+	if ((window.width < min_size.width) || (window.height < min_size.height))
+	{
+		result->hint_miss = 1;
+		return 0;
+	}
+
+	cvSetImageROI(img, window);
+	result->rect_count = MAX_MATCH_RECTS;
+
+	err = cv2CascadeClassifier_detectMultiScale(ctx->cascade,
+			img, result->match_rects, &result->rect_count,
+			ctx->args->scale_factor, ctx->args->min_neighbours,
+			catcierge_haar_matcher_flags(ctx->args), &min_size, &max_size);
+
+	cvResetImageROI(img);
+	result->hint_time = catcierge_timer_now() - start;
+
+	if (err)
+		return -1;
+
+	if (result->rect_count == 0)
+	{
+		result->hint_miss = 1;
+		return 0;
+	}
+
+	// Back to whole image coordinates.
+	count = (result->rect_count < MAX_MATCH_RECTS) ? result->rect_count : MAX_MATCH_RECTS;
+
+	for (i = 0; i < count; i++)
+	{
+		result->match_rects[i].x += window.x;
+		result->match_rects[i].y += window.y;
+	}
+
+	result->hint_hit = 1;
+
+	return 1;
+}
+
 double catcierge_haar_matcher_match(void *octx,
-		IplImage *img, match_result_t *result, int save_steps)
+		catcierge_frame_ctx_t *frame, match_result_t *result, int save_steps)
 {
 	catcierge_haar_matcher_t *ctx = (catcierge_haar_matcher_t *)octx;
 	catcierge_haar_matcher_args_t *args = ctx->args;
 	double ret = HAAR_SUCCESS_NO_HEAD;
+	IplImage *img = NULL;
 	IplImage *img_eq = NULL;
-	IplImage *img_gray = NULL;
-	IplImage *tmp = NULL;
 	IplImage *thr_img = NULL;
 	CvSize max_size;
 	CvSize min_size;
 	int cat_head_found = 0;
+	double start;
 	assert(ctx);
 	assert(ctx->args);
 	assert(result);
+	assert(frame);
+	assert(frame->img);
 
+	img = frame->img;
 	min_size.width = args->min_width;
 	min_size.height = args->min_height;
 	max_size.width = 0;
 	max_size.height = 0;
 	result->step_img_count = 0;
 	result->description[0] = '\0';
-
-	// Make gray scale if needed.
-	if (img->nChannels != 1)
-	{
-		tmp = cvCreateImage(cvGetSize(img), 8, 1);
-		cvCvtColor(img, tmp, CV_BGR2GRAY);
-		img_gray = tmp;
-	}
-	else
-	{
-		img_gray = img;
-	}
+	result->hint_hit = 0;
+	result->hint_miss = 0;
+	result->search_time = 0.0;
+	result->hint_time = 0.0;
 
 	if (result->direction)
 	{
 		result->direction = MATCH_DIR_UNKNOWN;
 	}
 
-	// Equalize histogram.
-	if (args->eq_histogram)
-	{
-		img_eq = cvCreateImage(cvGetSize(img), 8, 1);
-		cvEqualizeHist(img_gray, img_eq);
-	}
-	else
+	// Gray scale and optionally equalized, shared with
+	// the rest of the frame consumers. Only the ROI is
+	// changed on it below, never the pixels.
+	img_eq = args->eq_histogram ?
+		catcierge_frame_ctx_equalized(frame) : catcierge_frame_ctx_gray(frame);
+
+	if (!img_eq)
 	{
-		img_eq = img_gray;
+		result->result = -1.0;
+		return -1.0;
 	}
 
 	catcierge_haar_matcher_save_step_image(ctx,
 		img_eq, result, "gray", "Grayscale original", save_steps);
 
-	result->rect_count = MAX_MATCH_RECTS;
+	// The head has usually not moved much since the previous frame
+	// of the match group, so only look near it first.
+	if (args->track && (result->hint_count > 0))
+	{
+		if (catcierge_haar_matcher_detect_tracked(ctx, img_eq, result) < 0)
+		{
+			ret = -1.0;
+			goto fail;
+		}
+	}
 
-	if (cv2CascadeClassifier_detectMultiScale(ctx->cascade,
-			img_eq, result->match_rects, &result->rect_count,
-			1.1, 3, CV_HAAR_SCALE_IMAGE, &min_size, &max_size))
+	if (!result->hint_hit)
 	{
-		ret = -1.0;
-		goto fail;
+		start = catcierge_timer_now();
+		result->rect_count = MAX_MATCH_RECTS;
+
+		if (cv2CascadeClassifier_detectMultiScale(ctx->cascade,
+				img_eq, result->match_rects, &result->rect_count,
+				args->scale_factor, args->min_neighbours,
+				catcierge_haar_matcher_flags(args), &min_size, &max_size))
+		{
+			ret = -1.0;
+			goto fail;
+		}
+
+		result->search_time = catcierge_timer_now() - start;
 	}
 
 	if (ctx->super.debug) printf("Rect count: %d\n", (int)result->rect_count);
@@ -508,6 +814,12 @@ double catcierge_haar_matcher_match(void *octx,
 			flags = CV_THRESH_BINARY_INV | CV_THRESH_OTSU;
 			find_prey = catcierge_haar_matcher_find_prey_adaptive;
 		}
+		else if (args->prey_method == PREY_METHOD_FAST)
+		{
+			inverted = 1;
+			flags = CV_THRESH_BINARY_INV | CV_THRESH_OTSU;
+			find_prey = catcierge_haar_matcher_find_prey_fast;
+		}
 		else
 		{
 			inverted = 0;
@@ -536,7 +848,6 @@ double catcierge_haar_matcher_match(void *octx,
 			goto done;
 		}
 
-		// Note that thr_img will be modified.
 		if (find_prey(ctx, img_eq, thr_img, result, save_steps))
 		{
 			if (ctx->super.debug) printf("Found prey!\n");
@@ -563,16 +874,7 @@ double catcierge_haar_matcher_match(void *octx,
 done:
 fail:
 	cvResetImageROI(img);
-
-	if (args->eq_histogram)
-	{
-		cvReleaseImage(&img_eq);
-	}
-
-	if (tmp)
-	{
-		cvReleaseImage(&tmp);
-	}
+	cvResetImageROI(img_eq);
 
 	if (thr_img)
 	{
@@ -630,6 +932,21 @@ int catcierge_haar_matcher_parse_args(catcierge_haar_matcher_args_t *args,
 		return 0;
 	}
 
+	if (!strcmp(key, "cascade_cache"))
+	{
+		if (value_count == 1)
+		{
+			args->cascade_cache = values[0];
+		}
+		else
+		{
+			fprintf(stderr, "Missing value for --cascade_cache\n");
+			return -1;
+		}
+
+		return 0;
+	}
+
 	if (!strcmp(key, "min_size"))
 	{
 		if (value_count == 1)
@@ -651,6 +968,51 @@ int catcierge_haar_matcher_parse_args(catcierge_haar_matcher_args_t *args,
 		return 0;
 	}
 
+	if (!strcmp(key, "scale_factor"))
+	{
+		if (value_count == 1)
+		{
+			args->scale_factor = atof(values[0]);
+
+			if (args->scale_factor <= 1.0)
+			{
+				fprintf(stderr, "--scale_factor must be larger than 1.0\n");
+				return -1;
+			}
+
+			return 0;
+		}
+
+		fprintf(stderr, "Missing value for --scale_factor\n");
+		return -1;
+	}
+
+	if (!strcmp(key, "min_neighbours"))
+	{
+		if (value_count == 1)
+		{
+			args->min_neighbours = atoi(values[0]);
+
+			if (args->min_neighbours < 0)
+			{
+				fprintf(stderr, "--min_neighbours cannot be negative\n");
+				return -1;
+			}
+
+			return 0;
+		}
+
+		fprintf(stderr, "Missing value for --min_neighbours\n");
+		return -1;
+	}
+
+	if (!strcmp(key, "scale_image"))
+	{
+		args->scale_image = 1;
+		if (value_count == 1) args->scale_image = atoi(values[0]);
+		return 0;
+	}
+
 	if (!strcmp(key, "no_match_is_fail"))
 	{
 		args->no_match_is_fail = 1;
@@ -708,6 +1070,32 @@ int catcierge_haar_matcher_parse_args(catcierge_haar_matcher_args_t *args,
 		return 0;
 	}
 
+	if (!strcmp(key, "head_track"))
+	{
+		args->track = 1;
+		if (value_count == 1) args->track = atoi(values[0]);
+		return 0;
+	}
+
+	if (!strcmp(key, "head_track_pad"))
+	{
+		if (value_count == 1)
+		{
+			args->track_pad = atoi(values[0]);
+
+			if ((args->track_pad < 0) || (args->track_pad > MAX_HAAR_TRACK_PAD))
+			{
+				fprintf(stderr, "--head_track_pad must be between 0 and %d\n", MAX_HAAR_TRACK_PAD);
+				return -1;
+			}
+
+			return 0;
+		}
+
+		fprintf(stderr, "Missing value for --head_track_pad\n");
+		return -1;
+	}
+
 	if (!strcmp(key, "prey_method"))
 	{
 		if (value_count == 1)
@@ -721,15 +1109,19 @@ int catcierge_haar_matcher_parse_args(catcierge_haar_matcher_args_t *args,
 			{
 				args->prey_method = PREY_METHOD_NORMAL;
 			}
+			else if (!strcasecmp(d, "fast"))
+			{
+				args->prey_method = PREY_METHOD_FAST;
+			}
 			else
 			{
-				fprintf(stderr, "Invalid prey method \"%s\", must be \"adaptive\" or \"normal\".\n", d);
+				fprintf(stderr, "Invalid prey method \"%s\", must be \"adaptive\", \"normal\" or \"fast\".\n", d);
 				return -1;
 			}
 		}
 		else
 		{
-			fprintf(stderr, "Missing either \"adaptive\" or \"normal\" for --prey_method\n");
+			fprintf(stderr, "Missing either \"adaptive\", \"normal\" or \"fast\" for --prey_method\n");
 			return -1;
 		}
 
@@ -742,34 +1134,61 @@ int catcierge_haar_matcher_parse_args(catcierge_haar_matcher_args_t *args,
 void catcierge_haar_matcher_usage()
 {
 	fprintf(stderr, " --cascade <path>       Path to the haar cascade xml generated by opencv_traincascade.\n");
+	fprintf(stderr, " --cascade_cache <path> Path to a binary cache of the parsed cascade, which is a lot\n");
+	fprintf(stderr, "                        faster to load than the xml. It is written if it doesn't\n");
+	fprintf(stderr, "                        exist or was created from a different xml.\n");
 	fprintf(stderr, " --in_direction <left|right>\n");
 	fprintf(stderr, "                        The direction which is considered going inside.\n");
 	fprintf(stderr, " --min_size <WxH>       The size of the minimum.\n");
+	fprintf(stderr, " --scale_factor <factor>\n");
+	fprintf(stderr, "                        How much bigger the head is looked for at each scale.\n");
+	fprintf(stderr, "                        Larger is faster but can miss heads. Default %0.2f\n", DEFAULT_HAAR_SCALE_FACTOR);
+	fprintf(stderr, " --min_neighbours <count>\n");
+	fprintf(stderr, "                        How many overlapping detections are needed to count\n");
+	fprintf(stderr, "                        as a head. Default %d\n", DEFAULT_HAAR_MIN_NEIGHBOURS);
+	fprintf(stderr, " --scale_image <0|1>    Scale the image instead of the cascade when looking for\n");
+	fprintf(stderr, "                        the head at different sizes. Default %d\n", DEFAULT_HAAR_SCALE_IMAGE);
 	fprintf(stderr, " --no_match_is_fail     If no cat head is found in the picture, consider this a failure.\n");
 	fprintf(stderr, "                        The default is to only consider found prey a failure.\n");
 	fprintf(stderr, " --eq_histogram         Equalize the histogram of the image before doing.\n");
 	fprintf(stderr, "                        the haar cascade detection step.\n");
-	fprintf(stderr, " --prey_method <adaptive|normal>  (Adaptive is default)\n");
+	fprintf(stderr, " --prey_method <adaptive|normal|fast>  (Adaptive is default)\n");
 	fprintf(stderr, "                        Sets the prey matching method. Adaptive combines the result\n");
 	fprintf(stderr, "                        of both a global and adaptive thresholding to be better able to\n");
 	fprintf(stderr, "                        find prey parts otherwise blended into the background.\n");
 	fprintf(stderr, "                        Normal is simpler and doesn't catch such corner cases as well.\n");
+	fprintf(stderr, "                        Fast works like adaptive but uses a mean instead of a gaussian\n");
+	fprintf(stderr, "                        adaptive threshold and cheaper morphology.\n");
 	fprintf(stderr, " --prey_steps <1-2>     Only applicable for normal prey mode. 2 means a secondary\n");
 	fprintf(stderr, "                        search should be made if no prey is found initially.\n");
+	fprintf(stderr, " --head_track           After the first frame of a match, look for the head close\n");
+	fprintf(stderr, "                        to where it was in the previous frame first, and only\n");
+	fprintf(stderr, "                        search the whole frame if it isn't found there.\n");
+	fprintf(stderr, " --head_track_pad <percent>\n");
+	fprintf(stderr, "                        How much of the previous head size to search around it\n");
+	fprintf(stderr, "                        when tracking. Default %d\n", DEFAULT_HAAR_TRACK_PAD);
 	fprintf(stderr, "\n");
 }
 
 catcierge_output_var_t haar_vars[] =
 {
 	{ "cascade", "Cascade XML given via --cascade." },
+	{ "cascade_cache", "Cascade cache given via --cascade_cache." },
 	{ "in_direction", "The in direction left or right, same as --in_direction." },
 	{ "min_size", "Minimum size of a match in the format WxH. Given by --min_size." },
 	{ "min_size_width", "Minimum width of a match. Given --min_size." },
 	{ "min_size_height", "Minimum height of a match. Given by --min_size." },
+	{ "scale_factor", "Value of --scale_factor." },
+	{ "min_neighbours", "Value of --min_neighbours." },
+	{ "scale_image", "Value of --scale_image." },
 	{ "no_match_is_fail", "Value of --no_match_is_fail." },
 	{ "eq_histogram", "Value of --eq_histogram." },
 	{ "prey_method", "Value of --prey_method." },
 	{ "prey_steps", "Value of --prey_steps." },
+	{ "head_track", "Value of --head_track." },
+	{ "head_track_pad", "Value of --head_track_pad." },
+	{ "contour_mem", "Bytes currently allocated for prey contours." },
+	{ "contour_mem_peak", "The most bytes allocated for prey contours." },
 };
 
 void catcierge_haar_output_print_usage()
@@ -791,10 +1210,22 @@ const char *catcierge_haar_matcher_prey_method_str(catcierge_haar_prey_method_t
 	{
 		case PREY_METHOD_NORMAL: return "normal";
 		case PREY_METHOD_ADAPTIVE: return "adaptive";
+		case PREY_METHOD_FAST: return "fast";
 		default: return "unknown";
 	}
 }
 
+static const char *catcierge_haar_matcher_prey_method_name(catcierge_haar_prey_method_t method)
+{
+	switch (method)
+	{
+		case PREY_METHOD_NORMAL: return "Normal";
+		case PREY_METHOD_ADAPTIVE: return "Adaptive";
+		case PREY_METHOD_FAST: return "Fast";
+		default: return "Unknown";
+	}
+}
+
 const char *catcierge_haar_matcher_translate(catcierge_matcher_t *octx, const char *var,
 	char *buf, size_t bufsize)
 {
@@ -806,6 +1237,11 @@ const char *catcierge_haar_matcher_translate(catcierge_matcher_t *octx, const ch
 		return ctx->args->cascade;
 	}
 
+	if (!strcmp(var, "cascade_cache"))
+	{
+		return ctx->args->cascade_cache ? ctx->args->cascade_cache : "";
+	}
+
 	if (!strcmp(var, "in_direction"))
 	{
 		return catcierge_get_left_right_str(ctx->args->in_direction);
@@ -831,6 +1267,24 @@ const char *catcierge_haar_matcher_translate(catcierge_matcher_t *octx, const ch
 		return buf;
 	}
 
+	if (!strcmp(var, "scale_factor"))
+	{
+		snprintf(buf, bufsize - 1, "%f", ctx->args->scale_factor);
+		return buf;
+	}
+
+	if (!strcmp(var, "min_neighbours"))
+	{
+		snprintf(buf, bufsize - 1, "%d", ctx->args->min_neighbours);
+		return buf;
+	}
+
+	if (!strcmp(var, "scale_image"))
+	{
+		snprintf(buf, bufsize - 1, "%d", ctx->args->scale_image);
+		return buf;
+	}
+
 	if (!strcmp(var, "no_match_is_fail"))
 	{
 		snprintf(buf, bufsize - 1, "%d", ctx->args->no_match_is_fail);
@@ -854,6 +1308,30 @@ const char *catcierge_haar_matcher_translate(catcierge_matcher_t *octx, const ch
 		return buf;
 	}
 
+	if (!strcmp(var, "head_track"))
+	{
+		snprintf(buf, bufsize - 1, "%d", ctx->args->track);
+		return buf;
+	}
+
+	if (!strcmp(var, "head_track_pad"))
+	{
+		snprintf(buf, bufsize - 1, "%d", ctx->args->track_pad);
+		return buf;
+	}
+
+	if (!strcmp(var, "contour_mem"))
+	{
+		snprintf(buf, bufsize - 1, "%lu", (unsigned long)ctx->contour_bytes);
+		return buf;
+	}
+
+	if (!strcmp(var, "contour_mem_peak"))
+	{
+		snprintf(buf, bufsize - 1, "%lu", (unsigned long)ctx->contour_peak);
+		return buf;
+	}
+
 	return NULL;
 }
 
@@ -862,12 +1340,19 @@ void catcierge_haar_matcher_print_settings(catcierge_haar_matcher_args_t *args)
 	assert(args);
 	printf("Haar Cascade Matcher:\n");
 	printf("           Cascade: %s\n", args->cascade);
+	printf("     Cascade cache: %s\n", args->cascade_cache ? args->cascade_cache : "");
 	printf("      In direction: %s\n", (args->in_direction == DIR_LEFT) ? "Left" : "Right");
 	printf("          Min size: %dx%d\n", args->min_width, args->min_height);
+	printf("      Scale factor: %0.2f\n", args->scale_factor);
+	printf("    Min neighbours: %d\n", args->min_neighbours);
+	printf("       Scale image: %d\n", args->scale_image);
 	printf("Equalize histogram: %d\n", args->eq_histogram);
 	printf("  No match is fail: %d\n", args->no_match_is_fail);
-	printf("       Prey method: %s\n", args->prey_method == PREY_METHOD_ADAPTIVE ? "Adaptive" : "Normal");
+	printf("       Prey method: %s\n", catcierge_haar_matcher_prey_method_name(args->prey_method));
 	printf("        Prey steps: %d\n", args->prey_steps);
+	printf("        Head track: %d\n", args->track);
+	if (args->track)
+		printf("    Head track pad: %d%%\n", args->track_pad);
 	printf("\n");
 }
 
@@ -878,12 +1363,17 @@ void catcierge_haar_matcher_args_init(catcierge_haar_matcher_args_t *args)
 	args->super.type = MATCHER_HAAR;
 	args->min_width = 80;
 	args->min_height = 80;
+	args->scale_factor = DEFAULT_HAAR_SCALE_FACTOR;
+	args->min_neighbours = DEFAULT_HAAR_MIN_NEIGHBOURS;
+	args->scale_image = DEFAULT_HAAR_SCALE_IMAGE;
 	args->in_direction = DIR_RIGHT;
 	args->eq_histogram = 0;
 	args->debug = 0;
 	args->no_match_is_fail = 0;
 	args->prey_steps = 2;
 	args->prey_method = PREY_METHOD_ADAPTIVE;
+	args->track = 0;
+	args->track_pad = DEFAULT_HAAR_TRACK_PAD;
 }
 
 void catcierge_haar_matcher_set_debug(catcierge_haar_matcher_t *ctx, int debug)
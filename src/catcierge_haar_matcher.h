@@ -24,24 +24,55 @@
 #include "catcierge_haar_wrapper.h"
 #include "catcierge_types.h"
 #include "catcierge_matcher.h"
+#include "catcierge_ccl.h"
+#include "catcierge_morph.h"
 
 #define HAAR_FAIL 0.0
 #define HAAR_SUCCESS 1.0
 #define HAAR_SUCCESS_NO_HEAD 2.0 // Used to be 0.998 
 #define HAAR_SUCCESS_NO_HEAD_IS_FAIL 3.0 // 0.999
 
+// Contours smaller than this are not counted when looking for prey.
+#define CATCIERGE_HAAR_PREY_MIN_AREA 10.0
+
+// Block size of the contour storage used when drawing the prey contours.
+// It is cleared for each frame, so it only ever holds the contours of one
+// frame. If a frame needs more than the max, the storage and the labels
+// used for counting the contours are shrunk back down afterwards instead
+// of keeping the memory around.
+#define CATCIERGE_HAAR_STORAGE_BLOCK (64 * 1024)
+#define CATCIERGE_HAAR_STORAGE_MAX (1024 * 1024)
+
+// Default detectMultiScale parameters.
+#define DEFAULT_HAAR_SCALE_FACTOR 1.1
+#define DEFAULT_HAAR_MIN_NEIGHBOURS 3
+#define DEFAULT_HAAR_SCALE_IMAGE 1
+
+// When tracking the head, the previous head rect is padded with this
+// percentage of its size on each side, and only head sizes between
+// 1 / CATCIERGE_HAAR_TRACK_SCALE and CATCIERGE_HAAR_TRACK_SCALE times
+// the previous size are looked for.
+#define DEFAULT_HAAR_TRACK_PAD 50
+#define MAX_HAAR_TRACK_PAD 400
+#define CATCIERGE_HAAR_TRACK_SCALE 1.25
+
 typedef enum catcierge_haar_prey_method_e
 {
 	PREY_METHOD_ADAPTIVE,
-	PREY_METHOD_NORMAL
+	PREY_METHOD_NORMAL,
+	PREY_METHOD_FAST
 } catcierge_haar_prey_method_t;
 
 typedef struct catcierge_haar_matcher_args_s
 {
 	catcierge_matcher_args_t super;
 	const char *cascade;
+	const char *cascade_cache;	// Binary cache of the parsed cascade, optional.
 	int min_width;
 	int min_height;
+	double scale_factor;	// How much the search window grows between scales.
+	int min_neighbours;		// Overlapping detections needed to keep a head.
+	int scale_image;		// Scale the image instead of the cascade.
 	direction_t in_direction;
 	int eq_histogram;
 	int low_binary_thresh;
@@ -49,6 +80,8 @@ typedef struct catcierge_haar_matcher_args_s
 	int no_match_is_fail;
 	catcierge_haar_prey_method_t prey_method;
 	int prey_steps;
+	int track;			// Look for the head near the previous head first.
+	int track_pad;		// Percent of the head size to pad the search window with.
 	int debug;
 } catcierge_haar_matcher_args_t;
 
@@ -56,11 +89,19 @@ typedef struct catcierge_haar_matcher_s
 {
 	catcierge_matcher_t super;
 	CvMemStorage *storage;
+	catcierge_ccl_t ccl;
+	size_t contour_bytes;			// Currently allocated for finding prey contours.
+	size_t contour_peak;			// The most it has had allocated.
+	unsigned long contour_shrinks;	// Times it was shrunk back to the max.
 	IplConvKernel *kernel2x2;
 	IplConvKernel *kernel3x3;
 	IplConvKernel *kernel5x1;
+	catcierge_morph_t morph;		// Buffers for the fast prey method.
+	IplImage *prey_img;				// Grown to the largest region of interest.
 
 	cv2CascadeClassifier *cascade;
+	double cascade_load_time;		// Seconds it took to load the cascade.
+	int cascade_cache_hit;			// If the cascade was loaded from the cache.
 
 	catcierge_haar_matcher_args_t *args;
 } catcierge_haar_matcher_t;
@@ -68,9 +109,23 @@ typedef struct catcierge_haar_matcher_s
 typedef int (*find_prey_f)(catcierge_haar_matcher_t *ctx,
 		IplImage *img, IplImage *inv_thr_img, match_result_t *result, int save_steps);
 
+int catcierge_haar_matcher_find_prey(catcierge_haar_matcher_t *ctx,
+		IplImage *img, IplImage *thr_img, match_result_t *result, int save_steps);
+int catcierge_haar_matcher_find_prey_adaptive(catcierge_haar_matcher_t *ctx,
+		IplImage *img, IplImage *inv_thr_img, match_result_t *result, int save_steps);
+int catcierge_haar_matcher_find_prey_fast(catcierge_haar_matcher_t *ctx,
+		IplImage *img, IplImage *inv_thr_img, match_result_t *result, int save_steps);
+
+// Current and peak number of bytes allocated for contours.
+void catcierge_haar_matcher_memory(catcierge_haar_matcher_t *ctx, size_t *current, size_t *peak);
+
+// The window to look for the head in when it was found at prev before.
+CvRect catcierge_haar_matcher_track_window(catcierge_haar_matcher_t *ctx,
+		const CvRect *prev, CvSize img_size, CvSize *min_size, CvSize *max_size);
+
 int catcierge_haar_matcher_init(catcierge_matcher_t **ctx, catcierge_matcher_args_t *args);
 void catcierge_haar_matcher_destroy(catcierge_matcher_t **ctx);
-double catcierge_haar_matcher_match(void *ctx, IplImage *img, match_result_t *result, int save_steps);
+double catcierge_haar_matcher_match(void *ctx, catcierge_frame_ctx_t *frame, match_result_t *result, int save_steps);
 int catcierge_haar_matcher_decide(void *ctx, match_group_t *mg);
 void catcierge_haar_matcher_set_debug(catcierge_haar_matcher_t *ctx, int debug);
 
@@ -5,12 +5,278 @@
 #include <iostream>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 using namespace std;
 using namespace cv;
 
 #include "catcierge_haar_wrapper.h"
 
+extern "C"
+{
+#include "sha1.h"
+#include "catcierge_log.h"
+}
+
+#define CASCADE_CACHE_MAGIC "CATCASC"
+#define CASCADE_CACHE_VERSION 1
+
+//
+// Binary cascade cache file:
+//
+//   header  (cascade_cache_header_t)
+//   stages, classifiers, nodes, leaves and subsets as raw arrays
+//   the features node as YAML text
+//
+// The arrays are the parsed cascade exactly as CascadeClassifier
+// keeps it, so the cache is only valid for the same OpenCV version.
+// The features are only accessible through a FileNode, but they are
+// a small part of the cascade and the YAML is written without any
+// formatting.
+//
+typedef struct cascade_cache_header_s
+{
+	char magic[8];
+	unsigned int version;
+	char cv_version[32];
+	unsigned int sha1[5];		// Of the cascade xml.
+	int is_stump_based;
+	int stage_type;
+	int feature_type;
+	int ncategories;
+	int orig_width;
+	int orig_height;
+	unsigned int stage_count;
+	unsigned int classifier_count;
+	unsigned int node_count;
+	unsigned int leaf_count;
+	unsigned int subset_count;
+	unsigned int features_size;
+} cascade_cache_header_t;
+
+static int read_file(const char *path, vector<char> &buf)
+{
+	FILE *f = NULL;
+	long size;
+
+	if (!(f = fopen(path, "rb")))
+		return -1;
+
+	if (fseek(f, 0, SEEK_END) || ((size = ftell(f)) < 0) || fseek(f, 0, SEEK_SET))
+	{
+		fclose(f);
+		return -1;
+	}
+
+	buf.resize(size);
+
+	if (size && (fread(&buf[0], 1, size, f) != (size_t)size))
+	{
+		fclose(f);
+		return -1;
+	}
+
+	fclose(f);
+	return 0;
+}
+
+static void cascade_sha1(const vector<char> &xml, unsigned int *digest)
+{
+	SHA1Context sha;
+	SHA1Reset(&sha);
+
+	if (!xml.empty())
+		SHA1Input(&sha, (const unsigned char *)&xml[0], (unsigned)xml.size());
+
+	SHA1Result(&sha);
+	memcpy(digest, sha.Message_Digest, sizeof(sha.Message_Digest));
+}
+
+// Copies a file node, with all its children, to a file storage.
+// Elements of a sequence have no name.
+static void copy_node(FileStorage &fs, const FileNode &node, const string *name)
+{
+	FileNodeIterator it;
+	string child_name;
+
+	if (name)
+		fs << *name;
+
+	switch (node.type() & FileNode::TYPE_MASK)
+	{
+		case FileNode::INT: fs << (int)node; break;
+		case FileNode::REAL: fs << (double)node; break;
+		case FileNode::STRING: fs << (string)node; break;
+		case FileNode::SEQ:
+		{
+			fs << "[";
+			for (it = node.begin(); it != node.end(); ++it)
+				copy_node(fs, *it, NULL);
+			fs << "]";
+			break;
+		}
+		case FileNode::MAP:
+		{
+			fs << "{";
+			for (it = node.begin(); it != node.end(); ++it)
+			{
+				child_name = (*it).name();
+				copy_node(fs, *it, &child_name);
+			}
+			fs << "}";
+			break;
+		}
+		default: break;
+	}
+}
+
+#if (CV_MAJOR_VERSION == 2)
+
+// Gives access to the parsed cascade.
+class CachedCascadeClassifier : public CascadeClassifier
+{
+public:
+	int save_cache(const char *cache_path, const unsigned int *sha1, const FileNode &features);
+	int load_cache(const vector<char> &cache, const unsigned int *sha1);
+};
+
+template <typename T>
+static void write_array(FILE *f, const vector<T> &v)
+{
+	if (!v.empty())
+		fwrite(&v[0], sizeof(T), v.size(), f);
+}
+
+template <typename T>
+static int read_array(const vector<char> &buf, size_t &offset, vector<T> &v, size_t count)
+{
+	if ((buf.size() - offset) < (count * sizeof(T)))
+		return -1;
+
+	v.resize(count);
+
+	if (count)
+		memcpy(&v[0], &buf[offset], count * sizeof(T));
+
+	offset += count * sizeof(T);
+	return 0;
+}
+
+int CachedCascadeClassifier::save_cache(const char *cache_path,
+	const unsigned int *sha1, const FileNode &features)
+{
+	FILE *f = NULL;
+	string tmp_path = string(cache_path) + ".tmp";
+	string yaml;
+	cascade_cache_header_t hdr;
+
+	string name("features");
+	FileStorage fs(".yml", FileStorage::WRITE | FileStorage::MEMORY);
+	copy_node(fs, features, &name);
+	yaml = fs.releaseAndGetString();
+
+	memset(&hdr, 0, sizeof(hdr));
+	memcpy(hdr.magic, CASCADE_CACHE_MAGIC, sizeof(CASCADE_CACHE_MAGIC));
+	hdr.version = CASCADE_CACHE_VERSION;
+	snprintf(hdr.cv_version, sizeof(hdr.cv_version), "%s", CV_VERSION);
+	memcpy(hdr.sha1, sha1, sizeof(hdr.sha1));
+	hdr.is_stump_based = data.isStumpBased;
+	hdr.stage_type = data.stageType;
+	hdr.feature_type = data.featureType;
+	hdr.ncategories = data.ncategories;
+	hdr.orig_width = data.origWinSize.width;
+	hdr.orig_height = data.origWinSize.height;
+	hdr.stage_count = (unsigned int)data.stages.size();
+	hdr.classifier_count = (unsigned int)data.classifiers.size();
+	hdr.node_count = (unsigned int)data.nodes.size();
+	hdr.leaf_count = (unsigned int)data.leaves.size();
+	hdr.subset_count = (unsigned int)data.subsets.size();
+	hdr.features_size = (unsigned int)yaml.size();
+
+	// Write to a temporary file first, so that a half written
+	// cache is never loaded.
+	if (!(f = fopen(tmp_path.c_str(), "wb")))
+		return -1;
+
+	fwrite(&hdr, sizeof(hdr), 1, f);
+	write_array(f, data.stages);
+	write_array(f, data.classifiers);
+	write_array(f, data.nodes);
+	write_array(f, data.leaves);
+	write_array(f, data.subsets);
+	fwrite(yaml.data(), 1, yaml.size(), f);
+
+	if (ferror(f) | fclose(f))
+	{
+		remove(tmp_path.c_str());
+		return -1;
+	}
+
+	#ifdef _WIN32
+	remove(cache_path);
+	#endif
+
+	if (rename(tmp_path.c_str(), cache_path))
+	{
+		remove(tmp_path.c_str());
+		return -1;
+	}
+
+	return 0;
+}
+
+int CachedCascadeClassifier::load_cache(const vector<char> &cache, const unsigned int *sha1)
+{
+	size_t offset = sizeof(cascade_cache_header_t);
+	cascade_cache_header_t hdr;
+	Data d;
+
+	if (cache.size() < sizeof(hdr))
+		return -1;
+
+	memcpy(&hdr, &cache[0], sizeof(hdr));
+
+	// Stale or from another version.
+	if (memcmp(hdr.magic, CASCADE_CACHE_MAGIC, sizeof(CASCADE_CACHE_MAGIC))
+		|| (hdr.version != CASCADE_CACHE_VERSION)
+		|| strncmp(hdr.cv_version, CV_VERSION, sizeof(hdr.cv_version))
+		|| memcmp(hdr.sha1, sha1, sizeof(hdr.sha1)))
+	{
+		return -1;
+	}
+
+	d.isStumpBased = (hdr.is_stump_based != 0);
+	d.stageType = hdr.stage_type;
+	d.featureType = hdr.feature_type;
+	d.ncategories = hdr.ncategories;
+	d.origWinSize = Size(hdr.orig_width, hdr.orig_height);
+
+	if (read_array(cache, offset, d.stages, hdr.stage_count)
+	 || read_array(cache, offset, d.classifiers, hdr.classifier_count)
+	 || read_array(cache, offset, d.nodes, hdr.node_count)
+	 || read_array(cache, offset, d.leaves, hdr.leaf_count)
+	 || read_array(cache, offset, d.subsets, hdr.subset_count)
+	 || ((cache.size() - offset) != hdr.features_size))
+	{
+		return -1;
+	}
+
+	// The same as CascadeClassifier::read does after parsing the data.
+	string features(&cache[offset], hdr.features_size);
+	FileStorage fs(features, FileStorage::READ | FileStorage::MEMORY);
+	Ptr<FeatureEvaluator> evaluator = FeatureEvaluator::create(d.featureType);
+
+	if (evaluator.empty() || !evaluator->read(fs["features"]))
+		return -1;
+
+	data = d;
+	featureEvaluator = evaluator;
+
+	return 0;
+}
+
+#endif // CV_MAJOR_VERSION == 2
+
 #ifdef __cplusplus
 extern "C" 
 {
@@ -18,7 +284,11 @@ extern "C"
 
 cv2CascadeClassifier *cv2CascadeClassifier_create()
 {
+	#if (CV_MAJOR_VERSION == 2)
+	CascadeClassifier *cc = new CachedCascadeClassifier();
+	#else
 	CascadeClassifier *cc = new CascadeClassifier();
+	#endif
 	return (cv2CascadeClassifier *)cc;
 }
 
@@ -40,6 +310,60 @@ int cv2CascadeClassifier_load(cv2CascadeClassifier *c, const char *filename)
 	return 0;
 }
 
+int cv2CascadeClassifier_load_cached(cv2CascadeClassifier *c,
+	const char *filename, const char *cache_path, int *cache_hit)
+{
+	unsigned int sha1[5];
+	vector<char> xml;
+	vector<char> cache;
+	assert(c);
+	assert(filename);
+	assert(cache_hit);
+
+	*cache_hit = 0;
+
+	if (!cache_path)
+		return cv2CascadeClassifier_load(c, filename);
+
+	#if (CV_MAJOR_VERSION == 2)
+	CachedCascadeClassifier *cc = (CachedCascadeClassifier *)c;
+
+	if (read_file(filename, xml))
+	{
+		CATERR("Failed to read cascade xml: %s\n", filename);
+		return -1;
+	}
+
+	cascade_sha1(xml, sha1);
+
+	if (!read_file(cache_path, cache) && !cc->load_cache(cache, sha1))
+	{
+		*cache_hit = 1;
+		return 0;
+	}
+
+	// Stale or missing cache, parse the xml we already read.
+	string source(xml.begin(), xml.end());
+	FileStorage fs(source, FileStorage::READ | FileStorage::MEMORY);
+
+	if (!fs.isOpened() || !cc->read(fs.getFirstTopLevelNode()))
+	{
+		// Old style cascades can't be cached.
+		return cv2CascadeClassifier_load(c, filename);
+	}
+
+	if (cc->save_cache(cache_path, sha1, fs.getFirstTopLevelNode()["features"]))
+	{
+		CATERR("Failed to write cascade cache: %s\n", cache_path);
+	}
+
+	return 0;
+	#else
+	CATERR("The cascade cache needs OpenCV 2, loading the xml instead\n");
+	return cv2CascadeClassifier_load(c, filename);
+	#endif
+}
+
 int cv2CascadeClassifier_detectMultiScale(cv2CascadeClassifier *c,
 	const IplImage *img, CvRect *objects, size_t *object_count,
 	double scale_factor, int min_neighbours, int flags,
@@ -71,7 +395,8 @@ int cv2CascadeClassifier_detectMultiScale(cv2CascadeClassifier *c,
 		i++;
 	}
 
-	*object_count = objectVector.size();
+	// Only as many as fit in objects.
+	*object_count = i;
 
 	return 0;
 }
@@ -39,6 +39,16 @@ extern "C"
 cv2CascadeClassifier *cv2CascadeClassifier_create();
 void cv2CascadeClassifier_destroy(cv2CascadeClassifier *c);
 int cv2CascadeClassifier_load(cv2CascadeClassifier *c, const char *filename);
+
+//
+// Loads the cascade from a binary cache at cache_path if it was created
+// from the same xml (compared by SHA1) with the same OpenCV version.
+// Otherwise the xml is loaded and the cache is (re)written. cache_hit
+// is set if the cache was used. Returns -1 if the cascade failed to load,
+// failing to write the cache is only logged.
+//
+int cv2CascadeClassifier_load_cached(cv2CascadeClassifier *c,
+	const char *filename, const char *cache_path, int *cache_hit);
 int cv2CascadeClassifier_detectMultiScale(cv2CascadeClassifier *c,
 	const IplImage *img, CvRect *objects, size_t *object_count,
 	double scale_factor, int min_neighbours, int flags,
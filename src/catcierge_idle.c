@@ -0,0 +1,241 @@
+//
+// This file is part of the Catcierge project.
+//
+// Copyright (c) Joakim Soderberg 2013-2014
+//
+//    Catcierge is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    Catcierge is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Catcierge.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <catcierge_config.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include "catcierge_idle.h"
+#include "catcierge_timer.h"
+#include "catcierge_thread.h"
+#include "catcierge_log.h"
+
+void catcierge_idle_init(catcierge_idle_t *idle, catcierge_idle_args_t *args)
+{
+	assert(idle);
+	assert(args);
+
+	memset(idle, 0, sizeof(catcierge_idle_t));
+	idle->args = args;
+	idle->last_activity = catcierge_timer_now();
+	idle->last_obstruct_sum = -1;
+}
+
+void catcierge_idle_activity(catcierge_idle_t *idle)
+{
+	assert(idle);
+
+	idle->last_activity = catcierge_timer_now();
+
+	if (idle->idle)
+	{
+		idle->idle = 0;
+		idle->idle_time += idle->last_activity - idle->idle_start;
+		CATLOG("Activity, back to full frame rate\n");
+
+		// Let the next frame through right away.
+		idle->last_frame = 0.0;
+	}
+}
+
+void catcierge_idle_update(catcierge_idle_t *idle, int waiting, int obstruct_sum)
+{
+	assert(idle);
+
+	if (!idle->args->enabled)
+		return;
+
+	if (!waiting
+		|| ((obstruct_sum >= 0) && (idle->last_obstruct_sum >= 0)
+			&& (abs(obstruct_sum - idle->last_obstruct_sum) > CATCIERGE_IDLE_MOTION_PIXELS)))
+	{
+		catcierge_idle_activity(idle);
+	}
+
+	idle->last_obstruct_sum = waiting ? obstruct_sum : -1;
+}
+
+double catcierge_idle_calc_interval(catcierge_idle_args_t *args, double quiet_time)
+{
+	double t;
+	double min_interval;
+	double max_interval;
+	assert(args);
+
+	min_interval = (args->max_fps > 0.0) ? (1.0 / args->max_fps) : 0.0;
+	max_interval = (args->min_fps > 0.0) ? (1.0 / args->min_fps) : min_interval;
+
+	if (!args->enabled || (quiet_time < args->delay) || (max_interval <= min_interval))
+		return min_interval;
+
+	// Ramp the interval linearly from the full rate to the idle rate.
+	if (args->ramp <= 0.0)
+		return max_interval;
+
+	t = (quiet_time - args->delay) / args->ramp;
+
+	if (t >= 1.0)
+		return max_interval;
+
+	return min_interval + (max_interval - min_interval) * t;
+}
+
+void catcierge_idle_wait(catcierge_idle_t *idle)
+{
+	double now;
+	double quiet_time;
+	double wait;
+	assert(idle);
+
+	if (!idle->args->enabled)
+		return;
+
+	now = catcierge_timer_now();
+	quiet_time = now - idle->last_activity;
+
+	if (!idle->idle && (quiet_time >= idle->args->delay))
+	{
+		idle->idle = 1;
+		idle->idle_count++;
+		idle->idle_start = now;
+		CATLOG("No activity for %0.1f seconds, lowering frame rate to %0.1f fps\n",
+			quiet_time, idle->args->min_fps);
+	}
+
+	if (idle->last_frame > 0.0)
+	{
+		wait = idle->last_frame + catcierge_idle_calc_interval(idle->args, quiet_time) - now;
+
+		if (wait > 0.0)
+		{
+			catcierge_thread_sleep_ms((int)(wait * 1000.0));
+		}
+	}
+
+	idle->last_frame = catcierge_timer_now();
+}
+
+void catcierge_idle_print_stats(catcierge_idle_t *idle)
+{
+	double idle_time;
+	assert(idle);
+
+	if (!idle->args->enabled)
+		return;
+
+	idle_time = idle->idle_time;
+
+	if (idle->idle)
+		idle_time += catcierge_timer_now() - idle->idle_start;
+
+	CATLOG("Idle governor: Went idle %lu times, %0.1f seconds idle in total\n",
+		idle->idle_count, idle_time);
+}
+
+void catcierge_idle_args_init(catcierge_idle_args_t *args)
+{
+	assert(args);
+	memset(args, 0, sizeof(catcierge_idle_args_t));
+	args->min_fps = DEFAULT_IDLE_MIN_FPS;
+	args->max_fps = DEFAULT_IDLE_MAX_FPS;
+	args->delay = DEFAULT_IDLE_DELAY;
+	args->ramp = DEFAULT_IDLE_RAMP;
+}
+
+void catcierge_idle_usage()
+{
+	fprintf(stderr, " --idle                 Lower the frame rate while waiting when nothing has\n");
+	fprintf(stderr, "                        happened for a while to save CPU. Goes back to the full\n");
+	fprintf(stderr, "                        frame rate as soon as the frame is obstructed or\n");
+	fprintf(stderr, "                        something moves in front of the camera.\n");
+	fprintf(stderr, " --idle_min_fps <fps>   Frame rate when idle. Default %0.1f\n", DEFAULT_IDLE_MIN_FPS);
+	fprintf(stderr, " --idle_max_fps <fps>   Frame rate when active. 0 means as fast as the\n");
+	fprintf(stderr, "                        frame source allows. Default %0.1f\n", DEFAULT_IDLE_MAX_FPS);
+	fprintf(stderr, " --idle_delay <seconds> Time without activity before the frame rate is\n");
+	fprintf(stderr, "                        lowered. Default %0.1f\n", DEFAULT_IDLE_DELAY);
+	fprintf(stderr, " --idle_ramp <seconds>  Time to go from --idle_max_fps down to --idle_min_fps.\n");
+	fprintf(stderr, "                        Default %0.1f\n", DEFAULT_IDLE_RAMP);
+}
+
+static int catcierge_idle_parse_double(const char *key, double *val,
+		char **values, size_t value_count)
+{
+	if (value_count == 1)
+	{
+		*val = atof(values[0]);
+
+		if (*val < 0.0)
+		{
+			fprintf(stderr, "--%s cannot be negative\n", key);
+			return -1;
+		}
+
+		return 0;
+	}
+
+	fprintf(stderr, "--%s missing value\n", key);
+	return -1;
+}
+
+int catcierge_idle_parse_args(catcierge_idle_args_t *args, const char *key, char **values, size_t value_count)
+{
+	if (!strcmp(key, "idle"))
+	{
+		args->enabled = 1;
+		if (value_count == 1) args->enabled = atoi(values[0]);
+		return 0;
+	}
+
+	if (!strcmp(key, "idle_min_fps"))
+	{
+		return catcierge_idle_parse_double(key, &args->min_fps, values, value_count);
+	}
+
+	if (!strcmp(key, "idle_max_fps"))
+	{
+		return catcierge_idle_parse_double(key, &args->max_fps, values, value_count);
+	}
+
+	if (!strcmp(key, "idle_delay"))
+	{
+		return catcierge_idle_parse_double(key, &args->delay, values, value_count);
+	}
+
+	if (!strcmp(key, "idle_ramp"))
+	{
+		return catcierge_idle_parse_double(key, &args->ramp, values, value_count);
+	}
+
+	return 1;
+}
+
+void catcierge_idle_print_settings(catcierge_idle_args_t *args)
+{
+	assert(args);
+
+	printf("       Idle governor: %d\n", args->enabled);
+
+	if (!args->enabled)
+		return;
+
+	printf("        Idle min fps: %0.1f\n", args->min_fps);
+	printf("        Idle max fps: %0.1f %s\n", args->max_fps, (args->max_fps <= 0.0) ? "(unthrottled)" : "");
+	printf("          Idle delay: %0.1f seconds\n", args->delay);
+	printf("           Idle ramp: %0.1f seconds\n", args->ramp);
+}
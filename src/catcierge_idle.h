@@ -0,0 +1,79 @@
+//
+// This file is part of the Catcierge project.
+//
+// Copyright (c) Joakim Soderberg 2013-2014
+//
+//    Catcierge is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    Catcierge is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Catcierge.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef __CATCIERGE_IDLE_H__
+#define __CATCIERGE_IDLE_H__
+
+#define DEFAULT_IDLE_MIN_FPS 2.0
+#define DEFAULT_IDLE_MAX_FPS 0.0
+#define DEFAULT_IDLE_DELAY 10.0
+#define DEFAULT_IDLE_RAMP 5.0
+
+// A change in the obstruct sum larger than this between
+// two frames counts as motion and wakes up the governor.
+#define CATCIERGE_IDLE_MOTION_PIXELS 20
+
+typedef struct catcierge_idle_args_s
+{
+	int enabled;
+	double min_fps;		// Frame rate when fully idle.
+	double max_fps;		// Frame rate when active, 0 means as fast as frames arrive.
+	double delay;		// Seconds without activity before lowering the frame rate.
+	double ramp;		// Seconds to go from max_fps to min_fps.
+} catcierge_idle_args_t;
+
+//
+// Lowers the rate the state machine polls frames at while it is
+// waiting and nothing happens in front of the camera, and goes back
+// to the full rate as soon as something does.
+//
+typedef struct catcierge_idle_s
+{
+	catcierge_idle_args_t *args;
+	double last_activity;		// Monotonic time of the last activity.
+	double last_frame;			// Monotonic time the last frame was let through.
+	int last_obstruct_sum;		// -1 if unknown.
+	int idle;					// Set while running below the full rate.
+	unsigned long idle_count;	// Number of times we have gone idle.
+	double idle_start;
+	double idle_time;			// Total seconds spent idle.
+} catcierge_idle_t;
+
+void catcierge_idle_init(catcierge_idle_t *idle, catcierge_idle_args_t *args);
+
+// Something is happening, go back to the full frame rate.
+void catcierge_idle_activity(catcierge_idle_t *idle);
+
+// Called after each frame. Any state but waiting counts as activity,
+// as does motion in the obstruct area (obstruct_sum < 0 if unknown).
+void catcierge_idle_update(catcierge_idle_t *idle, int waiting, int obstruct_sum);
+
+// Sleeps until it is time for the next frame.
+void catcierge_idle_wait(catcierge_idle_t *idle);
+
+// Frame interval in seconds for the given time since the last activity.
+double catcierge_idle_calc_interval(catcierge_idle_args_t *args, double quiet_time);
+
+void catcierge_idle_print_stats(catcierge_idle_t *idle);
+
+void catcierge_idle_args_init(catcierge_idle_args_t *args);
+void catcierge_idle_usage();
+int catcierge_idle_parse_args(catcierge_idle_args_t *args, const char *key, char **values, size_t value_count);
+void catcierge_idle_print_settings(catcierge_idle_args_t *args);
+
+#endif // __CATCIERGE_IDLE_H__
@@ -0,0 +1,407 @@
+//
+// This file is part of the Catcierge project.
+//
+// Copyright (c) Joakim Soderberg 2013-2014
+//
+//    Catcierge is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    Catcierge is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Catcierge.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <catcierge_config.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include "catcierge_image_pool.h"
+#include "catcierge_log.h"
+
+int catcierge_image_pool_init(catcierge_image_pool_t *pool, size_t capacity)
+{
+	assert(pool);
+	memset(pool, 0, sizeof(catcierge_image_pool_t));
+
+	// No buffers, everything is allocated on the heap.
+	if (capacity == 0)
+		return 0;
+
+	if (!(pool->entries = (catcierge_image_pool_entry_t *)calloc(capacity,
+			sizeof(catcierge_image_pool_entry_t))))
+	{
+		CATERR("Out of memory!\n");
+		return -1;
+	}
+
+	if (catcierge_mutex_init(&pool->lock))
+	{
+		CATERR("Failed to create image pool lock\n");
+		free(pool->entries);
+		pool->entries = NULL;
+		return -1;
+	}
+
+	pool->capacity = capacity;
+	pool->max_capacity = CATCIERGE_IMAGE_POOL_GROWTH * capacity;
+	pool->stats.capacity = (unsigned int)capacity;
+
+	return 0;
+}
+
+// Adds count empty entries, the lock must be held.
+static int catcierge_image_pool_grow(catcierge_image_pool_t *pool, size_t count)
+{
+	size_t capacity = pool->capacity + count;
+	catcierge_image_pool_entry_t *entries;
+
+	if (!(entries = (catcierge_image_pool_entry_t *)realloc(pool->entries,
+			capacity * sizeof(catcierge_image_pool_entry_t))))
+	{
+		CATERR("Out of memory!\n");
+		return -1;
+	}
+
+	memset(&entries[pool->capacity], 0, count * sizeof(catcierge_image_pool_entry_t));
+	pool->entries = entries;
+	pool->capacity = capacity;
+	pool->stats.capacity = (unsigned int)capacity;
+
+	return 0;
+}
+
+void catcierge_image_pool_destroy(catcierge_image_pool_t *pool)
+{
+	size_t i;
+	assert(pool);
+
+	if (!pool->entries)
+		return;
+
+	for (i = 0; i < pool->capacity; i++)
+	{
+		if (pool->entries[i].img)
+		{
+			cvReleaseImage(&pool->entries[i].img);
+		}
+	}
+
+	catcierge_mutex_destroy(&pool->lock);
+	free(pool->entries);
+	memset(pool, 0, sizeof(catcierge_image_pool_t));
+}
+
+static int catcierge_image_pool_fits(IplImage *img, CvSize size, int depth, int channels, int exact)
+{
+	if ((img->depth != depth) || (img->nChannels != channels))
+		return 0;
+
+	if (exact)
+		return (img->width == size.width) && (img->height == size.height);
+
+	return (img->width >= size.width) && (img->height >= size.height);
+}
+
+static IplImage *catcierge_image_pool_borrow(catcierge_image_pool_t *pool,
+	CvSize size, int depth, int channels, int exact)
+{
+	size_t i;
+	unsigned int exhausted = 0;
+	IplImage *img = NULL;
+	catcierge_image_pool_entry_t *e;
+	catcierge_image_pool_entry_t *best = NULL;
+	catcierge_image_pool_entry_t *empty = NULL;
+	catcierge_image_pool_entry_t *other = NULL;
+
+	if (!pool || !pool->entries)
+	{
+		return cvCreateImage(size, depth, channels);
+	}
+
+	catcierge_mutex_lock(&pool->lock);
+
+	if (size.width > pool->max_size.width)
+		pool->max_size.width = size.width;
+
+	if (size.height > pool->max_size.height)
+		pool->max_size.height = size.height;
+
+	// The smallest free buffer that fits, otherwise one that is
+	// not created yet, or lastly one of another format.
+	for (i = 0; i < pool->capacity; i++)
+	{
+		e = &pool->entries[i];
+
+		if (e->refs)
+			continue;
+
+		if (!e->img)
+		{
+			if (!empty)
+				empty = e;
+		}
+		else if (catcierge_image_pool_fits(e->img, size, depth, channels, exact))
+		{
+			if (!best || ((e->img->width * e->img->height) < (best->img->width * best->img->height)))
+				best = e;
+		}
+		else if (!other)
+		{
+			other = e;
+		}
+	}
+
+	// Grow rather than destroy a buffer that its format will want back.
+	if (!best && !empty && other
+	 && (pool->capacity < pool->max_capacity)
+	 && !catcierge_image_pool_grow(pool, 1))
+	{
+		empty = &pool->entries[pool->capacity - 1];
+	}
+
+	if (!best && (e = (empty ? empty : other)))
+	{
+		if (e->img)
+		{
+			cvReleaseImage(&e->img);
+			pool->stats.recreated++;
+		}
+		else
+		{
+			pool->stats.allocated++;
+		}
+
+		if ((e->img = cvCreateImage(exact ? size : pool->max_size, depth, channels)))
+			best = e;
+	}
+
+	if (best)
+	{
+		best->refs = 1;
+		img = best->img;
+		pool->stats.used++;
+
+		if (pool->stats.used > pool->stats.peak)
+			pool->stats.peak = pool->stats.used;
+	}
+	else
+	{
+		exhausted = ++pool->stats.exhausted;
+	}
+
+	catcierge_mutex_unlock(&pool->lock);
+
+	if (!img)
+	{
+		if (exhausted == 1)
+		{
+			CATERR("All %d image pool buffers are in use, allocating images outside the pool\n",
+				(int)pool->capacity);
+		}
+
+		return cvCreateImage(size, depth, channels);
+	}
+
+	if ((img->width == size.width) && (img->height == size.height))
+	{
+		cvResetImageROI(img);
+	}
+	else
+	{
+		cvSetImageROI(img, cvRect(0, 0, size.width, size.height));
+	}
+
+	return img;
+}
+
+int catcierge_image_pool_reserve(catcierge_image_pool_t *pool, size_t count, CvSize size, int depth, int channels)
+{
+	size_t i;
+	size_t fitting = 0;
+	size_t empty = 0;
+	size_t missing;
+	int ret = 0;
+	catcierge_image_pool_entry_t *e;
+	assert(pool);
+
+	if (!pool->entries)
+		return 0;
+
+	catcierge_mutex_lock(&pool->lock);
+
+	// Images borrowed later are created at least this large as well.
+	if (size.width > pool->max_size.width)
+		pool->max_size.width = size.width;
+
+	if (size.height > pool->max_size.height)
+		pool->max_size.height = size.height;
+
+	for (i = 0; i < pool->capacity; i++)
+	{
+		e = &pool->entries[i];
+
+		if (!e->img)
+			empty++;
+		else if (catcierge_image_pool_fits(e->img, size, depth, channels, 1))
+			fitting++;
+	}
+
+	if (fitting >= count)
+		goto done;
+
+	missing = count - fitting;
+
+	if (empty < missing)
+	{
+		if (catcierge_image_pool_grow(pool, missing - empty))
+		{
+			ret = -1;
+			goto done;
+		}
+
+		pool->max_capacity += missing - empty;
+	}
+
+	for (i = 0; (i < pool->capacity) && (missing > 0); i++)
+	{
+		e = &pool->entries[i];
+
+		if (e->img)
+			continue;
+
+		if (!(e->img = cvCreateImage(size, depth, channels)))
+		{
+			CATERR("Out of memory!\n");
+			ret = -1;
+			break;
+		}
+
+		pool->stats.allocated++;
+		missing--;
+	}
+
+done:
+	catcierge_mutex_unlock(&pool->lock);
+
+	return ret;
+}
+
+IplImage *catcierge_image_pool_get(catcierge_image_pool_t *pool, CvSize size, int depth, int channels)
+{
+	return catcierge_image_pool_borrow(pool, size, depth, channels, 0);
+}
+
+IplImage *catcierge_image_pool_get_exact(catcierge_image_pool_t *pool, CvSize size, int depth, int channels)
+{
+	return catcierge_image_pool_borrow(pool, size, depth, channels, 1);
+}
+
+// Adds a reference if img is borrowed from the pool.
+static int catcierge_image_pool_retain(catcierge_image_pool_t *pool, IplImage *img)
+{
+	size_t i;
+	int found = 0;
+
+	if (!pool || !pool->entries)
+		return 0;
+
+	catcierge_mutex_lock(&pool->lock);
+
+	for (i = 0; i < pool->capacity; i++)
+	{
+		if ((pool->entries[i].img == img) && (pool->entries[i].refs > 0))
+		{
+			pool->entries[i].refs++;
+			found = 1;
+			break;
+		}
+	}
+
+	catcierge_mutex_unlock(&pool->lock);
+
+	return found;
+}
+
+IplImage *catcierge_image_pool_clone(catcierge_image_pool_t *pool, IplImage *src)
+{
+	CvRect roi;
+	IplImage *dst;
+	assert(src);
+
+	if (catcierge_image_pool_retain(pool, src))
+	{
+		return src;
+	}
+
+	roi = cvGetImageROI(src);
+
+	if (!(dst = catcierge_image_pool_get(pool,
+			cvSize(roi.width, roi.height), src->depth, src->nChannels)))
+	{
+		return NULL;
+	}
+
+	cvCopy(src, dst, NULL);
+
+	return dst;
+}
+
+void catcierge_image_pool_release(catcierge_image_pool_t *pool, IplImage **img)
+{
+	size_t i;
+	int found = 0;
+	catcierge_image_pool_entry_t *e;
+
+	if (!img || !*img)
+		return;
+
+	if (pool && pool->entries)
+	{
+		catcierge_mutex_lock(&pool->lock);
+
+		for (i = 0; i < pool->capacity; i++)
+		{
+			e = &pool->entries[i];
+
+			if ((e->img == *img) && (e->refs > 0))
+			{
+				if (--e->refs == 0)
+					pool->stats.used--;
+
+				found = 1;
+				break;
+			}
+		}
+
+		catcierge_mutex_unlock(&pool->lock);
+	}
+
+	// Allocated on the heap.
+	if (!found)
+	{
+		cvReleaseImage(img);
+	}
+
+	*img = NULL;
+}
+
+void catcierge_image_pool_get_stats(catcierge_image_pool_t *pool, catcierge_image_pool_stats_t *stats)
+{
+	assert(pool);
+	assert(stats);
+
+	if (!pool->entries)
+	{
+		memset(stats, 0, sizeof(catcierge_image_pool_stats_t));
+		return;
+	}
+
+	catcierge_mutex_lock(&pool->lock);
+	*stats = pool->stats;
+	catcierge_mutex_unlock(&pool->lock);
+}
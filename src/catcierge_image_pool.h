@@ -0,0 +1,100 @@
+//
+// This file is part of the Catcierge project.
+//
+// Copyright (c) Joakim Soderberg 2013-2014
+//
+//    Catcierge is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    Catcierge is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Catcierge.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef __CATCIERGE_IMAGE_POOL_H__
+#define __CATCIERGE_IMAGE_POOL_H__
+
+#include <stddef.h>
+#include <opencv2/imgproc/imgproc_c.h>
+#include "catcierge_thread.h"
+
+#define CATCIERGE_IMAGE_POOL_GROWTH 2
+
+typedef struct catcierge_image_pool_entry_s
+{
+	IplImage *img;				// Created when reserved or first needed.
+	int refs;					// 0 when the buffer is free.
+} catcierge_image_pool_entry_t;
+
+typedef struct catcierge_image_pool_stats_s
+{
+	unsigned int capacity;		// Buffers the pool can hold.
+	unsigned int allocated;		// Buffers created so far.
+	unsigned int used;			// Buffers currently borrowed.
+	unsigned int peak;			// Most buffers borrowed at the same time.
+	unsigned int exhausted;		// Images allocated outside the pool because it was full.
+	unsigned int recreated;		// Free buffers replaced by one of another format.
+} catcierge_image_pool_stats_t;
+
+//
+// A fixed number of reference counted image buffers, so that the images
+// kept for a match group are recycled instead of allocated for every
+// passage. The buffers are created up front using reserve, once the
+// frame size is known. Entries that are not reserved are created the
+// first time they are needed, at least as large as the largest image
+// borrowed or reserved so far. Smaller images borrow a buffer with the
+// ROI set to their size.
+//
+// When the free buffers are all of another format the pool grows, up to
+// CATCIERGE_IMAGE_POOL_GROWTH times its capacity, so that images of
+// different formats borrowed in turn keep a buffer each. Only a full
+// pool replaces a free buffer of another format.
+//
+// When every buffer is in use the image is allocated on the heap
+// instead, and counted as exhausted. Releasing such an image frees it,
+// so callers never have to know where an image came from.
+//
+// A NULL pool is allowed everywhere, and always uses the heap.
+// Safe to use from several threads.
+//
+typedef struct catcierge_image_pool_s
+{
+	catcierge_image_pool_entry_t *entries;
+	size_t capacity;
+	size_t max_capacity;		// Most entries the pool grows to for other formats.
+	CvSize max_size;			// Largest image borrowed or reserved so far.
+	catcierge_image_pool_stats_t stats;
+	catcierge_mutex_t lock;
+} catcierge_image_pool_t;
+
+int catcierge_image_pool_init(catcierge_image_pool_t *pool, size_t capacity);
+
+// Makes sure there are at least count buffers of exactly this format,
+// creating them now and growing the pool if there is not room for them.
+int catcierge_image_pool_reserve(catcierge_image_pool_t *pool, size_t count, CvSize size, int depth, int channels);
+
+// Frees all buffers, even the ones that are still borrowed.
+void catcierge_image_pool_destroy(catcierge_image_pool_t *pool);
+
+// Borrows a buffer with a reference count of 1.
+IplImage *catcierge_image_pool_get(catcierge_image_pool_t *pool, CvSize size, int depth, int channels);
+
+// Like catcierge_image_pool_get, but the buffer is exactly the requested
+// size and has no ROI set, for images whose ROI is changed by the user.
+IplImage *catcierge_image_pool_get_exact(catcierge_image_pool_t *pool, CvSize size, int depth, int channels);
+
+// Copies the ROI of src into a borrowed buffer. If src is a buffer from
+// the pool it is shared instead, so it must not be changed afterwards.
+IplImage *catcierge_image_pool_clone(catcierge_image_pool_t *pool, IplImage *src);
+
+// Drops a reference, the buffer is free again when the last one is gone.
+void catcierge_image_pool_release(catcierge_image_pool_t *pool, IplImage **img);
+
+void catcierge_image_pool_get_stats(catcierge_image_pool_t *pool, catcierge_image_pool_stats_t *stats);
+
+#endif // __CATCIERGE_IMAGE_POOL_H__
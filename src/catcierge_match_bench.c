@@ -0,0 +1,270 @@
+//
+// This file is part of the Catcierge project.
+//
+// Copyright (c) Joakim Soderberg 2013-2014
+//
+//    Catcierge is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    Catcierge is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Catcierge.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+//
+// Microbenchmark of what it costs per matched frame to reset the match
+// result and store the image paths, with the old layout where every match
+// and step had inline path buffers, compared to the current one.
+//
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "catcierge_fsm.h"
+#include "catcierge_arena.h"
+#include "catcierge_timer.h"
+#include "catcierge_util.h"
+
+#define DEFAULT_ITERATIONS 20000
+#define DEFAULT_STEPS 12
+#define BENCH_OUTPUT_PATH "/home/pi/catcierge/matches/2014-10-18"
+#define BENCH_TIME_STR "2014-10-18_12_34_56.123456"
+
+// The layout before the paths were moved to the match group string arena.
+typedef struct old_match_step_s
+{
+	IplImage *img;
+	char path[4096];
+	char filename[1024];
+	char full_path[4096];
+	const char *name;
+	const char *description;
+} old_match_step_t;
+
+typedef struct old_match_result_s
+{
+	double result;
+	int success;
+	char description[2048];
+	CvRect match_rects[MAX_MATCH_RECTS];
+	size_t rect_count;
+	match_direction_t direction;
+	old_match_step_t steps[MAX_STEPS];
+	size_t step_img_count;
+	CvRect hint_rects[MAX_MATCH_RECTS];
+	size_t hint_count;
+	match_direction_t hint_direction;
+	int hint_hit;
+	int hint_miss;
+	double search_time;
+	double hint_time;
+} old_match_result_t;
+
+typedef struct old_match_state_s
+{
+	char full_path[4096];
+	char path[4096];
+	char filename[1024];
+	IplImage *img;
+	struct timeval tv;
+	time_t time;
+	char time_str[1024];
+	old_match_result_t result;
+	SHA1Context sha;
+} old_match_state_t;
+
+static void old_match_frame(old_match_state_t *m, int idx, int steps, int saveimg)
+{
+	int j;
+	char base_path[1024];
+	old_match_step_t *step;
+
+	memset(&m->result, 0, sizeof(old_match_result_t));
+	m->result.hint_direction = MATCH_DIR_UNKNOWN;
+	m->result.step_img_count = steps;
+
+	snprintf(m->time_str, sizeof(m->time_str), "%s", BENCH_TIME_STR);
+	m->path[0] = '\0';
+	m->filename[0] = '\0';
+
+	if (!saveimg)
+		return;
+
+	snprintf(base_path, sizeof(base_path) - 1, "match_%s_%s__%d", "", m->time_str, idx);
+	snprintf(m->path, sizeof(m->path) - 1, "%s", BENCH_OUTPUT_PATH);
+	snprintf(m->filename, sizeof(m->filename) - 1, "%s.png", base_path);
+	snprintf(m->full_path, sizeof(m->full_path) - 1, "%s%s%s",
+		m->path, catcierge_path_sep(), m->filename);
+
+	for (j = 0; j < steps; j++)
+	{
+		step = &m->result.steps[j];
+		step->name = "step";
+		snprintf(step->path, sizeof(step->path) - 1, "%s", BENCH_OUTPUT_PATH);
+		snprintf(step->filename, sizeof(step->filename) - 1,
+			"%s_%02d_%s.png", base_path, j, step->name);
+		snprintf(step->full_path, sizeof(step->full_path) - 1, "%s%s%s",
+			step->path, catcierge_path_sep(), step->filename);
+	}
+}
+
+static void new_match_frame(catcierge_arena_t *strings, match_state_t *m, int idx, int steps, int saveimg)
+{
+	int j;
+	char base_path[1024];
+	match_step_t *step;
+
+	catcierge_match_result_reset(&m->result, NULL);
+	m->result.step_img_count = steps;
+
+	snprintf(m->time_str, sizeof(m->time_str), "%s", BENCH_TIME_STR);
+	m->path = "";
+	m->filename = "";
+	m->full_path = "";
+
+	if (!saveimg)
+		return;
+
+	snprintf(base_path, sizeof(base_path) - 1, "match_%s_%s__%d", "", m->time_str, idx);
+	m->path = catcierge_arena_printf(strings, "%s", BENCH_OUTPUT_PATH);
+	m->filename = catcierge_arena_printf(strings, "%s.png", base_path);
+	m->full_path = catcierge_arena_printf(strings, "%s%s%s",
+		m->path, catcierge_path_sep(), m->filename);
+
+	for (j = 0; j < steps; j++)
+	{
+		step = &m->result.steps[j];
+		step->name = "step";
+		step->path = catcierge_arena_printf(strings, "%s", BENCH_OUTPUT_PATH);
+		step->filename = catcierge_arena_printf(strings,
+			"%s_%02d_%s.png", base_path, j, step->name);
+		step->full_path = catcierge_arena_printf(strings, "%s%s%s",
+			step->path, catcierge_path_sep(), step->filename);
+	}
+}
+
+static void run_bench(int iterations, int steps, int saveimg)
+{
+	int i;
+	double start;
+	double old_time;
+	double new_time;
+	double old_copy_time;
+	double new_copy_time;
+	old_match_state_t *old_matches;
+	match_state_t *new_matches;
+	catcierge_arena_t strings;
+
+	old_matches = (old_match_state_t *)calloc(DEFAULT_MATCH_GROUP_SIZE, sizeof(old_match_state_t));
+	new_matches = (match_state_t *)calloc(DEFAULT_MATCH_GROUP_SIZE, sizeof(match_state_t));
+	catcierge_arena_init(&strings);
+
+	if (!old_matches || !new_matches)
+	{
+		fprintf(stderr, "Out of memory\n");
+		goto fail;
+	}
+
+	start = catcierge_timer_now();
+
+	for (i = 0; i < iterations; i++)
+	{
+		old_match_frame(&old_matches[i % DEFAULT_MATCH_GROUP_SIZE],
+			i % DEFAULT_MATCH_GROUP_SIZE, steps, saveimg);
+	}
+
+	old_time = (catcierge_timer_now() - start) / iterations;
+	start = catcierge_timer_now();
+
+	for (i = 0; i < iterations; i++)
+	{
+		// A new match group.
+		if ((i % DEFAULT_MATCH_GROUP_SIZE) == 0)
+			catcierge_arena_reset(&strings);
+
+		new_match_frame(&strings, &new_matches[i % DEFAULT_MATCH_GROUP_SIZE],
+			i % DEFAULT_MATCH_GROUP_SIZE, steps, saveimg);
+	}
+
+	new_time = (catcierge_timer_now() - start) / iterations;
+
+	// Copying a match, for instance to hand it to another thread.
+	start = catcierge_timer_now();
+
+	for (i = 0; i < iterations; i++)
+	{
+		old_matches[(i + 1) % DEFAULT_MATCH_GROUP_SIZE] = old_matches[i % DEFAULT_MATCH_GROUP_SIZE];
+	}
+
+	old_copy_time = (catcierge_timer_now() - start) / iterations;
+	start = catcierge_timer_now();
+
+	for (i = 0; i < iterations; i++)
+	{
+		new_matches[(i + 1) % DEFAULT_MATCH_GROUP_SIZE] = new_matches[i % DEFAULT_MATCH_GROUP_SIZE];
+	}
+
+	new_copy_time = (catcierge_timer_now() - start) / iterations;
+
+	printf("%2d steps, saveimg %d  reset %8.3f us -> %8.3f us (%6.2fx)  copy %8.3f us -> %8.3f us (%6.2fx)\n",
+		steps, saveimg,
+		old_time * 1000000.0, new_time * 1000000.0, old_time / new_time,
+		old_copy_time * 1000000.0, new_copy_time * 1000000.0, old_copy_time / new_copy_time);
+
+fail:
+	catcierge_arena_destroy(&strings);
+	free(old_matches);
+	free(new_matches);
+}
+
+int main(int argc, char **argv)
+{
+	int i;
+	int iterations = DEFAULT_ITERATIONS;
+	int steps = DEFAULT_STEPS;
+
+	for (i = 1; i < argc; i++)
+	{
+		if (!strcmp(argv[i], "--iterations") && ((i + 1) < argc))
+		{
+			iterations = atoi(argv[++i]);
+		}
+		else if (!strcmp(argv[i], "--steps") && ((i + 1) < argc))
+		{
+			steps = atoi(argv[++i]);
+		}
+		else
+		{
+			fprintf(stderr, "Usage: %s [--iterations <count>] [--steps <count>]\n", argv[0]);
+			return -1;
+		}
+	}
+
+	if (iterations <= 0)
+	{
+		fprintf(stderr, "Iterations must be > 0\n");
+		return -1;
+	}
+
+	if ((steps < 0) || (steps > MAX_STEPS))
+	{
+		fprintf(stderr, "Steps must be between 0 and %d\n", MAX_STEPS);
+		return -1;
+	}
+
+	printf("Match result reset and copy microbenchmark, %d iterations\n", iterations);
+	printf("Match state %d bytes -> %d bytes, match result %d bytes -> %d bytes\n\n",
+		(int)sizeof(old_match_state_t), (int)sizeof(match_state_t),
+		(int)sizeof(old_match_result_t), (int)sizeof(match_result_t));
+
+	run_bench(iterations, 0, 0);
+	run_bench(iterations, 0, 1);
+	run_bench(iterations, steps, 1);
+
+	return 0;
+}
@@ -23,6 +23,7 @@
 #include <opencv2/highgui/highgui_c.h>
 
 #include "catcierge_matcher.h"
+#include "catcierge_obstruct.h"
 #include "catcierge_template_matcher.h"
 #include "catcierge_haar_matcher.h"
 #include "catcierge_log.h"
@@ -75,33 +76,17 @@ void catcierge_matcher_destroy(catcierge_matcher_t **ctx)
 	*ctx = NULL;
 }
 
-int catcierge_is_frame_obstructed(IplImage *img, int debug)
+static void catcierge_show_obstruct_debug(IplImage *img, CvRect rect, int sum)
 {
-	CvSize size;
-	int w;
-	int h;
-	int x;
-	int y;
-	int sum;
 	IplImage *tmp = NULL;
 	IplImage *tmp2 = NULL;
 	CvRect roi = cvGetImageROI(img);
 
-	// Get a suitable Region Of Interest (ROI)
-	// in the center of the image.
-	// (This should contain only the white background)
-	size = cvGetSize(img);
-	w = (int)(size.width * 0.5);
-	h = (int)(size.height * 0.1);
-	x = (size.width - w) / 2;
-	y = (size.height - h) / 2;
-
-	cvSetImageROI(img, cvRect(x, y, w, h));
+	cvSetImageROI(img, rect);
 
-	// Only covert to grayscale if needed.
 	if (img->nChannels != 1)
 	{
-		tmp = cvCreateImage(cvSize(w, h), 8, 1);
+		tmp = cvCreateImage(cvSize(rect.width, rect.height), 8, 1);
 		cvCvtColor(img, tmp, CV_BGR2GRAY);
 	}
 	else
@@ -109,19 +94,13 @@ int catcierge_is_frame_obstructed(IplImage *img, int debug)
 		tmp = img;
 	}
 
-	// Get a binary image and sum the pixel values.
-	tmp2 = cvCreateImage(cvSize(w, h), 8, 1);
-	cvThreshold(tmp, tmp2, 90, 255, CV_THRESH_BINARY_INV);
+	tmp2 = cvCreateImage(cvSize(rect.width, rect.height), 8, 1);
+	cvThreshold(tmp, tmp2, CATCIERGE_OBSTRUCT_LEVEL, 255, CV_THRESH_BINARY_INV);
 
-	sum = (int)cvSum(tmp2).val[0] / 255;
+	printf("Sum: %d\n", sum);
+	cvShowImage("obstruct", tmp2);
 
-	if (debug)
-	{
-		printf("Sum: %d\n", sum);
-		cvShowImage("obstruct", tmp2);
-	}
-
-	cvSetImageROI(img, cvRect(roi.x, roi.y, roi.width, roi.height));
+	cvSetImageROI(img, roi);
 
 	if (img->nChannels != 1)
 	{
@@ -129,7 +108,58 @@ int catcierge_is_frame_obstructed(IplImage *img, int debug)
 	}
 
 	cvReleaseImage(&tmp2);
+}
+
+int catcierge_get_obstruct_sum_limit(IplImage *img, int limit, int debug)
+{
+	CvSize size;
+	CvRect rect;
+	int sum;
+
+	if (!img || (img->depth != IPL_DEPTH_8U))
+	{
+		CATERR("Obstruct check needs an 8-bit image\n");
+		return -1;
+	}
+
+	// Get a suitable Region Of Interest (ROI)
+	// in the center of the image.
+	// (This should contain only the white background)
+	size = cvGetSize(img);
+	rect.width = (int)(size.width * 0.5);
+	rect.height = (int)(size.height * 0.1);
+	rect.x = (size.width - rect.width) / 2;
+	rect.y = (size.height - rect.height) / 2;
+
+	// Count the dark pixels straight from the image data, this gives
+	// the same result as converting to grayscale, thresholding and
+	// summing but without any temporary images.
+	sum = catcierge_obstruct_count(
+		(unsigned char *)img->imageData + rect.y * img->widthStep + rect.x * img->nChannels,
+		img->widthStep, rect.width, rect.height, img->nChannels,
+		CATCIERGE_OBSTRUCT_LEVEL, debug ? -1 : limit);
+
+	if (debug && (sum >= 0))
+	{
+		catcierge_show_obstruct_debug(img, rect, sum);
+	}
+
+	return sum;
+}
+
+int catcierge_get_obstruct_sum(IplImage *img, int debug)
+{
+	return catcierge_get_obstruct_sum_limit(img, -1, debug);
+}
+
+int catcierge_is_frame_obstructed(IplImage *img, int debug)
+{
+	int sum;
+
+	// No need to count further than the threshold.
+	if ((sum = catcierge_get_obstruct_sum_limit(img, CATCIERGE_OBSTRUCT_THRESHOLD, debug)) < 0)
+		return -1;
 
 	// Spiders and other 1 pixel creatures need not bother!
-	return ((int)sum > 200);
+	return (sum > CATCIERGE_OBSTRUCT_THRESHOLD);
 }
@@ -23,9 +23,12 @@
 #include <opencv2/highgui/highgui_c.h>
 
 #include "catcierge_types.h"
+#include "catcierge_frame_ctx.h"
 
+// The matchers get the frame through a frame context, so that they
+// share the grayscale and other planes with the rest of the program.
 typedef double (*catcierge_match_func_t)(void *ctx,
-		IplImage *img, match_result_t *result, int save_steps);
+		catcierge_frame_ctx_t *frame, match_result_t *result, int save_steps);
 
 typedef int (*catcierge_decide_func_t)(void *ctx, match_group_t *mg);
 
@@ -41,6 +44,8 @@ typedef struct catcierge_matcher_s
 	catcierge_match_func_t match;
 	catcierge_decide_func_t decide;
 	catcierge_matcher_translate_func_t translate;
+	catcierge_image_pool_t *images;	// Where step images are borrowed from, can be NULL.
+	size_t step_img_max;			// Most step images a match saves.
 } catcierge_matcher_t;
 
 typedef struct catcierge_matcher_args_s
@@ -48,6 +53,13 @@ typedef struct catcierge_matcher_args_s
 	catcierge_matcher_type_t type;
 } catcierge_matcher_args_t;
 
+// Number of dark pixels in the middle of the frame needed for it to be obstructed.
+#define CATCIERGE_OBSTRUCT_THRESHOLD 200
+
+// Number of dark pixels in the middle of the frame. When limit >= 0 the
+// counting stops as soon as the sum is larger than limit.
+int catcierge_get_obstruct_sum_limit(IplImage *img, int limit, int debug);
+int catcierge_get_obstruct_sum(IplImage *img, int debug);
 int catcierge_is_frame_obstructed(IplImage *img, int debug);
 
 int catcierge_matcher_init(catcierge_matcher_t **ctx, catcierge_matcher_args_t *args);
@@ -0,0 +1,309 @@
+//
+// This file is part of the Catcierge project.
+//
+// Copyright (c) Joakim Soderberg 2013-2014
+//
+//    Catcierge is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    Catcierge is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Catcierge.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <catcierge_config.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include "catcierge_morph.h"
+#include "catcierge_log.h"
+
+typedef void (*catcierge_morph_row_func_t)(unsigned char *dst,
+		const unsigned char *a, const unsigned char *b, int n);
+
+void catcierge_morph_init(catcierge_morph_t *m)
+{
+	assert(m);
+	memset(m, 0, sizeof(catcierge_morph_t));
+}
+
+void catcierge_morph_destroy(catcierge_morph_t *m)
+{
+	if (!m)
+		return;
+
+	free(m->integral);
+	free(m->buf);
+	memset(m, 0, sizeof(catcierge_morph_t));
+}
+
+static int catcierge_morph_reserve(void **buf, size_t *size, size_t needed)
+{
+	void *b = NULL;
+
+	if (needed <= *size)
+		return 0;
+
+	if (!(b = realloc(*buf, needed)))
+	{
+		CATERR("Out of memory!\n");
+		return -1;
+	}
+
+	*buf = b;
+	*size = needed;
+
+	return 0;
+}
+
+int catcierge_morph_adaptive_threshold(catcierge_morph_t *m,
+		const unsigned char *src, int src_step,
+		const unsigned char *mask, int mask_step,
+		unsigned char *dst, int dst_step,
+		int width, int height, int block, int c)
+{
+	int x;
+	int y;
+	int x0;
+	int x1;
+	int y0;
+	int y1;
+	int r;
+	long area;
+	long sum;
+	unsigned int row_sum;
+	unsigned int *integral = NULL;
+	unsigned int *top = NULL;
+	unsigned int *bottom = NULL;
+	const unsigned char *s = NULL;
+	const unsigned char *mrow = NULL;
+	unsigned char *d = NULL;
+	int istep = width + 1;
+	assert(m);
+
+	if (!src || !dst || (width <= 0) || (height <= 0) || (block <= 0))
+		return -1;
+
+	if (catcierge_morph_reserve((void **)&m->integral, &m->integral_size,
+			(size_t)(width + 1) * (height + 1) * sizeof(unsigned int)))
+		return -1;
+
+	integral = m->integral;
+	memset(integral, 0, istep * sizeof(unsigned int));
+
+	for (y = 0; y < height; y++)
+	{
+		s = src + y * src_step;
+		row_sum = 0;
+		integral[(y + 1) * istep] = 0;
+
+		for (x = 0; x < width; x++)
+		{
+			row_sum += s[x];
+			integral[(y + 1) * istep + x + 1] = integral[y * istep + x + 1] + row_sum;
+		}
+	}
+
+	r = block / 2;
+
+	for (y = 0; y < height; y++)
+	{
+		y0 = (y - r < 0) ? 0 : (y - r);
+		y1 = (y + r >= height) ? (height - 1) : (y + r);
+		top = integral + y0 * istep;
+		bottom = integral + (y1 + 1) * istep;
+		s = src + y * src_step;
+		d = dst + y * dst_step;
+		mrow = mask ? (mask + y * mask_step) : NULL;
+
+		for (x = 0; x < width; x++)
+		{
+			x0 = (x - r < 0) ? 0 : (x - r);
+			x1 = (x + r >= width) ? (width - 1) : (x + r);
+			area = (long)(x1 - x0 + 1) * (y1 - y0 + 1);
+			sum = (long)bottom[x1 + 1] - bottom[x0] - top[x1 + 1] + top[x0];
+
+			// src <= sum / area - c, without dividing.
+			d[x] = ((mrow && mrow[x]) || (((long)s[x] + c) * area <= sum)) ? 255 : 0;
+		}
+	}
+
+	return 0;
+}
+
+static void catcierge_morph_row_max(unsigned char *dst,
+		const unsigned char *a, const unsigned char *b, int n)
+{
+	int i;
+
+	for (i = 0; i < n; i++)
+		dst[i] = (a[i] > b[i]) ? a[i] : b[i];
+}
+
+static void catcierge_morph_row_min(unsigned char *dst,
+		const unsigned char *a, const unsigned char *b, int n)
+{
+	int i;
+
+	for (i = 0; i < n; i++)
+		dst[i] = (a[i] < b[i]) ? a[i] : b[i];
+}
+
+//
+// van Herk / Gil-Werman running min/max of k values. The n values in p
+// are split into blocks of k, g is the running result from the start
+// of each block and h from the end of each block. Every window of k
+// values covers the end of one block and the start of the next, so
+// its result is op(h[start], g[end]). Each step works on a whole row
+// of len values at once, so the same code filters along the rows
+// (len 1) and along the columns (len width).
+//
+static void catcierge_morph_van_herk(catcierge_morph_row_func_t op,
+		unsigned char **p, unsigned char *g, unsigned char *h,
+		int n, int k, int len)
+{
+	int b;
+	int i;
+	int end;
+
+	for (b = 0; b < n; b += k)
+	{
+		end = ((b + k) < n) ? (b + k) : n;
+
+		memcpy(g + b * len, p[b], len);
+
+		for (i = b + 1; i < end; i++)
+			op(g + i * len, g + (i - 1) * len, p[i], len);
+
+		memcpy(h + (end - 1) * len, p[end - 1], len);
+
+		for (i = end - 2; i >= b; i--)
+			op(h + i * len, h + (i + 1) * len, p[i], len);
+	}
+}
+
+static int catcierge_morph_filter(catcierge_morph_t *m,
+		const unsigned char *src, int src_step,
+		unsigned char *dst, int dst_step,
+		int width, int height, int kw, int kh, int invert, int is_max)
+{
+	int x;
+	int y;
+	int i;
+	int n;
+	int nh;
+	int nv;
+	int maxn;
+	size_t gh_size;
+	unsigned char identity = is_max ? 0 : 255;
+	unsigned char flip = invert ? 255 : 0;
+	catcierge_morph_row_func_t op = is_max ? catcierge_morph_row_max : catcierge_morph_row_min;
+	unsigned char *tmp = NULL;		// Result of filtering the rows.
+	unsigned char *ident = NULL;	// A row outside the image.
+	unsigned char *line = NULL;		// Padded row.
+	unsigned char *g = NULL;
+	unsigned char *h = NULL;
+	unsigned char **p = NULL;
+	unsigned char *d = NULL;
+	size_t needed;
+	assert(m);
+
+	if (!src || !dst || (width <= 0) || (height <= 0) || (kw <= 0) || (kh <= 0))
+		return -1;
+
+	nh = width + kw - 1;
+	nv = height + kh - 1;
+	maxn = (nh > nv) ? nh : nv;
+	gh_size = ((size_t)nv * width > (size_t)nh) ? ((size_t)nv * width) : (size_t)nh;
+
+	needed = (size_t)width * height		// tmp
+		+ width							// ident
+		+ nh							// line
+		+ 2 * gh_size					// g and h
+		+ maxn * sizeof(unsigned char *); // p
+
+	if (catcierge_morph_reserve((void **)&m->buf, &m->buf_size, needed))
+		return -1;
+
+	p = (unsigned char **)m->buf;
+	tmp = m->buf + maxn * sizeof(unsigned char *);
+	ident = tmp + (size_t)width * height;
+	line = ident + width;
+	g = line + nh;
+	h = g + gh_size;
+
+	memset(ident, identity, width);
+
+	// Along the rows, with the row padded on both sides so that
+	// every window is complete.
+	for (i = 0; i < nh; i++)
+		p[i] = line + i;
+
+	for (y = 0; y < height; y++)
+	{
+		d = tmp + y * width;
+
+		if (kw == 1)
+		{
+			memcpy(d, src + y * src_step, width);
+			continue;
+		}
+
+		memset(line, identity, nh);
+		memcpy(line + kw / 2, src + y * src_step, width);
+
+		catcierge_morph_van_herk(op, p, g, h, nh, kw, 1);
+
+		for (x = 0; x < width; x++)
+			d[x] = is_max ?
+				((h[x] > g[x + kw - 1]) ? h[x] : g[x + kw - 1]) :
+				((h[x] < g[x + kw - 1]) ? h[x] : g[x + kw - 1]);
+	}
+
+	// Along the columns, a whole row at a time.
+	for (i = 0; i < nv; i++)
+	{
+		n = i - kh / 2;
+		p[i] = ((n >= 0) && (n < height)) ? (tmp + n * width) : ident;
+	}
+
+	catcierge_morph_van_herk(op, p, g, h, nv, kh, width);
+
+	for (y = 0; y < height; y++)
+	{
+		d = dst + y * dst_step;
+		op(d, h + y * width, g + (y + kh - 1) * width, width);
+
+		if (flip)
+		{
+			for (x = 0; x < width; x++)
+				d[x] ^= flip;
+		}
+	}
+
+	return 0;
+}
+
+int catcierge_morph_erode(catcierge_morph_t *m,
+		const unsigned char *src, int src_step,
+		unsigned char *dst, int dst_step,
+		int width, int height, int kw, int kh, int invert)
+{
+	return catcierge_morph_filter(m, src, src_step, dst, dst_step,
+		width, height, kw, kh, invert, 0);
+}
+
+int catcierge_morph_dilate(catcierge_morph_t *m,
+		const unsigned char *src, int src_step,
+		unsigned char *dst, int dst_step,
+		int width, int height, int kw, int kh, int invert)
+{
+	return catcierge_morph_filter(m, src, src_step, dst, dst_step,
+		width, height, kw, kh, invert, 1);
+}
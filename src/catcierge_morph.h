@@ -0,0 +1,79 @@
+//
+// This file is part of the Catcierge project.
+//
+// Copyright (c) Joakim Soderberg 2013-2014
+//
+//    Catcierge is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    Catcierge is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Catcierge.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef __CATCIERGE_MORPH_H__
+#define __CATCIERGE_MORPH_H__
+
+#include <stdlib.h>
+
+//
+// Fast 8-bit adaptive threshold and morphology working in buffers that
+// are kept between calls, so nothing is allocated once they are large
+// enough for the images used.
+//
+// The adaptive threshold uses the mean of a box around each pixel from
+// an integral image, so the cost does not depend on the block size.
+//
+// Erosion and dilation with a rectangle are done separably, first
+// along the rows and then along the columns, using the van Herk /
+// Gil-Werman algorithm. It needs 3 min/max operations per pixel and
+// direction whatever the size of the rectangle.
+//
+
+typedef struct catcierge_morph_s
+{
+	unsigned int *integral;		// (width + 1) x (height + 1) integral image.
+	size_t integral_size;
+	unsigned char *buf;			// Scratch rows for the min/max filter.
+	size_t buf_size;
+} catcierge_morph_t;
+
+void catcierge_morph_init(catcierge_morph_t *m);
+void catcierge_morph_destroy(catcierge_morph_t *m);
+
+//
+// Sets dst to 255 where mask is non-zero or src <= mean - c, where mean
+// is the mean of the block x block pixels around it (only counting the
+// pixels inside the image at the borders), and 0 elsewhere. This is an
+// inverted mean adaptive threshold combined with a mask in one step.
+// mask may be NULL. Returns -1 on error.
+//
+int catcierge_morph_adaptive_threshold(catcierge_morph_t *m,
+		const unsigned char *src, int src_step,
+		const unsigned char *mask, int mask_step,
+		unsigned char *dst, int dst_step,
+		int width, int height, int block, int c);
+
+//
+// Erodes or dilates with a kw x kh rectangle anchored in its center,
+// the same as cvErode and cvDilate with a rectangular structuring
+// element. Pixels outside the image are ignored. If invert is set the
+// result is inverted as well. dst may be the same as src.
+// Returns -1 on error.
+//
+int catcierge_morph_erode(catcierge_morph_t *m,
+		const unsigned char *src, int src_step,
+		unsigned char *dst, int dst_step,
+		int width, int height, int kw, int kh, int invert);
+
+int catcierge_morph_dilate(catcierge_morph_t *m,
+		const unsigned char *src, int src_step,
+		unsigned char *dst, int dst_step,
+		int width, int height, int kw, int kh, int invert);
+
+#endif // __CATCIERGE_MORPH_H__
@@ -0,0 +1,285 @@
+//
+// This file is part of the Catcierge project.
+//
+// Copyright (c) Joakim Soderberg 2013-2014
+//
+//    Catcierge is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    Catcierge is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Catcierge.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <catcierge_config.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include "catcierge_platform.h"
+#include "catcierge_motion.h"
+#include "catcierge_log.h"
+
+#ifdef CATCIERGE_HAVE_SSE2
+#include <emmintrin.h>
+#endif
+
+#ifdef CATCIERGE_HAVE_NEON
+#include <arm_neon.h>
+#endif
+
+void catcierge_motion_init(catcierge_motion_t *m, catcierge_motion_args_t *args)
+{
+	assert(m);
+	assert(args);
+
+	memset(m, 0, sizeof(catcierge_motion_t));
+	m->args = args;
+}
+
+void catcierge_motion_reset(catcierge_motion_t *m)
+{
+	assert(m);
+	m->has_ref = 0;
+}
+
+//
+// Each thumbnail pixel is the mean of a 2x2 block in the middle of
+// its cell. Sampling instead of averaging the whole cell keeps this
+// a lot cheaper than the obstruction check it is supposed to save.
+// For color frames only the green channel is used.
+//
+void catcierge_motion_thumbnail(IplImage *img, unsigned char *thumb)
+{
+	int cx;
+	int cy;
+	int x;
+	int y;
+	int x1;
+	int y1;
+	int ch;
+	const unsigned char *row0;
+	const unsigned char *row1;
+	assert(img);
+	assert(thumb);
+
+	ch = (img->nChannels > 1) ? 1 : 0;
+
+	for (cy = 0; cy < CATCIERGE_MOTION_HEIGHT; cy++)
+	{
+		y = ((2 * cy + 1) * img->height) / (2 * CATCIERGE_MOTION_HEIGHT);
+		y1 = (y + 1 < img->height) ? (y + 1) : y;
+		row0 = (const unsigned char *)img->imageData + y * img->widthStep;
+		row1 = (const unsigned char *)img->imageData + y1 * img->widthStep;
+
+		for (cx = 0; cx < CATCIERGE_MOTION_WIDTH; cx++)
+		{
+			x = ((2 * cx + 1) * img->width) / (2 * CATCIERGE_MOTION_WIDTH);
+			x1 = (x + 1 < img->width) ? (x + 1) : x;
+			x = x * img->nChannels + ch;
+			x1 = x1 * img->nChannels + ch;
+
+			*thumb++ = (unsigned char)((row0[x] + row0[x1] + row1[x] + row1[x1] + 2) >> 2);
+		}
+	}
+}
+
+unsigned int catcierge_motion_sad_scalar(const unsigned char *a, const unsigned char *b, int count)
+{
+	int i;
+	unsigned int sad = 0;
+
+	for (i = 0; i < count; i++)
+	{
+		sad += (a[i] > b[i]) ? (a[i] - b[i]) : (b[i] - a[i]);
+	}
+
+	return sad;
+}
+
+unsigned int catcierge_motion_sad(const unsigned char *a, const unsigned char *b, int count)
+{
+	int i = 0;
+	unsigned int sad = 0;
+	#if defined(CATCIERGE_HAVE_SSE2)
+	__m128i acc = _mm_setzero_si128();
+
+	for (; (i + 16) <= count; i += 16)
+	{
+		acc = _mm_add_epi64(acc, _mm_sad_epu8(
+			_mm_loadu_si128((const __m128i *)(a + i)),
+			_mm_loadu_si128((const __m128i *)(b + i))));
+	}
+
+	sad = (unsigned int)(_mm_cvtsi128_si32(acc) + _mm_cvtsi128_si32(_mm_srli_si128(acc, 8)));
+	#elif defined(CATCIERGE_HAVE_NEON)
+	uint16x8_t acc;
+	uint64x2_t s;
+	int n;
+
+	while ((i + 16) <= count)
+	{
+		// 16-bit lanes hold up to 128 * 2 * 255 without overflowing.
+		acc = vdupq_n_u16(0);
+
+		for (n = 0; (n < 128) && ((i + 16) <= count); n++, i += 16)
+		{
+			acc = vpadalq_u8(acc, vabdq_u8(vld1q_u8(a + i), vld1q_u8(b + i)));
+		}
+
+		s = vpaddlq_u32(vpaddlq_u16(acc));
+		sad += (unsigned int)(vgetq_lane_u64(s, 0) + vgetq_lane_u64(s, 1));
+	}
+	#endif
+
+	return sad + catcierge_motion_sad_scalar(a + i, b + i, count - i);
+}
+
+int catcierge_motion_check(catcierge_motion_t *m, IplImage *img, double now)
+{
+	assert(m);
+	assert(img);
+
+	m->moved = 0;
+
+	if (!m->args || !m->args->enabled)
+		return 1;
+
+	catcierge_motion_thumbnail(img, m->cur);
+
+	if (!m->has_ref || (img->width != m->ref_width) || (img->height != m->ref_height))
+	{
+		m->last_sad = 0;
+	}
+	else
+	{
+		m->last_sad = catcierge_motion_sad(m->ref, m->cur, CATCIERGE_MOTION_CELLS);
+		m->moved = (m->last_sad > (unsigned int)(m->args->threshold * CATCIERGE_MOTION_CELLS));
+
+		if (!m->moved && ((now - m->last_eval) < m->args->watchdog))
+		{
+			m->gated++;
+			return 0;
+		}
+
+		if (m->moved)
+			m->motion_count++;
+		else
+			m->watchdog_count++;
+	}
+
+	// Evaluate, and compare the following frames to this one.
+	memcpy(m->ref, m->cur, sizeof(m->ref));
+	m->has_ref = 1;
+	m->ref_width = img->width;
+	m->ref_height = img->height;
+	m->last_eval = now;
+	m->evaluated++;
+
+	return 1;
+}
+
+void catcierge_motion_print_stats(catcierge_motion_t *m)
+{
+	unsigned long total;
+	assert(m);
+
+	if (!m->args || !m->args->enabled)
+		return;
+
+	total = m->gated + m->evaluated;
+
+	CATLOG("Motion gate: %lu of %lu frames gated (%0.1f%%), %lu evaluated (%lu motion, %lu watchdog)\n",
+		m->gated, total, total ? (100.0 * m->gated / total) : 0.0,
+		m->evaluated, m->motion_count, m->watchdog_count);
+}
+
+void catcierge_motion_args_init(catcierge_motion_args_t *args)
+{
+	assert(args);
+	memset(args, 0, sizeof(catcierge_motion_args_t));
+	args->threshold = DEFAULT_MOTION_THRESHOLD;
+	args->watchdog = DEFAULT_MOTION_WATCHDOG;
+}
+
+void catcierge_motion_usage()
+{
+	fprintf(stderr, " --motion_gate          Only check if the frame is obstructed when something\n");
+	fprintf(stderr, "                        moved since the last checked frame (compared using a\n");
+	fprintf(stderr, "                        %dx%d thumbnail), or --motion_watchdog has passed.\n",
+		CATCIERGE_MOTION_WIDTH, CATCIERGE_MOTION_HEIGHT);
+	fprintf(stderr, " --motion_threshold <level>\n");
+	fprintf(stderr, "                        Mean difference per thumbnail pixel (0-255) that\n");
+	fprintf(stderr, "                        counts as motion. Default %0.1f\n", DEFAULT_MOTION_THRESHOLD);
+	fprintf(stderr, " --motion_watchdog <seconds>\n");
+	fprintf(stderr, "                        Check the frame at least this often even without\n");
+	fprintf(stderr, "                        motion. Default %0.1f\n", DEFAULT_MOTION_WATCHDOG);
+}
+
+int catcierge_motion_parse_args(catcierge_motion_args_t *args, const char *key, char **values, size_t value_count)
+{
+	if (!strcmp(key, "motion_gate"))
+	{
+		args->enabled = 1;
+		if (value_count == 1) args->enabled = atoi(values[0]);
+		return 0;
+	}
+
+	if (!strcmp(key, "motion_threshold"))
+	{
+		if (value_count == 1)
+		{
+			args->threshold = atof(values[0]);
+
+			if ((args->threshold < 0.0) || (args->threshold > 255.0))
+			{
+				fprintf(stderr, "--motion_threshold must be between 0 and 255\n");
+				return -1;
+			}
+
+			return 0;
+		}
+
+		fprintf(stderr, "--motion_threshold missing value\n");
+		return -1;
+	}
+
+	if (!strcmp(key, "motion_watchdog"))
+	{
+		if (value_count == 1)
+		{
+			args->watchdog = atof(values[0]);
+
+			if (args->watchdog < 0.0)
+			{
+				fprintf(stderr, "--motion_watchdog cannot be negative\n");
+				return -1;
+			}
+
+			return 0;
+		}
+
+		fprintf(stderr, "--motion_watchdog missing value\n");
+		return -1;
+	}
+
+	return 1;
+}
+
+void catcierge_motion_print_settings(catcierge_motion_args_t *args)
+{
+	assert(args);
+
+	printf("         Motion gate: %d\n", args->enabled);
+
+	if (!args->enabled)
+		return;
+
+	printf("    Motion threshold: %0.1f\n", args->threshold);
+	printf("     Motion watchdog: %0.1f seconds\n", args->watchdog);
+}
@@ -0,0 +1,82 @@
+//
+// This file is part of the Catcierge project.
+//
+// Copyright (c) Joakim Soderberg 2013-2014
+//
+//    Catcierge is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    Catcierge is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Catcierge.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef __CATCIERGE_MOTION_H__
+#define __CATCIERGE_MOTION_H__
+
+#include <opencv2/imgproc/imgproc_c.h>
+
+#define CATCIERGE_MOTION_WIDTH 40
+#define CATCIERGE_MOTION_HEIGHT 30
+#define CATCIERGE_MOTION_CELLS (CATCIERGE_MOTION_WIDTH * CATCIERGE_MOTION_HEIGHT)
+
+#define DEFAULT_MOTION_THRESHOLD 4.0
+#define DEFAULT_MOTION_WATCHDOG 1.0
+
+typedef struct catcierge_motion_args_s
+{
+	int enabled;
+	double threshold;	// Mean absolute difference per thumbnail pixel that counts as motion.
+	double watchdog;	// Evaluate at least this often in seconds, even without motion.
+} catcierge_motion_args_t;
+
+//
+// Motion gate in front of the obstruction check. Each frame is
+// shrunk to a tiny thumbnail and compared to the thumbnail of the
+// last frame that was fully evaluated. Only when they differ enough,
+// or the watchdog times out, does the frame need to be evaluated.
+//
+typedef struct catcierge_motion_s
+{
+	catcierge_motion_args_t *args;
+	unsigned char ref[CATCIERGE_MOTION_CELLS];	// Thumbnail of the last evaluated frame.
+	unsigned char cur[CATCIERGE_MOTION_CELLS];
+	int has_ref;
+	int ref_width;
+	int ref_height;
+	double last_eval;			// Monotonic time of the last evaluated frame.
+	unsigned int last_sad;		// Difference of the last checked frame.
+	int moved;					// Set if the last checked frame had motion.
+
+	unsigned long gated;		// Frames skipped.
+	unsigned long evaluated;	// Frames that needed evaluation.
+	unsigned long motion_count;	// Evaluated because of motion.
+	unsigned long watchdog_count; // Evaluated because of the watchdog.
+} catcierge_motion_t;
+
+void catcierge_motion_init(catcierge_motion_t *m, catcierge_motion_args_t *args);
+
+// Returns 1 if the frame needs to be evaluated, 0 if it is unchanged
+// since the last evaluated frame. now is a monotonic time in seconds.
+int catcierge_motion_check(catcierge_motion_t *m, IplImage *img, double now);
+
+// Forget the reference frame so that the next frame is evaluated.
+void catcierge_motion_reset(catcierge_motion_t *m);
+
+void catcierge_motion_thumbnail(IplImage *img, unsigned char *thumb);
+unsigned int catcierge_motion_sad(const unsigned char *a, const unsigned char *b, int count);
+unsigned int catcierge_motion_sad_scalar(const unsigned char *a, const unsigned char *b, int count);
+
+void catcierge_motion_print_stats(catcierge_motion_t *m);
+
+void catcierge_motion_args_init(catcierge_motion_args_t *args);
+void catcierge_motion_usage();
+int catcierge_motion_parse_args(catcierge_motion_args_t *args, const char *key, char **values, size_t value_count);
+void catcierge_motion_print_settings(catcierge_motion_args_t *args);
+
+#endif // __CATCIERGE_MOTION_H__
@@ -0,0 +1,270 @@
+//
+// This file is part of the Catcierge project.
+//
+// Copyright (c) Joakim Soderberg 2013-2014
+//
+//    Catcierge is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    Catcierge is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Catcierge.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <stdio.h>
+#include "catcierge_platform.h"
+#include "catcierge_obstruct.h"
+
+#ifdef CATCIERGE_HAVE_SSE2
+#include <emmintrin.h>
+#endif
+
+#ifdef CATCIERGE_HAVE_NEON
+#include <arm_neon.h>
+#endif
+
+// The 8-bit per lane counters must be flushed before they overflow.
+#define CATCIERGE_OBSTRUCT_MAX_CHUNKS 255
+
+typedef int (*catcierge_obstruct_row_f)(const unsigned char *row,
+		int width, int channels, int level);
+
+//
+// (B * cb + G * cg + R * cr + (1 << (shift - 1))) >> shift <= level
+// is the same as
+// B * cb + G * cg + R * cr < ((level + 1) << shift) - (1 << (shift - 1))
+//
+static int catcierge_luma_limit(int level)
+{
+	return ((level + 1) << CATCIERGE_LUMA_SHIFT) - (1 << (CATCIERGE_LUMA_SHIFT - 1));
+}
+
+static int catcierge_obstruct_row_scalar(const unsigned char *row,
+		int width, int channels, int level)
+{
+	int x;
+	int count = 0;
+	int luma_limit;
+
+	if (channels == 1)
+	{
+		for (x = 0; x < width; x++)
+		{
+			count += (row[x] <= level);
+		}
+	}
+	else
+	{
+		luma_limit = catcierge_luma_limit(level);
+
+		for (x = 0; x < width; x++, row += channels)
+		{
+			count += ((CATCIERGE_LUMA_B * row[0]
+					 + CATCIERGE_LUMA_G * row[1]
+					 + CATCIERGE_LUMA_R * row[2]) < luma_limit);
+		}
+	}
+
+	return count;
+}
+
+#ifdef CATCIERGE_HAVE_SSE2
+
+static int catcierge_sse2_sum(__m128i acc)
+{
+	__m128i s = _mm_sad_epu8(acc, _mm_setzero_si128());
+	return _mm_cvtsi128_si32(s) + _mm_cvtsi128_si32(_mm_srli_si128(s, 8));
+}
+
+static int catcierge_obstruct_row_sse2(const unsigned char *row,
+		int width, int channels, int level)
+{
+	int x = 0;
+	int chunks = 0;
+	int count = 0;
+	__m128i p;
+	__m128i zero = _mm_setzero_si128();
+	__m128i lvl = _mm_set1_epi8((char)level);
+	__m128i acc = zero;
+
+	// Only grayscale is vectorized, SSE2 has no cheap way to deinterleave BGR.
+	if (channels != 1)
+		return catcierge_obstruct_row_scalar(row, width, channels, level);
+
+	for (; (x + 16) <= width; x += 16)
+	{
+		// p <= level exactly when the saturated p - level is 0.
+		p = _mm_loadu_si128((const __m128i *)(row + x));
+		acc = _mm_sub_epi8(acc, _mm_cmpeq_epi8(_mm_subs_epu8(p, lvl), zero));
+
+		if (++chunks == CATCIERGE_OBSTRUCT_MAX_CHUNKS)
+		{
+			count += catcierge_sse2_sum(acc);
+			acc = zero;
+			chunks = 0;
+		}
+	}
+
+	count += catcierge_sse2_sum(acc);
+
+	return count + catcierge_obstruct_row_scalar(row + x, width - x, channels, level);
+}
+
+#endif // CATCIERGE_HAVE_SSE2
+
+#ifdef CATCIERGE_HAVE_NEON
+
+static int catcierge_neon_sum(uint8x16_t acc)
+{
+	uint64x2_t s = vpaddlq_u32(vpaddlq_u16(vpaddlq_u8(acc)));
+	return (int)(vgetq_lane_u64(s, 0) + vgetq_lane_u64(s, 1));
+}
+
+static uint32x4_t catcierge_neon_luma(uint16x4_t b, uint16x4_t g, uint16x4_t r)
+{
+	uint32x4_t s = vmull_n_u16(b, CATCIERGE_LUMA_B);
+	s = vmlal_n_u16(s, g, CATCIERGE_LUMA_G);
+	return vmlal_n_u16(s, r, CATCIERGE_LUMA_R);
+}
+
+// 0xff for each of the 16 pixels that is at or below the luma limit.
+static uint8x16_t catcierge_neon_dark_mask(uint8x16_t b, uint8x16_t g, uint8x16_t r, uint32x4_t lim)
+{
+	uint16x8_t b16 = vmovl_u8(vget_low_u8(b));
+	uint16x8_t g16 = vmovl_u8(vget_low_u8(g));
+	uint16x8_t r16 = vmovl_u8(vget_low_u8(r));
+	uint16x8_t lo;
+	uint16x8_t hi;
+
+	lo = vcombine_u16(
+		vmovn_u32(vcltq_u32(catcierge_neon_luma(vget_low_u16(b16), vget_low_u16(g16), vget_low_u16(r16)), lim)),
+		vmovn_u32(vcltq_u32(catcierge_neon_luma(vget_high_u16(b16), vget_high_u16(g16), vget_high_u16(r16)), lim)));
+
+	b16 = vmovl_u8(vget_high_u8(b));
+	g16 = vmovl_u8(vget_high_u8(g));
+	r16 = vmovl_u8(vget_high_u8(r));
+
+	hi = vcombine_u16(
+		vmovn_u32(vcltq_u32(catcierge_neon_luma(vget_low_u16(b16), vget_low_u16(g16), vget_low_u16(r16)), lim)),
+		vmovn_u32(vcltq_u32(catcierge_neon_luma(vget_high_u16(b16), vget_high_u16(g16), vget_high_u16(r16)), lim)));
+
+	return vcombine_u8(vmovn_u16(lo), vmovn_u16(hi));
+}
+
+static int catcierge_obstruct_row_neon(const unsigned char *row,
+		int width, int channels, int level)
+{
+	int x = 0;
+	int chunks = 0;
+	int count = 0;
+	uint8x16_t mask;
+	uint8x16x3_t bgr;
+	uint8x16x4_t bgra;
+	uint8x16_t lvl = vdupq_n_u8((uint8_t)level);
+	uint32x4_t lim = vdupq_n_u32((uint32_t)catcierge_luma_limit(level));
+	uint8x16_t acc = vdupq_n_u8(0);
+
+	for (; (x + 16) <= width; x += 16)
+	{
+		if (channels == 1)
+		{
+			mask = vcleq_u8(vld1q_u8(row + x), lvl);
+		}
+		else if (channels == 3)
+		{
+			bgr = vld3q_u8(row + x * 3);
+			mask = catcierge_neon_dark_mask(bgr.val[0], bgr.val[1], bgr.val[2], lim);
+		}
+		else
+		{
+			bgra = vld4q_u8(row + x * 4);
+			mask = catcierge_neon_dark_mask(bgra.val[0], bgra.val[1], bgra.val[2], lim);
+		}
+
+		acc = vsubq_u8(acc, mask);
+
+		if (++chunks == CATCIERGE_OBSTRUCT_MAX_CHUNKS)
+		{
+			count += catcierge_neon_sum(acc);
+			acc = vdupq_n_u8(0);
+			chunks = 0;
+		}
+	}
+
+	count += catcierge_neon_sum(acc);
+
+	return count + catcierge_obstruct_row_scalar(row + x * channels, width - x, channels, level);
+}
+
+#endif // CATCIERGE_HAVE_NEON
+
+static int catcierge_obstruct_count_rows(catcierge_obstruct_row_f count_row,
+		const unsigned char *data, int step,
+		int width, int height, int channels, int level, int limit)
+{
+	int y;
+	int count = 0;
+
+	if (!data || (width < 0) || (height < 0)
+		|| ((channels != 1) && (channels != 3) && (channels != 4))
+		|| (step < (width * channels)))
+	{
+		return -1;
+	}
+
+	if (level < 0)
+		return 0;
+
+	if (level > 255)
+		level = 255;
+
+	for (y = 0; y < height; y++)
+	{
+		count += count_row(data + y * step, width, channels, level);
+
+		// A whole row is counted at a time, the ROI is usually only a
+		// few rows high so this is fine grained enough.
+		if ((limit >= 0) && (count > limit))
+			break;
+	}
+
+	return count;
+}
+
+int catcierge_obstruct_count_scalar(const unsigned char *data, int step,
+		int width, int height, int channels, int level, int limit)
+{
+	return catcierge_obstruct_count_rows(catcierge_obstruct_row_scalar,
+		data, step, width, height, channels, level, limit);
+}
+
+int catcierge_obstruct_count(const unsigned char *data, int step,
+		int width, int height, int channels, int level, int limit)
+{
+	#if defined(CATCIERGE_HAVE_SSE2)
+	return catcierge_obstruct_count_rows(catcierge_obstruct_row_sse2,
+		data, step, width, height, channels, level, limit);
+	#elif defined(CATCIERGE_HAVE_NEON)
+	return catcierge_obstruct_count_rows(catcierge_obstruct_row_neon,
+		data, step, width, height, channels, level, limit);
+	#else
+	return catcierge_obstruct_count_rows(catcierge_obstruct_row_scalar,
+		data, step, width, height, channels, level, limit);
+	#endif
+}
+
+const char *catcierge_obstruct_simd_str()
+{
+	#if defined(CATCIERGE_HAVE_SSE2)
+	return "SSE2";
+	#elif defined(CATCIERGE_HAVE_NEON)
+	return "NEON";
+	#else
+	return "None";
+	#endif
+}
@@ -0,0 +1,52 @@
+//
+// This file is part of the Catcierge project.
+//
+// Copyright (c) Joakim Soderberg 2013-2014
+//
+//    Catcierge is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    Catcierge is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Catcierge.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef __CATCIERGE_OBSTRUCT_H__
+#define __CATCIERGE_OBSTRUCT_H__
+
+// Pixels with a luma at or below this level are counted as dark.
+#define CATCIERGE_OBSTRUCT_LEVEL 90
+
+// Fixed point BGR to luma weights, the same as the 8-bit
+// CV_BGR2GRAY conversion in OpenCV uses, so that the result
+// is identical to converting the image first.
+#define CATCIERGE_LUMA_SHIFT 14
+#define CATCIERGE_LUMA_B 1868
+#define CATCIERGE_LUMA_G 9617
+#define CATCIERGE_LUMA_R 4899
+
+//
+// Counts the 8-bit pixels in a width x height area with a luma at
+// or below level. data points at the first pixel, step is the row
+// size in bytes, and channels is 1 (gray), 3 (BGR) or 4 (BGRA).
+//
+// If limit is >= 0 the counting stops as soon as the count is
+// larger than limit, so the result is only exact up to limit + 1.
+//
+// Returns -1 on invalid input.
+//
+int catcierge_obstruct_count(const unsigned char *data, int step,
+		int width, int height, int channels, int level, int limit);
+
+// Plain C version of the above, always available.
+int catcierge_obstruct_count_scalar(const unsigned char *data, int step,
+		int width, int height, int channels, int level, int limit);
+
+const char *catcierge_obstruct_simd_str();
+
+#endif // __CATCIERGE_OBSTRUCT_H__
@@ -0,0 +1,223 @@
+//
+// This file is part of the Catcierge project.
+//
+// Copyright (c) Joakim Soderberg 2013-2014
+//
+//    Catcierge is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    Catcierge is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Catcierge.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+//
+// Microbenchmark comparing the obstruction check against the old
+// convert + threshold + sum implementation.
+//
+#include <opencv2/imgproc/imgproc_c.h>
+#include <opencv2/highgui/highgui_c.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "catcierge_matcher.h"
+#include "catcierge_obstruct.h"
+#include "catcierge_timer.h"
+
+#define DEFAULT_ITERATIONS 20000
+
+// The way the obstruct sum was calculated before, kept as a reference.
+static int legacy_obstruct_sum(IplImage *img)
+{
+	CvSize size;
+	int w;
+	int h;
+	int x;
+	int y;
+	int sum;
+	IplImage *tmp = NULL;
+	IplImage *tmp2 = NULL;
+	CvRect roi = cvGetImageROI(img);
+
+	size = cvGetSize(img);
+	w = (int)(size.width * 0.5);
+	h = (int)(size.height * 0.1);
+	x = (size.width - w) / 2;
+	y = (size.height - h) / 2;
+
+	cvSetImageROI(img, cvRect(x, y, w, h));
+
+	if (img->nChannels != 1)
+	{
+		tmp = cvCreateImage(cvSize(w, h), 8, 1);
+		cvCvtColor(img, tmp, CV_BGR2GRAY);
+	}
+	else
+	{
+		tmp = img;
+	}
+
+	tmp2 = cvCreateImage(cvSize(w, h), 8, 1);
+	cvThreshold(tmp, tmp2, CATCIERGE_OBSTRUCT_LEVEL, 255, CV_THRESH_BINARY_INV);
+	sum = (int)cvSum(tmp2).val[0] / 255;
+
+	cvSetImageROI(img, roi);
+
+	if (img->nChannels != 1)
+	{
+		cvReleaseImage(&tmp);
+	}
+
+	cvReleaseImage(&tmp2);
+
+	return sum;
+}
+
+static IplImage *create_bench_image(int width, int height, int channels, int obstructed)
+{
+	IplImage *img = cvCreateImage(cvSize(width, height), IPL_DEPTH_8U, channels);
+
+	// White background with some noise around the obstruct level.
+	cvSet(img, cvScalarAll(255), NULL);
+	cvRectangle(img, cvPoint(0, 0), cvPoint(width / 8, height - 1), cvScalarAll(85), CV_FILLED, 8, 0);
+
+	if (obstructed)
+	{
+		cvRectangle(img, cvPoint(width / 4, height / 3),
+			cvPoint(width - width / 4, height - height / 3), cvScalarAll(20), CV_FILLED, 8, 0);
+	}
+
+	return img;
+}
+
+static void run_bench(const char *name, IplImage *img, int iterations)
+{
+	int i;
+	int legacy_sum = 0;
+	int sum = 0;
+	int scalar_sum = 0;
+	int obstructed = 0;
+	double start;
+	double legacy_time;
+	double sum_time;
+	double scalar_time;
+	double obstructed_time;
+	CvSize size = cvGetSize(img);
+	int w = (int)(size.width * 0.5);
+	int h = (int)(size.height * 0.1);
+	unsigned char *roi_data = (unsigned char *)img->imageData
+		+ ((size.height - h) / 2) * img->widthStep
+		+ ((size.width - w) / 2) * img->nChannels;
+
+	start = catcierge_timer_now();
+	for (i = 0; i < iterations; i++)
+		legacy_sum = legacy_obstruct_sum(img);
+	legacy_time = catcierge_timer_now() - start;
+
+	start = catcierge_timer_now();
+	for (i = 0; i < iterations; i++)
+		scalar_sum = catcierge_obstruct_count_scalar(roi_data, img->widthStep,
+			w, h, img->nChannels, CATCIERGE_OBSTRUCT_LEVEL, -1);
+	scalar_time = catcierge_timer_now() - start;
+
+	start = catcierge_timer_now();
+	for (i = 0; i < iterations; i++)
+		sum = catcierge_get_obstruct_sum(img, 0);
+	sum_time = catcierge_timer_now() - start;
+
+	start = catcierge_timer_now();
+	for (i = 0; i < iterations; i++)
+		obstructed = catcierge_is_frame_obstructed(img, 0);
+	obstructed_time = catcierge_timer_now() - start;
+
+	printf("%-24s legacy %8.0f ns  scalar %8.0f ns (%5.1fx)  %s %8.0f ns (%5.1fx)  obstructed check %8.0f ns (%5.1fx)\n",
+		name,
+		legacy_time * 1e9 / iterations,
+		scalar_time * 1e9 / iterations, legacy_time / scalar_time,
+		catcierge_obstruct_simd_str(),
+		sum_time * 1e9 / iterations, legacy_time / sum_time,
+		obstructed_time * 1e9 / iterations, legacy_time / obstructed_time);
+
+	if ((legacy_sum != sum) || (legacy_sum != scalar_sum)
+		|| (obstructed != (legacy_sum > CATCIERGE_OBSTRUCT_THRESHOLD)))
+	{
+		printf("  MISMATCH: legacy sum %d, scalar sum %d, sum %d, obstructed %d\n",
+			legacy_sum, scalar_sum, sum, obstructed);
+	}
+}
+
+int main(int argc, char **argv)
+{
+	int i;
+	int iterations = DEFAULT_ITERATIONS;
+	const char *image_path = NULL;
+	IplImage *img = NULL;
+	char name[64];
+	int sizes[][2] = { { 320, 240 }, { 640, 480 }, { 1280, 960 } };
+	int channels[] = { 1, 3 };
+	int c;
+	int obstructed;
+
+	for (i = 1; i < argc; i++)
+	{
+		if (!strcmp(argv[i], "--iterations") && ((i + 1) < argc))
+		{
+			iterations = atoi(argv[++i]);
+		}
+		else if (!strcmp(argv[i], "--image") && ((i + 1) < argc))
+		{
+			image_path = argv[++i];
+		}
+		else
+		{
+			fprintf(stderr, "Usage: %s [--iterations <count>] [--image <path>]\n", argv[0]);
+			return -1;
+		}
+	}
+
+	if (iterations <= 0)
+	{
+		fprintf(stderr, "Iterations must be > 0\n");
+		return -1;
+	}
+
+	printf("Obstruct check microbenchmark, %d iterations, SIMD: %s\n\n",
+		iterations, catcierge_obstruct_simd_str());
+
+	if (image_path)
+	{
+		if (!(img = cvLoadImage(image_path, CV_LOAD_IMAGE_UNCHANGED)))
+		{
+			fprintf(stderr, "Failed to load image %s\n", image_path);
+			return -1;
+		}
+
+		run_bench(image_path, img, iterations);
+		cvReleaseImage(&img);
+		return 0;
+	}
+
+	for (i = 0; i < (int)(sizeof(sizes) / sizeof(sizes[0])); i++)
+	{
+		for (c = 0; c < (int)(sizeof(channels) / sizeof(channels[0])); c++)
+		{
+			for (obstructed = 0; obstructed <= 1; obstructed++)
+			{
+				snprintf(name, sizeof(name), "%dx%dx%d %s",
+					sizes[i][0], sizes[i][1], channels[c], obstructed ? "obstructed" : "clear");
+
+				img = create_bench_image(sizes[i][0], sizes[i][1], channels[c], obstructed);
+				run_bench(name, img, iterations);
+				cvReleaseImage(&img);
+			}
+		}
+	}
+
+	return 0;
+}
@@ -67,10 +67,26 @@ catcierge_output_var_t vars[] =
 	{ "match_group_success", "Match group success status."},
 	{ "match_group_success_count", "Match group success count."},
 	{ "match_group_final_decision", "Did the match group veto the final decision?"},
+	{ "match_group_latency", "Milliseconds from the frame being obstructed until the lock decision."},
 	{ "match_group_desc", "Match group description."},
 	{ "match_group_direction", "The match group direction (based on all match directions)."},
 	{ "match_group_count", "Match group count o matches so far."},
 	{ "match_group_max_count", "Match group max number of matches that will be made."},
+	{ "match_group_frames_used", "Number of matches the lock decision was based on."},
+	{ "match_group_early_decision", "Was the lock decision made before all matches were made?"},
+	{ "frame_seq", "Sequence number of the current camera frame." },
+	{ "frames_captured", "Number of frames grabbed by the capture thread." },
+	{ "frames_consumed", "Number of captured frames processed by the state machine." },
+	{ "frames_overwritten", "Number of captured frames overwritten before being processed." },
+	{ "frames_dropped", "Number of failed frame grabs in the capture thread." },
+	{ "frames_gated", "Number of frames the motion gate skipped the obstruction check for." },
+	{ "frames_evaluated", "Number of frames the motion gate let through to the obstruction check." },
+	{ "image_pool_capacity", "Number of image buffers the match, step and obstruct images can borrow." },
+	{ "image_pool_allocated", "Number of image buffers created so far." },
+	{ "image_pool_used", "Number of image buffers currently borrowed." },
+	{ "image_pool_peak", "Most image buffers borrowed at the same time." },
+	{ "image_pool_exhausted", "Number of images allocated outside the pool because it was full." },
+	{ "image_pool_recreated", "Number of free image buffers replaced by one of another format." },
 	{ "match#_id", "Unique ID for match #." },
 	{ "match#_filename", "Image filenamefor match #." },
 	{ "match#_path", "Image output path for match # (excluding filename)." },
@@ -81,6 +97,9 @@ catcierge_output_var_t vars[] =
 	{ "match#_direction", "Direction for match #." },
 	{ "match#_description", "Description of match #." },
 	{ "match#_result", "Result for match #." },
+	{ "match#_hint", "If the search hint from the previous match was enough for match # (hit, miss or none)." },
+	{ "match#_search_time", "Seconds spent searching the whole frame for match #." },
+	{ "match#_hint_time", "Seconds spent searching near the hint for match #." },
 	{ "match#_time", "Time of match #." },
 	{ "match#_step#_filename", "Image filename for match step # for match #."},
 	{ "match#_step#_path", "Image path for match step # for match # (excluding filename)."},
@@ -769,6 +788,12 @@ const char *catcierge_output_translate(catcierge_grb_t *grb,
 		return buf;
 	}
 
+	if (!strcmp(var, "match_group_latency"))
+	{
+		snprintf(buf, bufsize - 1, "%0.1f", 1000.0 * grb->match_group.decision_latency);
+		return buf;
+	}
+
 	if (!strcmp(var, "match_group_direction"))
 	{
 		return catcierge_get_direction_str(grb->match_group.direction);
@@ -787,12 +812,127 @@ const char *catcierge_output_translate(catcierge_grb_t *grb,
 		return buf;
 	}
 
+	if (!strcmp(var, "match_group_frames_used"))
+	{
+		snprintf(buf, bufsize - 1, "%d", (int)grb->match_group.match_count);
+		return buf;
+	}
+
+	if (!strcmp(var, "match_group_early_decision"))
+	{
+		snprintf(buf, bufsize - 1, "%d", grb->match_group.early_decision);
+		return buf;
+	}
+
 	if (!strcmp(var, "match_group_max_count"))
 	{
-		snprintf(buf, bufsize - 1, "%d", MATCH_MAX_COUNT);
+		snprintf(buf, bufsize - 1, "%d", (int)grb->match_group.max_count);
+		return buf;
+	}
+
+	if (!strcmp(var, "frame_seq"))
+	{
+		snprintf(buf, bufsize - 1, "%lu", grb->frame_seq);
 		return buf;
 	}
 
+	if (!strncmp(var, "frames_", 7))
+	{
+		catcierge_capture_stats_t stats;
+		memset(&stats, 0, sizeof(stats));
+
+		if (grb->args.capture_thread && grb->capture_thread.frames)
+		{
+			catcierge_capture_thread_get_stats(&grb->capture_thread, &stats);
+		}
+
+		var += 7;
+
+		if (!strcmp(var, "captured"))
+		{
+			snprintf(buf, bufsize - 1, "%u", stats.captured);
+			return buf;
+		}
+
+		if (!strcmp(var, "consumed"))
+		{
+			snprintf(buf, bufsize - 1, "%u", stats.consumed);
+			return buf;
+		}
+
+		if (!strcmp(var, "overwritten"))
+		{
+			snprintf(buf, bufsize - 1, "%u", stats.overwritten);
+			return buf;
+		}
+
+		if (!strcmp(var, "dropped"))
+		{
+			snprintf(buf, bufsize - 1, "%u", stats.dropped);
+			return buf;
+		}
+
+		if (!strcmp(var, "gated"))
+		{
+			snprintf(buf, bufsize - 1, "%lu", grb->motion.gated);
+			return buf;
+		}
+
+		if (!strcmp(var, "evaluated"))
+		{
+			snprintf(buf, bufsize - 1, "%lu", grb->motion.evaluated);
+			return buf;
+		}
+
+		return NULL;
+	}
+
+	if (!strncmp(var, "image_pool_", 11))
+	{
+		catcierge_image_pool_stats_t stats;
+		catcierge_image_pool_get_stats(&grb->match_group.images, &stats);
+
+		var += 11;
+
+		if (!strcmp(var, "capacity"))
+		{
+			snprintf(buf, bufsize - 1, "%u", stats.capacity);
+			return buf;
+		}
+
+		if (!strcmp(var, "allocated"))
+		{
+			snprintf(buf, bufsize - 1, "%u", stats.allocated);
+			return buf;
+		}
+
+		if (!strcmp(var, "used"))
+		{
+			snprintf(buf, bufsize - 1, "%u", stats.used);
+			return buf;
+		}
+
+		if (!strcmp(var, "peak"))
+		{
+			snprintf(buf, bufsize - 1, "%u", stats.peak);
+			return buf;
+		}
+
+		if (!strcmp(var, "exhausted"))
+		{
+			snprintf(buf, bufsize - 1, "%u", stats.exhausted);
+			return buf;
+		}
+
+		if (!strcmp(var, "recreated"))
+		{
+			snprintf(buf, bufsize - 1, "%u", stats.recreated);
+			return buf;
+		}
+
+		return NULL;
+	}
+
 	if (!strcmp(var, "obstruct_filename"))
 	{
 		return mg->obstruct_filename;
@@ -858,7 +998,7 @@ const char *catcierge_output_translate(catcierge_grb_t *grb,
 			idx--; // Convert to 0-based index.
 		}
 
-		if ((idx < 0) || (idx >= MATCH_MAX_COUNT))
+		if ((idx < 0) || ((size_t)idx >= grb->match_group.max_count))
 		{
 			return NULL;
 		}
@@ -923,6 +1063,20 @@ const char *catcierge_output_translate(catcierge_grb_t *grb,
 			snprintf(buf, bufsize - 1, "%f", m->result.result);
 			return buf;
 		}
+		else if (!strcmp(subvar, "hint"))
+		{
+			return m->result.hint_hit ? "hit" : (m->result.hint_miss ? "miss" : "none");
+		}
+		else if (!strcmp(subvar, "search_time"))
+		{
+			snprintf(buf, bufsize - 1, "%f", m->result.search_time);
+			return buf;
+		}
+		else if (!strcmp(subvar, "hint_time"))
+		{
+			snprintf(buf, bufsize - 1, "%f", m->result.hint_time);
+			return buf;
+		}
 		else if (!strncmp(subvar, "time", 4))
 		{
 			return catcierge_get_time_var_format(subvar, buf, bufsize,
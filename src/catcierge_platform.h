@@ -24,6 +24,18 @@ typedef int mode_t;
 #include "win32/gettimeofday.h"
 #endif // _WIN32
 
+// SIMD instruction sets targeted by the compiler (-DWITH_SIMD=OFF turns them off).
+#if !defined(CATCIERGE_NO_SIMD)
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#define CATCIERGE_HAVE_SSE2
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define CATCIERGE_HAVE_NEON
+#endif
+#if defined(__AVX2__)
+#define CATCIERGE_HAVE_AVX2
+#endif
+#endif
+
 #if (!defined (va_copy))
 	#define va_copy(dest, src) (dest) = (src)
 #endif
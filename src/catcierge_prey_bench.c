@@ -0,0 +1,198 @@
+//
+// This file is part of the Catcierge project.
+//
+// Copyright (c) Joakim Soderberg 2013-2014
+//
+//    Catcierge is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    Catcierge is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Catcierge.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+//
+// Microbenchmark comparing counting the prey contours with the
+// connected component labeling against cvFindContours + cvContourArea.
+//
+#include <opencv2/imgproc/imgproc_c.h>
+#include <opencv2/highgui/highgui_c.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "catcierge_ccl.h"
+#include "catcierge_haar_matcher.h"
+#include "catcierge_timer.h"
+
+#define DEFAULT_ITERATIONS 20000
+
+// The way the prey contours were counted before, kept as a reference.
+static int legacy_count(IplImage *img, IplImage *tmp, CvMemStorage *storage)
+{
+	int count = 0;
+	CvSeq *it = NULL;
+	CvSeq *contours = NULL;
+
+	// cvFindContours modifies the image.
+	cvCopy(img, tmp, NULL);
+	cvClearMemStorage(storage);
+
+	cvFindContours(tmp, storage, &contours,
+		sizeof(CvContour), CV_RETR_LIST, CV_CHAIN_APPROX_NONE, cvPoint(0, 0));
+
+	for (it = contours; it; it = it->h_next)
+	{
+		if (cvContourArea(it, CV_WHOLE_SEQ, 0) > CATCIERGE_HAAR_PREY_MIN_AREA)
+			count++;
+	}
+
+	return count;
+}
+
+// A thresholded region below a cat head, white background
+// with the cat in black and optionally a prey.
+static IplImage *create_bench_image(int width, int height, int prey)
+{
+	IplImage *img = cvCreateImage(cvSize(width, height), IPL_DEPTH_8U, 1);
+
+	cvSet(img, cvScalarAll(255), NULL);
+	cvRectangle(img, cvPoint(0, 0), cvPoint(width / 2, height / 2), cvScalarAll(0), CV_FILLED, 8, 0);
+	cvCircle(img, cvPoint(width / 3, height / 2), height / 4, cvScalarAll(0), CV_FILLED, 8, 0);
+
+	if (prey)
+	{
+		// A tail splitting the background.
+		cvLine(img, cvPoint(width / 3, height / 2), cvPoint(width - 1, height - 1), cvScalarAll(0), 3, 8, 0);
+	}
+
+	return img;
+}
+
+static void run_bench(const char *name, IplImage *img, int iterations)
+{
+	int i;
+	int legacy = 0;
+	int count = 0;
+	int early = 0;
+	double start;
+	double legacy_time;
+	double count_time;
+	double early_time;
+	IplImage *tmp = cvCloneImage(img);
+	CvMemStorage *storage = cvCreateMemStorage(0);
+	catcierge_ccl_t ccl;
+
+	if (catcierge_ccl_init(&ccl))
+	{
+		fprintf(stderr, "Failed to init labeler\n");
+		goto fail;
+	}
+
+	start = catcierge_timer_now();
+	for (i = 0; i < iterations; i++)
+		legacy = legacy_count(img, tmp, storage);
+	legacy_time = catcierge_timer_now() - start;
+
+	start = catcierge_timer_now();
+	for (i = 0; i < iterations; i++)
+		count = catcierge_ccl_count_image(&ccl, img, CATCIERGE_HAAR_PREY_MIN_AREA, 0);
+	count_time = catcierge_timer_now() - start;
+
+	start = catcierge_timer_now();
+	for (i = 0; i < iterations; i++)
+		early = catcierge_ccl_count_image(&ccl, img, CATCIERGE_HAAR_PREY_MIN_AREA, 2);
+	early_time = catcierge_timer_now() - start;
+
+	printf("%-24s %3d contours  legacy %8.0f ns  labeling %8.0f ns (%5.1fx)  stop at 2 %8.0f ns (%5.1fx)\n",
+		name, legacy,
+		legacy_time * 1e9 / iterations,
+		count_time * 1e9 / iterations, legacy_time / count_time,
+		early_time * 1e9 / iterations, legacy_time / early_time);
+
+	if ((legacy != count) || ((legacy > 1) != (early > 1)))
+	{
+		printf("  MISMATCH: legacy %d, labeling %d, stop at 2 %d\n", legacy, count, early);
+	}
+
+fail:
+	catcierge_ccl_destroy(&ccl);
+	cvReleaseMemStorage(&storage);
+	cvReleaseImage(&tmp);
+}
+
+int main(int argc, char **argv)
+{
+	int i;
+	int iterations = DEFAULT_ITERATIONS;
+	const char *image_path = NULL;
+	IplImage *img = NULL;
+	IplImage *thr_img = NULL;
+	char name[64];
+	int sizes[][2] = { { 110, 40 }, { 160, 80 }, { 230, 120 } };
+	int prey;
+
+	for (i = 1; i < argc; i++)
+	{
+		if (!strcmp(argv[i], "--iterations") && ((i + 1) < argc))
+		{
+			iterations = atoi(argv[++i]);
+		}
+		else if (!strcmp(argv[i], "--image") && ((i + 1) < argc))
+		{
+			image_path = argv[++i];
+		}
+		else
+		{
+			fprintf(stderr, "Usage: %s [--iterations <count>] [--image <path>]\n", argv[0]);
+			return -1;
+		}
+	}
+
+	if (iterations <= 0)
+	{
+		fprintf(stderr, "Iterations must be > 0\n");
+		return -1;
+	}
+
+	printf("Prey contour count microbenchmark, %d iterations\n\n", iterations);
+
+	if (image_path)
+	{
+		if (!(img = cvLoadImage(image_path, CV_LOAD_IMAGE_GRAYSCALE)))
+		{
+			fprintf(stderr, "Failed to load image %s\n", image_path);
+			return -1;
+		}
+
+		// Same as the prey detection does.
+		thr_img = cvCreateImage(cvGetSize(img), 8, 1);
+		cvThreshold(img, thr_img, 0, 255, CV_THRESH_BINARY | CV_THRESH_OTSU);
+
+		run_bench(image_path, thr_img, iterations);
+
+		cvReleaseImage(&thr_img);
+		cvReleaseImage(&img);
+		return 0;
+	}
+
+	for (i = 0; i < (int)(sizeof(sizes) / sizeof(sizes[0])); i++)
+	{
+		for (prey = 0; prey <= 1; prey++)
+		{
+			snprintf(name, sizeof(name), "%dx%d %s",
+				sizes[i][0], sizes[i][1], prey ? "prey" : "no prey");
+
+			img = create_bench_image(sizes[i][0], sizes[i][1], prey);
+			run_bench(name, img, iterations);
+			cvReleaseImage(&img);
+		}
+	}
+
+	return 0;
+}
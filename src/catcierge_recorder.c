@@ -0,0 +1,444 @@
+//
+// This file is part of the Catcierge project.
+//
+// Copyright (c) Joakim Soderberg 2013-2014
+//
+//    Catcierge is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    Catcierge is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Catcierge.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <catcierge_config.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include <errno.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+#include "catcierge_recorder.h"
+#include "catcierge_log.h"
+
+#define RECORD_ALIGN(x) (((x) + 7) & ~((size_t)7))
+
+#ifdef _WIN32
+#define catcierge_record_barrier() MemoryBarrier()
+#else
+#define catcierge_record_barrier() __sync_synchronize()
+#endif
+
+const char *catcierge_record_state_str(catcierge_record_state_t state)
+{
+	switch (state)
+	{
+		case RECORD_STATE_WAITING: return "Waiting";
+		case RECORD_STATE_MATCHING: return "Matching";
+		case RECORD_STATE_KEEPOPEN: return "Keep open";
+		case RECORD_STATE_LOCKOUT: return "Lockout";
+		default: break;
+	}
+
+	return "Unknown";
+}
+
+//
+// Maps a file into memory. If size is non-zero the file is created (or truncated)
+// and preallocated to that size, otherwise an existing file is mapped privately
+// so that any changes made to the frames are never written back.
+//
+static int catcierge_record_map(catcierge_record_map_t *map, const char *path, size_t size)
+{
+	#ifdef _WIN32
+	LARGE_INTEGER file_size;
+	int create = (size != 0);
+
+	memset(map, 0, sizeof(catcierge_record_map_t));
+
+	if ((map->file = CreateFileA(path,
+			create ? (GENERIC_READ | GENERIC_WRITE) : GENERIC_READ,
+			FILE_SHARE_READ, NULL,
+			create ? CREATE_ALWAYS : OPEN_EXISTING,
+			FILE_ATTRIBUTE_NORMAL, NULL)) == INVALID_HANDLE_VALUE)
+	{
+		CATERR("Failed to open \"%s\"\n", path);
+		return -1;
+	}
+
+	if (create)
+	{
+		file_size.QuadPart = size;
+
+		if (!SetFilePointerEx(map->file, file_size, NULL, FILE_BEGIN)
+		 || !SetEndOfFile(map->file))
+		{
+			CATERR("Failed to preallocate %lu bytes for \"%s\"\n", (unsigned long)size, path);
+			goto fail;
+		}
+	}
+	else
+	{
+		if (!GetFileSizeEx(map->file, &file_size))
+			goto fail;
+
+		size = (size_t)file_size.QuadPart;
+	}
+
+	if (!(map->mapping = CreateFileMappingA(map->file, NULL,
+			create ? PAGE_READWRITE : PAGE_WRITECOPY, 0, 0, NULL)))
+	{
+		CATERR("Failed to create file mapping for \"%s\"\n", path);
+		goto fail;
+	}
+
+	if (!(map->data = (unsigned char *)MapViewOfFile(map->mapping,
+			create ? FILE_MAP_WRITE : FILE_MAP_COPY, 0, 0, size)))
+	{
+		CATERR("Failed to map \"%s\"\n", path);
+		goto fail;
+	}
+
+	map->size = size;
+	return 0;
+
+fail:
+	if (map->mapping) CloseHandle(map->mapping);
+	CloseHandle(map->file);
+	memset(map, 0, sizeof(catcierge_record_map_t));
+	return -1;
+	#else
+	struct stat st;
+	int create = (size != 0);
+	void *data;
+
+	memset(map, 0, sizeof(catcierge_record_map_t));
+
+	if ((map->fd = open(path, create ? (O_RDWR | O_CREAT | O_TRUNC) : O_RDONLY, 0644)) < 0)
+	{
+		CATERR("Failed to open \"%s\": %s\n", path, strerror(errno));
+		return -1;
+	}
+
+	if (create)
+	{
+		// Allocate all blocks up front, so we don't run out
+		// of disk space in the middle of a recording.
+		#ifdef __linux__
+		if (posix_fallocate(map->fd, 0, (off_t)size))
+		#else
+		if (ftruncate(map->fd, (off_t)size))
+		#endif
+		{
+			CATERR("Failed to preallocate %lu bytes for \"%s\"\n", (unsigned long)size, path);
+			goto fail;
+		}
+	}
+	else
+	{
+		if (fstat(map->fd, &st))
+			goto fail;
+
+		size = (size_t)st.st_size;
+	}
+
+	if ((data = mmap(NULL, size, PROT_READ | PROT_WRITE,
+			create ? MAP_SHARED : MAP_PRIVATE, map->fd, 0)) == MAP_FAILED)
+	{
+		CATERR("Failed to map \"%s\": %s\n", path, strerror(errno));
+		goto fail;
+	}
+
+	map->data = (unsigned char *)data;
+	map->size = size;
+	return 0;
+
+fail:
+	close(map->fd);
+	memset(map, 0, sizeof(catcierge_record_map_t));
+	return -1;
+	#endif // _WIN32
+}
+
+static void catcierge_record_unmap(catcierge_record_map_t *map)
+{
+	if (!map->data)
+		return;
+
+	#ifdef _WIN32
+	UnmapViewOfFile(map->data);
+	CloseHandle(map->mapping);
+	CloseHandle(map->file);
+	#else
+	munmap(map->data, map->size);
+	close(map->fd);
+	#endif
+
+	memset(map, 0, sizeof(catcierge_record_map_t));
+}
+
+static catcierge_record_frame_header_t *catcierge_record_get_slot(
+		catcierge_record_map_t *map, catcierge_record_header_t *header, uint64_t seq)
+{
+	size_t slot = (size_t)((seq - 1) % header->slot_count);
+
+	return (catcierge_record_frame_header_t *)(map->data
+		+ CATCIERGE_RECORD_HEADER_SIZE + slot * header->slot_size);
+}
+
+int catcierge_recorder_open(catcierge_recorder_t *rec, const char *path,
+		size_t max_size, int width, int height)
+{
+	size_t frame_size;
+	size_t slot_size;
+	size_t slot_count;
+	catcierge_record_header_t *header;
+	assert(rec);
+	assert(path);
+
+	memset(rec, 0, sizeof(catcierge_recorder_t));
+
+	frame_size = (size_t)width * height;
+	slot_size = RECORD_ALIGN(sizeof(catcierge_record_frame_header_t) + frame_size);
+
+	if (max_size <= CATCIERGE_RECORD_HEADER_SIZE)
+	{
+		slot_count = 0;
+	}
+	else
+	{
+		slot_count = (max_size - CATCIERGE_RECORD_HEADER_SIZE) / slot_size;
+	}
+
+	if (slot_count == 0)
+	{
+		CATERR("Recording size of %lu bytes is too small for a single %dx%d frame\n",
+			(unsigned long)max_size, width, height);
+		return -1;
+	}
+
+	if (catcierge_record_map(&rec->map, path,
+			CATCIERGE_RECORD_HEADER_SIZE + slot_count * slot_size))
+	{
+		return -1;
+	}
+
+	header = rec->header = (catcierge_record_header_t *)rec->map.data;
+	memset(header, 0, CATCIERGE_RECORD_HEADER_SIZE);
+	memcpy(header->magic, CATCIERGE_RECORD_MAGIC, sizeof(header->magic));
+	header->version = CATCIERGE_RECORD_VERSION;
+	header->header_size = CATCIERGE_RECORD_HEADER_SIZE;
+	header->width = width;
+	header->height = height;
+	header->frame_size = (uint32_t)frame_size;
+	header->slot_size = (uint32_t)slot_size;
+	header->slot_count = (uint32_t)slot_count;
+	header->write_count = 0;
+
+	CATLOG("Recording %dx%d frames to \"%s\" (%lu frames, %lu bytes)\n",
+		width, height, path, (unsigned long)slot_count, (unsigned long)rec->map.size);
+
+	return 0;
+}
+
+int catcierge_recorder_write(catcierge_recorder_t *rec, IplImage *img,
+		uint64_t frame_seq, double timestamp, catcierge_record_state_t state, int obstruct_sum)
+{
+	int y;
+	uint64_t seq;
+	unsigned char *pixels;
+	catcierge_record_header_t *header;
+	catcierge_record_frame_header_t *fh;
+	assert(rec);
+	assert(img);
+
+	if (!(header = rec->header))
+		return -1;
+
+	if ((img->width != (int)header->width)
+	 || (img->height != (int)header->height)
+	 || (img->depth != IPL_DEPTH_8U))
+	{
+		return -1;
+	}
+
+	if (img->nChannels != 1)
+	{
+		if (!rec->gray && !(rec->gray = cvCreateImage(cvGetSize(img), IPL_DEPTH_8U, 1)))
+		{
+			return -1;
+		}
+
+		cvCvtColor(img, rec->gray, CV_BGR2GRAY);
+		img = rec->gray;
+	}
+
+	seq = header->write_count + 1;
+	fh = catcierge_record_get_slot(&rec->map, header, seq);
+	pixels = (unsigned char *)(fh + 1);
+
+	// Invalidate the slot first, so that a reader (or a crash)
+	// never sees a half written frame as valid.
+	fh->seq = 0;
+	catcierge_record_barrier();
+
+	if (img->widthStep == img->width)
+	{
+		memcpy(pixels, img->imageData, header->frame_size);
+	}
+	else
+	{
+		for (y = 0; y < img->height; y++)
+		{
+			memcpy(pixels + y * img->width, img->imageData + y * img->widthStep, img->width);
+		}
+	}
+
+	fh->frame_seq = frame_seq;
+	fh->timestamp = timestamp;
+	fh->state = (int32_t)state;
+	fh->obstruct_sum = obstruct_sum;
+
+	catcierge_record_barrier();
+	fh->seq = seq;
+	header->write_count = seq;
+
+	return 0;
+}
+
+void catcierge_recorder_close(catcierge_recorder_t *rec)
+{
+	assert(rec);
+
+	if (rec->header)
+	{
+		CATLOG("Recorded %lu frames\n", (unsigned long)rec->header->write_count);
+	}
+
+	catcierge_record_unmap(&rec->map);
+	rec->header = NULL;
+
+	if (rec->gray)
+	{
+		cvReleaseImage(&rec->gray);
+	}
+}
+
+int catcierge_record_reader_open(catcierge_record_reader_t *reader, const char *path)
+{
+	uint64_t count;
+	catcierge_record_header_t *header;
+	assert(reader);
+	assert(path);
+
+	memset(reader, 0, sizeof(catcierge_record_reader_t));
+
+	if (catcierge_record_map(&reader->map, path, 0))
+	{
+		return -1;
+	}
+
+	header = (catcierge_record_header_t *)reader->map.data;
+
+	if ((reader->map.size < CATCIERGE_RECORD_HEADER_SIZE)
+	 || memcmp(header->magic, CATCIERGE_RECORD_MAGIC, sizeof(header->magic)))
+	{
+		CATERR("\"%s\" is not a catcierge recording\n", path);
+		goto fail;
+	}
+
+	if (header->version != CATCIERGE_RECORD_VERSION)
+	{
+		CATERR("Unsupported recording version %u in \"%s\"\n", header->version, path);
+		goto fail;
+	}
+
+	if ((header->slot_count == 0)
+	 || (header->frame_size != (header->width * header->height))
+	 || (header->slot_size < (sizeof(catcierge_record_frame_header_t) + header->frame_size))
+	 || (reader->map.size < (header->header_size + (size_t)header->slot_count * header->slot_size)))
+	{
+		CATERR("Corrupt recording header in \"%s\"\n", path);
+		goto fail;
+	}
+
+	reader->header = header;
+
+	if (!(reader->img = cvCreateImageHeader(cvSize(header->width, header->height), IPL_DEPTH_8U, 1)))
+	{
+		CATERR("Out of memory\n");
+		goto fail;
+	}
+
+	count = (header->write_count < header->slot_count) ? header->write_count : header->slot_count;
+	reader->last_seq = header->write_count;
+	reader->first_seq = header->write_count - count + 1;
+	reader->next_seq = reader->first_seq;
+
+	return 0;
+
+fail:
+	catcierge_record_reader_close(reader);
+	return -1;
+}
+
+int catcierge_record_reader_next(catcierge_record_reader_t *reader, catcierge_record_frame_t *frame)
+{
+	catcierge_record_frame_header_t *fh;
+	assert(reader);
+	assert(frame);
+
+	while (reader->next_seq <= reader->last_seq)
+	{
+		fh = catcierge_record_get_slot(&reader->map, reader->header, reader->next_seq);
+		reader->next_seq++;
+
+		// Skip frames that were being written when the recording stopped.
+		if (fh->seq != (reader->next_seq - 1))
+			continue;
+
+		cvSetData(reader->img, (unsigned char *)(fh + 1), reader->header->width);
+
+		frame->img = reader->img;
+		frame->seq = fh->seq;
+		frame->frame_seq = fh->frame_seq;
+		frame->timestamp = fh->timestamp;
+		frame->state = (catcierge_record_state_t)fh->state;
+		frame->obstruct_sum = fh->obstruct_sum;
+
+		return 0;
+	}
+
+	return 1;
+}
+
+void catcierge_record_reader_rewind(catcierge_record_reader_t *reader)
+{
+	assert(reader);
+	reader->next_seq = reader->first_seq;
+}
+
+void catcierge_record_reader_close(catcierge_record_reader_t *reader)
+{
+	assert(reader);
+
+	if (reader->img)
+	{
+		cvReleaseImageHeader(&reader->img);
+	}
+
+	catcierge_record_unmap(&reader->map);
+	reader->header = NULL;
+}
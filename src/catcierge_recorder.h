@@ -0,0 +1,128 @@
+//
+// This file is part of the Catcierge project.
+//
+// Copyright (c) Joakim Soderberg 2013-2014
+//
+//    Catcierge is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    Catcierge is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Catcierge.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef __CATCIERGE_RECORDER_H__
+#define __CATCIERGE_RECORDER_H__
+
+#include <stdint.h>
+#include <opencv2/imgproc/imgproc_c.h>
+#include "catcierge_platform.h"
+
+//
+// Continuous recording of raw frames into a memory mapped ring file.
+//
+// File layout:
+//   catcierge_record_header_t (padded to CATCIERGE_RECORD_HEADER_SIZE)
+//   slot_count * slot_size bytes of slots, where each slot is a
+//   catcierge_record_frame_header_t followed by width * height
+//   bytes of 8-bit grayscale pixels.
+//
+// Recording seq N (starting at 1) is always written to slot (N - 1) % slot_count.
+// All values are stored in host byte order.
+//
+#define CATCIERGE_RECORD_MAGIC "CATREC01"
+#define CATCIERGE_RECORD_VERSION 1
+#define CATCIERGE_RECORD_HEADER_SIZE 64
+#define DEFAULT_RECORD_SIZE_MB 64
+
+typedef enum catcierge_record_state_e
+{
+	RECORD_STATE_UNKNOWN = 0,
+	RECORD_STATE_WAITING = 1,
+	RECORD_STATE_MATCHING = 2,
+	RECORD_STATE_KEEPOPEN = 3,
+	RECORD_STATE_LOCKOUT = 4,
+	RECORD_STATE_COUNT
+} catcierge_record_state_t;
+
+typedef struct catcierge_record_header_s
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t header_size;
+	uint32_t width;
+	uint32_t height;
+	uint32_t frame_size;		// Pixel bytes per frame.
+	uint32_t slot_size;			// Frame header + pixels, 8 byte aligned.
+	uint32_t slot_count;
+	uint32_t reserved;
+	uint64_t write_count;		// Total number of frames written.
+} catcierge_record_header_t;
+
+typedef struct catcierge_record_frame_header_s
+{
+	uint64_t seq;				// Recording sequence number, 0 for an empty or half written slot.
+	uint64_t frame_seq;			// Camera frame sequence number.
+	double timestamp;			// Monotonic time in seconds.
+	int32_t state;				// catcierge_record_state_t
+	int32_t obstruct_sum;		// -1 if unknown.
+} catcierge_record_frame_header_t;
+
+typedef struct catcierge_record_map_s
+{
+	#ifdef _WIN32
+	HANDLE file;
+	HANDLE mapping;
+	#else
+	int fd;
+	#endif
+	unsigned char *data;
+	size_t size;
+} catcierge_record_map_t;
+
+typedef struct catcierge_recorder_s
+{
+	catcierge_record_map_t map;
+	catcierge_record_header_t *header;
+	IplImage *gray;				// Used when recording color frames.
+} catcierge_recorder_t;
+
+typedef struct catcierge_record_frame_s
+{
+	IplImage *img;
+	uint64_t seq;
+	uint64_t frame_seq;
+	double timestamp;
+	catcierge_record_state_t state;
+	int obstruct_sum;
+} catcierge_record_frame_t;
+
+typedef struct catcierge_record_reader_s
+{
+	catcierge_record_map_t map;
+	catcierge_record_header_t *header;
+	uint64_t first_seq;			// Oldest frame still in the ring.
+	uint64_t last_seq;			// Newest frame in the ring.
+	uint64_t next_seq;
+	IplImage *img;				// Header pointing into the mapped file.
+} catcierge_record_reader_t;
+
+int catcierge_recorder_open(catcierge_recorder_t *rec, const char *path,
+		size_t max_size, int width, int height);
+int catcierge_recorder_write(catcierge_recorder_t *rec, IplImage *img,
+		uint64_t frame_seq, double timestamp, catcierge_record_state_t state, int obstruct_sum);
+void catcierge_recorder_close(catcierge_recorder_t *rec);
+
+int catcierge_record_reader_open(catcierge_record_reader_t *reader, const char *path);
+int catcierge_record_reader_next(catcierge_record_reader_t *reader, catcierge_record_frame_t *frame);
+void catcierge_record_reader_rewind(catcierge_record_reader_t *reader);
+void catcierge_record_reader_close(catcierge_record_reader_t *reader);
+
+const char *catcierge_record_state_str(catcierge_record_state_t state);
+
+#endif // __CATCIERGE_RECORDER_H__
@@ -0,0 +1,518 @@
+//
+// This file is part of the Catcierge project.
+//
+// Copyright (c) Joakim Soderberg 2013-2014
+//
+//    Catcierge is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    Catcierge is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Catcierge.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+//
+// Frame sources that replay frames from disk instead of using the camera.
+// Used for benchmarking and soak testing the state machine.
+//
+#include <catcierge_config.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include "catcierge_platform.h"
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <dirent.h>
+#endif
+#include "catcierge_frame_source.h"
+#include "catcierge_recorder.h"
+#include "catcierge_util.h"
+#include "catcierge_log.h"
+
+//
+// Directory source.
+//
+typedef struct catcierge_dir_source_s
+{
+	char **paths;
+	size_t count;
+	size_t alloc_count;
+	size_t cur;
+	IplImage **imgs; // Only used when preloading.
+} catcierge_dir_source_t;
+
+static int catcierge_is_image_filename(const char *filename)
+{
+	size_t i;
+	const char *ext;
+	static const char *exts[] = { ".png", ".jpg", ".jpeg", ".bmp", ".pgm", ".ppm", ".tif", ".tiff" };
+
+	if (!(ext = strrchr(filename, '.')))
+		return 0;
+
+	for (i = 0; i < sizeof(exts) / sizeof(exts[0]); i++)
+	{
+		if (!strcasecmp(ext, exts[i]))
+			return 1;
+	}
+
+	return 0;
+}
+
+static int catcierge_dir_source_add(catcierge_dir_source_t *ds, const char *dir, const char *filename)
+{
+	char **tmp;
+	size_t len;
+
+	if (!catcierge_is_image_filename(filename))
+		return 0;
+
+	if (ds->count >= ds->alloc_count)
+	{
+		ds->alloc_count = ds->alloc_count ? (ds->alloc_count * 2) : 64;
+
+		if (!(tmp = realloc(ds->paths, ds->alloc_count * sizeof(char *))))
+		{
+			CATERR("Out of memory\n");
+			return -1;
+		}
+
+		ds->paths = tmp;
+	}
+
+	len = strlen(dir) + strlen(filename) + 2;
+
+	if (!(ds->paths[ds->count] = malloc(len)))
+	{
+		CATERR("Out of memory\n");
+		return -1;
+	}
+
+	snprintf(ds->paths[ds->count], len, "%s/%s", dir, filename);
+	ds->count++;
+
+	return 0;
+}
+
+static int catcierge_dir_source_list(catcierge_dir_source_t *ds, const char *dir)
+{
+	#ifdef _WIN32
+	char pattern[4096];
+	WIN32_FIND_DATAA fd;
+	HANDLE h;
+
+	snprintf(pattern, sizeof(pattern), "%s\\*", dir);
+
+	if ((h = FindFirstFileA(pattern, &fd)) == INVALID_HANDLE_VALUE)
+	{
+		CATERR("Failed to open directory \"%s\"\n", dir);
+		return -1;
+	}
+
+	do
+	{
+		if (fd.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+			continue;
+
+		if (catcierge_dir_source_add(ds, dir, fd.cFileName))
+		{
+			FindClose(h);
+			return -1;
+		}
+	} while (FindNextFileA(h, &fd));
+
+	FindClose(h);
+	#else
+	DIR *d;
+	struct dirent *de;
+
+	if (!(d = opendir(dir)))
+	{
+		CATERR("Failed to open directory \"%s\"\n", dir);
+		return -1;
+	}
+
+	while ((de = readdir(d)))
+	{
+		if (de->d_name[0] == '.')
+			continue;
+
+		if (catcierge_dir_source_add(ds, dir, de->d_name))
+		{
+			closedir(d);
+			return -1;
+		}
+	}
+
+	closedir(d);
+	#endif // _WIN32
+
+	return 0;
+}
+
+static int catcierge_path_cmp(const void *a, const void *b)
+{
+	return strcmp(*(const char **)a, *(const char **)b);
+}
+
+static void catcierge_dir_source_close(catcierge_frame_source_t *src)
+{
+	size_t i;
+	catcierge_dir_source_t *ds = (catcierge_dir_source_t *)src->ctx;
+
+	if (!ds)
+		return;
+
+	for (i = 0; i < ds->count; i++)
+	{
+		if (ds->imgs && ds->imgs[i])
+		{
+			cvReleaseImage(&ds->imgs[i]);
+		}
+
+		free(ds->paths[i]);
+	}
+
+	free(ds->imgs);
+	free(ds->paths);
+	free(ds);
+	src->ctx = NULL;
+}
+
+static int catcierge_dir_source_open(catcierge_frame_source_t *src)
+{
+	size_t i;
+	catcierge_dir_source_t *ds;
+	catcierge_frame_source_args_t *args = src->args;
+
+	if (!args->path)
+	{
+		CATERR("No --frame_source_path specified for dir frame source\n");
+		return -1;
+	}
+
+	if (!(ds = calloc(1, sizeof(catcierge_dir_source_t))))
+	{
+		CATERR("Out of memory\n");
+		return -1;
+	}
+
+	src->ctx = ds;
+
+	if (catcierge_dir_source_list(ds, args->path))
+		goto fail;
+
+	if (ds->count == 0)
+	{
+		CATERR("No images found in \"%s\"\n", args->path);
+		goto fail;
+	}
+
+	qsort(ds->paths, ds->count, sizeof(char *), catcierge_path_cmp);
+
+	if (args->preload)
+	{
+		if (!(ds->imgs = calloc(ds->count, sizeof(IplImage *))))
+		{
+			CATERR("Out of memory\n");
+			goto fail;
+		}
+
+		for (i = 0; i < ds->count; i++)
+		{
+			if (!(ds->imgs[i] = cvLoadImage(ds->paths[i], 0)))
+			{
+				CATERR("Failed to load image \"%s\"\n", ds->paths[i]);
+				goto fail;
+			}
+		}
+	}
+
+	CATLOG("Replaying %d images from \"%s\"\n", (int)ds->count, args->path);
+
+	return 0;
+
+fail:
+	catcierge_dir_source_close(src);
+	return -1;
+}
+
+static IplImage *catcierge_dir_source_next_frame(catcierge_frame_source_t *src)
+{
+	size_t tries;
+	IplImage *img = NULL;
+	catcierge_dir_source_t *ds = (catcierge_dir_source_t *)src->ctx;
+	assert(ds);
+
+	for (tries = 0; !img && (tries < ds->count); tries++)
+	{
+		if (ds->cur >= ds->count)
+		{
+			if (!src->args->loop)
+			{
+				src->eof = 1;
+				return NULL;
+			}
+
+			ds->cur = 0;
+		}
+
+		if (ds->imgs)
+		{
+			img = ds->imgs[ds->cur];
+		}
+		else if (!(img = cvLoadImage(ds->paths[ds->cur], 0)))
+		{
+			CATERR("Failed to load image \"%s\", skipping\n", ds->paths[ds->cur]);
+		}
+
+		ds->cur++;
+	}
+
+	return img;
+}
+
+static void catcierge_dir_source_release(catcierge_frame_source_t *src, IplImage *img)
+{
+	catcierge_dir_source_t *ds = (catcierge_dir_source_t *)src->ctx;
+	assert(ds);
+
+	// Preloaded images are kept until the source is closed.
+	if (!ds->imgs)
+	{
+		cvReleaseImage(&img);
+	}
+}
+
+void catcierge_dir_source_init(catcierge_frame_source_t *src)
+{
+	assert(src);
+
+	src->name = "dir";
+	src->open = catcierge_dir_source_open;
+	src->next_frame = catcierge_dir_source_next_frame;
+	src->release = catcierge_dir_source_release;
+	src->close = catcierge_dir_source_close;
+}
+
+//
+// Raw frame file source.
+// The file is simply a sequence of 8-bit frames of --frame_source_size
+// without any header, such as what "ffmpeg -f rawvideo -pix_fmt gray" outputs.
+//
+typedef struct catcierge_raw_source_s
+{
+	FILE *f;
+	IplImage *img; // Reused for every frame.
+} catcierge_raw_source_t;
+
+static void catcierge_raw_source_close(catcierge_frame_source_t *src)
+{
+	catcierge_raw_source_t *rs = (catcierge_raw_source_t *)src->ctx;
+
+	if (!rs)
+		return;
+
+	if (rs->f)
+	{
+		fclose(rs->f);
+	}
+
+	if (rs->img)
+	{
+		cvReleaseImage(&rs->img);
+	}
+
+	free(rs);
+	src->ctx = NULL;
+}
+
+static int catcierge_raw_source_open(catcierge_frame_source_t *src)
+{
+	catcierge_raw_source_t *rs;
+	catcierge_frame_source_args_t *args = src->args;
+
+	if (!args->path)
+	{
+		CATERR("No --frame_source_path specified for raw frame source\n");
+		return -1;
+	}
+
+	if (!(rs = calloc(1, sizeof(catcierge_raw_source_t))))
+	{
+		CATERR("Out of memory\n");
+		return -1;
+	}
+
+	src->ctx = rs;
+
+	if (!(rs->f = fopen(args->path, "rb")))
+	{
+		CATERR("Failed to open raw frame file \"%s\"\n", args->path);
+		goto fail;
+	}
+
+	if (!(rs->img = cvCreateImage(cvSize(args->width, args->height), IPL_DEPTH_8U, args->channels)))
+	{
+		CATERR("Out of memory\n");
+		goto fail;
+	}
+
+	CATLOG("Replaying %dx%dx%d raw frames from \"%s\"\n",
+		args->width, args->height, args->channels, args->path);
+
+	return 0;
+
+fail:
+	catcierge_raw_source_close(src);
+	return -1;
+}
+
+static int catcierge_raw_source_read(catcierge_raw_source_t *rs)
+{
+	int y;
+	size_t row_size = (size_t)(rs->img->width * rs->img->nChannels);
+
+	// Rows in an IplImage might be padded.
+	if ((size_t)rs->img->widthStep == row_size)
+	{
+		return (fread(rs->img->imageData, row_size * rs->img->height, 1, rs->f) == 1) ? 0 : -1;
+	}
+
+	for (y = 0; y < rs->img->height; y++)
+	{
+		if (fread(rs->img->imageData + y * rs->img->widthStep, row_size, 1, rs->f) != 1)
+		{
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+static IplImage *catcierge_raw_source_next_frame(catcierge_frame_source_t *src)
+{
+	catcierge_raw_source_t *rs = (catcierge_raw_source_t *)src->ctx;
+	assert(rs);
+
+	if (!catcierge_raw_source_read(rs))
+	{
+		return rs->img;
+	}
+
+	// A partial frame at the end of the file is ignored.
+	if (src->args->loop && (src->frame_count > 0))
+	{
+		rewind(rs->f);
+
+		if (!catcierge_raw_source_read(rs))
+		{
+			return rs->img;
+		}
+	}
+
+	src->eof = 1;
+	return NULL;
+}
+
+void catcierge_raw_source_init(catcierge_frame_source_t *src)
+{
+	assert(src);
+
+	src->name = "raw";
+	src->open = catcierge_raw_source_open;
+	src->next_frame = catcierge_raw_source_next_frame;
+	src->release = NULL; // The same image is reused for each frame.
+	src->close = catcierge_raw_source_close;
+}
+
+//
+// Recording source, replays a ring file written by the recorder.
+// The frames are used straight from the mapped file without copying.
+//
+static void catcierge_rec_source_close(catcierge_frame_source_t *src)
+{
+	catcierge_record_reader_t *reader = (catcierge_record_reader_t *)src->ctx;
+
+	if (!reader)
+		return;
+
+	catcierge_record_reader_close(reader);
+	free(reader);
+	src->ctx = NULL;
+}
+
+static int catcierge_rec_source_open(catcierge_frame_source_t *src)
+{
+	catcierge_record_reader_t *reader;
+	catcierge_frame_source_args_t *args = src->args;
+
+	if (!args->path)
+	{
+		CATERR("No --frame_source_path specified for rec frame source\n");
+		return -1;
+	}
+
+	if (!(reader = calloc(1, sizeof(catcierge_record_reader_t))))
+	{
+		CATERR("Out of memory\n");
+		return -1;
+	}
+
+	if (catcierge_record_reader_open(reader, args->path))
+	{
+		free(reader);
+		return -1;
+	}
+
+	src->ctx = reader;
+
+	CATLOG("Replaying %lu recorded frames from \"%s\"\n",
+		(unsigned long)(reader->last_seq - reader->first_seq + 1), args->path);
+
+	return 0;
+}
+
+static IplImage *catcierge_rec_source_next_frame(catcierge_frame_source_t *src)
+{
+	catcierge_record_frame_t frame;
+	catcierge_record_reader_t *reader = (catcierge_record_reader_t *)src->ctx;
+	assert(reader);
+
+	if (!catcierge_record_reader_next(reader, &frame))
+	{
+		return frame.img;
+	}
+
+	if (src->args->loop && (src->frame_count > 0))
+	{
+		catcierge_record_reader_rewind(reader);
+
+		if (!catcierge_record_reader_next(reader, &frame))
+		{
+			return frame.img;
+		}
+	}
+
+	src->eof = 1;
+	return NULL;
+}
+
+void catcierge_rec_source_init(catcierge_frame_source_t *src)
+{
+	assert(src);
+
+	src->name = "rec";
+	src->open = catcierge_rec_source_open;
+	src->next_frame = catcierge_rec_source_next_frame;
+	src->release = NULL; // Frames point into the mapped file.
+	src->close = catcierge_rec_source_close;
+}
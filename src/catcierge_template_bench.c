@@ -0,0 +1,186 @@
+//
+// This file is part of the Catcierge project.
+//
+// Copyright (c) Joakim Soderberg 2013-2014
+//
+//    Catcierge is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    Catcierge is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Catcierge.  If not, see <http://www.gnu.org/licenses/>.
+//
+
+//
+// Microbenchmark comparing the template matching methods for
+// an increasing number of snouts.
+//
+#include <opencv2/imgproc/imgproc_c.h>
+#include <opencv2/highgui/highgui_c.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "catcierge_frame_ctx.h"
+#include "catcierge_template_matcher.h"
+#include "catcierge_timer.h"
+
+#define DEFAULT_ITERATIONS 50
+
+static int run_bench(catcierge_template_matcher_args_t *args,
+		IplImage *img, int iterations, double *time, double *res)
+{
+	int i;
+	double start;
+	catcierge_matcher_t *matcher = NULL;
+	catcierge_frame_ctx_t frame;
+	match_result_t result;
+
+	memset(&result, 0, sizeof(result));
+	catcierge_frame_ctx_init(&frame);
+
+	if (catcierge_template_matcher_init(&matcher, (catcierge_matcher_args_t *)args))
+	{
+		return -1;
+	}
+
+	// Warm up, the first frame sets up the frame context planes.
+	catcierge_frame_ctx_set(&frame, img);
+	matcher->match(matcher, &frame, &result, 0);
+
+	start = catcierge_timer_now();
+
+	for (i = 0; i < iterations; i++)
+	{
+		catcierge_frame_ctx_set(&frame, img);
+		*res = matcher->match(matcher, &frame, &result, 0);
+	}
+
+	*time = (catcierge_timer_now() - start) / iterations;
+
+	catcierge_frame_ctx_destroy(&frame);
+	catcierge_matcher_destroy(&matcher);
+
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	int i;
+	int count;
+	int workers = 1;
+	int iterations = DEFAULT_ITERATIONS;
+	const char *snouts[MAX_SNOUT_COUNT];
+	int snout_count = 0;
+	const char *image_path = NULL;
+	IplImage *img = NULL;
+	catcierge_template_matcher_args_t args;
+	double spatial_time;
+	double spatial_res;
+	double fft_time;
+	double fft_res;
+	double binary_time;
+	double binary_res;
+
+	for (i = 1; i < argc; i++)
+	{
+		if (!strcmp(argv[i], "--iterations") && ((i + 1) < argc))
+		{
+			iterations = atoi(argv[++i]);
+		}
+		else if (!strcmp(argv[i], "--image") && ((i + 1) < argc))
+		{
+			image_path = argv[++i];
+		}
+		else if (!strcmp(argv[i], "--snout") && ((i + 1) < argc) && (snout_count < MAX_SNOUT_COUNT))
+		{
+			snouts[snout_count++] = argv[++i];
+		}
+		else if (!strcmp(argv[i], "--match_workers") && ((i + 1) < argc))
+		{
+			workers = atoi(argv[++i]);
+		}
+		else
+		{
+			fprintf(stderr, "Usage: %s --image <path> --snout <path> [--snout <path> ...]\n"
+							"          [--iterations <count>] [--match_workers <count>]\n", argv[0]);
+			return -1;
+		}
+	}
+
+	if (!image_path || (snout_count == 0))
+	{
+		fprintf(stderr, "An image and at least one snout is needed\n");
+		return -1;
+	}
+
+	if (iterations <= 0)
+	{
+		fprintf(stderr, "Iterations must be > 0\n");
+		return -1;
+	}
+
+	if (!(img = cvLoadImage(image_path, CV_LOAD_IMAGE_GRAYSCALE)))
+	{
+		fprintf(stderr, "Failed to load image %s\n", image_path);
+		return -1;
+	}
+
+	printf("Template match microbenchmark, %dx%d image, %d iterations, %d workers, popcount SIMD: %s\n\n",
+		img->width, img->height, iterations, workers, catcierge_binary_simd_str());
+
+	// The given snouts are repeated to get the higher snout counts.
+	for (count = 1; count <= MAX_SNOUT_COUNT; count = (count < 4) ? (count + 1) : (count * 2))
+	{
+		catcierge_template_matcher_args_init(&args);
+		args.match_workers = workers;
+		args.match_both = 1;
+		args.snout_count = count;
+
+		for (i = 0; i < count; i++)
+		{
+			args.snout_paths[i] = snouts[i % snout_count];
+		}
+
+		args.method = TEMPLATE_METHOD_SPATIAL;
+
+		if (run_bench(&args, img, iterations, &spatial_time, &spatial_res))
+		{
+			fprintf(stderr, "Failed to init spatial template matcher\n");
+			break;
+		}
+
+		args.method = TEMPLATE_METHOD_FFT;
+
+		if (run_bench(&args, img, iterations, &fft_time, &fft_res))
+		{
+			fprintf(stderr, "Failed to init FFT template matcher\n");
+			break;
+		}
+
+		args.method = TEMPLATE_METHOD_BINARY;
+
+		if (run_bench(&args, img, iterations, &binary_time, &binary_res))
+		{
+			fprintf(stderr, "Failed to init binary template matcher\n");
+			break;
+		}
+
+		printf("%2d snouts  spatial %8.3f ms  fft %8.3f ms (%5.2fx)  binary %8.3f ms (%5.2fx)  result %f%s\n",
+			count, spatial_time * 1000.0,
+			fft_time * 1000.0, spatial_time / fft_time,
+			binary_time * 1000.0, spatial_time / binary_time, spatial_res,
+			((fabs(spatial_res - fft_res) > 0.0001) || (fabs(spatial_res - binary_res) > 0.0001))
+			? "  MISMATCH" : "");
+	}
+
+	cvReleaseImage(&img);
+
+	return 0;
+}
@@ -21,6 +21,8 @@
 #include <opencv2/imgproc/imgproc_c.h>
 #include <opencv2/highgui/highgui_c.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <assert.h>
 #ifdef _WIN32
 #include <io.h>
@@ -81,6 +83,457 @@ static int _catcierge_prepare_img(catcierge_template_matcher_t *ctx, const IplIm
 	return 0;
 }
 
+static void catcierge_template_scratch_destroy(catcierge_template_scratch_t *scratch)
+{
+	size_t i;
+	assert(scratch);
+
+	if (scratch->matchres)
+	{
+		for (i = 0; i < scratch->count; i++)
+		{
+			if (scratch->matchres[i])
+				cvReleaseImageHeader(&scratch->matchres[i]);
+		}
+
+		free(scratch->matchres);
+		scratch->matchres = NULL;
+	}
+
+	free(scratch->data);
+	scratch->data = NULL;
+	scratch->size = 0;
+	scratch->count = 0;
+}
+
+static int catcierge_template_scratch_init(catcierge_template_scratch_t *scratch,
+		int width, int height, IplImage **snouts, size_t snout_count, size_t copies)
+{
+	size_t i;
+	size_t offset = 0;
+	CvSize snout_size;
+	CvSize matchres_size;
+	assert(scratch);
+
+	memset(scratch, 0, sizeof(catcierge_template_scratch_t));
+
+	if (!(scratch->matchres = (IplImage **)calloc(snout_count * copies, sizeof(IplImage *))))
+	{
+		fprintf(stderr, "Template matcher: Out of memory!\n");
+		return -1;
+	}
+
+	scratch->count = snout_count * copies;
+
+	// Create the headers first to know the total size.
+	for (i = 0; i < scratch->count; i++)
+	{
+		snout_size = cvGetSize(snouts[i % snout_count]);
+		matchres_size = cvSize(width  - snout_size.width + 1,
+							   height - snout_size.height + 1);
+
+		if ((matchres_size.width <= 0) || (matchres_size.height <= 0))
+		{
+			fprintf(stderr, "Snout image %dx%d is larger than the %dx%d match image\n",
+				snout_size.width, snout_size.height, width, height);
+			goto fail;
+		}
+
+		if (!(scratch->matchres[i] = cvCreateImageHeader(matchres_size, IPL_DEPTH_32F, 1)))
+			goto fail;
+
+		// Keep every buffer 16 byte aligned.
+		scratch->size += (scratch->matchres[i]->imageSize + 15) & ~15;
+	}
+
+	if (!(scratch->data = (char *)malloc(scratch->size)))
+	{
+		fprintf(stderr, "Template matcher: Out of memory!\n");
+		goto fail;
+	}
+
+	for (i = 0; i < scratch->count; i++)
+	{
+		cvSetData(scratch->matchres[i], scratch->data + offset, scratch->matchres[i]->widthStep);
+		offset += (scratch->matchres[i]->imageSize + 15) & ~15;
+	}
+
+	return 0;
+
+fail:
+	catcierge_template_scratch_destroy(scratch);
+	return -1;
+}
+
+//
+// Sets up the buffers for the coarse to fine search. Each snout is
+// matched against a match image downscaled by 2^pyramid first, and
+// only a small window around the best coarse matches is matched at
+// full resolution.
+//
+static int catcierge_template_pyramid_init(catcierge_template_matcher_t *ctx,
+		catcierge_template_res_t *res)
+{
+	size_t i;
+	CvSize coarse_size;
+	CvSize snout_size;
+	catcierge_template_job_t *job;
+	assert(ctx);
+	assert(res);
+
+	coarse_size = cvSize(res->width >> ctx->pyramid, res->height >> ctx->pyramid);
+
+	if (!(res->coarse_img = cvCreateImage(coarse_size, IPL_DEPTH_8U, 1)))
+	{
+		fprintf(stderr, "Template matcher: Out of memory!\n");
+		return -1;
+	}
+
+	for (i = 0; i < (2 * ctx->snout_count); i++)
+	{
+		job = &res->jobs[i];
+		snout_size = cvSize(job->snout->width >> ctx->pyramid, job->snout->height >> ctx->pyramid);
+
+		if ((snout_size.width < CATCIERGE_PYRAMID_MIN_SNOUT)
+		 || (snout_size.height < CATCIERGE_PYRAMID_MIN_SNOUT))
+		{
+			fprintf(stderr, "Snout image %dx%d is too small for --template_pyramid %d\n",
+				job->snout->width, job->snout->height, ctx->pyramid);
+			return -1;
+		}
+
+		if (!(job->coarse_snout = cvCreateImage(snout_size, IPL_DEPTH_8U, 1))
+		 || !(job->coarse_res = cvCreateImage(cvSize(coarse_size.width - snout_size.width + 1,
+				coarse_size.height - snout_size.height + 1), IPL_DEPTH_32F, 1)))
+		{
+			fprintf(stderr, "Template matcher: Out of memory!\n");
+			return -1;
+		}
+
+		cvResize(job->snout, job->coarse_snout, CV_INTER_AREA);
+	}
+
+	return 0;
+}
+
+static void catcierge_template_pyramid_destroy(catcierge_template_matcher_t *ctx,
+		catcierge_template_res_t *res)
+{
+	size_t i;
+	catcierge_template_job_t *job;
+	assert(ctx);
+	assert(res);
+
+	if (res->coarse_img)
+		cvReleaseImage(&res->coarse_img);
+
+	if (!res->jobs)
+		return;
+
+	for (i = 0; i < (2 * ctx->snout_count); i++)
+	{
+		job = &res->jobs[i];
+
+		if (job->coarse_snout) cvReleaseImage(&job->coarse_snout);
+		if (job->coarse_res) cvReleaseImage(&job->coarse_res);
+	}
+}
+
+//
+// Buffers for matching a snout against a window of the match image,
+// with up to radius pixels in each direction around a position.
+//
+static int catcierge_template_window_init(catcierge_template_matcher_t *ctx,
+		catcierge_template_res_t *res, int radius)
+{
+	size_t i;
+	catcierge_template_job_t *job;
+	assert(ctx);
+	assert(res);
+
+	res->window_radius = radius;
+
+	for (i = 0; i < (2 * ctx->snout_count); i++)
+	{
+		job = &res->jobs[i];
+
+		if (!(job->view = cvCreateImageHeader(cvSize(res->width, res->height), IPL_DEPTH_8U, 1))
+		 || !(job->window_res = cvCreateImage(cvSize(2 * radius + 1, 2 * radius + 1), IPL_DEPTH_32F, 1)))
+		{
+			fprintf(stderr, "Template matcher: Out of memory!\n");
+			return -1;
+		}
+
+		// Create the ROIs up front, changing them later doesn't allocate.
+		cvSetImageROI(job->view, cvRect(0, 0, res->width, res->height));
+		cvSetImageROI(job->window_res, cvRect(0, 0, 1, 1));
+	}
+
+	return 0;
+}
+
+static void catcierge_template_window_destroy(catcierge_template_matcher_t *ctx,
+		catcierge_template_res_t *res)
+{
+	size_t i;
+	catcierge_template_job_t *job;
+	assert(ctx);
+	assert(res);
+
+	if (!res->jobs)
+		return;
+
+	for (i = 0; i < (2 * ctx->snout_count); i++)
+	{
+		job = &res->jobs[i];
+
+		if (job->view) cvReleaseImageHeader(&job->view);
+		if (job->window_res) cvReleaseImage(&job->window_res);
+	}
+}
+
+static IplImage *catcierge_template_scale_snout(IplImage *snout, double scale)
+{
+	IplImage *scaled;
+	CvSize size = cvSize((int)(snout->width * scale + 0.5), (int)(snout->height * scale + 0.5));
+
+	if ((size.width == snout->width) && (size.height == snout->height))
+		return cvCloneImage(snout);
+
+	if ((size.width < 1) || (size.height < 1))
+	{
+		fprintf(stderr, "Snout image %dx%d is too small to scale by %0.2f\n",
+			snout->width, snout->height, scale);
+		return NULL;
+	}
+
+	if (!(scaled = cvCreateImage(size, IPL_DEPTH_8U, 1)))
+		return NULL;
+
+	cvResize(snout, scaled, (scale < 1.0) ? CV_INTER_AREA : CV_INTER_LINEAR);
+
+	// Keep it binary, the same as the match image.
+	cvThreshold(scaled, scaled, 127, 255, CV_THRESH_BINARY);
+
+	return scaled;
+}
+
+static void catcierge_template_res_destroy(catcierge_template_matcher_t *ctx,
+		catcierge_template_res_t **res)
+{
+	size_t i;
+	catcierge_template_res_t *r;
+	assert(ctx);
+	assert(res);
+
+	if (!(r = *res))
+		return;
+
+	catcierge_template_scratch_destroy(&r->scratch);
+	catcierge_template_pyramid_destroy(ctx, r);
+	catcierge_template_window_destroy(ctx, r);
+
+	if (r->jobs)
+	{
+		for (i = 0; i < (2 * ctx->snout_count); i++)
+		{
+			catcierge_fft_template_destroy(&r->jobs[i].fft);
+			catcierge_binary_template_destroy(&r->jobs[i].binary);
+		}
+
+		free(r->jobs);
+	}
+
+	catcierge_fft_frame_destroy(&r->fft);
+	catcierge_binary_frame_destroy(&r->binary);
+
+	if (r->snouts)
+	{
+		for (i = 0; i < (2 * ctx->snout_count); i++)
+		{
+			if (r->snouts[i])
+				cvReleaseImage(&r->snouts[i]);
+		}
+
+		free(r->snouts);
+	}
+
+	free(r);
+	*res = NULL;
+}
+
+//
+// Scales the snouts for matching at width x height, and sets up
+// all the buffers needed for that.
+//
+static catcierge_template_res_t *catcierge_template_res_create(
+		catcierge_template_matcher_t *ctx, int width, int height)
+{
+	size_t i;
+	size_t n = ctx->snout_count;
+	double sx = (double)width / CATCIERGE_DEFAULT_RESOLUTION_WIDTH;
+	double sy = (double)height / CATCIERGE_DEFUALT_RESOLUTION_HEIGHT;
+	double scale;
+	int radius;
+	catcierge_template_res_t *res = NULL;
+	assert(ctx);
+
+	if (!(res = (catcierge_template_res_t *)calloc(1, sizeof(catcierge_template_res_t)))
+	 || !(res->snouts = (IplImage **)calloc(2 * n, sizeof(IplImage *)))
+	 || !(res->jobs = (catcierge_template_job_t *)calloc(2 * n, sizeof(catcierge_template_job_t))))
+	{
+		fprintf(stderr, "Template matcher: Out of memory!\n");
+		goto fail;
+	}
+
+	res->width = width;
+	res->height = height;
+
+	// The same scale on both axes, so that the snouts keep their shape
+	// when the resolution is not 4:3. A wider (or taller) view fits
+	// more around the cat, not a bigger cat.
+	scale = (sx < sy) ? sx : sy;
+
+	for (i = 0; i < n; i++)
+	{
+		if (!(res->snouts[i] = catcierge_template_scale_snout(ctx->snouts[i], scale))
+		 || !(res->snouts[n + i] = catcierge_template_scale_snout(ctx->flipped_snouts[i], scale)))
+		{
+			fprintf(stderr, "Failed to scale snout image: %s\n", ctx->args->snout_paths[i]);
+			goto fail;
+		}
+	}
+
+	if (catcierge_template_scratch_init(&res->scratch,
+			width, height, res->snouts, n, ctx->match_both ? 2 : 1))
+	{
+		fprintf(stderr, "Failed to allocate template matcher buffers\n");
+		goto fail;
+	}
+
+	for (i = 0; i < n; i++)
+	{
+		res->jobs[i].snout = res->snouts[i];
+		res->jobs[i].matchres = res->scratch.matchres[i];
+		res->jobs[n + i].snout = res->snouts[n + i];
+		res->jobs[n + i].matchres = res->scratch.matchres[ctx->match_both ? (n + i) : i];
+	}
+
+	if (ctx->method == TEMPLATE_METHOD_FFT)
+	{
+		if (catcierge_fft_frame_init(&res->fft, width, height))
+		{
+			fprintf(stderr, "Failed to init FFT template matching\n");
+			goto fail;
+		}
+
+		// The snouts never change, so their spectra are only calculated once.
+		for (i = 0; i < (2 * n); i++)
+		{
+			if (catcierge_fft_template_init(&res->jobs[i].fft, &res->fft, res->jobs[i].snout))
+			{
+				fprintf(stderr, "Failed to prepare snout for FFT matching: %s\n",
+					ctx->args->snout_paths[i % n]);
+				goto fail;
+			}
+		}
+	}
+
+	if (ctx->method == TEMPLATE_METHOD_BINARY)
+	{
+		if (catcierge_binary_frame_init(&res->binary, width, height))
+		{
+			fprintf(stderr, "Failed to init binary template matching\n");
+			goto fail;
+		}
+
+		for (i = 0; i < (2 * n); i++)
+		{
+			if (catcierge_binary_template_init(&res->jobs[i].binary, &res->binary, res->jobs[i].snout))
+			{
+				fprintf(stderr, "Failed to prepare snout for binary matching: %s\n",
+					ctx->args->snout_paths[i % n]);
+				goto fail;
+			}
+		}
+	}
+
+	if (ctx->pyramid && catcierge_template_pyramid_init(ctx, res))
+	{
+		fprintf(stderr, "Failed to init pyramid template matching\n");
+		goto fail;
+	}
+
+	radius = (ctx->hint > (2 << ctx->pyramid)) ? ctx->hint : (2 << ctx->pyramid);
+
+	if ((ctx->pyramid || ctx->hint)
+		&& catcierge_template_window_init(ctx, res, radius))
+	{
+		fprintf(stderr, "Failed to init template matcher search windows\n");
+		goto fail;
+	}
+
+	return res;
+
+fail:
+	if (res)
+		catcierge_template_res_destroy(ctx, &res);
+
+	return NULL;
+}
+
+//
+// Gets the snouts and buffers for matching at width x height from
+// the cache, or creates them. The least recently used resolution
+// is thrown out when the cache is full.
+//
+static catcierge_template_res_t *catcierge_template_get_res(
+		catcierge_template_matcher_t *ctx, int width, int height)
+{
+	size_t i;
+	size_t slot = 0;
+	catcierge_template_res_t *res;
+	assert(ctx);
+
+	ctx->match_count++;
+
+	for (i = 0; i < CATCIERGE_TEMPLATE_RES_CACHE; i++)
+	{
+		res = ctx->res_cache[i];
+
+		if (res && (res->width == width) && (res->height == height))
+		{
+			res->last_used = ctx->match_count;
+			return res;
+		}
+
+		if (!res)
+		{
+			slot = i;
+		}
+		else if (ctx->res_cache[slot]
+			&& (res->last_used < ctx->res_cache[slot]->last_used))
+		{
+			slot = i;
+		}
+	}
+
+	catcierge_template_res_destroy(ctx, &ctx->res_cache[slot]);
+
+	if (!(res = catcierge_template_res_create(ctx, width, height)))
+	{
+		return NULL;
+	}
+
+	CATLOG("Template matcher: Scaled %d snouts for matching at %dx%d\n",
+		(int)ctx->snout_count, width, height);
+
+	res->last_used = ctx->match_count;
+	ctx->res_cache[slot] = res;
+
+	return res;
+}
+
 void catcierge_template_matcher_set_debug(catcierge_template_matcher_t *ctx, int debug)
 {
 	ctx->super.debug = debug;
@@ -91,7 +544,6 @@ int catcierge_template_matcher_init(catcierge_matcher_t **octx,
 {
 	int i;
 	CvSize snout_size;
-	CvSize matchres_size;
 	IplImage *snout_prep = NULL;
 	const char **snout_paths = NULL;
 	int snout_count;
@@ -122,9 +574,8 @@ int catcierge_template_matcher_init(catcierge_matcher_t **octx,
 	ctx->low_binary_thresh = CATCIERGE_LOW_BINARY_THRESH_DEFAULT;
 	ctx->high_binary_thresh = CATCIERGE_HIGH_BINARY_THRESH_DEFAULT;
 
-	// TODO: Make these setable instead.
-	ctx->width = CATCIERGE_DEFAULT_RESOLUTION_WIDTH;
-	ctx->height = CATCIERGE_DEFUALT_RESOLUTION_HEIGHT;
+	ctx->width = args->match_width;
+	ctx->height = args->match_height;
 
 	for (i = 0; i < snout_count; i++)
 	{
@@ -150,9 +601,8 @@ int catcierge_template_matcher_init(catcierge_matcher_t **octx,
 	// Load the snout images.
 	ctx->snouts = (IplImage **)calloc(snout_count, sizeof(IplImage *));
 	ctx->flipped_snouts = (IplImage **)calloc(snout_count, sizeof(IplImage *));
-	ctx->matchres = (IplImage **)calloc(snout_count, sizeof(IplImage *));
 
-	if (!ctx->snouts || !ctx->flipped_snouts || !ctx->matchres)
+	if (!ctx->snouts || !ctx->flipped_snouts)
 	{
 		fprintf(stderr, "Template matcher: Out of memory!\n");
 		return -1;
@@ -184,15 +634,55 @@ int catcierge_template_matcher_init(catcierge_matcher_t **octx,
 		ctx->flipped_snouts[i] = cvCloneImage(ctx->snouts[i]);
 		cvFlip(ctx->snouts[i], ctx->flipped_snouts[i], 1);
 
-		// Setup a matchres image for each snout
-		// (We can share these for normal and flipped snouts).
-		matchres_size = cvSize(ctx->width  - snout_size.width + 1, 
-							   ctx->height - snout_size.height + 1);
-		ctx->matchres[i] = cvCreateImage(matchres_size, IPL_DEPTH_32F, 1);
-
 		cvReleaseImage(&snout_prep);
 	}
 
+	if (catcierge_workers_init(&ctx->workers, args->match_workers))
+	{
+		fprintf(stderr, "Failed to start template matcher workers\n");
+		return -1;
+	}
+
+	// Matching both snout sets at once only makes sense in parallel.
+	ctx->match_both = args->match_both && (catcierge_workers_count(&ctx->workers) > 1);
+	ctx->method = args->method;
+	ctx->pyramid = args->pyramid;
+	ctx->hint = args->hint;
+
+	if (ctx->pyramid && (ctx->method != TEMPLATE_METHOD_SPATIAL))
+	{
+		fprintf(stderr, "--template_pyramid can only be used with --template_method spatial\n");
+		return -1;
+	}
+
+	// The hint window is always matched spatially, so the other
+	// methods would score the hint differently than a full search.
+	if (ctx->hint && (ctx->method != TEMPLATE_METHOD_SPATIAL))
+	{
+		fprintf(stderr, "--template_hint can only be used with --template_method spatial\n");
+		return -1;
+	}
+
+	if (ctx->width && ctx->height)
+	{
+		if (!(ctx->work_gray = cvCreateImage(cvSize(ctx->width, ctx->height), IPL_DEPTH_8U, 1))
+		 || !(ctx->work_img = cvCreateImage(cvSize(ctx->width, ctx->height), IPL_DEPTH_8U, 1)))
+		{
+			fprintf(stderr, "Template matcher: Out of memory!\n");
+			return -1;
+		}
+	}
+
+	// Prepare the resolution we expect to match at up front, so that
+	// any problems show up right away. Other capture resolutions
+	// are prepared when the first frame arrives.
+	if (!catcierge_template_get_res(ctx,
+			ctx->width ? ctx->width : CATCIERGE_DEFAULT_RESOLUTION_WIDTH,
+			ctx->height ? ctx->height : CATCIERGE_DEFUALT_RESOLUTION_HEIGHT))
+	{
+		return -1;
+	}
+
 	ctx->super.match = catcierge_template_matcher_match;
 	ctx->super.decide = caticerge_template_matcher_decide;
 	ctx->super.translate = catcierge_template_matcher_translate;
@@ -246,17 +736,17 @@ void catcierge_template_matcher_destroy(catcierge_matcher_t **octx)
 		ctx->kernel = NULL;
 	}
 
-	if (ctx->matchres)
-	{
-		for (i = 0; i < ctx->snout_count; i++)
-		{
-			cvReleaseImage(&ctx->matchres[i]);
-		}
+	// Stop the workers before freeing anything they use.
+	catcierge_workers_destroy(&ctx->workers);
 
-		free(ctx->matchres);
-		ctx->matchres = NULL;
+	for (i = 0; i < CATCIERGE_TEMPLATE_RES_CACHE; i++)
+	{
+		catcierge_template_res_destroy(ctx, &ctx->res_cache[i]);
 	}
 
+	if (ctx->work_gray) cvReleaseImage(&ctx->work_gray);
+	if (ctx->work_img) cvReleaseImage(&ctx->work_img);
+
 	free(*octx);
 	*octx = NULL;
 }
@@ -266,80 +756,335 @@ int caticerge_template_matcher_decide(void *ctx, match_group_t *mg)
 	return mg->success;
 }
 
-double catcierge_template_matcher_match(void *octx,
-						IplImage *img, match_result_t *result, int save_steps)
+//
+// Matches a snout against the positions up to radius pixels away
+// from x, y only. Gives the same scores as a full search for those.
+//
+static void catcierge_template_match_window(catcierge_template_matcher_t *ctx,
+		catcierge_template_job_t *job, int x, int y, int radius,
+		double *max_val, CvPoint *max_loc)
 {
-	IplImage *img_cpy = NULL;
-	IplImage *img_prep = NULL;
+	int x0 = x - radius;
+	int y0 = y - radius;
+	int x1 = x + radius;
+	int y1 = y + radius;
+	int max_x = ctx->res->width - job->snout->width;
+	int max_y = ctx->res->height - job->snout->height;
+	double min_val;
 	CvPoint min_loc;
-	CvPoint max_loc;
-	CvSize img_size;
-	CvSize snout_size;
+	assert(radius <= ctx->res->window_radius);
+
+	x0 = (x0 < 0) ? 0 : ((x0 > max_x) ? max_x : x0);
+	y0 = (y0 < 0) ? 0 : ((y0 > max_y) ? max_y : y0);
+	x1 = (x1 < 0) ? 0 : ((x1 > max_x) ? max_x : x1);
+	y1 = (y1 < 0) ? 0 : ((y1 > max_y) ? max_y : y1);
+
+	cvSetImageROI(job->view, cvRect(x0, y0,
+		x1 - x0 + job->snout->width, y1 - y0 + job->snout->height));
+	cvSetImageROI(job->window_res, cvRect(0, 0, x1 - x0 + 1, y1 - y0 + 1));
+	cvMatchTemplate(job->view, job->snout, job->window_res, CV_TM_CCOEFF_NORMED);
+	cvMinMaxLoc(job->window_res, &min_val, max_val, &min_loc, max_loc, NULL);
+
+	max_loc->x += x0;
+	max_loc->y += y0;
+}
+
+//
+// Coarse to fine search for a single snout. The scores are calculated
+// at full resolution the same way as a full search does, but only
+// in a window around the best coarse matches. So the result is the
+// same unless the best full resolution match is missed by the coarse
+// search.
+//
+static void catcierge_template_pyramid_job(catcierge_template_matcher_t *ctx,
+		catcierge_template_job_t *job)
+{
+	int i;
+	int x;
+	int y;
+	int scale = 1 << ctx->pyramid;
+	double min_val;
+	double coarse_val;
+	double val;
+	CvPoint min_loc;
+	CvPoint loc;
+	CvPoint val_loc;
+	float *row;
+
+	cvMatchTemplate(ctx->res->coarse_img, job->coarse_snout, job->coarse_res, CV_TM_CCOEFF_NORMED);
+
+	job->max_val = -1.0;
+	job->max_loc = cvPoint(0, 0);
+
+	for (i = 0; i < CATCIERGE_PYRAMID_CANDIDATES; i++)
+	{
+		cvMinMaxLoc(job->coarse_res, &min_val, &coarse_val, &min_loc, &loc, NULL);
+
+		// All candidates used up.
+		if (coarse_val < -1.5)
+			break;
+
+		// Full resolution match positions around the candidate.
+		catcierge_template_match_window(ctx, job,
+			loc.x * scale, loc.y * scale, 2 * scale, &val, &val_loc);
+
+		if (val > job->max_val)
+		{
+			job->max_val = val;
+			job->max_loc = val_loc;
+		}
+
+		// Suppress the coarse neighbourhood so the next candidate is
+		// somewhere else. Scores are never below -1.
+		for (y = loc.y - 2; y <= loc.y + 2; y++)
+		{
+			if ((y < 0) || (y >= job->coarse_res->height))
+				continue;
+
+			row = (float *)(job->coarse_res->imageData + y * job->coarse_res->widthStep);
+
+			for (x = loc.x - 2; x <= loc.x + 2; x++)
+			{
+				if ((x >= 0) && (x < job->coarse_res->width))
+					row[x] = -2.0f;
+			}
+		}
+	}
+}
+
+//
+// Job i matches snout i, and job snout_count + i flipped snout i.
+// Each job has its own result buffer and output, so the jobs can
+// run on any thread in any order.
+//
+static void catcierge_template_matcher_job(void *user, size_t i)
+{
 	double min_val;
-	double max_val;
+	CvPoint min_loc;
+	catcierge_template_matcher_t *ctx = (catcierge_template_matcher_t *)user;
+	catcierge_template_job_t *job = &ctx->res->jobs[i];
+
+	// Try to match the snout with the image.
+	// If we find it, the max_val should be close to 1.0
+	if (ctx->method == TEMPLATE_METHOD_FFT)
+	{
+		if (catcierge_fft_match(&ctx->res->fft, &job->fft, job->matchres))
+		{
+			job->max_val = 0.0;
+			job->max_loc = cvPoint(0, 0);
+			return;
+		}
+	}
+	else if (ctx->method == TEMPLATE_METHOD_BINARY)
+	{
+		if (catcierge_binary_match(&ctx->res->binary, &job->binary, job->matchres))
+		{
+			job->max_val = 0.0;
+			job->max_loc = cvPoint(0, 0);
+			return;
+		}
+	}
+	else if (ctx->pyramid)
+	{
+		catcierge_template_pyramid_job(ctx, job);
+		return;
+	}
+	else
+	{
+		cvMatchTemplate(ctx->match_img, job->snout, job->matchres, CV_TM_CCOEFF_NORMED);
+	}
+
+	cvMinMaxLoc(job->matchres, &min_val, &job->max_val, &min_loc, &job->max_loc, NULL);
+}
+
+//
+// Only searches around where the snout was found in the previous frame.
+//
+static void catcierge_template_matcher_hint_job(void *user, size_t i)
+{
+	catcierge_template_matcher_t *ctx = (catcierge_template_matcher_t *)user;
+	catcierge_template_job_t *job = &ctx->res->jobs[i];
+	const CvRect *hint = &ctx->hint_rects[i % ctx->snout_count];
+
+	catcierge_template_match_window(ctx, job, hint->x, hint->y, ctx->hint,
+		&job->max_val, &job->max_loc);
+}
+
+static void catcierge_template_matcher_run_jobs(catcierge_template_matcher_t *ctx,
+		size_t first, size_t count)
+{
+	catcierge_workers_run(&ctx->workers, catcierge_template_matcher_job, ctx, first, count);
+}
+
+//
+// Averages the results of one snout set in snout order, so that
+// the result is the same no matter how the jobs were run.
+//
+static double catcierge_template_matcher_reduce(catcierge_template_matcher_t *ctx,
+		size_t first, match_result_t *result)
+{
+	size_t i;
+	CvSize snout_size;
 	double match_sum = 0.0;
+	catcierge_template_job_t *job;
+
+	for (i = 0; i < ctx->snout_count; i++)
+	{
+		job = &ctx->res->jobs[first + i];
+
+		// This is only used for returning match_rect.
+		snout_size = cvGetSize(job->snout);
+
+		if (ctx->super.debug)
+		{
+			cvShowImage("Match image", ctx->match_img);
+			cvShowImage("Match template", ctx->pyramid ? job->coarse_res : job->matchres);
+		}
+
+		match_sum += job->max_val;
+
+		if (i < result->rect_count)
+		{
+			result->match_rects[i] = cvRect(job->max_loc.x, job->max_loc.y,
+				snout_size.width, snout_size.height);
+		}
+	}
+
+	return match_sum / ctx->snout_count;
+}
+
+double catcierge_template_matcher_match(void *octx,
+						catcierge_frame_ctx_t *frame, match_result_t *result, int save_steps)
+{
+	IplImage *img_cpy = NULL;
+	CvSize img_size;
+	CvSize match_size;
 	double match_avg = 0.0;
+	double sx;
+	double sy;
+	int both;
 	size_t i;
+	size_t first;
+	catcierge_template_res_t *res;
 	catcierge_template_matcher_t *ctx = (catcierge_template_matcher_t *)octx;
 	assert(ctx);
-	assert(img);
+	assert(frame);
+	assert(frame->img);
 
-	img_size = cvGetSize(img);
+	img_size = cvGetSize(frame->img);
 	result->result = -1.0;
 	result->rect_count = ctx->args->snout_count;
 	result->description[0] = '\0';
+	result->hint_hit = 0;
+	result->hint_miss = 0;
+
+	match_size = ctx->width ? cvSize(ctx->width, ctx->height) : img_size;
 
-	if ((img_size.width != ctx->width)
-	 || (img_size.height != ctx->height))
+	if (!(res = catcierge_template_get_res(ctx, match_size.width, match_size.height)))
 	{
-		fprintf(stderr, "Match image must have size %dx%d\n", ctx->width, ctx->height);
+		fprintf(stderr, "Failed to prepare the snouts for matching at %dx%d\n",
+			match_size.width, match_size.height);
 		return result->result;
 	}
 
-	img_cpy = cvCreateImage(img_size, 8, 1);
+	ctx->res = res;
 
-	if (!(img_prep = cvCloneImage(img)))
+	if ((match_size.width == img_size.width) && (match_size.height == img_size.height))
 	{
-		fprintf(stderr, "Failed to clone match image\n");
-		return result->result;
+		// The same threshold as _catcierge_prepare_img uses for the snouts.
+		img_cpy = catcierge_frame_ctx_threshold(frame,
+			ctx->low_binary_thresh, ctx->high_binary_thresh);
+	}
+	else if ((img_cpy = catcierge_frame_ctx_gray(frame)))
+	{
+		cvResize(img_cpy, ctx->work_gray, CV_INTER_AREA);
+		cvThreshold(ctx->work_gray, ctx->work_img,
+					ctx->low_binary_thresh,
+					ctx->high_binary_thresh,
+					CV_THRESH_BINARY);
+		img_cpy = ctx->work_img;
 	}
 
-	if (_catcierge_prepare_img(ctx, img_prep, img_cpy))
+	if (!img_cpy)
 	{
 		fprintf(stderr, "Failed to prepare match image\n");
-		cvReleaseImage(&img_cpy);
-		cvReleaseImage(&img_prep);
 		return result->result;
 	}
 
 	result->direction = MATCH_DIR_UNKNOWN;
+	ctx->match_img = img_cpy;
 
-	// First check normal facing snouts.
-	for (i = 0; i < ctx->snout_count; i++)
+	// Match rects are given in capture coordinates.
+	sx = (double)img_size.width / match_size.width;
+	sy = (double)img_size.height / match_size.height;
+
+	// Transform the frame once for all the snouts.
+	if ((ctx->method == TEMPLATE_METHOD_FFT)
+		&& catcierge_fft_frame_set(&res->fft, img_cpy))
 	{
-		// This is only used for returning match_rect.
-		snout_size = cvGetSize(ctx->snouts[i]);
+		fprintf(stderr, "Failed to transform match image\n");
+		return result->result;
+	}
 
-		// Try to match the snout with the image.
-		// If we find it, the max_val should be close to 1.0
-		cvMatchTemplate(img_cpy, ctx->snouts[i], ctx->matchres[i], CV_TM_CCOEFF_NORMED);
-		cvMinMaxLoc(ctx->matchres[i], &min_val, &max_val, &min_loc, &max_loc, NULL);
+	// Pack the frame once for all the snouts.
+	if ((ctx->method == TEMPLATE_METHOD_BINARY)
+		&& catcierge_binary_frame_set(&res->binary, img_cpy))
+	{
+		fprintf(stderr, "Failed to pack match image\n");
+		return result->result;
+	}
 
-		if (ctx->super.debug)
+	if (ctx->pyramid)
+	{
+		cvResize(img_cpy, res->coarse_img, CV_INTER_AREA);
+	}
+
+	if (res->window_radius)
+	{
+		for (i = 0; i < (2 * ctx->snout_count); i++)
+		{
+			cvSetData(res->jobs[i].view, img_cpy->imageData, img_cpy->widthStep);
+		}
+	}
+
+	// Try the hint first, the snout has usually not moved much since
+	// the previous frame of the match group.
+	if (ctx->hint && (result->hint_count == ctx->snout_count)
+		&& ((result->hint_direction == MATCH_DIR_IN)
+		 || ((result->hint_direction == MATCH_DIR_OUT) && ctx->match_flipped)))
+	{
+		first = (result->hint_direction == MATCH_DIR_OUT) ? ctx->snout_count : 0;
+
+		for (i = 0; i < ctx->snout_count; i++)
 		{
-			cvShowImage("Match image", img_cpy);
-			cvShowImage("Match template", ctx->matchres[i]);
+			ctx->hint_rects[i] = cvRect(
+				(int)(result->hint_rects[i].x / sx + 0.5),
+				(int)(result->hint_rects[i].y / sy + 0.5), 0, 0);
 		}
 
-		match_sum += max_val;
+		catcierge_workers_run(&ctx->workers, catcierge_template_matcher_hint_job,
+			ctx, first, ctx->snout_count);
+		match_avg = catcierge_template_matcher_reduce(ctx, first, result);
 
-		if (i < result->rect_count) 
+		if (match_avg >= ctx->match_threshold)
 		{
-			result->match_rects[i] = cvRect(max_loc.x, max_loc.y, snout_size.width, snout_size.height);
+			result->hint_hit = 1;
+			result->direction = result->hint_direction;
+			goto done;
 		}
+
+		// Not good enough, search everything.
+		result->hint_miss = 1;
 	}
 
-	match_avg = match_sum / ctx->snout_count;
+	// When matching both sets at once the flipped snouts are matched
+	// even if they turn out not to be needed. That costs CPU, but
+	// no extra latency.
+	both = ctx->match_flipped && ctx->flipped_snouts && ctx->match_both;
+
+	// First check normal facing snouts.
+	catcierge_template_matcher_run_jobs(ctx, 0, both ? (2 * ctx->snout_count) : ctx->snout_count);
+	match_avg = catcierge_template_matcher_reduce(ctx, 0, result);
 
 	if (match_avg >= ctx->match_threshold)
 	{
@@ -348,23 +1093,12 @@ double catcierge_template_matcher_match(void *octx,
 	else if (ctx->match_flipped && ctx->flipped_snouts)
 	{
 		// If we fail the match, try the flipped snout as well.
-		match_sum = 0.0;
-
-		for (i = 0; i < ctx->snout_count; i++)
+		if (!both)
 		{
-			snout_size = cvGetSize(ctx->flipped_snouts[i]);
-			cvMatchTemplate(img_cpy, ctx->flipped_snouts[i], ctx->matchres[i], CV_TM_CCOEFF_NORMED);
-			cvMinMaxLoc(ctx->matchres[i], &min_val, &max_val, &min_loc, &max_loc, NULL);
-
-			match_sum += max_val;
-
-			if (i < result->rect_count) 
-			{
-				result->match_rects[i] = cvRect(max_loc.x, max_loc.y, snout_size.width, snout_size.height);
-			}
+			catcierge_template_matcher_run_jobs(ctx, ctx->snout_count, ctx->snout_count);
 		}
 
-		match_avg = match_sum / ctx->snout_count;
+		match_avg = catcierge_template_matcher_reduce(ctx, ctx->snout_count, result);
 
 		// Only qualify as OUT if it was a good match.
 		if (match_avg >= ctx->match_threshold)
@@ -373,8 +1107,18 @@ double catcierge_template_matcher_match(void *octx,
 		}
 	}
 
-	cvReleaseImage(&img_cpy);
-	cvReleaseImage(&img_prep);
+done:
+	if ((sx != 1.0) || (sy != 1.0))
+	{
+		for (i = 0; i < result->rect_count; i++)
+		{
+			result->match_rects[i] = cvRect(
+				(int)(result->match_rects[i].x * sx + 0.5),
+				(int)(result->match_rects[i].y * sy + 0.5),
+				(int)(result->match_rects[i].width * sx + 0.5),
+				(int)(result->match_rects[i].height * sy + 0.5));
+		}
+	}
 
 	result->result = match_avg;
 	result->success = (result->result >= ctx->args->match_threshold);
@@ -395,6 +1139,18 @@ double catcierge_template_matcher_match(void *octx,
 	return result->result;
 }
 
+const char *catcierge_template_method_str(catcierge_template_method_t method)
+{
+	switch (method)
+	{
+		case TEMPLATE_METHOD_SPATIAL: return "spatial";
+		case TEMPLATE_METHOD_FFT: return "fft";
+		case TEMPLATE_METHOD_BINARY: return "binary";
+	}
+
+	return "unknown";
+}
+
 void catcierge_template_matcher_usage()
 {
 	fprintf(stderr, " --snout <paths>        Path to the snout images to use. If more than \n");
@@ -403,6 +1159,41 @@ void catcierge_template_matcher_usage()
 	fprintf(stderr, "                        Default %.1f\n", DEFAULT_MATCH_THRESH);
 	fprintf(stderr, " --match_flipped <0|1>  Match a flipped version of the snout\n");
 	fprintf(stderr, "                        (don't consider going out a failed match). Default on.\n");
+	fprintf(stderr, " --match_workers <count>\n");
+	fprintf(stderr, "                        Number of threads used to match the snouts in parallel.\n");
+	fprintf(stderr, "                        0 means one per CPU. Default %d\n", DEFAULT_MATCH_WORKERS);
+	fprintf(stderr, " --template_method <spatial|fft|binary>\n");
+	fprintf(stderr, "                        How to correlate the snouts with the image. fft\n");
+	fprintf(stderr, "                        calculates the snout spectra once at startup and\n");
+	fprintf(stderr, "                        only transforms each frame once for all snouts,\n");
+	fprintf(stderr, "                        which is faster with many or large snouts.\n");
+	fprintf(stderr, "                        binary packs the thresholded images into bits and\n");
+	fprintf(stderr, "                        scores the snouts by counting bits (%s).\n",
+		catcierge_binary_simd_str());
+	fprintf(stderr, "                        All give the same scores. Default spatial.\n");
+	fprintf(stderr, " --template_pyramid <levels>\n");
+	fprintf(stderr, "                        Search for the snouts in an image downscaled by\n");
+	fprintf(stderr, "                        2^levels first, and only match a small window around\n");
+	fprintf(stderr, "                        the best matches at full resolution. Much faster, but\n");
+	fprintf(stderr, "                        can miss the best match. 0 to %d. Default %d (off)\n",
+		MAX_TEMPLATE_PYRAMID, DEFAULT_TEMPLATE_PYRAMID);
+	fprintf(stderr, " --template_hint <pixels>\n");
+	fprintf(stderr, "                        Within a match group, first only search this many\n");
+	fprintf(stderr, "                        pixels around where the snouts were found in the\n");
+	fprintf(stderr, "                        previous frame. Falls back to a full search if that\n");
+	fprintf(stderr, "                        is below the threshold. 0 to %d. Default %d (off)\n",
+		MAX_TEMPLATE_HINT, DEFAULT_TEMPLATE_HINT);
+	fprintf(stderr, "                        Only with --template_method spatial.\n");
+	fprintf(stderr, " --match_resolution <width>x<height>\n");
+	fprintf(stderr, "                        Scale the frames to this resolution before matching,\n");
+	fprintf(stderr, "                        so that a higher capture resolution can be used for\n");
+	fprintf(stderr, "                        the saved images without making matching slower.\n");
+	fprintf(stderr, "                        The snouts are made for %dx%d and are scaled to fit.\n",
+		CATCIERGE_DEFAULT_RESOLUTION_WIDTH, CATCIERGE_DEFUALT_RESOLUTION_HEIGHT);
+	fprintf(stderr, "                        Default is to match at the capture resolution.\n");
+	fprintf(stderr, " --match_both <0|1>     Match the normal and flipped snouts at the same time\n");
+	fprintf(stderr, "                        when using --match_workers, instead of only matching\n");
+	fprintf(stderr, "                        the flipped ones when the normal ones fail.\n");
 	fprintf(stderr, "\n");
 }
 
@@ -523,6 +1314,118 @@ int catcierge_template_matcher_parse_args(catcierge_template_matcher_args_t *arg
 		return 0;
 	}
 
+	if (!strcmp(key, "match_workers"))
+	{
+		if (value_count == 1)
+		{
+			args->match_workers = atoi(values[0]);
+
+			if (args->match_workers < 0)
+			{
+				fprintf(stderr, "--match_workers cannot be negative\n");
+				return -1;
+			}
+
+			return 0;
+		}
+
+		fprintf(stderr, "--match_workers missing value\n");
+		return -1;
+	}
+
+	if (!strcmp(key, "template_method"))
+	{
+		if (value_count == 1)
+		{
+			if (!strcmp(values[0], "spatial"))
+			{
+				args->method = TEMPLATE_METHOD_SPATIAL;
+				return 0;
+			}
+			else if (!strcmp(values[0], "fft"))
+			{
+				args->method = TEMPLATE_METHOD_FFT;
+				return 0;
+			}
+			else if (!strcmp(values[0], "binary"))
+			{
+				args->method = TEMPLATE_METHOD_BINARY;
+				return 0;
+			}
+
+			fprintf(stderr, "Invalid --template_method \"%s\", expected spatial, fft or binary\n", values[0]);
+			return -1;
+		}
+
+		fprintf(stderr, "--template_method missing value\n");
+		return -1;
+	}
+
+	if (!strcmp(key, "template_pyramid"))
+	{
+		if (value_count == 1)
+		{
+			args->pyramid = atoi(values[0]);
+
+			if ((args->pyramid < 0) || (args->pyramid > MAX_TEMPLATE_PYRAMID))
+			{
+				fprintf(stderr, "--template_pyramid must be between 0 and %d\n", MAX_TEMPLATE_PYRAMID);
+				return -1;
+			}
+
+			return 0;
+		}
+
+		fprintf(stderr, "--template_pyramid missing value\n");
+		return -1;
+	}
+
+	if (!strcmp(key, "template_hint"))
+	{
+		if (value_count == 1)
+		{
+			args->hint = atoi(values[0]);
+
+			if ((args->hint < 0) || (args->hint > MAX_TEMPLATE_HINT))
+			{
+				fprintf(stderr, "--template_hint must be between 0 and %d\n", MAX_TEMPLATE_HINT);
+				return -1;
+			}
+
+			return 0;
+		}
+
+		fprintf(stderr, "--template_hint missing value\n");
+		return -1;
+	}
+
+	if (!strcmp(key, "match_resolution"))
+	{
+		if (value_count == 1)
+		{
+			if ((sscanf(values[0], "%dx%d", &args->match_width, &args->match_height) != 2)
+				|| (args->match_width <= 0) || (args->match_height <= 0))
+			{
+				fprintf(stderr, "Invalid --match_resolution \"%s\", expected <width>x<height>\n", values[0]);
+				args->match_width = 0;
+				args->match_height = 0;
+				return -1;
+			}
+
+			return 0;
+		}
+
+		fprintf(stderr, "--match_resolution missing value\n");
+		return -1;
+	}
+
+	if (!strcmp(key, "match_both"))
+	{
+		args->match_both = 1;
+		if (value_count == 1) args->match_both = atoi(values[0]);
+		return 0;
+	}
+
 	return 1;
 }
 
@@ -539,6 +1442,15 @@ void catcierge_template_matcher_print_settings(catcierge_template_matcher_args_t
 	}
 	printf("  Match threshold: %.2f\n", args->match_threshold);
 	printf("    Match flipped: %d\n", args->match_flipped);
+	printf("    Match workers: %d\n", args->match_workers);
+	printf("       Match both: %d\n", args->match_both);
+	printf("  Template method: %s\n", catcierge_template_method_str(args->method));
+	printf(" Template pyramid: %d\n", args->pyramid);
+	printf("    Template hint: %d\n", args->hint);
+	if (args->match_width)
+		printf(" Match resolution: %dx%d\n", args->match_width, args->match_height);
+	else
+		printf(" Match resolution: capture\n");
 	printf("\n");
 }
 
@@ -548,6 +1460,9 @@ void catcierge_template_matcher_args_init(catcierge_template_matcher_args_t *arg
 	memset(args, 0, sizeof(catcierge_template_matcher_args_t));
 	args->match_threshold = DEFAULT_MATCH_THRESH;
 	args->match_flipped = 1;
+	args->match_workers = DEFAULT_MATCH_WORKERS;
+	args->pyramid = DEFAULT_TEMPLATE_PYRAMID;
+	args->hint = DEFAULT_TEMPLATE_HINT;
 	args->snout_count = 0;
 }
 
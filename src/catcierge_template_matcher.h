@@ -23,14 +23,34 @@
 #include <stdio.h>
 #include "catcierge_types.h"
 #include "catcierge_matcher.h"
+#include "catcierge_workers.h"
+#include "catcierge_fft_match.h"
+#include "catcierge_binary_match.h"
 
 #define CATCIERGE_LOW_BINARY_THRESH_DEFAULT 90
 #define CATCIERGE_HIGH_BINARY_THRESH_DEFAULT 255
 
+// The resolution the snout images are made for. They are
+// scaled when matching at other resolutions.
 #define CATCIERGE_DEFAULT_RESOLUTION_WIDTH 320
 #define CATCIERGE_DEFUALT_RESOLUTION_HEIGHT 240
+#define CATCIERGE_TEMPLATE_RES_CACHE 4	// Resolutions to keep scaled snouts for.
 #define DEFAULT_MATCH_THRESH 0.8	// The threshold signifying a good match returned by catcierge_match.
 #define MAX_SNOUT_COUNT 24
+#define DEFAULT_MATCH_WORKERS 1
+#define DEFAULT_TEMPLATE_PYRAMID 0
+#define MAX_TEMPLATE_PYRAMID 2
+#define CATCIERGE_PYRAMID_CANDIDATES 2	// Coarse matches refined at full resolution per snout.
+#define CATCIERGE_PYRAMID_MIN_SNOUT 4	// Smallest coarse snout size in pixels.
+#define DEFAULT_TEMPLATE_HINT 0
+#define MAX_TEMPLATE_HINT 64
+
+typedef enum catcierge_template_method_e
+{
+	TEMPLATE_METHOD_SPATIAL,	// cvMatchTemplate
+	TEMPLATE_METHOD_FFT,		// Precomputed snout spectra, see catcierge_fft_match.h
+	TEMPLATE_METHOD_BINARY		// Bit packed popcount, see catcierge_binary_match.h
+} catcierge_template_method_t;
 
 typedef struct catcierge_template_matcher_args_s
 {
@@ -39,19 +59,89 @@ typedef struct catcierge_template_matcher_args_s
 	size_t snout_count;
 	double match_threshold;
 	int match_flipped;
+	int match_workers;		// Threads used for matching the snouts, 0 for one per CPU.
+	int match_both;			// Match the normal and flipped snouts at the same time.
+	catcierge_template_method_t method;
+	int pyramid;			// Halve the resolution this many times for a coarse search.
+	int hint;				// Padding around the match rect hints to search first, 0 for off.
+	int match_width;		// Resolution to match at, 0 to match at the capture resolution.
+	int match_height;
 } catcierge_template_matcher_args_t;
 
+//
+// Buffers needed when matching a frame. These are allocated in
+// one block at init, sized from the resolution and the snouts,
+// so that matching does not need any heap allocations.
+//
+typedef struct catcierge_template_scratch_s
+{
+	char *data;
+	size_t size;
+	size_t count;
+	IplImage **matchres;	// Match result for each snout, and each flipped snout
+							// when they are matched at the same time.
+} catcierge_template_scratch_t;
+
+// Matching of a single snout against the match image.
+typedef struct catcierge_template_job_s
+{
+	IplImage *snout;
+	IplImage *matchres;
+	double max_val;
+	CvPoint max_loc;
+	catcierge_fft_template_t fft;	// Used with TEMPLATE_METHOD_FFT.
+	catcierge_binary_template_t binary; // Used with TEMPLATE_METHOD_BINARY.
+
+	// Used with a pyramid search.
+	IplImage *coarse_snout;
+	IplImage *coarse_res;
+
+	// Used when only searching part of the match image.
+	IplImage *view;			// Header for the match image, with the search window as ROI.
+	IplImage *window_res;
+} catcierge_template_job_t;
+
+//
+// Everything that depends on the resolution the snouts are matched
+// at. Created the first time a frame is matched at that resolution
+// and then kept in a small cache.
+//
+typedef struct catcierge_template_res_s
+{
+	int width;
+	int height;
+	IplImage **snouts;		// Snouts scaled to this resolution, normal followed by flipped.
+	catcierge_template_scratch_t scratch;
+	catcierge_template_job_t *jobs;	// Normal snouts followed by the flipped ones.
+	catcierge_fft_frame_t fft;	// Transform of the match image for TEMPLATE_METHOD_FFT.
+	catcierge_binary_frame_t binary; // Packed match image for TEMPLATE_METHOD_BINARY.
+	IplImage *coarse_img;	// Downscaled match image for the pyramid search.
+	int window_radius;		// Largest search window, 0 if there are none.
+	unsigned long last_used;
+} catcierge_template_res_t;
+
 typedef struct catcierge_template_matcher_s
 {
 	catcierge_matcher_t super;
 	CvMemStorage *storage;
-	int width;
+	int width;				// Resolution to match at, 0 for the capture resolution.
 	int height;
-	IplImage **snouts;
+	IplImage **snouts;		// As loaded, for CATCIERGE_DEFAULT_RESOLUTION_WIDTH/HEIGHT.
 	size_t snout_count;
 	IplImage **flipped_snouts;
 	IplConvKernel *kernel;
-	IplImage **matchres;
+	catcierge_template_res_t *res_cache[CATCIERGE_TEMPLATE_RES_CACHE];
+	catcierge_template_res_t *res;	// Resolution of the frame being matched.
+	unsigned long match_count;
+	IplImage *work_gray;	// Frame scaled to the match resolution.
+	IplImage *work_img;
+	catcierge_workers_t workers;
+	IplImage *match_img;	// Image the jobs are matched against.
+	int match_both;
+	catcierge_template_method_t method;
+	int pyramid;
+	int hint;
+	CvRect hint_rects[MAX_MATCH_RECTS];	// Hints of the frame being matched, at the match resolution.
 
 	int match_flipped;
 	double match_threshold;
@@ -72,11 +162,13 @@ void catcierge_template_matcher_set_binary_thresholds(catcierge_template_matcher
 void catcierge_template_matcher_set_erode(catcierge_template_matcher_t *ctx, int erode);
 void catcierge_template_matcher_set_debug(catcierge_template_matcher_t *ctx, int debug);
 
-double catcierge_template_matcher_match(void *ctx, IplImage *img, match_result_t *result, int save_steps);
+double catcierge_template_matcher_match(void *ctx, catcierge_frame_ctx_t *frame, match_result_t *result, int save_steps);
 int caticerge_template_matcher_decide(void *ctx, match_group_t *mg);
 
 int catcierge_template_matcher_is_frame_obstructed(catcierge_template_matcher_t *ctx, IplImage *img);
 
+const char *catcierge_template_method_str(catcierge_template_method_t method);
+
 void catcierge_template_matcher_usage();
 int catcierge_template_matcher_parse_args(catcierge_template_matcher_args_t *args, const char *key, char **values, size_t value_count);
 void catcierge_template_matcher_print_settings(catcierge_template_matcher_args_t * args);
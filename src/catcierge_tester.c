@@ -25,12 +25,384 @@
 #include "catcierge_haar_matcher.h"
 #include "catcierge_util.h"
 #include "catcierge_types.h"
+#include "catcierge_timer.h"
 #ifdef _WIN32
 #include <process.h>
 #else
 #include <limits.h>
 #endif
 #include <time.h>
+#include <math.h>
+
+#define PYRAMID_REPORT_ITERATIONS 10
+#define SWEEP_MAX_VALUES 16
+
+// Parameter grid for --sweep.
+typedef struct sweep_args_s
+{
+	double scale_factors[SWEEP_MAX_VALUES];
+	size_t scale_factor_count;
+	int min_neighbours[SWEEP_MAX_VALUES];
+	size_t min_neighbours_count;
+	int scale_images[SWEEP_MAX_VALUES];
+	size_t scale_image_count;
+} sweep_args_t;
+
+// What an image is labeled as, given by the name of its directory.
+typedef enum sweep_label_e
+{
+	SWEEP_LABEL_NONE,
+	SWEEP_LABEL_NO_HEAD,
+	SWEEP_LABEL_NO_PREY,
+	SWEEP_LABEL_PREY
+} sweep_label_t;
+
+static double time_match(catcierge_matcher_t *matcher, catcierge_frame_ctx_t *frame,
+	IplImage *img, match_result_t *result, double *res)
+{
+	int i;
+	clock_t start = clock();
+
+	for (i = 0; i < PYRAMID_REPORT_ITERATIONS; i++)
+	{
+		catcierge_frame_ctx_set(frame, img);
+		*res = matcher->match(matcher, frame, result, 0);
+	}
+
+	return (double)(clock() - start) / CLOCKS_PER_SEC / PYRAMID_REPORT_ITERATIONS;
+}
+
+//
+// Matches all images with a full search and with a pyramid search,
+// and reports the speedup and how much the scores differ.
+//
+static int pyramid_report(catcierge_template_matcher_args_t *args,
+	IplImage **imgs, char **img_paths, size_t img_count)
+{
+	int ret = -1;
+	size_t i;
+	int levels = args->pyramid ? args->pyramid : 1;
+	catcierge_matcher_t *full = NULL;
+	catcierge_matcher_t *pyramid = NULL;
+	catcierge_frame_ctx_t frame;
+	match_result_t result;
+	double full_res;
+	double pyramid_res;
+	double full_time;
+	double pyramid_time;
+	double full_total = 0.0;
+	double pyramid_total = 0.0;
+	double diff;
+	double diff_sum = 0.0;
+	double diff_max = 0.0;
+	int decision_diff = 0;
+
+	memset(&result, 0, sizeof(result));
+	catcierge_frame_ctx_init(&frame);
+
+	args->pyramid = 0;
+
+	if (catcierge_template_matcher_init(&full, (catcierge_matcher_args_t *)args))
+	{
+		fprintf(stderr, "Failed to init full search template matcher\n");
+		goto fail;
+	}
+
+	args->pyramid = levels;
+
+	if (catcierge_template_matcher_init(&pyramid, (catcierge_matcher_args_t *)args))
+	{
+		fprintf(stderr, "Failed to init pyramid template matcher\n");
+		goto fail;
+	}
+
+	printf("Pyramid search with %d levels compared to a full search:\n", levels);
+
+	for (i = 0; i < img_count; i++)
+	{
+		full_time = time_match(full, &frame, imgs[i], &result, &full_res);
+		pyramid_time = time_match(pyramid, &frame, imgs[i], &result, &pyramid_res);
+
+		if ((full_res < 0.0) || (pyramid_res < 0.0))
+		{
+			fprintf(stderr, "Something went wrong when matching image: %s\n", img_paths[i]);
+			goto fail;
+		}
+
+		diff = fabs(full_res - pyramid_res);
+		diff_sum += diff;
+		if (diff > diff_max) diff_max = diff;
+		full_total += full_time;
+		pyramid_total += pyramid_time;
+
+		if ((full_res >= args->match_threshold) != (pyramid_res >= args->match_threshold))
+			decision_diff++;
+
+		printf("  %s: full %f (%0.2f ms) pyramid %f (%0.2f ms) diff %f\n",
+			img_paths[i], full_res, full_time * 1000.0,
+			pyramid_res, pyramid_time * 1000.0, diff);
+	}
+
+	printf("---------------------------------------------------\n");
+	printf("        Images: %d\n", (int)img_count);
+	printf("   Full search: %0.3f ms per image\n", full_total * 1000.0 / img_count);
+	printf("Pyramid search: %0.3f ms per image\n", pyramid_total * 1000.0 / img_count);
+	printf("       Speedup: %0.2fx\n", (pyramid_total > 0.0) ? (full_total / pyramid_total) : 0.0);
+	printf("    Score diff: avg %f, max %f\n", diff_sum / img_count, diff_max);
+	printf(" Decision diff: %d\n", decision_diff);
+
+	ret = 0;
+
+fail:
+	catcierge_frame_ctx_destroy(&frame);
+	catcierge_matcher_destroy(&full);
+	catcierge_matcher_destroy(&pyramid);
+
+	return ret;
+}
+
+static sweep_label_t sweep_get_label(const char *path)
+{
+	const char *end = NULL;
+	const char *start = NULL;
+	const char *p;
+	size_t len;
+
+	// Find the last directory in the path.
+	for (p = path; *p; p++)
+	{
+		if ((*p == '/') || (*p == '\\'))
+		{
+			start = end;
+			end = p;
+		}
+	}
+
+	if (!end)
+		return SWEEP_LABEL_NONE;
+
+	start = start ? (start + 1) : path;
+	len = end - start;
+
+	if ((len == 7) && !strncmp(start, "no_head", len)) return SWEEP_LABEL_NO_HEAD;
+	if ((len == 7) && !strncmp(start, "no_prey", len)) return SWEEP_LABEL_NO_PREY;
+	if ((len == 4) && !strncmp(start, "prey", len)) return SWEEP_LABEL_PREY;
+
+	return SWEEP_LABEL_NONE;
+}
+
+static int compare_double(const void *a, const void *b)
+{
+	double da = *(const double *)a;
+	double db = *(const double *)b;
+	return (da < db) ? -1 : ((da > db) ? 1 : 0);
+}
+
+static double percentile(const double *sorted, size_t count, double p)
+{
+	size_t i = (size_t)(p * (count - 1) + 0.5);
+	return sorted[i];
+}
+
+//
+// Matches all images with every combination of the haar detection
+// parameters, and reports the latency, how often a head was found and
+// how often the prey decision agrees with the labels. Images in a
+// directory named "prey", "no_prey" or "no_head" are labeled.
+//
+static int sweep_report(catcierge_haar_matcher_args_t *args, sweep_args_t *sweep,
+	IplImage **imgs, char **img_paths, size_t img_count)
+{
+	int ret = -1;
+	size_t i;
+	size_t s;
+	size_t n;
+	size_t m;
+	int prey;
+	int head_count;
+	int head_total = 0;
+	int agree_count;
+	int agree_total = 0;
+	double start;
+	double *times = NULL;
+	sweep_label_t *labels = NULL;
+	catcierge_matcher_t *matcher = NULL;
+	catcierge_frame_ctx_t frame;
+	match_result_t result;
+
+	memset(&result, 0, sizeof(result));
+	catcierge_frame_ctx_init(&frame);
+
+	// Default to the value given on the command line.
+	if (!sweep->scale_factor_count)
+		sweep->scale_factors[sweep->scale_factor_count++] = args->scale_factor;
+	if (!sweep->min_neighbours_count)
+		sweep->min_neighbours[sweep->min_neighbours_count++] = args->min_neighbours;
+	if (!sweep->scale_image_count)
+		sweep->scale_images[sweep->scale_image_count++] = args->scale_image;
+
+	if (!(times = calloc(img_count, sizeof(double)))
+	 || !(labels = calloc(img_count, sizeof(sweep_label_t))))
+	{
+		fprintf(stderr, "Out of memory\n");
+		goto fail;
+	}
+
+	for (i = 0; i < img_count; i++)
+	{
+		labels[i] = sweep_get_label(img_paths[i]);
+
+		// Unlabeled images are not known to have a head.
+		if ((labels[i] == SWEEP_LABEL_PREY) || (labels[i] == SWEEP_LABEL_NO_PREY)) head_total++;
+		if (labels[i] != SWEEP_LABEL_NONE) agree_total++;
+	}
+
+	// The matcher reads the parameters for each match,
+	// so the same one can be used for all combinations.
+	if (catcierge_haar_matcher_init(&matcher, (catcierge_matcher_args_t *)args))
+	{
+		fprintf(stderr, "Failed to init haar matcher\n");
+		goto fail;
+	}
+
+	printf("%d images, %d with a head, %d labeled\n", (int)img_count, head_total, agree_total);
+	printf("scale  neighbours  scale_img   p50 ms   p90 ms   p99 ms  detected  agree\n");
+
+	for (s = 0; s < sweep->scale_factor_count; s++)
+	{
+		for (n = 0; n < sweep->min_neighbours_count; n++)
+		{
+			for (m = 0; m < sweep->scale_image_count; m++)
+			{
+				args->scale_factor = sweep->scale_factors[s];
+				args->min_neighbours = sweep->min_neighbours[n];
+				args->scale_image = sweep->scale_images[m];
+				head_count = 0;
+				agree_count = 0;
+
+				for (i = 0; i < img_count; i++)
+				{
+					catcierge_frame_ctx_set(&frame, imgs[i]);
+
+					start = catcierge_timer_now();
+
+					if (matcher->match(matcher, &frame, &result, 0) < 0.0)
+					{
+						fprintf(stderr, "Something went wrong when matching image: %s\n", img_paths[i]);
+						goto fail;
+					}
+
+					times[i] = catcierge_timer_now() - start;
+					prey = (result.rect_count > 0) && (result.result == HAAR_FAIL);
+
+					if (((labels[i] == SWEEP_LABEL_PREY) || (labels[i] == SWEEP_LABEL_NO_PREY))
+						&& (result.rect_count > 0))
+						head_count++;
+
+					if (((labels[i] == SWEEP_LABEL_PREY) && prey)
+					 || ((labels[i] == SWEEP_LABEL_NO_PREY) && (result.rect_count > 0) && !prey)
+					 || ((labels[i] == SWEEP_LABEL_NO_HEAD) && (result.rect_count == 0)))
+					{
+						agree_count++;
+					}
+				}
+
+				qsort(times, img_count, sizeof(double), compare_double);
+
+				printf("%5.2f  %10d  %9d  %7.2f  %7.2f  %7.2f  %7.1f%%  %5.1f%%\n",
+					args->scale_factor, args->min_neighbours, args->scale_image,
+					1000.0 * percentile(times, img_count, 0.5),
+					1000.0 * percentile(times, img_count, 0.9),
+					1000.0 * percentile(times, img_count, 0.99),
+					head_total ? (100.0 * head_count / head_total) : 0.0,
+					agree_total ? (100.0 * agree_count / agree_total) : 0.0);
+			}
+		}
+	}
+
+	ret = 0;
+
+fail:
+	free(times);
+	free(labels);
+	catcierge_frame_ctx_destroy(&frame);
+	catcierge_matcher_destroy(&matcher);
+
+	return ret;
+}
+
+static int parse_sweep_int(const char *value, int *out)
+{
+	char *end = NULL;
+	long v = strtol(value, &end, 10);
+
+	if ((end == value) || (*end != '\0'))
+		return -1;
+
+	*out = (int)v;
+
+	return 0;
+}
+
+static int parse_sweep_arg(sweep_args_t *sweep, const char *key, char **values, size_t value_count)
+{
+	size_t i;
+
+	if (value_count > SWEEP_MAX_VALUES)
+	{
+		fprintf(stderr, "At most %d values for --%s\n", SWEEP_MAX_VALUES, key);
+		return -1;
+	}
+
+	if (!strcmp(key, "sweep_scale_factor"))
+	{
+		for (i = 0; i < value_count; i++)
+		{
+			if ((sweep->scale_factors[i] = atof(values[i])) <= 1.0)
+			{
+				fprintf(stderr, "--sweep_scale_factor values must be larger than 1.0\n");
+				return -1;
+			}
+		}
+
+		sweep->scale_factor_count = value_count;
+		return 0;
+	}
+
+	if (!strcmp(key, "sweep_min_neighbours"))
+	{
+		for (i = 0; i < value_count; i++)
+		{
+			if (parse_sweep_int(values[i], &sweep->min_neighbours[i])
+				|| (sweep->min_neighbours[i] < 0))
+			{
+				fprintf(stderr, "--sweep_min_neighbours values must be counts of 0 or more, got \"%s\"\n", values[i]);
+				return -1;
+			}
+		}
+
+		sweep->min_neighbours_count = value_count;
+		return 0;
+	}
+
+	if (!strcmp(key, "sweep_scale_image"))
+	{
+		for (i = 0; i < value_count; i++)
+		{
+			if (parse_sweep_int(values[i], &sweep->scale_images[i])
+				|| ((sweep->scale_images[i] != 0) && (sweep->scale_images[i] != 1)))
+			{
+				fprintf(stderr, "--sweep_scale_image values must be 0 or 1, got \"%s\"\n", values[i]);
+				return -1;
+			}
+		}
+
+		sweep->scale_image_count = value_count;
+		return 0;
+	}
+
+	return 1;
+}
 
 static int parse_arg(catcierge_template_matcher_args_t *args,
 	catcierge_haar_matcher_args_t *hargs, const char *key, char **values, size_t value_count)
@@ -74,8 +446,12 @@ int main(int argc, char **argv)
 	int success_count = 0;
 	int preload = 0;
 	int test_matchable = 0;
+	int pyramid_compare = 0;
+	int sweep_compare = 0;
+	sweep_args_t sweep;
 	const char *matcher_str = NULL;
 	match_result_t result;
+	catcierge_frame_ctx_t frame;
 
 	clock_t start;
 	clock_t end;
@@ -85,7 +461,9 @@ int main(int argc, char **argv)
 	char *values[4096];
 	size_t value_count = 0;
 	memset(&args, 0, sizeof(args));
+	memset(&sweep, 0, sizeof(sweep));
 	memset(&result, 0, sizeof(result));
+	catcierge_frame_ctx_init(&frame);
 
 	fprintf(stderr, "Catcierge Image match Tester (C) Joakim Soderberg 2013-2014\n");
 
@@ -99,6 +477,11 @@ int main(int argc, char **argv)
 						"          [--threshold]\n"
 						"          [--preload]\n"
 						"          [--test_matchable]\n"
+						"          [--pyramid_report]\n"
+						"          [--sweep]\n"
+						"          [--sweep_scale_factor <factors>]\n"
+						"          [--sweep_min_neighbours <counts>]\n"
+						"          [--sweep_scale_image <0|1 ...>]\n"
 						"          [--snout <snout images for template matching>]\n"
 						"          [--cascade <haar cascade xml>]\n"
 						"           --images <input images>\n"
@@ -136,6 +519,16 @@ int main(int argc, char **argv)
 			test_matchable = 1;
 			preload = 1;
 		}
+		else if (!strcmp(argv[i], "--pyramid_report"))
+		{
+			pyramid_compare = 1;
+			preload = 1;
+		}
+		else if (!strcmp(argv[i], "--sweep"))
+		{
+			sweep_compare = 1;
+			preload = 1;
+		}
 		else if (!strcmp(argv[i], "--debug"))
 		{
 			debug = 1;
@@ -195,6 +588,17 @@ int main(int argc, char **argv)
 				j = i + 1;
 			}
 
+			if (!strncmp(key, "sweep_", 6))
+			{
+				if ((ret = parse_sweep_arg(&sweep, key, values, value_count)) != 0)
+				{
+					fprintf(stderr, "Failed to parse command line arguments for \"%s\"\n", key);
+					return -1;
+				}
+
+				continue;
+			}
+
 			if ((ret = parse_arg(&args, &hargs, key, values, value_count)) < 0)
 			{
 				fprintf(stderr, "Failed to parse command line arguments for \"%s\"\n", key);
@@ -241,6 +645,18 @@ int main(int argc, char **argv)
 	args.super.type = MATCHER_TEMPLATE;
 	hargs.super.type = MATCHER_HAAR;
 
+	if (pyramid_compare && strcmp(matcher_str, "template"))
+	{
+		fprintf(stderr, "--pyramid_report needs the template matcher\n");
+		return -1;
+	}
+
+	if (sweep_compare && strcmp(matcher_str, "haar"))
+	{
+		fprintf(stderr, "--sweep needs the haar matcher\n");
+		return -1;
+	}
+
 	if (catcierge_matcher_init(&matcher,
 		(!strcmp(matcher_str, "template")
 		? (catcierge_matcher_args_t *)&args
@@ -272,6 +688,30 @@ int main(int argc, char **argv)
 
 	start = clock();
 
+	if (sweep_compare)
+	{
+		ret = sweep_report(&hargs, &sweep, imgs, img_paths, img_count);
+
+		for (i = 0; i < (int)img_count; i++)
+		{
+			cvReleaseImage(&imgs[i]);
+		}
+
+		goto fail;
+	}
+
+	if (pyramid_compare)
+	{
+		ret = pyramid_report(&args, imgs, img_paths, img_count);
+
+		for (i = 0; i < (int)img_count; i++)
+		{
+			cvReleaseImage(&imgs[i]);
+		}
+
+		goto fail;
+	}
+
 	if (test_matchable)
 	{
 		for (i = 0; i < (int)img_count; i++)
@@ -322,7 +762,9 @@ int main(int argc, char **argv)
 			printf("  Image size: %dx%d\n", img_size.width, img_size.height);
 
 
-			if ((match_res = matcher->match(matcher, img, &result, 0)) < 0)
+			catcierge_frame_ctx_set(&frame, img);
+
+			if ((match_res = matcher->match(matcher, &frame, &result, 0)) < 0)
 			{
 				fprintf(stderr, "Something went wrong when matching image: %s\n", img_paths[i]);
 				catcierge_matcher_destroy(&matcher);
@@ -404,6 +846,7 @@ int main(int argc, char **argv)
 	}
 
 fail:
+	catcierge_frame_ctx_destroy(&frame);
 	catcierge_matcher_destroy(&matcher);
 	cvDestroyAllWindows();
 
@@ -0,0 +1,196 @@
+//
+// This file is part of the Catcierge project.
+//
+// Copyright (c) Joakim Soderberg 2013-2014
+//
+//    Catcierge is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    Catcierge is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Catcierge.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <catcierge_config.h>
+#include <assert.h>
+#include <string.h>
+#include "catcierge_thread.h"
+#ifndef _WIN32
+#include <time.h>
+#include <errno.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+static DWORD WINAPI catcierge_thread_trampoline(LPVOID param)
+{
+	catcierge_thread_t *t = (catcierge_thread_t *)param;
+	t->ret = t->func(t->arg);
+	return 0;
+}
+#endif // _WIN32
+
+int catcierge_thread_create(catcierge_thread_t *t, catcierge_thread_func_t func, void *arg)
+{
+	assert(t);
+	assert(func);
+
+	memset(t, 0, sizeof(catcierge_thread_t));
+	t->func = func;
+	t->arg = arg;
+
+	#ifdef _WIN32
+	if (!(t->handle = CreateThread(NULL, 0, catcierge_thread_trampoline, t, 0, NULL)))
+	{
+		return -1;
+	}
+	#else
+	if (pthread_create(&t->handle, NULL, func, arg))
+	{
+		return -1;
+	}
+	#endif
+
+	t->started = 1;
+
+	return 0;
+}
+
+void *catcierge_thread_join(catcierge_thread_t *t)
+{
+	assert(t);
+
+	if (!t->started)
+		return NULL;
+
+	#ifdef _WIN32
+	WaitForSingleObject(t->handle, INFINITE);
+	CloseHandle(t->handle);
+	#else
+	pthread_join(t->handle, &t->ret);
+	#endif
+
+	t->started = 0;
+
+	return t->ret;
+}
+
+void catcierge_thread_sleep_ms(int ms)
+{
+	#ifdef _WIN32
+	Sleep((DWORD)ms);
+	#else
+	struct timespec ts;
+	ts.tv_sec = ms / 1000;
+	ts.tv_nsec = (ms % 1000) * 1000000L;
+
+	while (nanosleep(&ts, &ts) && (errno == EINTR))
+		;
+	#endif
+}
+
+int catcierge_thread_cpu_count()
+{
+	long count;
+	#ifdef _WIN32
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	count = (long)info.dwNumberOfProcessors;
+	#elif defined(_SC_NPROCESSORS_ONLN)
+	count = sysconf(_SC_NPROCESSORS_ONLN);
+	#else
+	count = 1;
+	#endif
+
+	return (count < 1) ? 1 : (int)count;
+}
+
+int catcierge_mutex_init(catcierge_mutex_t *m)
+{
+	assert(m);
+	#ifdef _WIN32
+	InitializeCriticalSection(m);
+	return 0;
+	#else
+	return pthread_mutex_init(m, NULL) ? -1 : 0;
+	#endif
+}
+
+void catcierge_mutex_destroy(catcierge_mutex_t *m)
+{
+	assert(m);
+	#ifdef _WIN32
+	DeleteCriticalSection(m);
+	#else
+	pthread_mutex_destroy(m);
+	#endif
+}
+
+void catcierge_mutex_lock(catcierge_mutex_t *m)
+{
+	#ifdef _WIN32
+	EnterCriticalSection(m);
+	#else
+	pthread_mutex_lock(m);
+	#endif
+}
+
+void catcierge_mutex_unlock(catcierge_mutex_t *m)
+{
+	#ifdef _WIN32
+	LeaveCriticalSection(m);
+	#else
+	pthread_mutex_unlock(m);
+	#endif
+}
+
+int catcierge_cond_init(catcierge_cond_t *c)
+{
+	assert(c);
+	#ifdef _WIN32
+	InitializeConditionVariable(c);
+	return 0;
+	#else
+	return pthread_cond_init(c, NULL) ? -1 : 0;
+	#endif
+}
+
+void catcierge_cond_destroy(catcierge_cond_t *c)
+{
+	assert(c);
+	#ifndef _WIN32
+	pthread_cond_destroy(c);
+	#endif
+}
+
+void catcierge_cond_wait(catcierge_cond_t *c, catcierge_mutex_t *m)
+{
+	#ifdef _WIN32
+	SleepConditionVariableCS(c, m, INFINITE);
+	#else
+	pthread_cond_wait(c, m);
+	#endif
+}
+
+void catcierge_cond_signal(catcierge_cond_t *c)
+{
+	#ifdef _WIN32
+	WakeConditionVariable(c);
+	#else
+	pthread_cond_signal(c);
+	#endif
+}
+
+void catcierge_cond_broadcast(catcierge_cond_t *c)
+{
+	#ifdef _WIN32
+	WakeAllConditionVariable(c);
+	#else
+	pthread_cond_broadcast(c);
+	#endif
+}
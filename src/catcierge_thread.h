@@ -0,0 +1,100 @@
+//
+// This file is part of the Catcierge project.
+//
+// Copyright (c) Joakim Soderberg 2013-2014
+//
+//    Catcierge is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    Catcierge is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Catcierge.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef __CATCIERGE_THREAD_H__
+#define __CATCIERGE_THREAD_H__
+
+#include "catcierge_platform.h"
+
+#ifndef _WIN32
+#include <pthread.h>
+#endif
+
+typedef void *(*catcierge_thread_func_t)(void *arg);
+
+typedef struct catcierge_thread_s
+{
+	#ifdef _WIN32
+	HANDLE handle;
+	#else
+	pthread_t handle;
+	#endif
+	catcierge_thread_func_t func;
+	void *arg;
+	void *ret;
+	int started;
+} catcierge_thread_t;
+
+#ifdef _WIN32
+typedef CRITICAL_SECTION catcierge_mutex_t;
+typedef CONDITION_VARIABLE catcierge_cond_t;
+#else
+typedef pthread_mutex_t catcierge_mutex_t;
+typedef pthread_cond_t catcierge_cond_t;
+#endif
+
+//
+// Atomic helpers for the lock-free structures.
+// These are only used on int sized values so that they
+// work on all the platforms we run on (including ARMv6).
+//
+#ifdef _WIN32
+#define catcierge_atomic_load(p) \
+	InterlockedCompareExchange((volatile LONG *)(p), 0, 0)
+#define catcierge_atomic_store(p, v) \
+	InterlockedExchange((volatile LONG *)(p), (LONG)(v))
+#define catcierge_atomic_cas(p, oldval, newval) \
+	(InterlockedCompareExchange((volatile LONG *)(p), (LONG)(newval), (LONG)(oldval)) == (LONG)(oldval))
+#define catcierge_atomic_add(p, v) \
+	InterlockedExchangeAdd((volatile LONG *)(p), (LONG)(v))
+#elif defined(__ATOMIC_ACQUIRE)
+// GCC 4.7+ and clang.
+#define catcierge_atomic_load(p) __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define catcierge_atomic_store(p, v) __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+#define catcierge_atomic_cas(p, oldval, newval) \
+	__sync_bool_compare_and_swap((p), (oldval), (newval))
+#define catcierge_atomic_add(p, v) __sync_fetch_and_add((p), (v))
+#else
+// Older GCC, such as the one in Raspbian wheezy.
+#define catcierge_atomic_load(p) __sync_fetch_and_add((p), 0)
+#define catcierge_atomic_store(p, v) \
+	do { __sync_synchronize(); *(p) = (v); __sync_synchronize(); } while (0)
+#define catcierge_atomic_cas(p, oldval, newval) \
+	__sync_bool_compare_and_swap((p), (oldval), (newval))
+#define catcierge_atomic_add(p, v) __sync_fetch_and_add((p), (v))
+#endif
+
+int catcierge_thread_create(catcierge_thread_t *t, catcierge_thread_func_t func, void *arg);
+void *catcierge_thread_join(catcierge_thread_t *t);
+void catcierge_thread_sleep_ms(int ms);
+
+// Number of CPUs online, at least 1.
+int catcierge_thread_cpu_count();
+
+int catcierge_mutex_init(catcierge_mutex_t *m);
+void catcierge_mutex_destroy(catcierge_mutex_t *m);
+void catcierge_mutex_lock(catcierge_mutex_t *m);
+void catcierge_mutex_unlock(catcierge_mutex_t *m);
+
+int catcierge_cond_init(catcierge_cond_t *c);
+void catcierge_cond_destroy(catcierge_cond_t *c);
+void catcierge_cond_wait(catcierge_cond_t *c, catcierge_mutex_t *m);
+void catcierge_cond_signal(catcierge_cond_t *c);
+void catcierge_cond_broadcast(catcierge_cond_t *c);
+
+#endif // __CATCIERGE_THREAD_H__
@@ -69,3 +69,47 @@ int catcierge_timer_has_timed_out(catcierge_timer_t *t)
 	assert(t);
 	return (round(catcierge_timer_get(t)) >= t->timeout);
 }
+
+double catcierge_timer_now()
+{
+	#ifdef _WIN32
+	LARGE_INTEGER freq;
+	LARGE_INTEGER count;
+	QueryPerformanceFrequency(&freq);
+	QueryPerformanceCounter(&count);
+	return (double)count.QuadPart / (double)freq.QuadPart;
+	#else
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (double)ts.tv_sec + (ts.tv_nsec / 1000000000.0);
+	#endif
+}
+
+double catcierge_timer_cpu_now()
+{
+	#ifdef _WIN32
+	FILETIME creation_time;
+	FILETIME exit_time;
+	FILETIME kernel_time;
+	FILETIME user_time;
+	ULARGE_INTEGER kernel;
+	ULARGE_INTEGER user;
+
+	if (!GetProcessTimes(GetCurrentProcess(), &creation_time, &exit_time, &kernel_time, &user_time))
+		return 0.0;
+
+	kernel.LowPart = kernel_time.dwLowDateTime;
+	kernel.HighPart = kernel_time.dwHighDateTime;
+	user.LowPart = user_time.dwLowDateTime;
+	user.HighPart = user_time.dwHighDateTime;
+
+	// In 100 nanosecond units.
+	return (double)(kernel.QuadPart + user.QuadPart) / 10000000.0;
+	#elif defined(CLOCK_PROCESS_CPUTIME_ID)
+	struct timespec ts;
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+	return (double)ts.tv_sec + (ts.tv_nsec / 1000000000.0);
+	#else
+	return (double)clock() / CLOCKS_PER_SEC;
+	#endif
+}
@@ -48,5 +48,12 @@ void catcierge_timer_set(catcierge_timer_t *t, double timeout);
 
 int catcierge_timer_has_timed_out(catcierge_timer_t *t);
 
+// Monotonic time in seconds, unaffected by changes to the wall clock.
+// Only useful for measuring intervals.
+double catcierge_timer_now();
+
+// CPU time in seconds used by all threads of the process so far.
+double catcierge_timer_cpu_now();
+
 
 #endif // __CATCIERGE_TIMER_H__
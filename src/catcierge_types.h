@@ -25,9 +25,12 @@
 #include <time.h>
 
 #include "catcierge_platform.h"
+#include "catcierge_arena.h"
+#include "catcierge_image_pool.h"
 #include "sha1.h"
 
-#define MATCH_MAX_COUNT 4 // The number of matches to perform before deciding the lock state.
+#define DEFAULT_MATCH_GROUP_SIZE 4 // The number of matches to perform before deciding the lock state.
+#define MAX_MATCH_GROUP_SIZE 10 // Largest --match_group_size, the legacy execute commands get 3 arguments per match.
 
 typedef struct catcierge_output_var_s
 {
@@ -64,12 +67,14 @@ typedef enum catcierge_lockout_method_s
 #define MAX_STEPS 24
 #define MAX_MATCH_RECTS 24
 
+// The paths point into the string arena of the match group,
+// and are only set for the steps that are saved.
 typedef struct match_step_s
 {
 	IplImage *img;
-	char path[4096];
-	char filename[1024];
-	char full_path[4096];
+	const char *path;
+	const char *filename;
+	const char *full_path;
 	const char *name;
 	const char *description;
 } match_step_t;
@@ -86,20 +91,31 @@ typedef struct match_result_s
 	match_direction_t direction;
 	match_step_t steps[MAX_STEPS];	// Step by step images+description for the matching algorithm.
 	size_t step_img_count;			// The number of step images.
+
+	// Optional search window hint, set before matching. The matcher can
+	// search near these first, for instance where the snout was found
+	// in the previous frame.
+	CvRect hint_rects[MAX_MATCH_RECTS];
+	size_t hint_count;
+	match_direction_t hint_direction;
+	int hint_hit;					// Searching near the hint was enough.
+	int hint_miss;					// The hint was tried, but a full search was needed.
+	double search_time;				// Seconds spent searching the whole frame.
+	double hint_time;				// Seconds spent searching near the hint.
 } match_result_t;
 
 // The state of a single match.
 typedef struct match_state_s
 {
-	char full_path[4096];			// The full path.
-	char path[4096];				// Path to where the image for this match should be saved.
-	char filename[1024];			// Name of the file only.
+	const char *full_path;			// The full path.
+	const char *path;				// Path to where the image for this match should be saved.
+	const char *filename;			// Name of the file only.
 	IplImage *img;					// A cached image of the match frame.
 	struct timeval tv;
 	time_t time;					// We need this on Windows. 
 									// Since tv_sec in struct timeval is a long (32-bit) and time_t
 									// might be a 64-bit integer.
-	char time_str[1024];			// Time string of match (used in image filename).
+	char time_str[64];				// Time string of match (used in image filename).
 	match_result_t result;			// Updated by the matcher algorithm.
 	SHA1Context sha;				// Used to generate match ID.
 } match_state_t;
@@ -107,11 +123,16 @@ typedef struct match_state_s
 typedef struct match_group_s
 {
 	SHA1Context sha;				// Used to generate match group ID.
-	match_state_t matches[MATCH_MAX_COUNT];
-	size_t match_count;				// The current match count, will go up to MATCH_MAX_COUNT.
+	match_state_t *matches;			// Pool of max_count matches, allocated once at startup.
+	catcierge_arena_t strings;		// Image paths of the match group, reset when a new one starts.
+	catcierge_image_pool_t images;	// Buffers for the match, step and obstruct images.
+	int images_reserved;			// The buffers are created for the frame size.
+	size_t max_count;				// The number of matches to perform before deciding.
+	size_t match_count;				// The current match count, will go up to max_count.
 	int success;
 	int success_count;
 	int final_decision;				// Was the match decision overriden by the matcher?
+	int early_decision;				// Was the decision made before all matches were made?
 	char description[512];
 	match_direction_t direction;
 	
@@ -121,11 +142,13 @@ typedef struct match_group_s
 	time_t end_time;
 
 	IplImage *obstruct_img;
-	char obstruct_filename[1024];
-	char obstruct_path[4096];
-	char obstruct_full_path[4096];
+	const char *obstruct_filename;
+	const char *obstruct_path;
+	const char *obstruct_full_path;
 	struct timeval obstruct_tv;
 	time_t obstruct_time;
+	double obstruct_frame_time;		// Monotonic capture time of the obstructed frame.
+	double decision_latency;		// Seconds from the obstructed frame until the lock decision.
 } match_group_t;
 
 #endif // __CATCIERGE_TYPES_H__
@@ -0,0 +1,195 @@
+//
+// This file is part of the Catcierge project.
+//
+// Copyright (c) Joakim Soderberg 2013-2014
+//
+//    Catcierge is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    Catcierge is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Catcierge.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <catcierge_config.h>
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+#include "catcierge_workers.h"
+#include "catcierge_log.h"
+
+static void *catcierge_workers_thread(void *arg)
+{
+	size_t job;
+	catcierge_workers_t *w = (catcierge_workers_t *)arg;
+
+	catcierge_mutex_lock(&w->lock);
+
+	while (1)
+	{
+		while (!w->quit && (w->next >= w->end))
+		{
+			catcierge_cond_wait(&w->work_cond, &w->lock);
+		}
+
+		if (w->quit)
+			break;
+
+		job = w->next++;
+		catcierge_mutex_unlock(&w->lock);
+
+		w->func(w->user, job);
+
+		catcierge_mutex_lock(&w->lock);
+
+		if (++w->done == w->count)
+		{
+			catcierge_cond_signal(&w->done_cond);
+		}
+	}
+
+	catcierge_mutex_unlock(&w->lock);
+
+	return NULL;
+}
+
+int catcierge_workers_init(catcierge_workers_t *w, int worker_count)
+{
+	size_t i;
+	assert(w);
+
+	memset(w, 0, sizeof(catcierge_workers_t));
+
+	if (worker_count <= 0)
+		worker_count = catcierge_thread_cpu_count();
+
+	if (worker_count <= 1)
+		return 0;
+
+	if (catcierge_mutex_init(&w->lock))
+		return -1;
+
+	if (catcierge_cond_init(&w->work_cond))
+	{
+		CATERR("Failed to create worker conditions\n");
+		catcierge_mutex_destroy(&w->lock);
+		return -1;
+	}
+
+	if (catcierge_cond_init(&w->done_cond))
+	{
+		CATERR("Failed to create worker conditions\n");
+		catcierge_cond_destroy(&w->work_cond);
+		catcierge_mutex_destroy(&w->lock);
+		return -1;
+	}
+
+	w->initialized = 1;
+
+	if (!(w->threads = (catcierge_thread_t *)calloc(worker_count - 1, sizeof(catcierge_thread_t))))
+	{
+		CATERR("Out of memory!\n");
+		catcierge_workers_destroy(w);
+		return -1;
+	}
+
+	for (i = 0; i < (size_t)(worker_count - 1); i++)
+	{
+		if (catcierge_thread_create(&w->threads[i], catcierge_workers_thread, w))
+		{
+			CATERR("Failed to create worker thread\n");
+			catcierge_workers_destroy(w);
+			return -1;
+		}
+
+		w->thread_count++;
+	}
+
+	return 0;
+}
+
+void catcierge_workers_destroy(catcierge_workers_t *w)
+{
+	size_t i;
+	assert(w);
+
+	if (!w->initialized)
+		return;
+
+	catcierge_mutex_lock(&w->lock);
+	w->quit = 1;
+	catcierge_cond_broadcast(&w->work_cond);
+	catcierge_mutex_unlock(&w->lock);
+
+	for (i = 0; i < w->thread_count; i++)
+	{
+		catcierge_thread_join(&w->threads[i]);
+	}
+
+	free(w->threads);
+	w->threads = NULL;
+	w->thread_count = 0;
+
+	catcierge_cond_destroy(&w->work_cond);
+	catcierge_cond_destroy(&w->done_cond);
+	catcierge_mutex_destroy(&w->lock);
+	w->initialized = 0;
+}
+
+void catcierge_workers_run(catcierge_workers_t *w,
+		catcierge_workers_func_t func, void *user, size_t first, size_t count)
+{
+	size_t job;
+	assert(w);
+	assert(func);
+
+	// Nothing to gain from waking up the workers.
+	if (!w->threads || (count <= 1))
+	{
+		for (job = first; job < (first + count); job++)
+		{
+			func(user, job);
+		}
+
+		return;
+	}
+
+	catcierge_mutex_lock(&w->lock);
+
+	w->func = func;
+	w->user = user;
+	w->next = first;
+	w->end = first + count;
+	w->done = 0;
+	w->count = count;
+	catcierge_cond_broadcast(&w->work_cond);
+
+	while (w->next < w->end)
+	{
+		job = w->next++;
+		catcierge_mutex_unlock(&w->lock);
+
+		func(user, job);
+
+		catcierge_mutex_lock(&w->lock);
+		w->done++;
+	}
+
+	while (w->done < w->count)
+	{
+		catcierge_cond_wait(&w->done_cond, &w->lock);
+	}
+
+	catcierge_mutex_unlock(&w->lock);
+}
+
+int catcierge_workers_count(catcierge_workers_t *w)
+{
+	assert(w);
+	return (int)w->thread_count + 1;
+}
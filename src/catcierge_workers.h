@@ -0,0 +1,63 @@
+//
+// This file is part of the Catcierge project.
+//
+// Copyright (c) Joakim Soderberg 2013-2014
+//
+//    Catcierge is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 2 of the License, or
+//    (at your option) any later version.
+//
+//    Catcierge is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with Catcierge.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef __CATCIERGE_WORKERS_H__
+#define __CATCIERGE_WORKERS_H__
+
+#include <stddef.h>
+#include "catcierge_thread.h"
+
+// Called once for each job index in a batch, from any of the threads.
+typedef void (*catcierge_workers_func_t)(void *user, size_t job);
+
+//
+// A small pool of worker threads that runs a batch of independent
+// jobs in parallel. The calling thread takes part in the work as
+// well, so a pool with N workers has N - 1 helper threads.
+//
+typedef struct catcierge_workers_s
+{
+	catcierge_thread_t *threads;
+	size_t thread_count;		// Helper threads.
+	catcierge_mutex_t lock;
+	catcierge_cond_t work_cond;	// Signaled when a batch is started, or on quit.
+	catcierge_cond_t done_cond;	// Signaled when the last job of a batch is done.
+	catcierge_workers_func_t func;
+	void *user;
+	size_t next;				// Next job to be taken.
+	size_t end;					// One past the last job of the batch.
+	size_t done;				// Jobs finished in the batch.
+	size_t count;				// Jobs in the batch.
+	int quit;
+	int initialized;			// The lock and conditions have been created.
+} catcierge_workers_t;
+
+// worker_count is the total number of threads to use including the
+// caller, 0 means one for each CPU. 1 runs everything in the caller.
+int catcierge_workers_init(catcierge_workers_t *w, int worker_count);
+void catcierge_workers_destroy(catcierge_workers_t *w);
+
+// Runs func for the jobs first to first + count - 1 and returns
+// when all of them are done. Not reentrant.
+void catcierge_workers_run(catcierge_workers_t *w,
+		catcierge_workers_func_t func, void *user, size_t first, size_t count);
+
+// Total number of threads doing work, including the caller.
+int catcierge_workers_count(catcierge_workers_t *w);
+
+#endif // __CATCIERGE_WORKERS_H__
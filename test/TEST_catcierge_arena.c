@@ -0,0 +1,81 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "catcierge_config.h"
+#include "catcierge_arena.h"
+#include "minunit.h"
+#include "catcierge_test_config.h"
+#include "catcierge_test_helpers.h"
+
+#define STRING_COUNT 1000
+
+static char *run_arena_tests()
+{
+	int i;
+	char expected[64];
+	char *big = NULL;
+	const char *s;
+	const char *strs[STRING_COUNT];
+	catcierge_arena_t a;
+
+	catcierge_arena_init(&a);
+
+	// Enough strings to need several blocks,
+	// the first ones must stay the same.
+	for (i = 0; i < STRING_COUNT; i++)
+	{
+		strs[i] = catcierge_arena_printf(&a, "match_%d_%s.png", i, "some_time");
+		mu_assert("Expected a string", strs[i]);
+	}
+
+	mu_assert("Expected more than one block", a.blocks && a.blocks->next);
+
+	for (i = 0; i < STRING_COUNT; i++)
+	{
+		snprintf(expected, sizeof(expected), "match_%d_%s.png", i, "some_time");
+		mu_assert("Expected the same string", !strcmp(strs[i], expected));
+	}
+
+	// Larger than a block.
+	big = (char *)malloc(3 * CATCIERGE_ARENA_BLOCK_SIZE);
+	memset(big, 'a', 3 * CATCIERGE_ARENA_BLOCK_SIZE - 1);
+	big[3 * CATCIERGE_ARENA_BLOCK_SIZE - 1] = '\0';
+	s = catcierge_arena_printf(&a, "%s", big);
+	mu_assert("Expected a big string", s && !strcmp(s, big));
+	free(big);
+
+	mu_assert("Expected the empty string", !strcmp(catcierge_arena_printf(&a, "%s", ""), ""));
+
+	// Everything fits in a single block after a reset.
+	catcierge_arena_reset(&a);
+	mu_assert("Expected a single block", a.blocks && !a.blocks->next && !a.blocks->used);
+	catcierge_test_STATUS("Merged into a %d byte block", (int)a.blocks->size);
+
+	for (i = 0; i < STRING_COUNT; i++)
+	{
+		strs[i] = catcierge_arena_printf(&a, "match_%d_%s.png", i, "some_time");
+	}
+
+	mu_assert("Expected no new block after a reset", !a.blocks->next);
+	mu_assert("Expected the same string after a reset", !strcmp(strs[0], "match_0_some_time.png"));
+
+	catcierge_arena_destroy(&a);
+	mu_assert("Expected no blocks", !a.blocks);
+
+	// Destroying twice is fine.
+	catcierge_arena_destroy(&a);
+
+	return NULL;
+}
+
+int TEST_catcierge_arena(int argc, char **argv)
+{
+	int ret = 0;
+	char *e = NULL;
+
+	CATCIERGE_RUN_TEST((e = run_arena_tests()),
+		"Run string arena tests",
+		"String arena", &ret);
+
+	return ret;
+}
@@ -157,7 +157,23 @@ char *run_parse_args_tests()
 		(ret == -1));
 	PARSE_SETTING("ok_matches_needed", "Expected value for input",
 		(ret == -1));
+	PARSE_SETTING("match_group_size 6", "Expected valid parse",
+		(ret == 0) && (args.match_group_size == 6));
+	PARSE_SETTING("match_group_size 0", "Expected too small value",
+		(ret == -1));
+	PARSE_SETTING("match_group_size 20", "Expected too big value",
+		(ret == -1));
+	PARSE_SETTING("match_group_size", "Expected value for input",
+		(ret == -1));
 	PARSE_SINGLE_SETTING("no_final_decision", args.no_final_decision, 1);
+	PARSE_SINGLE_SETTING("early_decision", args.early_decision, 1);
+	PARSE_SINGLE_SETTING("burst", args.burst, 1);
+	PARSE_SETTING("burst_workers 2", "Expected valid parse",
+		(ret == 0) && (args.burst_workers == 2));
+	PARSE_SETTING("burst_workers -1", "Expected negative value to fail",
+		(ret == -1));
+	PARSE_SETTING("burst_workers", "Expected value for input",
+		(ret == -1));
 
 	PARSE_SETTING("lockout_method 1", "Expected valid parse OBSTRUCT_OR_TIMER_1",
 		(ret == 0) && (args.lockout_method == OBSTRUCT_OR_TIMER_1));
@@ -362,6 +378,9 @@ char *run_parse_args_tests()
 		PARSE_SETTING("cascade /path/to/catcierge.xml", "Expected valid cascade path",
 			(ret == 0) && !strcmp(args.haar.cascade, "/path/to/catcierge.xml"));
 		PARSE_SETTING("cascade", "Expected failure for missing value.", (ret == -1));
+		PARSE_SETTING("cascade_cache /path/to/catcierge.cache", "Expected valid cascade cache path",
+			(ret == 0) && !strcmp(args.haar.cascade_cache, "/path/to/catcierge.cache"));
+		PARSE_SETTING("cascade_cache", "Expected failure for missing value.", (ret == -1));
 
 		PARSE_SETTING("min_size 12x34", "Expected valid min size.",
 			(ret == 0) && (args.haar.min_width == 12) && (args.haar.min_height == 34));
@@ -371,6 +390,26 @@ char *run_parse_args_tests()
 		PARSE_SETTING("prey_steps 5", "Expected valid min size.",
 			(ret == 0) && (args.haar.prey_steps == 5));
 		PARSE_SETTING("prey_steps", "Expected min size value.", (ret == -1));
+
+		PARSE_SETTING("scale_factor 1.3", "Expected scale factor",
+			(ret == 0) && (args.haar.scale_factor == 1.3));
+		PARSE_SETTING("scale_factor 1.0", "Expected invalid scale factor", (ret == -1));
+		PARSE_SETTING("scale_factor", "Expected failure for missing value", (ret == -1));
+		PARSE_SETTING("min_neighbours 5", "Expected min neighbours",
+			(ret == 0) && (args.haar.min_neighbours == 5));
+		PARSE_SETTING("min_neighbours -1", "Expected invalid min neighbours", (ret == -1));
+		PARSE_SETTING("min_neighbours", "Expected failure for missing value", (ret == -1));
+		PARSE_SETTING("scale_image 0", "Expected scale image off",
+			(ret == 0) && (args.haar.scale_image == 0));
+		PARSE_SINGLE_SETTING("scale_image", args.haar.scale_image, 1);
+
+		PARSE_SINGLE_SETTING("head_track", args.haar.track, 1);
+		PARSE_SETTING("head_track_pad 20", "Expected head track pad",
+			(ret == 0) && (args.haar.track_pad == 20));
+		PARSE_SETTING("head_track_pad -1", "Expected invalid head track pad",
+			(ret == -1));
+		PARSE_SETTING("head_track_pad", "Expected failure for missing value",
+			(ret == -1));
 	
 		PARSE_SINGLE_SETTING("no_match_is_fail", args.haar.no_match_is_fail, 1);
 		PARSE_SINGLE_SETTING("equalize_historgram", args.haar.eq_histogram, 1);
@@ -388,6 +427,8 @@ char *run_parse_args_tests()
 			(ret == 0) && (args.haar.prey_method == PREY_METHOD_ADAPTIVE));
 		PARSE_SETTING("prey_method normal", "Expected normal prey method",
 			(ret == 0) && (args.haar.prey_method == PREY_METHOD_NORMAL));
+		PARSE_SETTING("prey_method fast", "Expected fast prey method",
+			(ret == 0) && (args.haar.prey_method == PREY_METHOD_FAST));
 		PARSE_SETTING("prey_method blarg", "Expected invalid prey method",
 			(ret == -1));
 		PARSE_SETTING("prey_method", "Expected failure for missing value",
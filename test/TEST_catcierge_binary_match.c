@@ -0,0 +1,181 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include "catcierge_binary_match.h"
+#include "minunit.h"
+#include "catcierge_test_helpers.h"
+
+#define MATCH_TOLERANCE 0.0001
+
+static IplImage *create_test_frame(int width, int height)
+{
+	int x;
+	int y;
+	IplImage *img = cvCreateImage(cvSize(width, height), IPL_DEPTH_8U, 1);
+
+	// Binary blobs, like the thresholded frames we match against.
+	srand(4321);
+	cvSet(img, cvScalarAll(255), NULL);
+
+	for (y = 0; y < 40; y++)
+	{
+		x = rand() % width;
+		cvRectangle(img, cvPoint(x, rand() % height),
+			cvPoint(x + rand() % 40, rand() % height), cvScalarAll(0), CV_FILLED, 8, 0);
+	}
+
+	return img;
+}
+
+static char *compare_template(IplImage *frame, CvRect rect)
+{
+	double max_diff;
+	double bin_max;
+	double ref_max;
+	double min_val;
+	CvPoint min_loc;
+	CvPoint bin_loc;
+	CvPoint ref_loc;
+	catcierge_binary_frame_t f;
+	catcierge_binary_template_t t;
+	IplImage *templ = cvCreateImage(cvSize(rect.width, rect.height), IPL_DEPTH_8U, 1);
+	CvSize res_size = cvSize(frame->width - rect.width + 1, frame->height - rect.height + 1);
+	IplImage *res = cvCreateImage(res_size, IPL_DEPTH_32F, 1);
+	IplImage *ref = cvCreateImage(res_size, IPL_DEPTH_32F, 1);
+	IplImage *diff = cvCreateImage(res_size, IPL_DEPTH_32F, 1);
+
+	cvSetImageROI(frame, rect);
+	cvCopy(frame, templ, NULL);
+	cvResetImageROI(frame);
+
+	mu_assert("Failed to init binary frame", !catcierge_binary_frame_init(&f, frame->width, frame->height));
+	mu_assert("Failed to init binary template", !catcierge_binary_template_init(&t, &f, templ));
+	mu_assert("Failed to set binary frame", !catcierge_binary_frame_set(&f, frame));
+	mu_assert("Failed to binary match", !catcierge_binary_match(&f, &t, res));
+
+	cvMatchTemplate(frame, templ, ref, CV_TM_CCOEFF_NORMED);
+
+	cvAbsDiff(res, ref, diff);
+	cvMinMaxLoc(diff, &min_val, &max_diff, &min_loc, &bin_loc, NULL);
+	cvMinMaxLoc(res, &min_val, &bin_max, &min_loc, &bin_loc, NULL);
+	cvMinMaxLoc(ref, &min_val, &ref_max, &min_loc, &ref_loc, NULL);
+
+	catcierge_test_STATUS("%dx%d template: max %f at %d,%d (reference %f at %d,%d), max difference %g",
+		rect.width, rect.height, bin_max, bin_loc.x, bin_loc.y,
+		ref_max, ref_loc.x, ref_loc.y, max_diff);
+
+	mu_assert("Expected binary result to be within tolerance", max_diff < MATCH_TOLERANCE);
+	mu_assert("Expected the same best match", fabs(bin_max - ref_max) < MATCH_TOLERANCE);
+
+	catcierge_binary_template_destroy(&t);
+	catcierge_binary_frame_destroy(&f);
+	cvReleaseImage(&templ);
+	cvReleaseImage(&res);
+	cvReleaseImage(&ref);
+	cvReleaseImage(&diff);
+
+	return NULL;
+}
+
+static char *run_compare_tests()
+{
+	char *e = NULL;
+	IplImage *frame = create_test_frame(320, 240);
+
+	// Widths around the 64-bit word size.
+	if ((e = compare_template(frame, cvRect(100, 80, 80, 60)))) goto fail;
+	if ((e = compare_template(frame, cvRect(1, 3, 63, 13)))) goto fail;
+	if ((e = compare_template(frame, cvRect(70, 10, 64, 20)))) goto fail;
+	if ((e = compare_template(frame, cvRect(130, 50, 65, 30)))) goto fail;
+	if ((e = compare_template(frame, cvRect(200, 100, 120, 140)))) goto fail;
+	if ((e = compare_template(frame, cvRect(0, 0, 320, 240)))) goto fail;
+
+fail:
+	cvReleaseImage(&frame);
+	return e;
+}
+
+static char *run_count_tests()
+{
+	int i;
+	uint64_t a[67];
+	uint64_t b[67];
+
+	srand(1);
+
+	for (i = 0; i < 67; i++)
+	{
+		a[i] = ((uint64_t)rand() << 40) ^ ((uint64_t)rand() << 20) ^ (uint64_t)rand();
+		b[i] = ((uint64_t)rand() << 40) ^ ((uint64_t)rand() << 20) ^ (uint64_t)rand();
+	}
+
+	a[0] = ~(uint64_t)0;
+	b[0] = ~(uint64_t)0;
+	mu_assert("Expected 64 bits set", catcierge_binary_and_count(a, b, 1) == 64);
+
+	for (i = 0; i <= 67; i++)
+	{
+		mu_assert("Expected the same count as the scalar version",
+			catcierge_binary_and_count(a, b, i) == catcierge_binary_and_count_scalar(a, b, i));
+	}
+
+	catcierge_test_STATUS("Popcount SIMD: %s", catcierge_binary_simd_str());
+
+	return NULL;
+}
+
+static char *run_flat_tests()
+{
+	double min_val;
+	double max_val;
+	catcierge_binary_frame_t f;
+	catcierge_binary_template_t t;
+	IplImage *frame = create_test_frame(320, 240);
+	IplImage *templ = cvCreateImage(cvSize(30, 30), IPL_DEPTH_8U, 1);
+	IplImage *res = cvCreateImage(cvSize(291, 211), IPL_DEPTH_32F, 1);
+	IplImage *color = cvCreateImage(cvSize(320, 240), IPL_DEPTH_8U, 3);
+
+	cvSet(templ, cvScalarAll(255), NULL);
+
+	mu_assert("Failed to init binary frame", !catcierge_binary_frame_init(&f, 320, 240));
+	mu_assert("Failed to init binary template", !catcierge_binary_template_init(&t, &f, templ));
+	mu_assert("Expected flat template", t.flat);
+	mu_assert("Failed to set binary frame", !catcierge_binary_frame_set(&f, frame));
+	mu_assert("Failed to binary match", !catcierge_binary_match(&f, &t, res));
+
+	// Same as cvMatchTemplate, a flat template matches everywhere.
+	cvMinMaxLoc(res, &min_val, &max_val, NULL, NULL, NULL);
+	mu_assert("Expected flat template to match everywhere", (min_val == 1.0) && (max_val == 1.0));
+
+	mu_assert("Expected color frame to fail", catcierge_binary_frame_set(&f, color));
+
+	catcierge_binary_template_destroy(&t);
+	catcierge_binary_frame_destroy(&f);
+	cvReleaseImage(&frame);
+	cvReleaseImage(&templ);
+	cvReleaseImage(&res);
+	cvReleaseImage(&color);
+
+	return NULL;
+}
+
+int TEST_catcierge_binary_match(int argc, char **argv)
+{
+	int ret = 0;
+	char *e = NULL;
+
+	CATCIERGE_RUN_TEST((e = run_count_tests()),
+		"Run binary popcount tests",
+		"SIMD popcount same as scalar", &ret);
+
+	CATCIERGE_RUN_TEST((e = run_compare_tests()),
+		"Run binary match compare tests",
+		"Binary match gives the same result as cvMatchTemplate", &ret);
+
+	CATCIERGE_RUN_TEST((e = run_flat_tests()),
+		"Run binary match flat template tests",
+		"Binary match flat template", &ret);
+
+	return ret;
+}
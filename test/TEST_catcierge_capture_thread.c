@@ -0,0 +1,191 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include "catcierge_capture_thread.h"
+#include "catcierge_timer.h"
+#include "minunit.h"
+#include "catcierge_test_helpers.h"
+
+typedef struct fake_camera_s
+{
+	IplImage *img;
+	IplImage *other;		// Returned after switch_at frames, if set.
+	unsigned long switch_at;
+	unsigned long count;
+} fake_camera_t;
+
+// Encodes the frame count in the first pixel, so that we can
+// check that the consumer gets the frame matching its sequence number.
+static IplImage *fake_grab(void *user)
+{
+	fake_camera_t *cam = (fake_camera_t *)user;
+	IplImage *img;
+
+	cam->count++;
+	img = (cam->other && (cam->count > cam->switch_at)) ? cam->other : cam->img;
+	((unsigned char *)img->imageData)[0] = (unsigned char)(cam->count % 256);
+	catcierge_thread_sleep_ms(1);
+
+	return img;
+}
+
+static char *run_init_tests()
+{
+	catcierge_capture_thread_t ct;
+	fake_camera_t cam;
+
+	mu_assert("Expected too few buffers to fail",
+		catcierge_capture_thread_init(&ct, CATCIERGE_CAPTURE_MIN_BUFFERS - 1, fake_grab, &cam));
+	catcierge_capture_thread_destroy(&ct);
+
+	mu_assert("Expected too many buffers to fail",
+		catcierge_capture_thread_init(&ct, CATCIERGE_CAPTURE_MAX_BUFFERS + 1, fake_grab, &cam));
+	catcierge_capture_thread_destroy(&ct);
+
+	mu_assert("Expected default buffer count to succeed",
+		!catcierge_capture_thread_init(&ct, CATCIERGE_CAPTURE_DEFAULT_BUFFERS, fake_grab, &cam));
+	catcierge_capture_thread_destroy(&ct);
+
+	return NULL;
+}
+
+static char *run_consume_tests(int consumer_delay_ms)
+{
+	int i;
+	catcierge_capture_thread_t ct;
+	catcierge_capture_frame_t *frame;
+	catcierge_capture_stats_t stats;
+	fake_camera_t cam;
+	unsigned long prev_seq = 0;
+	double prev_timestamp = 0.0;
+
+	cam.count = 0;
+	cam.other = NULL;
+	cam.img = cvCreateImage(cvSize(32, 24), IPL_DEPTH_8U, 1);
+	cvSetZero(cam.img);
+
+	mu_assert("Failed to init capture thread",
+		!catcierge_capture_thread_init(&ct, CATCIERGE_CAPTURE_DEFAULT_BUFFERS, fake_grab, &cam));
+	mu_assert("Failed to start capture thread",
+		!catcierge_capture_thread_start(&ct));
+
+	for (i = 0; i < 50; i++)
+	{
+		frame = catcierge_capture_thread_acquire(&ct, 2.0);
+		mu_assert("Timed out waiting for frame", frame);
+
+		mu_assert("Expected frame sequence to increase", frame->seq > prev_seq);
+		mu_assert("Expected frame timestamps to be monotonic", frame->timestamp >= prev_timestamp);
+		mu_assert("Expected frame contents to match sequence number",
+			((unsigned char *)frame->img->imageData)[0] == (unsigned char)(frame->seq % 256));
+
+		prev_seq = frame->seq;
+		prev_timestamp = frame->timestamp;
+
+		// Simulate a slow matcher.
+		if (consumer_delay_ms)
+			catcierge_thread_sleep_ms(consumer_delay_ms);
+
+		catcierge_capture_thread_release(&ct, frame);
+	}
+
+	catcierge_capture_thread_stop(&ct);
+	catcierge_capture_thread_get_stats(&ct, &stats);
+
+	catcierge_test_STATUS("Captured %u, consumed %u, overwritten %u, dropped %u",
+		stats.captured, stats.consumed, stats.overwritten, stats.dropped);
+
+	mu_assert("Expected 50 consumed frames", stats.consumed == 50);
+	mu_assert("Expected no dropped frames", stats.dropped == 0);
+	mu_assert("Expected every captured frame to be consumed, overwritten or left in the ring",
+		stats.captured >= (stats.consumed + stats.overwritten));
+	mu_assert("Expected at most the ring size to be left unconsumed",
+		(stats.captured - stats.consumed - stats.overwritten) <= CATCIERGE_CAPTURE_DEFAULT_BUFFERS);
+
+	if (consumer_delay_ms)
+	{
+		mu_assert("Expected a slow consumer to cause overwritten frames", stats.overwritten > 0);
+	}
+
+	catcierge_capture_thread_destroy(&ct);
+	cvReleaseImage(&cam.img);
+
+	return NULL;
+}
+
+// The camera changes resolution and channels while capturing.
+static char *run_resize_tests()
+{
+	int i;
+	int switched = 0;
+	catcierge_capture_thread_t ct;
+	catcierge_capture_frame_t *frame;
+	fake_camera_t cam;
+
+	cam.count = 0;
+	cam.switch_at = 20;
+	cam.img = cvCreateImage(cvSize(32, 24), IPL_DEPTH_8U, 1);
+	cam.other = cvCreateImage(cvSize(64, 36), IPL_DEPTH_8U, 3);
+	cvSetZero(cam.img);
+	cvSetZero(cam.other);
+
+	mu_assert("Failed to init capture thread",
+		!catcierge_capture_thread_init(&ct, CATCIERGE_CAPTURE_DEFAULT_BUFFERS, fake_grab, &cam));
+	mu_assert("Failed to start capture thread",
+		!catcierge_capture_thread_start(&ct));
+
+	for (i = 0; i < 50; i++)
+	{
+		frame = catcierge_capture_thread_acquire(&ct, 2.0);
+		mu_assert("Timed out waiting for frame", frame);
+
+		if (frame->seq > cam.switch_at)
+		{
+			mu_assert("Expected the new frame size",
+				(frame->img->width == 64) && (frame->img->height == 36) && (frame->img->nChannels == 3));
+			switched = 1;
+		}
+		else
+		{
+			mu_assert("Expected the old frame size",
+				(frame->img->width == 32) && (frame->img->height == 24) && (frame->img->nChannels == 1));
+		}
+
+		mu_assert("Expected frame contents to match sequence number",
+			((unsigned char *)frame->img->imageData)[0] == (unsigned char)(frame->seq % 256));
+
+		catcierge_capture_thread_release(&ct, frame);
+	}
+
+	catcierge_capture_thread_stop(&ct);
+	mu_assert("Expected frames of the new size", switched);
+
+	catcierge_capture_thread_destroy(&ct);
+	cvReleaseImage(&cam.img);
+	cvReleaseImage(&cam.other);
+
+	return NULL;
+}
+
+int TEST_catcierge_capture_thread(int argc, char **argv)
+{
+	int ret = 0;
+	char *e = NULL;
+
+	CATCIERGE_RUN_TEST((e = run_init_tests()),
+		"Run init tests",
+		"Buffer count limits", &ret);
+
+	CATCIERGE_RUN_TEST((e = run_consume_tests(0)),
+		"Run consume tests",
+		"Fast consumer", &ret);
+
+	CATCIERGE_RUN_TEST((e = run_consume_tests(10)),
+		"Run consume tests",
+		"Slow consumer", &ret);
+
+	CATCIERGE_RUN_TEST((e = run_resize_tests()),
+		"Run resize tests",
+		"Frame size changes while capturing", &ret);
+
+	return ret;
+}
@@ -0,0 +1,251 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "catcierge_config.h"
+#include "catcierge_fsm.h"
+#include "catcierge_ccl.h"
+#include "minunit.h"
+#include "catcierge_test_config.h"
+#include "catcierge_test_helpers.h"
+#include "catcierge_test_common.h"
+#include <opencv2/imgproc/imgproc_c.h>
+
+static const double min_areas[] = { 0.0, 1.0, 10.0 };
+
+// The way prey contours were counted before.
+static int count_contours(IplImage *img, double min_area)
+{
+	int count = 0;
+	CvSeq *it = NULL;
+	CvSeq *contours = NULL;
+	CvMemStorage *storage = cvCreateMemStorage(0);
+	IplImage *tmp = cvCloneImage(img);
+
+	cvFindContours(tmp, storage, &contours,
+		sizeof(CvContour), CV_RETR_LIST, CV_CHAIN_APPROX_NONE, cvPoint(0, 0));
+
+	for (it = contours; it; it = it->h_next)
+	{
+		if (cvContourArea(it, CV_WHOLE_SEQ, 0) > min_area)
+			count++;
+	}
+
+	cvReleaseImage(&tmp);
+	cvReleaseMemStorage(&storage);
+
+	return count;
+}
+
+static char *compare_counts(catcierge_ccl_t *ccl, IplImage *img)
+{
+	size_t i;
+	int expected;
+	int count;
+	int early;
+
+	for (i = 0; i < sizeof(min_areas) / sizeof(min_areas[0]); i++)
+	{
+		expected = count_contours(img, min_areas[i]);
+		count = catcierge_ccl_count_image(ccl, img, min_areas[i], 0);
+		early = catcierge_ccl_count_image(ccl, img, min_areas[i], 2);
+
+		if (count != expected)
+		{
+			catcierge_test_STATUS("%dx%d min area %0.1f: %d contours, expected %d",
+				img->width, img->height, min_areas[i], count, expected);
+			return "Expected the same contour count as cvFindContours";
+		}
+
+		if ((expected < 2) ? (early != expected) : (early < 2))
+		{
+			return "Expected the same decision when stopping early";
+		}
+	}
+
+	return NULL;
+}
+
+static IplImage *create_random_image(int width, int height, int percent)
+{
+	int x;
+	int y;
+	IplImage *img = cvCreateImage(cvSize(width, height), IPL_DEPTH_8U, 1);
+
+	for (y = 0; y < height; y++)
+	{
+		for (x = 0; x < width; x++)
+		{
+			((unsigned char *)img->imageData)[y * img->widthStep + x] =
+				((rand() % 100) < percent) ? 255 : 0;
+		}
+	}
+
+	return img;
+}
+
+static char *run_random_tests()
+{
+	int i;
+	IplImage *img = NULL;
+	IplImage *tmp = NULL;
+	catcierge_ccl_t ccl;
+	char *e = NULL;
+
+	srand(1234);
+
+	if (catcierge_ccl_init(&ccl))
+		return "Failed to init labeler";
+
+	for (i = 0; i < 500; i++)
+	{
+		img = create_random_image(1 + rand() % 64, 1 + rand() % 64, rand() % 100);
+
+		// Blobs with holes.
+		if ((i % 3) == 0)
+		{
+			tmp = cvCloneImage(img);
+			cvDilate(img, tmp, NULL, 1);
+			cvErode(tmp, img, NULL, 1);
+			cvReleaseImage(&tmp);
+		}
+
+		e = compare_counts(&ccl, img);
+		cvReleaseImage(&img);
+
+		if (e)
+			break;
+	}
+
+	catcierge_test_STATUS("Compared %d random images", i);
+	catcierge_ccl_destroy(&ccl);
+
+	return e;
+}
+
+static char *run_shape_tests()
+{
+	int count;
+	IplImage *img = NULL;
+	catcierge_ccl_t ccl;
+
+	if (catcierge_ccl_init(&ccl))
+		return "Failed to init labeler";
+
+	img = cvCreateImage(cvSize(100, 80), IPL_DEPTH_8U, 1);
+
+	// A white background split by a dark band, touching the border.
+	cvSet(img, cvScalarAll(255), NULL);
+	cvRectangle(img, cvPoint(0, 30), cvPoint(99, 50), cvScalarAll(0), CV_FILLED, 8, 0);
+	count = catcierge_ccl_count_image(&ccl, img, 10.0, 0);
+	mu_assert("Expected 2 contours", (count == 2) && (count == count_contours(img, 10.0)));
+
+	// A ring, one contour outside and one for the hole.
+	cvSetZero(img);
+	cvCircle(img, cvPoint(50, 40), 20, cvScalarAll(255), 4, 8, 0);
+	count = catcierge_ccl_count_image(&ccl, img, 10.0, 0);
+	mu_assert("Expected 2 contours for a ring", (count == 2) && (count == count_contours(img, 10.0)));
+
+	// Nested rings.
+	cvCircle(img, cvPoint(50, 40), 8, cvScalarAll(255), 2, 8, 0);
+	count = catcierge_ccl_count_image(&ccl, img, 10.0, 0);
+	mu_assert("Expected 4 contours for nested rings", (count == 4) && (count == count_contours(img, 10.0)));
+	mu_assert("Expected to stop at 2 contours", catcierge_ccl_count_image(&ccl, img, 10.0, 2) == 2);
+
+	// Too small to count.
+	cvSetZero(img);
+	cvRectangle(img, cvPoint(10, 10), cvPoint(12, 12), cvScalarAll(255), CV_FILLED, 8, 0);
+	mu_assert("Expected small square to not count", catcierge_ccl_count_image(&ccl, img, 10.0, 0) == 0);
+	mu_assert("Expected small square to count", catcierge_ccl_count_image(&ccl, img, 1.0, 0) == 1);
+
+	// Only the ROI is looked at, without copying it.
+	cvSet(img, cvScalarAll(255), NULL);
+	cvRectangle(img, cvPoint(0, 30), cvPoint(99, 50), cvScalarAll(0), CV_FILLED, 8, 0);
+	cvSetImageROI(img, cvRect(10, 0, 50, 40));
+	count = catcierge_ccl_count_image(&ccl, img, 10.0, 0);
+	mu_assert("Expected 1 contour in the ROI", (count == 1) && (count == count_contours(img, 10.0)));
+	cvResetImageROI(img);
+
+	mu_assert("Expected NULL data to fail", catcierge_ccl_count(&ccl, NULL, 100, 100, 80, 10.0, 0) < 0);
+	mu_assert("Expected empty image to fail",
+		catcierge_ccl_count(&ccl, (unsigned char *)img->imageData, img->widthStep, 0, 80, 10.0, 0) < 0);
+
+	cvReleaseImage(&img);
+
+	img = cvCreateImage(cvSize(100, 80), IPL_DEPTH_8U, 3);
+	mu_assert("Expected color image to fail", catcierge_ccl_count_image(&ccl, img, 10.0, 0) < 0);
+	cvReleaseImage(&img);
+
+	catcierge_ccl_destroy(&ccl);
+
+	return NULL;
+}
+
+static char *run_corpus_tests()
+{
+	int i;
+	int j;
+	IplImage *img = NULL;
+	IplImage *thr_img = NULL;
+	IplImage *erod_img = NULL;
+	catcierge_ccl_t ccl;
+	char *e = NULL;
+
+	if (catcierge_ccl_init(&ccl))
+		return "Failed to init labeler";
+
+	// The series used by the haar matcher tests, thresholded
+	// and eroded the same way the prey detection does.
+	for (j = 6; (j <= 14) && !e; j++)
+	{
+		for (i = 1; (i <= 4) && !e; i++)
+		{
+			if (!(img = open_test_image(j, i)))
+			{
+				e = "Failed to load test image";
+				break;
+			}
+
+			thr_img = cvCreateImage(cvGetSize(img), 8, 1);
+			erod_img = cvCreateImage(cvGetSize(img), 8, 1);
+
+			cvThreshold(img, thr_img, 0, 255, CV_THRESH_BINARY | CV_THRESH_OTSU);
+			cvErode(thr_img, erod_img, NULL, 3);
+
+			if (!(e = compare_counts(&ccl, thr_img)))
+				e = compare_counts(&ccl, erod_img);
+
+			cvThreshold(img, thr_img, 0, 255, CV_THRESH_BINARY_INV | CV_THRESH_OTSU);
+
+			if (!e)
+				e = compare_counts(&ccl, thr_img);
+
+			cvReleaseImage(&img);
+			cvReleaseImage(&thr_img);
+			cvReleaseImage(&erod_img);
+		}
+	}
+
+	catcierge_ccl_destroy(&ccl);
+
+	return e;
+}
+
+int TEST_catcierge_ccl(int argc, char **argv)
+{
+	int ret = 0;
+	char *e = NULL;
+
+	CATCIERGE_RUN_TEST((e = run_random_tests()),
+		"Run contour count random image tests",
+		"Same count as cvFindContours", &ret);
+
+	CATCIERGE_RUN_TEST((e = run_shape_tests()),
+		"Run contour count shape tests",
+		"Contour count shapes", &ret);
+
+	CATCIERGE_RUN_TEST((e = run_corpus_tests()),
+		"Run contour count test image tests",
+		"Same count on the test images", &ret);
+
+	return ret;
+}
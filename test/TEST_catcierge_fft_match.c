@@ -0,0 +1,134 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include "catcierge_fft_match.h"
+#include "minunit.h"
+#include "catcierge_test_helpers.h"
+
+#define MATCH_TOLERANCE 0.0001
+
+static IplImage *create_test_frame(int width, int height)
+{
+	int x;
+	int y;
+	IplImage *img = cvCreateImage(cvSize(width, height), IPL_DEPTH_8U, 1);
+
+	// Binary blobs, like the thresholded frames we match against.
+	srand(1234);
+	cvSet(img, cvScalarAll(255), NULL);
+
+	for (y = 0; y < 40; y++)
+	{
+		x = rand() % width;
+		cvRectangle(img, cvPoint(x, rand() % height),
+			cvPoint(x + rand() % 40, rand() % height), cvScalarAll(0), CV_FILLED, 8, 0);
+	}
+
+	return img;
+}
+
+static char *compare_template(IplImage *frame, CvRect rect, int flat)
+{
+	double max_diff;
+	double fft_max;
+	double ref_max;
+	double min_val;
+	CvPoint min_loc;
+	CvPoint fft_loc;
+	CvPoint ref_loc;
+	catcierge_fft_frame_t f;
+	catcierge_fft_template_t t;
+	IplImage *templ = cvCreateImage(cvSize(rect.width, rect.height), IPL_DEPTH_8U, 1);
+	CvSize res_size = cvSize(frame->width - rect.width + 1, frame->height - rect.height + 1);
+	IplImage *res = cvCreateImage(res_size, IPL_DEPTH_32F, 1);
+	IplImage *ref = cvCreateImage(res_size, IPL_DEPTH_32F, 1);
+	IplImage *diff = cvCreateImage(res_size, IPL_DEPTH_32F, 1);
+
+	cvSetImageROI(frame, rect);
+	cvCopy(frame, templ, NULL);
+	cvResetImageROI(frame);
+
+	if (flat)
+		cvSet(templ, cvScalarAll(255), NULL);
+	else
+		cvRectangle(templ, cvPoint(2, 2), cvPoint(6, 6), cvScalarAll(0), CV_FILLED, 8, 0);
+
+	mu_assert("Failed to init FFT frame", !catcierge_fft_frame_init(&f, frame->width, frame->height));
+	mu_assert("Failed to init FFT template", !catcierge_fft_template_init(&t, &f, templ));
+	mu_assert("Failed to set FFT frame", !catcierge_fft_frame_set(&f, frame));
+	mu_assert("Failed to FFT match", !catcierge_fft_match(&f, &t, res));
+
+	cvMatchTemplate(frame, templ, ref, CV_TM_CCOEFF_NORMED);
+
+	cvAbsDiff(res, ref, diff);
+	cvMinMaxLoc(diff, &min_val, &max_diff, &min_loc, &fft_loc, NULL);
+	cvMinMaxLoc(res, &min_val, &fft_max, &min_loc, &fft_loc, NULL);
+	cvMinMaxLoc(ref, &min_val, &ref_max, &min_loc, &ref_loc, NULL);
+
+	catcierge_test_STATUS("%dx%d template: max %f at %d,%d (reference %f at %d,%d), max difference %g",
+		rect.width, rect.height, fft_max, fft_loc.x, fft_loc.y,
+		ref_max, ref_loc.x, ref_loc.y, max_diff);
+
+	mu_assert("Expected FFT result to be within tolerance", max_diff < MATCH_TOLERANCE);
+	mu_assert("Expected the same best match", fabs(fft_max - ref_max) < MATCH_TOLERANCE);
+
+	catcierge_fft_template_destroy(&t);
+	catcierge_fft_frame_destroy(&f);
+	cvReleaseImage(&templ);
+	cvReleaseImage(&res);
+	cvReleaseImage(&ref);
+	cvReleaseImage(&diff);
+
+	return NULL;
+}
+
+static char *run_compare_tests()
+{
+	char *e = NULL;
+	IplImage *frame = create_test_frame(320, 240);
+
+	if ((e = compare_template(frame, cvRect(100, 80, 80, 60), 0))) goto fail;
+	if ((e = compare_template(frame, cvRect(0, 0, 17, 13), 0))) goto fail;
+	if ((e = compare_template(frame, cvRect(200, 100, 120, 140), 0))) goto fail;
+	if ((e = compare_template(frame, cvRect(0, 0, 320, 240), 0))) goto fail;
+	if ((e = compare_template(frame, cvRect(10, 10, 30, 30), 1))) goto fail;
+
+fail:
+	cvReleaseImage(&frame);
+	return e;
+}
+
+static char *run_invalid_tests()
+{
+	catcierge_fft_frame_t f;
+	catcierge_fft_template_t t;
+	IplImage *big = cvCreateImage(cvSize(400, 100), IPL_DEPTH_8U, 1);
+	IplImage *color = cvCreateImage(cvSize(320, 240), IPL_DEPTH_8U, 3);
+
+	mu_assert("Failed to init FFT frame", !catcierge_fft_frame_init(&f, 320, 240));
+	mu_assert("Expected too large template to fail", catcierge_fft_template_init(&t, &f, big));
+	mu_assert("Expected color frame to fail", catcierge_fft_frame_set(&f, color));
+
+	catcierge_fft_frame_destroy(&f);
+	cvReleaseImage(&big);
+	cvReleaseImage(&color);
+
+	return NULL;
+}
+
+int TEST_catcierge_fft_match(int argc, char **argv)
+{
+	int ret = 0;
+	char *e = NULL;
+
+	CATCIERGE_RUN_TEST((e = run_compare_tests()),
+		"Run FFT match compare tests",
+		"FFT match gives the same result as cvMatchTemplate", &ret);
+
+	CATCIERGE_RUN_TEST((e = run_invalid_tests()),
+		"Run FFT match invalid input tests",
+		"FFT match invalid input", &ret);
+
+	return ret;
+}
@@ -0,0 +1,122 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "catcierge_frame_ctx.h"
+#include "minunit.h"
+#include "catcierge_test_helpers.h"
+
+static char *run_gray_tests()
+{
+	catcierge_frame_ctx_t f;
+	IplImage *img = cvCreateImage(cvSize(320, 240), IPL_DEPTH_8U, 3);
+	IplImage *gray_img = cvCreateImage(cvSize(320, 240), IPL_DEPTH_8U, 1);
+	IplImage *gray;
+	IplImage *gray2;
+
+	catcierge_frame_ctx_init(&f);
+	cvSet(img, cvScalarAll(100), NULL);
+
+	catcierge_frame_ctx_set(&f, img);
+	mu_assert("Expected frame itself before gray is computed", catcierge_frame_ctx_luma(&f) == img);
+
+	gray = catcierge_frame_ctx_gray(&f);
+	mu_assert("Expected gray plane", gray && (gray != img) && (gray->nChannels == 1));
+	mu_assert("Expected gray pixel value", (unsigned char)gray->imageData[0] == 100);
+
+	gray2 = catcierge_frame_ctx_gray(&f);
+	mu_assert("Expected cached gray plane", gray2 == gray);
+	mu_assert("Expected gray plane as luma", catcierge_frame_ctx_luma(&f) == gray);
+	mu_assert("Expected gray to be computed once", f.stats.gray_computed == 1);
+	mu_assert("Expected 2 gray hits", f.stats.gray_hits == 2);
+
+	// A new frame in the same buffer must be converted again.
+	cvSet(img, cvScalarAll(50), NULL);
+	catcierge_frame_ctx_set(&f, img);
+	mu_assert("Expected frame itself for new frame", catcierge_frame_ctx_luma(&f) == img);
+	gray2 = catcierge_frame_ctx_gray(&f);
+	mu_assert("Expected gray buffer to be reused", gray2 == gray);
+	mu_assert("Expected new gray pixel value", (unsigned char)gray2->imageData[0] == 50);
+	mu_assert("Expected gray to be computed twice", f.stats.gray_computed == 2);
+
+	// Gray scale frames are used as is.
+	catcierge_frame_ctx_set(&f, gray_img);
+	mu_assert("Expected gray frame to be used as is", catcierge_frame_ctx_gray(&f) == gray_img);
+	mu_assert("Expected no conversion of gray frame", f.stats.gray_computed == 2);
+	mu_assert("Expected 3 frames", f.stats.frames == 3);
+
+	catcierge_frame_ctx_print_stats(&f);
+	catcierge_frame_ctx_destroy(&f);
+	cvReleaseImage(&img);
+	cvReleaseImage(&gray_img);
+
+	return NULL;
+}
+
+static char *run_plane_tests()
+{
+	catcierge_frame_ctx_t f;
+	IplImage *img = cvCreateImage(cvSize(320, 240), IPL_DEPTH_8U, 3);
+	IplImage *small = cvCreateImage(cvSize(160, 120), IPL_DEPTH_8U, 3);
+	IplImage *eq;
+	IplImage *thr;
+	IplImage *copy;
+
+	catcierge_frame_ctx_init(&f);
+	cvSet(img, cvScalarAll(100), NULL);
+	catcierge_frame_ctx_set(&f, img);
+
+	eq = catcierge_frame_ctx_equalized(&f);
+	mu_assert("Expected equalized plane", eq && (eq->nChannels == 1));
+	mu_assert("Expected cached equalized plane", catcierge_frame_ctx_equalized(&f) == eq);
+	mu_assert("Expected equalize once", (f.stats.eq_computed == 1) && (f.stats.eq_hits == 1));
+
+	thr = catcierge_frame_ctx_threshold(&f, 90, 255);
+	mu_assert("Expected threshold plane", thr && (thr->nChannels == 1));
+	mu_assert("Expected threshold pixel value", (unsigned char)thr->imageData[0] == 255);
+	mu_assert("Expected cached threshold plane", catcierge_frame_ctx_threshold(&f, 90, 255) == thr);
+	mu_assert("Expected gray to be shared by the planes", f.stats.gray_computed == 1);
+
+	// Other levels.
+	thr = catcierge_frame_ctx_threshold(&f, 110, 255);
+	mu_assert("Expected new threshold pixel value", (unsigned char)thr->imageData[0] == 0);
+	mu_assert("Expected threshold twice", (f.stats.thr_computed == 2) && (f.stats.thr_hits == 1));
+
+	// ROI left by a consumer is reset.
+	cvSetImageROI(thr, cvRect(10, 10, 20, 20));
+	thr = catcierge_frame_ctx_threshold(&f, 110, 255);
+	mu_assert("Expected ROI to be reset", !thr->roi);
+
+	copy = catcierge_frame_ctx_copy(&f);
+	mu_assert("Expected copy of frame", copy && (copy != img) && (copy->nChannels == 3)
+		&& !memcmp(copy->imageData, img->imageData, img->imageSize));
+
+	// New frame size.
+	catcierge_frame_ctx_set(&f, small);
+	eq = catcierge_frame_ctx_equalized(&f);
+	mu_assert("Expected planes to follow the frame size", (eq->width == 160) && (eq->height == 120));
+
+	catcierge_frame_ctx_set(&f, NULL);
+	mu_assert("Expected no planes without a frame", !catcierge_frame_ctx_gray(&f) && !catcierge_frame_ctx_copy(&f));
+
+	catcierge_frame_ctx_destroy(&f);
+	cvReleaseImage(&img);
+	cvReleaseImage(&small);
+
+	return NULL;
+}
+
+int TEST_catcierge_frame_ctx(int argc, char **argv)
+{
+	int ret = 0;
+	char *e = NULL;
+
+	CATCIERGE_RUN_TEST((e = run_gray_tests()),
+		"Run frame context gray tests",
+		"Frame context gray plane", &ret);
+
+	CATCIERGE_RUN_TEST((e = run_plane_tests()),
+		"Run frame context plane tests",
+		"Frame context planes", &ret);
+
+	return ret;
+}
@@ -0,0 +1,257 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "catcierge_frame_source.h"
+#include "catcierge_timer.h"
+#include "catcierge_util.h"
+#include "minunit.h"
+#include "catcierge_test_helpers.h"
+
+#define TEST_RAW_PATH "frame_source_test.raw"
+#define TEST_DIR_PATH "frame_source_test_dir"
+#define TEST_WIDTH 32
+#define TEST_HEIGHT 24
+#define TEST_FRAME_COUNT 5
+
+static int create_raw_file()
+{
+	int i;
+	FILE *f;
+	unsigned char frame[TEST_WIDTH * TEST_HEIGHT];
+
+	if (!(f = fopen(TEST_RAW_PATH, "wb")))
+		return -1;
+
+	// Every frame is filled with its index.
+	for (i = 0; i < TEST_FRAME_COUNT; i++)
+	{
+		memset(frame, i, sizeof(frame));
+		fwrite(frame, sizeof(frame), 1, f);
+	}
+
+	// Partial frame at the end that should be ignored.
+	fwrite(frame, 10, 1, f);
+	fclose(f);
+
+	return 0;
+}
+
+static void init_raw_args(catcierge_frame_source_args_t *args)
+{
+	catcierge_frame_source_args_init(args);
+	args->type = FRAME_SOURCE_RAW;
+	args->path = TEST_RAW_PATH;
+	args->width = TEST_WIDTH;
+	args->height = TEST_HEIGHT;
+	args->channels = 1;
+	args->fps = 0.0;
+}
+
+static char *run_raw_tests()
+{
+	int i;
+	IplImage *img;
+	catcierge_frame_source_t src;
+	catcierge_frame_source_args_t args;
+
+	mu_assert("Failed to create raw file", !create_raw_file());
+	init_raw_args(&args);
+
+	mu_assert("Failed to init raw source", !catcierge_frame_source_init(&src, &args));
+	mu_assert("Failed to open raw source", !catcierge_frame_source_open(&src));
+
+	for (i = 0; i < TEST_FRAME_COUNT; i++)
+	{
+		img = catcierge_frame_source_next(&src);
+		mu_assert("Expected a frame", img);
+		mu_assert("Expected correct frame size",
+			(img->width == TEST_WIDTH) && (img->height == TEST_HEIGHT) && (img->nChannels == 1));
+		mu_assert("Expected frame contents to match frame index",
+			((unsigned char *)img->imageData)[0] == i);
+		catcierge_frame_source_release(&src, img);
+	}
+
+	mu_assert("Expected no more frames", !catcierge_frame_source_next(&src));
+	mu_assert("Expected end of replay", src.eof);
+	mu_assert("Expected frame count to match", src.frame_count == TEST_FRAME_COUNT);
+
+	catcierge_frame_source_close(&src);
+
+	return NULL;
+}
+
+static char *run_raw_loop_tests()
+{
+	int i;
+	IplImage *img;
+	catcierge_frame_source_t src;
+	catcierge_frame_source_args_t args;
+
+	mu_assert("Failed to create raw file", !create_raw_file());
+	init_raw_args(&args);
+	args.loop = 1;
+
+	mu_assert("Failed to init raw source", !catcierge_frame_source_init(&src, &args));
+	mu_assert("Failed to open raw source", !catcierge_frame_source_open(&src));
+
+	for (i = 0; i < (TEST_FRAME_COUNT * 3); i++)
+	{
+		img = catcierge_frame_source_next(&src);
+		mu_assert("Expected a frame", img);
+		mu_assert("Expected frame contents to match frame index",
+			((unsigned char *)img->imageData)[0] == (i % TEST_FRAME_COUNT));
+		catcierge_frame_source_release(&src, img);
+	}
+
+	mu_assert("Expected no end of replay when looping", !src.eof);
+
+	catcierge_frame_source_close(&src);
+
+	return NULL;
+}
+
+static char *run_throttle_tests()
+{
+	int i;
+	double start;
+	double elapsed;
+	IplImage *img;
+	catcierge_frame_source_t src;
+	catcierge_frame_source_args_t args;
+
+	mu_assert("Failed to create raw file", !create_raw_file());
+	init_raw_args(&args);
+	args.fps = 50.0;
+
+	mu_assert("Failed to init raw source", !catcierge_frame_source_init(&src, &args));
+	mu_assert("Failed to open raw source", !catcierge_frame_source_open(&src));
+
+	start = catcierge_timer_now();
+
+	for (i = 0; i < TEST_FRAME_COUNT; i++)
+	{
+		img = catcierge_frame_source_next(&src);
+		mu_assert("Expected a frame", img);
+		catcierge_frame_source_release(&src, img);
+	}
+
+	elapsed = catcierge_timer_now() - start;
+	catcierge_test_STATUS("%d frames at %0.1f fps took %0.3f seconds",
+		TEST_FRAME_COUNT, args.fps, elapsed);
+
+	// The first frame is returned right away.
+	mu_assert("Expected replay to be throttled",
+		elapsed >= ((TEST_FRAME_COUNT - 1) / args.fps) * 0.9);
+
+	catcierge_frame_source_close(&src);
+
+	return NULL;
+}
+
+static char *run_dir_tests(int preload)
+{
+	int i;
+	IplImage *img;
+	char path[1024];
+	catcierge_frame_source_t src;
+	catcierge_frame_source_args_t args;
+	// Written out of order, should be replayed in alphabetical order.
+	const char *names[] = { "frame2.png", "frame0.png", "frame1.png" };
+	const int values[] = { 200, 0, 100 };
+
+	mu_assert("Failed to create test dir", !catcierge_make_path("%s", TEST_DIR_PATH));
+
+	for (i = 0; i < 3; i++)
+	{
+		img = cvCreateImage(cvSize(TEST_WIDTH, TEST_HEIGHT), IPL_DEPTH_8U, 1);
+		cvSet(img, cvScalarAll(values[i]), NULL);
+		snprintf(path, sizeof(path), "%s/%s", TEST_DIR_PATH, names[i]);
+		mu_assert("Failed to save test image", cvSaveImage(path, img, 0));
+		cvReleaseImage(&img);
+	}
+
+	// Should be ignored.
+	snprintf(path, sizeof(path), "%s/not_an_image.txt", TEST_DIR_PATH);
+	fclose(fopen(path, "w"));
+
+	catcierge_frame_source_args_init(&args);
+	args.type = FRAME_SOURCE_DIRECTORY;
+	args.path = TEST_DIR_PATH;
+	args.fps = 0.0;
+	args.preload = preload;
+
+	mu_assert("Failed to init dir source", !catcierge_frame_source_init(&src, &args));
+	mu_assert("Failed to open dir source", !catcierge_frame_source_open(&src));
+
+	for (i = 0; i < 3; i++)
+	{
+		img = catcierge_frame_source_next(&src);
+		mu_assert("Expected a frame", img);
+		mu_assert("Expected images in alphabetical order",
+			((unsigned char *)img->imageData)[0] == (i * 100));
+		catcierge_frame_source_release(&src, img);
+	}
+
+	mu_assert("Expected no more frames", !catcierge_frame_source_next(&src));
+	mu_assert("Expected end of replay", src.eof);
+
+	catcierge_frame_source_close(&src);
+
+	return NULL;
+}
+
+static char *run_invalid_tests()
+{
+	catcierge_frame_source_t src;
+	catcierge_frame_source_args_t args;
+
+	catcierge_frame_source_args_init(&args);
+	args.type = FRAME_SOURCE_RAW;
+	args.path = "this_file_does_not_exist.raw";
+
+	mu_assert("Failed to init raw source", !catcierge_frame_source_init(&src, &args));
+	mu_assert("Expected open of missing raw file to fail", catcierge_frame_source_open(&src));
+	mu_assert("Expected no frame from unopened source", !catcierge_frame_source_next(&src));
+	catcierge_frame_source_close(&src);
+
+	args.type = FRAME_SOURCE_DIRECTORY;
+	args.path = NULL;
+
+	mu_assert("Failed to init dir source", !catcierge_frame_source_init(&src, &args));
+	mu_assert("Expected open without path to fail", catcierge_frame_source_open(&src));
+	catcierge_frame_source_close(&src);
+
+	return NULL;
+}
+
+int TEST_catcierge_frame_source(int argc, char **argv)
+{
+	int ret = 0;
+	char *e = NULL;
+
+	CATCIERGE_RUN_TEST((e = run_raw_tests()),
+		"Run raw source tests",
+		"Raw replay", &ret);
+
+	CATCIERGE_RUN_TEST((e = run_raw_loop_tests()),
+		"Run raw source loop tests",
+		"Raw replay loop", &ret);
+
+	CATCIERGE_RUN_TEST((e = run_throttle_tests()),
+		"Run throttle tests",
+		"Throttled replay", &ret);
+
+	CATCIERGE_RUN_TEST((e = run_dir_tests(0)),
+		"Run dir source tests",
+		"Dir replay", &ret);
+
+	CATCIERGE_RUN_TEST((e = run_dir_tests(1)),
+		"Run dir source tests",
+		"Dir replay preloaded", &ret);
+
+	CATCIERGE_RUN_TEST((e = run_invalid_tests()),
+		"Run invalid frame source tests",
+		"Invalid frame sources", &ret);
+
+	return ret;
+}
@@ -0,0 +1,260 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "catcierge_config.h"
+#include "catcierge_fsm.h"
+#include "catcierge_util.h"
+#include "minunit.h"
+#include "catcierge_test_config.h"
+#include "catcierge_test_helpers.h"
+#include "catcierge_args.h"
+#include "catcierge_types.h"
+#include <opencv2/imgproc/imgproc_c.h>
+#include <opencv2/highgui/highgui_c.h>
+#include "catcierge_test_common.h"
+
+#define TEST_BURST_DIR "fsm_burst_test_dir"
+#define TEST_BURST_REC "fsm_burst_test.rec"
+
+static void init_haar_args(catcierge_args_t *args)
+{
+	catcierge_haar_matcher_args_init(&args->haar);
+	args->saveimg = 0;
+	args->matcher = "haar";
+	args->matcher_type = MATCHER_HAAR;
+	args->ok_matches_needed = 3;
+	args->haar.prey_method = PREY_METHOD_ADAPTIVE;
+	args->haar.prey_steps = 2;
+	args->haar.cascade = CATCIERGE_CASCADE;
+}
+
+// Writes the obstruct frame followed by the 4 match frames of a series,
+// so that they can be replayed as a directory frame source.
+static char *create_series_dir(int series, char *path, size_t path_len)
+{
+	int i;
+	IplImage *img;
+	char img_path[1024];
+
+	snprintf(path, path_len, "%s/%04d", TEST_BURST_DIR, series);
+
+	if (catcierge_make_path("%s", path))
+		return "Failed to create test dir";
+
+	for (i = 0; i <= DEFAULT_MATCH_GROUP_SIZE; i++)
+	{
+		if (!(img = open_test_image(series, (i == 0) ? 1 : i)))
+			return "Failed to load test image";
+
+		snprintf(img_path, sizeof(img_path), "%s/frame%d.png", path, i);
+
+		if (!cvSaveImage(img_path, img, 0))
+		{
+			cvReleaseImage(&img);
+			return "Failed to save test image";
+		}
+
+		cvReleaseImage(&img);
+	}
+
+	return NULL;
+}
+
+// The decision one frame at a time, to compare the burst against.
+static char *run_sequential(int series, catcierge_state_func_t *state, int *success_count)
+{
+	int i;
+	catcierge_grb_t grb;
+
+	catcierge_grabber_init(&grb);
+	init_haar_args(&grb.args);
+
+	if (catcierge_matcher_init(&grb.matcher, catcierge_get_matcher_args(&grb.args)))
+		return "Failed to init catcierge lib!\n";
+
+	catcierge_set_state(&grb, catcierge_state_waiting);
+	load_test_image_and_run(&grb, series, 1);
+
+	for (i = 1; i <= DEFAULT_MATCH_GROUP_SIZE; i++)
+	{
+		load_test_image_and_run(&grb, series, i);
+	}
+
+	*state = grb.state;
+	*success_count = grb.match_group.success_count;
+
+	catcierge_matcher_destroy(&grb.matcher);
+	catcierge_grabber_destroy(&grb);
+
+	return NULL;
+}
+
+// Every frame of the burst is recorded, not only the last one.
+static char *check_burst_recording()
+{
+	int count = 0;
+	catcierge_record_reader_t reader;
+	catcierge_record_frame_t frame;
+
+	mu_assert("Failed to open recording", !catcierge_record_reader_open(&reader, TEST_BURST_REC));
+
+	while (!catcierge_record_reader_next(&reader, &frame))
+	{
+		mu_assert("Expected the obstructing frame to be recorded as waiting, the rest as matching",
+			frame.state == ((count == 0) ? RECORD_STATE_WAITING : RECORD_STATE_MATCHING));
+		count++;
+	}
+
+	catcierge_record_reader_close(&reader);
+
+	mu_assert("Expected every frame to be recorded", (count == (1 + DEFAULT_MATCH_GROUP_SIZE)));
+
+	return NULL;
+}
+
+static char *run_burst(int series, int workers)
+{
+	char path[1024];
+	catcierge_grb_t grb;
+	catcierge_args_t *args = &grb.args;
+	catcierge_state_func_t expected_state = NULL;
+	int expected_success_count = 0;
+	char *e = NULL;
+
+	if ((e = create_series_dir(series, path, sizeof(path))))
+		return e;
+
+	if ((e = run_sequential(series, &expected_state, &expected_success_count)))
+		return e;
+
+	catcierge_grabber_init(&grb);
+	init_haar_args(args);
+	args->burst = 1;
+	args->burst_workers = workers;
+	args->source.type = FRAME_SOURCE_DIRECTORY;
+	args->source.path = path;
+	args->source.fps = 0.0;
+	args->record_path = TEST_BURST_REC;
+	args->record_size = 4;
+	remove(TEST_BURST_REC);
+
+	if (catcierge_matcher_init(&grb.matcher, catcierge_get_matcher_args(args)))
+		return "Failed to init catcierge lib!\n";
+
+	mu_assert("Failed to init burst matching", !catcierge_burst_init(&grb));
+	mu_assert("Expected burst to stay on", args->burst);
+	mu_assert("Failed to open frame source", !catcierge_setup_camera(&grb));
+
+	catcierge_set_state(&grb, catcierge_state_waiting);
+
+	// The obstructing frame.
+	mu_assert("Expected a frame", (grb.img = catcierge_next_frame(&grb)));
+	catcierge_run_state(&grb);
+	mu_assert("Expected MATCHING state", (grb.state == catcierge_state_matching));
+
+	// All 4 matches are made during a single state machine tick.
+	mu_assert("Expected a frame", (grb.img = catcierge_next_frame(&grb)));
+	catcierge_run_state(&grb);
+
+	catcierge_test_STATUS("Series %d, %d workers: %d successful matches, %d sequentially, decision after %0.1fms",
+		series, catcierge_workers_count(&grb.burst_workers),
+		grb.match_group.success_count, expected_success_count,
+		1000.0 * grb.match_group.decision_latency);
+
+	mu_assert("Expected all frames to be matched", (grb.match_group.match_count == DEFAULT_MATCH_GROUP_SIZE));
+	mu_assert("Expected the same successful match count as sequential matching",
+		(grb.match_group.success_count == expected_success_count));
+	mu_assert("Expected the same state as sequential matching", (grb.state == expected_state));
+	mu_assert("Expected all frames to be used", !catcierge_next_frame(&grb));
+
+	catcierge_destroy_camera(&grb);
+	catcierge_matcher_destroy(&grb.matcher);
+	catcierge_grabber_destroy(&grb);
+
+	if ((e = check_burst_recording()))
+		return e;
+
+	remove(TEST_BURST_REC);
+
+	return NULL;
+}
+
+static char *run_burst_tests()
+{
+	int j;
+	char *e = NULL;
+
+	// Series 6 to 9 are allowed in, 10 to 14 have prey.
+	for (j = 6; (j <= 14) && !e; j++)
+	{
+		e = run_burst(j, (j % 2) ? 1 : DEFAULT_MATCH_GROUP_SIZE);
+	}
+
+	return e;
+}
+
+static char *run_burst_eof_tests()
+{
+	int i;
+	char path[1024];
+	char img_path[1024];
+	catcierge_grb_t grb;
+	catcierge_args_t *args = &grb.args;
+	char *e = NULL;
+
+	if ((e = create_series_dir(10, path, sizeof(path))))
+		return e;
+
+	// Leave only the obstructing frame and two more.
+	for (i = 3; i <= DEFAULT_MATCH_GROUP_SIZE; i++)
+	{
+		snprintf(img_path, sizeof(img_path), "%s/frame%d.png", path, i);
+		remove(img_path);
+	}
+
+	catcierge_grabber_init(&grb);
+	init_haar_args(args);
+	args->burst = 1;
+	args->source.type = FRAME_SOURCE_DIRECTORY;
+	args->source.path = path;
+	args->source.fps = 0.0;
+
+	if (catcierge_matcher_init(&grb.matcher, catcierge_get_matcher_args(args)))
+		return "Failed to init catcierge lib!\n";
+
+	mu_assert("Failed to init burst matching", !catcierge_burst_init(&grb));
+	mu_assert("Failed to open frame source", !catcierge_setup_camera(&grb));
+
+	catcierge_set_state(&grb, catcierge_state_waiting);
+	mu_assert("Expected a frame", (grb.img = catcierge_next_frame(&grb)));
+	catcierge_run_state(&grb);
+	mu_assert("Expected a frame", (grb.img = catcierge_next_frame(&grb)));
+	catcierge_run_state(&grb);
+
+	mu_assert("Expected no decision without enough frames",
+		(grb.state == catcierge_state_matching) && (grb.match_group.match_count == 0));
+	mu_assert("Expected end of replay", grb.source.eof);
+
+	catcierge_destroy_camera(&grb);
+	catcierge_matcher_destroy(&grb.matcher);
+	catcierge_grabber_destroy(&grb);
+
+	return NULL;
+}
+
+int TEST_catcierge_fsm_burst(int argc, char **argv)
+{
+	char *e = NULL;
+	int ret = 0;
+	catcierge_test_HEADLINE("TEST_catcierge_fsm_burst");
+
+	CATCIERGE_RUN_TEST((e = run_burst_tests()),
+		"Run burst match tests",
+		"Same decision as matching one frame at a time", &ret);
+
+	CATCIERGE_RUN_TEST((e = run_burst_eof_tests()),
+		"Run burst match end of replay tests",
+		"No decision without enough frames", &ret);
+
+	return ret;
+}
@@ -126,8 +126,14 @@ static char *run_failure_tests(catcierge_haar_prey_method_t prey_method)
 
 static char *run_save_steps_test()
 {
+	size_t i;
+	size_t j;
+	int step_count = 0;
+	unsigned int color_count = 0;
+	unsigned int reserved;
 	catcierge_grb_t grb;
 	catcierge_args_t *args = &grb.args;
+	catcierge_image_pool_stats_t stats;
 
 	catcierge_grabber_init(&grb);
 
@@ -157,6 +163,15 @@ static char *run_save_steps_test()
 	// and triggers the matching.
 	load_test_image_and_run(&grb, 1, 1);
 
+	// The match and step images are created on the first frame.
+	catcierge_image_pool_get_stats(&grb.match_group.images, &stats);
+	reserved = stats.allocated;
+	catcierge_test_STATUS("Image pool: %u buffers reserved", reserved);
+	mu_assert("Expected 11 step images per match", grb.matcher->step_img_max == 11);
+	mu_assert("Expected a buffer for each match and step image",
+		reserved == (unsigned int)(grb.match_group.max_count * (1 + grb.matcher->step_img_max)));
+	mu_assert("Expected the pool to hold only what is reserved", stats.capacity == reserved);
+
 	// Some normal images.
 	load_test_image_and_run(&grb, 10, 1);
 	catcierge_test_STATUS("Step image count: %d", grb.match_group.matches[0].result.step_img_count);
@@ -176,6 +191,168 @@ static char *run_save_steps_test()
 	catcierge_test_STATUS("Step image count: %d", grb.match_group.matches[3].result.step_img_count);
 	mu_assert("Expected 10 step images", grb.match_group.matches[3].result.step_img_count == 11);
 
+	// The match images are given back when saved, the
+	// step images when a new match is made in their place.
+	for (i = 0; i < grb.match_group.max_count; i++)
+	{
+		match_result_t *res = &grb.match_group.matches[i].result;
+		step_count += (int)res->step_img_count;
+
+		for (j = 0; j < res->step_img_count; j++)
+		{
+			color_count += (res->steps[j].img->nChannels == 3);
+		}
+	}
+
+	catcierge_image_pool_get_stats(&grb.match_group.images, &stats);
+	catcierge_test_STATUS("Image pool: %u buffers created, %u in use", stats.allocated, stats.used);
+	mu_assert("Expected the step images to be borrowed", stats.used == (unsigned int)step_count);
+	mu_assert("Expected no images outside the pool", stats.exhausted == 0);
+
+	// The final step images are the only color ones, the pool grows
+	// for them instead of replacing the reserved gray buffers.
+	catcierge_test_STATUS("Image pool: %u color step images, %u recreated", color_count, stats.recreated);
+	mu_assert("Expected only the color step images to be created after the first frame",
+		stats.allocated == (reserved + color_count));
+	mu_assert("Expected no buffer to be recreated", stats.recreated == 0);
+
+	catcierge_matcher_destroy(&grb.matcher);
+	catcierge_grabber_destroy(&grb);
+
+	return NULL;
+}
+
+static char *run_early_decision_tests()
+{
+	int i;
+	int j;
+	int frames_used = 0;
+	catcierge_grb_t grb;
+	catcierge_args_t *args = &grb.args;
+
+	catcierge_grabber_init(&grb);
+
+	catcierge_haar_matcher_args_init(&args->haar);
+	args->saveimg = 0;
+	args->matcher = "haar";
+	args->matcher_type = MATCHER_HAAR;
+	args->early_decision = 1;
+	args->haar.prey_method = PREY_METHOD_ADAPTIVE;
+	args->haar.prey_steps = 2;
+	args->haar.cascade = CATCIERGE_CASCADE;
+
+	if (catcierge_matcher_init(&grb.matcher, (catcierge_matcher_args_t *)&args->haar))
+	{
+		return "Failed to init catcierge lib!\n";
+	}
+
+	catcierge_set_state(&grb, catcierge_state_waiting);
+
+	// Same series and settings as the success and failure tests.
+	for (j = 6; j <= 14; j++)
+	{
+		args->ok_matches_needed = (j <= 9) ? 2 : 3;
+
+		load_test_image_and_run(&grb, j, 1);
+		mu_assert("Expected MATCHING state", (grb.state == catcierge_state_matching));
+
+		for (i = 1; (i <= 4) && (grb.state == catcierge_state_matching); i++)
+		{
+			load_test_image_and_run(&grb, j, i);
+		}
+
+		catcierge_test_STATUS("Test series %d decided after %d matches",
+			j, (int)grb.match_group.match_count);
+		frames_used += (int)grb.match_group.match_count;
+
+		if (j <= 9)
+			mu_assert("Expected KEEP OPEN state", (grb.state == catcierge_state_keepopen));
+		else
+			mu_assert("Expected LOCKOUT state", (grb.state == catcierge_state_lockout));
+
+		mu_assert("Expected early decision flag to match the match count",
+			grb.match_group.early_decision == (grb.match_group.match_count < DEFAULT_MATCH_GROUP_SIZE));
+
+		load_test_image_and_run(&grb, 1, 5);
+		mu_assert("Expected WAITING state", (grb.state == catcierge_state_waiting));
+	}
+
+	catcierge_test_STATUS("Used %d of %d frames", frames_used, 9 * DEFAULT_MATCH_GROUP_SIZE);
+
+	// Without a head in any image the match group is vetoed,
+	// so all the matches have to be made even though they succeed.
+	args->ok_matches_needed = 2;
+	load_test_image_and_run(&grb, 6, 1);
+	mu_assert("Expected MATCHING state", (grb.state == catcierge_state_matching));
+
+	for (i = 1; (i <= 4) && (grb.state == catcierge_state_matching); i++)
+	{
+		load_test_image_and_run(&grb, 1, 5);
+	}
+
+	mu_assert("Expected all matches to be made", (grb.match_group.match_count == DEFAULT_MATCH_GROUP_SIZE));
+	mu_assert("Expected the matcher to veto", grb.match_group.final_decision);
+	mu_assert("Expected LOCKOUT state", (grb.state == catcierge_state_lockout));
+
+	catcierge_matcher_destroy(&grb.matcher);
+	catcierge_grabber_destroy(&grb);
+
+	return NULL;
+}
+
+static char *run_match_group_size_tests()
+{
+	int i;
+	int size;
+	catcierge_grb_t grb;
+	catcierge_args_t *args = &grb.args;
+
+	catcierge_grabber_init(&grb);
+
+	catcierge_haar_matcher_args_init(&args->haar);
+	args->saveimg = 0;
+	args->matcher = "haar";
+	args->matcher_type = MATCHER_HAAR;
+	args->haar.cascade = CATCIERGE_CASCADE;
+
+	// Always let the cat in, only the number of matches is tested.
+	args->ok_matches_needed = 0;
+	args->no_final_decision = 1;
+
+	if (catcierge_matcher_init(&grb.matcher, (catcierge_matcher_args_t *)&args->haar))
+	{
+		return "Failed to init catcierge lib!\n";
+	}
+
+	catcierge_set_state(&grb, catcierge_state_waiting);
+
+	for (size = 1; size <= MAX_MATCH_GROUP_SIZE; size += 3)
+	{
+		catcierge_test_STATUS("Match group size %d", size);
+		args->match_group_size = size;
+		mu_assert("Failed to resize match group",
+			!catcierge_match_group_init(&grb.match_group, size));
+		mu_assert("Expected the new size", grb.match_group.max_count == (size_t)size);
+
+		load_test_image_and_run(&grb, 6, 1);
+		mu_assert("Expected MATCHING state", (grb.state == catcierge_state_matching));
+
+		// The series only has 4 images, reuse them for larger groups.
+		for (i = 0; i < size; i++)
+		{
+			mu_assert("Expected to decide only after all matches",
+				(grb.state == catcierge_state_matching));
+			load_test_image_and_run(&grb, 6, 1 + (i % 4));
+		}
+
+		mu_assert("Expected a decision", (grb.state != catcierge_state_matching));
+		mu_assert("Expected all matches to be made", (grb.match_group.match_count == (size_t)size));
+		mu_assert("Expected KEEP OPEN state", (grb.state == catcierge_state_keepopen));
+
+		load_test_image_and_run(&grb, 1, 5);
+		mu_assert("Expected WAITING state", (grb.state == catcierge_state_waiting));
+	}
+
 	catcierge_matcher_destroy(&grb.matcher);
 	catcierge_grabber_destroy(&grb);
 
@@ -206,6 +383,14 @@ int TEST_catcierge_fsm_haar_matcher(int argc, char **argv)
 		"Run save steps tests. Adaptive prey matching",
 		"Save steps tests", &ret);
 
+	CATCIERGE_RUN_TEST((e = run_early_decision_tests()),
+		"Run early decision tests",
+		"Early decision tests", &ret);
+
+	CATCIERGE_RUN_TEST((e = run_match_group_size_tests()),
+		"Run match group size tests",
+		"Match group size tests", &ret);
+
 	if (ret)
 	{
 		catcierge_test_FAILURE("One or more tests failed");
@@ -25,7 +25,7 @@ static char *run_tests()
 	catcierge_timer_start(&grb.frame_timer);
 
 	// Load images so we can test the cleanup.
-	for (i = 0; i < MATCH_MAX_COUNT; i++)
+	for (i = 0; i < grb.match_group.max_count; i++)
 	{
 		grb.match_group.matches[i].img = catcierge_get_frame(&grb);
 	}
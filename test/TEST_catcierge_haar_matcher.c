@@ -0,0 +1,502 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "catcierge_config.h"
+#include "catcierge_fsm.h"
+#include "catcierge_haar_matcher.h"
+#include "minunit.h"
+#include "catcierge_test_config.h"
+#include "catcierge_test_helpers.h"
+#include "catcierge_test_common.h"
+#include <opencv2/imgproc/imgproc_c.h>
+#include <opencv2/core/version.hpp>
+
+#define SOAK_FRAMES 100000
+#define TEST_CASCADE_CACHE "______test_cascade.cache"
+#define TEST_CASCADE_XML "______test_cascade.xml"
+
+// White background split in two by a dark band, like a cat with prey.
+static IplImage *create_prey_image()
+{
+	IplImage *img = cvCreateImage(cvSize(120, 80), IPL_DEPTH_8U, 1);
+	cvSet(img, cvScalarAll(255), NULL);
+	cvRectangle(img, cvPoint(0, 30), cvPoint(119, 50), cvScalarAll(0), CV_FILLED, 8, 0);
+	return img;
+}
+
+// Thousands of single pixel contours.
+static IplImage *create_noise_image()
+{
+	int x;
+	int y;
+	IplImage *img = cvCreateImage(cvSize(640, 480), IPL_DEPTH_8U, 1);
+	cvSetZero(img);
+
+	for (y = 0; y < img->height; y += 2)
+	{
+		for (x = 0; x < img->width; x += 2)
+		{
+			((unsigned char *)img->imageData)[y * img->widthStep + x] = 255;
+		}
+	}
+
+	return img;
+}
+
+static char *run_soak_tests()
+{
+	int i;
+	size_t warm_bytes;
+	size_t current;
+	size_t peak;
+	char buf[64];
+	const char *val;
+	match_result_t result;
+	catcierge_matcher_t *matcher = NULL;
+	catcierge_haar_matcher_t *ctx = NULL;
+	catcierge_haar_matcher_args_t args;
+	IplImage *img = NULL;
+	IplImage *inv_img = NULL;
+	IplImage *thr_img = NULL;
+	IplImage *noise_img = NULL;
+	char *e = NULL;
+
+	catcierge_haar_matcher_args_init(&args);
+	args.cascade = CATCIERGE_CASCADE;
+	memset(&result, 0, sizeof(result));
+
+	if (catcierge_haar_matcher_init(&matcher, (catcierge_matcher_args_t *)&args))
+	{
+		e = "Failed to init haar matcher";
+		goto fail;
+	}
+
+	ctx = (catcierge_haar_matcher_t *)matcher;
+	img = create_prey_image();
+	inv_img = cvCloneImage(img);
+	cvNot(img, inv_img);
+	thr_img = cvCloneImage(img);
+	noise_img = create_noise_image();
+
+	mu_assert("Expected prey", catcierge_haar_matcher_find_prey(ctx, img, thr_img, &result, 0));
+	cvCopy(img, thr_img, NULL);
+	mu_assert("Expected adaptive prey",
+		catcierge_haar_matcher_find_prey_adaptive(ctx, img, inv_img, &result, 0));
+
+	catcierge_haar_matcher_memory(ctx, &warm_bytes, &peak);
+	catcierge_test_STATUS("Contour storage after warm up %lu bytes", (unsigned long)warm_bytes);
+
+	for (i = 0; i < SOAK_FRAMES; i++)
+	{
+		// Finding contours modifies the image.
+		cvCopy(img, thr_img, NULL);
+
+		if ((i % 10) == 0)
+			catcierge_haar_matcher_find_prey_adaptive(ctx, img, inv_img, &result, 0);
+		else
+			catcierge_haar_matcher_find_prey(ctx, img, thr_img, &result, 0);
+
+		catcierge_haar_matcher_memory(ctx, &current, &peak);
+
+		if (current != warm_bytes)
+		{
+			catcierge_test_STATUS("Frame %d: %lu bytes", i, (unsigned long)current);
+			e = "Expected the contour storage to stay the same size";
+			goto fail;
+		}
+	}
+
+	catcierge_test_STATUS("%d frames, contour storage %lu bytes, peak %lu bytes",
+		SOAK_FRAMES, (unsigned long)current, (unsigned long)peak);
+
+	// A frame full of contours goes above the max, but
+	// the memory is given back afterwards.
+	catcierge_haar_matcher_find_prey(ctx, noise_img, noise_img, &result, 0);
+	catcierge_haar_matcher_memory(ctx, &current, &peak);
+	catcierge_test_STATUS("Noisy frame peak %lu bytes, after %lu bytes",
+		(unsigned long)peak, (unsigned long)current);
+
+	mu_assert("Expected noisy frame to need more than the max", peak > CATCIERGE_HAAR_STORAGE_MAX);
+	mu_assert("Expected storage to be shrunk", current <= CATCIERGE_HAAR_STORAGE_MAX);
+	mu_assert("Expected one shrink", ctx->contour_shrinks == 1);
+
+	cvCopy(img, thr_img, NULL);
+	catcierge_haar_matcher_find_prey(ctx, img, thr_img, &result, 0);
+	catcierge_haar_matcher_memory(ctx, &current, NULL);
+	mu_assert("Expected storage back at the normal size", current == warm_bytes);
+
+	val = matcher->translate(matcher, "contour_mem", buf, sizeof(buf));
+	mu_assert("Expected contour_mem output variable", val && (strtoul(val, NULL, 10) == current));
+
+	val = matcher->translate(matcher, "contour_mem_peak", buf, sizeof(buf));
+	mu_assert("Expected contour_mem_peak output variable", val && (strtoul(val, NULL, 10) == peak));
+
+fail:
+	if (img) cvReleaseImage(&img);
+	if (inv_img) cvReleaseImage(&inv_img);
+	if (thr_img) cvReleaseImage(&thr_img);
+	if (noise_img) cvReleaseImage(&noise_img);
+	catcierge_matcher_destroy(&matcher);
+
+	return e;
+}
+
+static char *run_match_memory_tests()
+{
+	int i;
+	int j;
+	size_t bytes = 0;
+	size_t current;
+	catcierge_matcher_t *matcher = NULL;
+	catcierge_haar_matcher_args_t args;
+	catcierge_frame_ctx_t frame;
+	match_result_t result;
+	IplImage *imgs[4];
+	char *e = NULL;
+
+	catcierge_haar_matcher_args_init(&args);
+	args.cascade = CATCIERGE_CASCADE;
+	memset(&result, 0, sizeof(result));
+	memset(imgs, 0, sizeof(imgs));
+	catcierge_frame_ctx_init(&frame);
+
+	if (catcierge_haar_matcher_init(&matcher, (catcierge_matcher_args_t *)&args))
+	{
+		e = "Failed to init haar matcher";
+		goto fail;
+	}
+
+	for (i = 0; i < 4; i++)
+	{
+		if (!(imgs[i] = open_test_image(6, i + 1)))
+		{
+			e = "Failed to load test image";
+			goto fail;
+		}
+	}
+
+	// The whole matcher, the storage only grows while the first
+	// round of images is matched.
+	for (j = 0; j < 50; j++)
+	{
+		for (i = 0; i < 4; i++)
+		{
+			catcierge_frame_ctx_set(&frame, imgs[i]);
+			matcher->match(matcher, &frame, &result, 0);
+		}
+
+		catcierge_haar_matcher_memory((catcierge_haar_matcher_t *)matcher, &current, NULL);
+
+		if (j == 0)
+		{
+			bytes = current;
+		}
+		else if (current != bytes)
+		{
+			e = "Expected the contour storage to stay the same size";
+			goto fail;
+		}
+	}
+
+	catcierge_test_STATUS("200 matches, contour storage %lu bytes", (unsigned long)bytes);
+	mu_assert("Expected the contour storage to be below the max", bytes <= CATCIERGE_HAAR_STORAGE_MAX);
+
+fail:
+	for (i = 0; i < 4; i++)
+	{
+		if (imgs[i]) cvReleaseImage(&imgs[i]);
+	}
+
+	catcierge_frame_ctx_destroy(&frame);
+	catcierge_matcher_destroy(&matcher);
+
+	return e;
+}
+
+static char *run_track_tests()
+{
+	int i;
+	int j;
+	int hits = 0;
+	int tracked = 0;
+	double search_time = 0.0;
+	double hint_time = 0.0;
+	catcierge_matcher_t *matcher = NULL;
+	catcierge_haar_matcher_t *ctx = NULL;
+	catcierge_haar_matcher_args_t args;
+	catcierge_frame_ctx_t frame;
+	match_result_t full;
+	match_result_t result;
+	CvRect window;
+	CvSize min_size;
+	CvSize max_size;
+	CvRect prev = cvRect(100, 100, 100, 80);
+	IplImage *img = NULL;
+	char *e = NULL;
+
+	catcierge_haar_matcher_args_init(&args);
+	args.cascade = CATCIERGE_CASCADE;
+	args.track = 1;
+	catcierge_frame_ctx_init(&frame);
+
+	if (catcierge_haar_matcher_init(&matcher, (catcierge_matcher_args_t *)&args))
+	{
+		e = "Failed to init haar matcher";
+		goto fail;
+	}
+
+	ctx = (catcierge_haar_matcher_t *)matcher;
+
+	// Padded by half the head size on each side, and clipped to the image.
+	window = catcierge_haar_matcher_track_window(ctx, &prev, cvSize(320, 240), &min_size, &max_size);
+	mu_assert("Expected padded window",
+		(window.x == 50) && (window.y == 60) && (window.width == 200) && (window.height == 160));
+	mu_assert("Expected narrowed sizes",
+		(min_size.width == 80) && (min_size.height == 80)
+		&& (max_size.width == 125) && (max_size.height == 100));
+
+	window = catcierge_haar_matcher_track_window(ctx, &prev, cvSize(220, 200), &min_size, &max_size);
+	mu_assert("Expected clipped window",
+		(window.x == 50) && (window.y == 60) && (window.width == 170) && (window.height == 140));
+
+	for (j = 6; (j <= 14) && !e; j++)
+	{
+		for (i = 1; i <= 4; i++)
+		{
+			if (!(img = open_test_image(j, i)))
+			{
+				e = "Failed to load test image";
+				break;
+			}
+
+			catcierge_frame_ctx_set(&frame, img);
+
+			memset(&full, 0, sizeof(full));
+			matcher->match(matcher, &frame, &full, 0);
+			search_time += full.search_time;
+
+			if (full.hint_hit || full.hint_miss)
+			{
+				e = "Expected no tracking without a hint";
+				break;
+			}
+
+			if (full.rect_count == 0)
+			{
+				cvReleaseImage(&img);
+				continue;
+			}
+
+			// The head in the same place as the previous frame.
+			memset(&result, 0, sizeof(result));
+			result.hint_rects[0] = full.match_rects[0];
+			result.hint_count = 1;
+			matcher->match(matcher, &frame, &result, 0);
+			hint_time += result.hint_time;
+			tracked++;
+
+			if (!result.hint_hit || (result.rect_count == 0) || (result.search_time != 0.0))
+			{
+				e = "Expected the head to be found near the hint";
+				break;
+			}
+
+			if (result.result == full.result)
+				hits++;
+
+			cvReleaseImage(&img);
+		}
+	}
+
+	catcierge_test_STATUS("Tracked %d heads, %d with the same result. Full search %0.2fms, tracked %0.2fms per frame",
+		tracked, hits,
+		tracked ? (1000.0 * search_time / tracked) : 0.0,
+		tracked ? (1000.0 * hint_time / tracked) : 0.0);
+
+	if (!e && (tracked == 0))
+		e = "Expected to find some heads";
+
+	// A hint where there is no head falls back to a full search.
+	if (!e && (img = open_test_image(6, 2)))
+	{
+		catcierge_frame_ctx_set(&frame, img);
+		memset(&result, 0, sizeof(result));
+		result.hint_rects[0] = cvRect(0, 0, 10, 10);
+		result.hint_count = 1;
+		matcher->match(matcher, &frame, &result, 0);
+
+		if (!result.hint_miss || (result.search_time == 0.0))
+			e = "Expected a full search after missing the head";
+	}
+
+fail:
+	if (img) cvReleaseImage(&img);
+	catcierge_frame_ctx_destroy(&frame);
+	catcierge_matcher_destroy(&matcher);
+
+	return e;
+}
+
+static catcierge_matcher_t *init_cached_matcher(catcierge_haar_matcher_args_t *args,
+	const char *cascade, int *cache_hit)
+{
+	catcierge_matcher_t *matcher = NULL;
+
+	catcierge_haar_matcher_args_init(args);
+	args->cascade = cascade;
+	args->cascade_cache = TEST_CASCADE_CACHE;
+
+	if (catcierge_haar_matcher_init(&matcher, (catcierge_matcher_args_t *)args))
+	{
+		catcierge_matcher_destroy(&matcher);
+		return NULL;
+	}
+
+	*cache_hit = ((catcierge_haar_matcher_t *)matcher)->cascade_cache_hit;
+	catcierge_test_STATUS("Loaded cascade in %0.1fms, cache hit %d",
+		1000.0 * ((catcierge_haar_matcher_t *)matcher)->cascade_load_time, *cache_hit);
+
+	return matcher;
+}
+
+static char *run_cascade_cache_tests()
+{
+	int i;
+	int hit;
+	FILE *in = NULL;
+	FILE *out = NULL;
+	char buf[4096];
+	size_t n;
+	catcierge_matcher_t *xml_matcher = NULL;
+	catcierge_matcher_t *cached_matcher = NULL;
+	catcierge_haar_matcher_args_t xml_args;
+	catcierge_haar_matcher_args_t cached_args;
+	catcierge_frame_ctx_t frame;
+	match_result_t xml_result;
+	match_result_t cached_result;
+	IplImage *img = NULL;
+	char *e = NULL;
+
+	remove(TEST_CASCADE_CACHE);
+	catcierge_frame_ctx_init(&frame);
+
+	// Written the first time.
+	if (!(xml_matcher = init_cached_matcher(&xml_args, CATCIERGE_CASCADE, &hit)))
+	{
+		e = "Failed to init haar matcher";
+		goto fail;
+	}
+
+	if (hit)
+	{
+		e = "Expected no cache the first time";
+		goto fail;
+	}
+
+	#if (CV_MAJOR_VERSION == 2)
+	if (!(cached_matcher = init_cached_matcher(&cached_args, CATCIERGE_CASCADE, &hit)))
+	{
+		e = "Failed to init haar matcher from the cache";
+		goto fail;
+	}
+
+	if (!hit)
+	{
+		e = "Expected the cascade to be loaded from the cache";
+		goto fail;
+	}
+
+	// The cached cascade must find the same heads.
+	for (i = 1; i <= 4; i++)
+	{
+		if (!(img = open_test_image(6, i)))
+		{
+			e = "Failed to load test image";
+			goto fail;
+		}
+
+		catcierge_frame_ctx_set(&frame, img);
+		memset(&xml_result, 0, sizeof(xml_result));
+		memset(&cached_result, 0, sizeof(cached_result));
+		xml_matcher->match(xml_matcher, &frame, &xml_result, 0);
+		cached_matcher->match(cached_matcher, &frame, &cached_result, 0);
+		cvReleaseImage(&img);
+
+		if ((xml_result.rect_count != cached_result.rect_count)
+			|| (xml_result.result != cached_result.result)
+			|| (xml_result.rect_count
+				&& memcmp(&xml_result.match_rects[0], &cached_result.match_rects[0], sizeof(CvRect))))
+		{
+			e = "Expected the same match with the cached cascade";
+			goto fail;
+		}
+	}
+
+	catcierge_matcher_destroy(&cached_matcher);
+
+	// A changed xml makes the cache stale.
+	if (!(in = fopen(CATCIERGE_CASCADE, "rb")) || !(out = fopen(TEST_CASCADE_XML, "wb")))
+	{
+		e = "Failed to copy the cascade";
+		goto fail;
+	}
+
+	while ((n = fread(buf, 1, sizeof(buf), in)) > 0)
+		fwrite(buf, 1, n, out);
+
+	fprintf(out, "<!-- changed -->\n");
+	fclose(in);
+	fclose(out);
+	in = out = NULL;
+
+	if (!(cached_matcher = init_cached_matcher(&cached_args, TEST_CASCADE_XML, &hit)) || hit)
+	{
+		e = "Expected a stale cache to not be used";
+		goto fail;
+	}
+
+	catcierge_matcher_destroy(&cached_matcher);
+
+	if (!(cached_matcher = init_cached_matcher(&cached_args, TEST_CASCADE_XML, &hit)) || !hit)
+	{
+		e = "Expected the stale cache to be rewritten";
+		goto fail;
+	}
+	#endif // CV_MAJOR_VERSION == 2
+
+fail:
+	if (in) fclose(in);
+	if (out) fclose(out);
+	if (img) cvReleaseImage(&img);
+	catcierge_frame_ctx_destroy(&frame);
+	catcierge_matcher_destroy(&xml_matcher);
+	catcierge_matcher_destroy(&cached_matcher);
+	remove(TEST_CASCADE_CACHE);
+	remove(TEST_CASCADE_XML);
+
+	return e;
+}
+
+int TEST_catcierge_haar_matcher(int argc, char **argv)
+{
+	int ret = 0;
+	char *e = NULL;
+
+	CATCIERGE_RUN_TEST((e = run_soak_tests()),
+		"Run haar matcher prey soak test",
+		"Bounded contour storage", &ret);
+
+	CATCIERGE_RUN_TEST((e = run_match_memory_tests()),
+		"Run haar matcher memory tests",
+		"Contour storage when matching", &ret);
+
+	CATCIERGE_RUN_TEST((e = run_track_tests()),
+		"Run haar matcher head tracking tests",
+		"Head tracking", &ret);
+
+	CATCIERGE_RUN_TEST((e = run_cascade_cache_tests()),
+		"Run haar cascade cache tests",
+		"Cascade cache", &ret);
+
+	return ret;
+}
@@ -0,0 +1,169 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include "catcierge_idle.h"
+#include "catcierge_timer.h"
+#include "minunit.h"
+#include "catcierge_test_helpers.h"
+
+#define EQ(a, b) (fabs((a) - (b)) < 0.00001)
+
+static char *run_interval_tests()
+{
+	catcierge_idle_args_t args;
+
+	catcierge_idle_args_init(&args);
+	args.enabled = 1;
+	args.max_fps = 10.0;
+	args.min_fps = 2.0;
+	args.delay = 10.0;
+	args.ramp = 4.0;
+
+	mu_assert("Expected full rate before delay", EQ(catcierge_idle_calc_interval(&args, 0.0), 0.1));
+	mu_assert("Expected full rate before delay", EQ(catcierge_idle_calc_interval(&args, 9.9), 0.1));
+	mu_assert("Expected ramp start", EQ(catcierge_idle_calc_interval(&args, 10.0), 0.1));
+	mu_assert("Expected half way ramp", EQ(catcierge_idle_calc_interval(&args, 12.0), 0.3));
+	mu_assert("Expected idle rate after ramp", EQ(catcierge_idle_calc_interval(&args, 14.0), 0.5));
+	mu_assert("Expected idle rate after ramp", EQ(catcierge_idle_calc_interval(&args, 1000.0), 0.5));
+
+	// Unthrottled full rate.
+	args.max_fps = 0.0;
+	mu_assert("Expected no wait before delay", EQ(catcierge_idle_calc_interval(&args, 5.0), 0.0));
+	mu_assert("Expected half way ramp", EQ(catcierge_idle_calc_interval(&args, 12.0), 0.25));
+
+	// No ramp, straight to the idle rate.
+	args.ramp = 0.0;
+	mu_assert("Expected idle rate without ramp", EQ(catcierge_idle_calc_interval(&args, 10.0), 0.5));
+
+	// Idle rate higher than the full rate makes no sense, never slow down.
+	args.max_fps = 5.0;
+	args.min_fps = 10.0;
+	mu_assert("Expected full rate", EQ(catcierge_idle_calc_interval(&args, 100.0), 0.2));
+
+	args.enabled = 0;
+	mu_assert("Expected full rate when disabled", EQ(catcierge_idle_calc_interval(&args, 100.0), 0.2));
+
+	return NULL;
+}
+
+static char *run_activity_tests()
+{
+	catcierge_idle_args_t args;
+	catcierge_idle_t idle;
+
+	catcierge_idle_args_init(&args);
+	args.enabled = 1;
+	args.delay = 0.0;
+	args.ramp = 0.0;
+	args.min_fps = 1000.0;
+	catcierge_idle_init(&idle, &args);
+
+	catcierge_idle_wait(&idle);
+	mu_assert("Expected to go idle", idle.idle && (idle.idle_count == 1));
+
+	// Small changes are noise.
+	catcierge_idle_update(&idle, 1, 0);
+	catcierge_idle_update(&idle, 1, CATCIERGE_IDLE_MOTION_PIXELS);
+	mu_assert("Expected to still be idle", idle.idle);
+
+	// Motion.
+	catcierge_idle_update(&idle, 1, CATCIERGE_IDLE_MOTION_PIXELS * 3);
+	mu_assert("Expected motion to wake up", !idle.idle);
+
+	catcierge_idle_wait(&idle);
+	mu_assert("Expected to go idle again", idle.idle && (idle.idle_count == 2));
+
+	// Any other state than waiting.
+	catcierge_idle_update(&idle, 0, -1);
+	mu_assert("Expected other state to wake up", !idle.idle);
+	mu_assert("Expected next frame to be let through at once", idle.last_frame == 0.0);
+
+	return NULL;
+}
+
+static char *run_wait_tests()
+{
+	int i;
+	double start;
+	double elapsed;
+	catcierge_idle_args_t args;
+	catcierge_idle_t idle;
+
+	catcierge_idle_args_init(&args);
+	args.enabled = 1;
+	args.delay = 0.0;
+	args.ramp = 0.0;
+	args.min_fps = 20.0;
+	catcierge_idle_init(&idle, &args);
+
+	start = catcierge_timer_now();
+
+	for (i = 0; i < 4; i++)
+	{
+		catcierge_idle_wait(&idle);
+	}
+
+	elapsed = catcierge_timer_now() - start;
+	catcierge_test_STATUS("4 idle frames at 20 fps took %0.3f seconds", elapsed);
+	mu_assert("Expected idle frames to be throttled", elapsed >= 0.14);
+
+	// Disabled never waits.
+	args.enabled = 0;
+	start = catcierge_timer_now();
+
+	for (i = 0; i < 4; i++)
+	{
+		catcierge_idle_wait(&idle);
+	}
+
+	elapsed = catcierge_timer_now() - start;
+	mu_assert("Expected no throttling when disabled", elapsed < 0.14);
+
+	return NULL;
+}
+
+static char *run_parse_tests()
+{
+	catcierge_idle_args_t args;
+	char *val = "2.5";
+	char *neg = "-1";
+
+	catcierge_idle_args_init(&args);
+
+	mu_assert("Expected --idle to be parsed", !catcierge_idle_parse_args(&args, "idle", NULL, 0));
+	mu_assert("Expected idle enabled", args.enabled == 1);
+	mu_assert("Expected --idle_min_fps to be parsed", !catcierge_idle_parse_args(&args, "idle_min_fps", &val, 1));
+	mu_assert("Expected idle_min_fps", EQ(args.min_fps, 2.5));
+	mu_assert("Expected --idle_ramp to be parsed", !catcierge_idle_parse_args(&args, "idle_ramp", &val, 1));
+	mu_assert("Expected idle_ramp", EQ(args.ramp, 2.5));
+	mu_assert("Expected negative --idle_delay to fail", catcierge_idle_parse_args(&args, "idle_delay", &neg, 1) < 0);
+	mu_assert("Expected missing --idle_max_fps value to fail", catcierge_idle_parse_args(&args, "idle_max_fps", NULL, 0) < 0);
+	mu_assert("Expected unknown key to be passed on", catcierge_idle_parse_args(&args, "show", NULL, 0) == 1);
+
+	return NULL;
+}
+
+int TEST_catcierge_idle(int argc, char **argv)
+{
+	int ret = 0;
+	char *e = NULL;
+
+	CATCIERGE_RUN_TEST((e = run_interval_tests()),
+		"Run idle interval tests",
+		"Idle frame interval", &ret);
+
+	CATCIERGE_RUN_TEST((e = run_activity_tests()),
+		"Run idle activity tests",
+		"Idle activity", &ret);
+
+	CATCIERGE_RUN_TEST((e = run_wait_tests()),
+		"Run idle wait tests",
+		"Idle throttling", &ret);
+
+	CATCIERGE_RUN_TEST((e = run_parse_tests()),
+		"Run idle args tests",
+		"Idle args", &ret);
+
+	return ret;
+}
@@ -0,0 +1,355 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "catcierge_config.h"
+#include "catcierge_image_pool.h"
+#include "catcierge_workers.h"
+#include "minunit.h"
+#include "catcierge_test_config.h"
+#include "catcierge_test_helpers.h"
+#include <opencv2/imgproc/imgproc_c.h>
+
+#define POOL_CAPACITY 4
+
+static char *run_reuse_tests()
+{
+	IplImage *img = NULL;
+	IplImage *first = NULL;
+	IplImage *small = NULL;
+	catcierge_image_pool_t pool;
+	catcierge_image_pool_stats_t stats;
+
+	mu_assert("Failed to init pool", !catcierge_image_pool_init(&pool, POOL_CAPACITY));
+
+	first = catcierge_image_pool_get(&pool, cvSize(320, 240), 8, 1);
+	mu_assert("Expected an image", first && (first->width == 320) && (first->height == 240));
+	mu_assert("Expected no ROI", !first->roi);
+	catcierge_image_pool_release(&pool, &first);
+	mu_assert("Expected release to clear the pointer", !first);
+
+	// The same buffer is handed out again.
+	img = catcierge_image_pool_get(&pool, cvSize(320, 240), 8, 1);
+	catcierge_image_pool_get_stats(&pool, &stats);
+	mu_assert("Expected one buffer", (stats.allocated == 1) && (stats.used == 1));
+
+	// Smaller images get a frame sized buffer with the ROI set.
+	small = catcierge_image_pool_get(&pool, cvSize(100, 50), 8, 1);
+	mu_assert("Expected a different buffer", small && (small != img));
+	mu_assert("Expected a frame sized buffer", (small->width == 320) && (small->height == 240));
+	mu_assert("Expected the ROI to be the requested size",
+		(cvGetSize(small).width == 100) && (cvGetSize(small).height == 50));
+
+	catcierge_image_pool_release(&pool, &small);
+	catcierge_image_pool_release(&pool, &img);
+
+	// ... and no ROI when reused for a frame.
+	img = catcierge_image_pool_get(&pool, cvSize(320, 240), 8, 1);
+	small = catcierge_image_pool_get(&pool, cvSize(320, 240), 8, 1);
+	mu_assert("Expected no ROI", !img->roi && !small->roi);
+	catcierge_image_pool_release(&pool, &small);
+	catcierge_image_pool_release(&pool, &img);
+
+	// Another format gets a buffer of its own.
+	img = catcierge_image_pool_get(&pool, cvSize(320, 240), 8, 3);
+	mu_assert("Expected a color image", img && (img->nChannels == 3));
+	catcierge_image_pool_release(&pool, &img);
+
+	catcierge_image_pool_get_stats(&pool, &stats);
+	catcierge_test_STATUS("%u buffers created, peak %u", stats.allocated, stats.peak);
+	mu_assert("Expected nothing in use", stats.used == 0);
+	mu_assert("Expected a peak of 2", stats.peak == 2);
+	mu_assert("Expected 3 buffers", stats.allocated == 3);
+	mu_assert("Expected the capacity", stats.capacity == POOL_CAPACITY);
+
+	catcierge_image_pool_destroy(&pool);
+
+	return NULL;
+}
+
+static char *run_refcount_tests()
+{
+	IplImage *frame = NULL;
+	IplImage *img = NULL;
+	IplImage *shared = NULL;
+	IplImage *copy = NULL;
+	IplImage *other = NULL;
+	catcierge_image_pool_t pool;
+	catcierge_image_pool_stats_t stats;
+
+	mu_assert("Failed to init pool", !catcierge_image_pool_init(&pool, POOL_CAPACITY));
+
+	// Images outside the pool are copied.
+	frame = cvCreateImage(cvSize(320, 240), 8, 1);
+	cvSet(frame, cvScalarAll(123), NULL);
+	copy = catcierge_image_pool_clone(&pool, frame);
+	mu_assert("Expected a copy", copy && (copy != frame));
+	mu_assert("Expected the same pixels", cvGetReal2D(copy, 10, 10) == 123.0);
+
+	// Images from the pool are shared.
+	shared = catcierge_image_pool_clone(&pool, copy);
+	mu_assert("Expected the same image", shared == copy);
+
+	catcierge_image_pool_release(&pool, &copy);
+	catcierge_image_pool_get_stats(&pool, &stats);
+	mu_assert("Expected the buffer to still be used", stats.used == 1);
+
+	// While shared the buffer can't be handed out again.
+	other = catcierge_image_pool_get(&pool, cvSize(320, 240), 8, 1);
+	mu_assert("Expected another buffer", other != shared);
+
+	catcierge_image_pool_release(&pool, &shared);
+	catcierge_image_pool_release(&pool, &other);
+	catcierge_image_pool_get_stats(&pool, &stats);
+	mu_assert("Expected the buffers to be free", stats.used == 0);
+
+	// The ROI is what is copied.
+	cvSetImageROI(frame, cvRect(10, 10, 40, 30));
+	img = catcierge_image_pool_clone(&pool, frame);
+	mu_assert("Expected the ROI size", (cvGetSize(img).width == 40) && (cvGetSize(img).height == 30));
+	catcierge_image_pool_release(&pool, &img);
+
+	cvReleaseImage(&frame);
+	catcierge_image_pool_destroy(&pool);
+
+	return NULL;
+}
+
+static char *run_exhausted_tests()
+{
+	int i;
+	IplImage *imgs[POOL_CAPACITY + 2];
+	IplImage *img = NULL;
+	catcierge_image_pool_t pool;
+	catcierge_image_pool_stats_t stats;
+
+	mu_assert("Failed to init pool", !catcierge_image_pool_init(&pool, POOL_CAPACITY));
+
+	for (i = 0; i < (POOL_CAPACITY + 2); i++)
+	{
+		imgs[i] = catcierge_image_pool_get(&pool, cvSize(64, 48), 8, 1);
+		mu_assert("Expected an image even when the pool is full", imgs[i]);
+	}
+
+	catcierge_image_pool_get_stats(&pool, &stats);
+	mu_assert("Expected the pool to be full", stats.used == POOL_CAPACITY);
+	mu_assert("Expected 2 images outside the pool", stats.exhausted == 2);
+
+	// Images from outside the pool are freed on release.
+	for (i = 0; i < (POOL_CAPACITY + 2); i++)
+	{
+		catcierge_image_pool_release(&pool, &imgs[i]);
+	}
+
+	catcierge_image_pool_get_stats(&pool, &stats);
+	mu_assert("Expected nothing in use", stats.used == 0);
+	mu_assert("Expected the peak to be the capacity", stats.peak == POOL_CAPACITY);
+
+	// Still borrowed buffers are freed on destroy.
+	img = catcierge_image_pool_get(&pool, cvSize(64, 48), 8, 1);
+	catcierge_image_pool_destroy(&pool);
+
+	// Without a pool everything is on the heap.
+	img = catcierge_image_pool_get(NULL, cvSize(64, 48), 8, 1);
+	mu_assert("Expected an image without a pool", img);
+	catcierge_image_pool_release(NULL, &img);
+	mu_assert("Expected release to clear the pointer", !img);
+
+	mu_assert("Failed to init empty pool", !catcierge_image_pool_init(&pool, 0));
+	img = catcierge_image_pool_get(&pool, cvSize(64, 48), 8, 1);
+	mu_assert("Expected an image from an empty pool", img);
+	catcierge_image_pool_release(&pool, &img);
+	catcierge_image_pool_destroy(&pool);
+
+	return NULL;
+}
+
+static char *run_reserve_tests()
+{
+	size_t i;
+	IplImage *imgs[POOL_CAPACITY + 2];
+	IplImage *small = NULL;
+	catcierge_image_pool_t pool;
+	catcierge_image_pool_stats_t stats;
+
+	mu_assert("Failed to init pool", !catcierge_image_pool_init(&pool, POOL_CAPACITY));
+
+	// Reserving more than the capacity grows the pool.
+	mu_assert("Failed to reserve", !catcierge_image_pool_reserve(&pool, POOL_CAPACITY + 2, cvSize(320, 240), 8, 1));
+	catcierge_image_pool_get_stats(&pool, &stats);
+	mu_assert("Expected the pool to grow", stats.capacity == (POOL_CAPACITY + 2));
+	mu_assert("Expected all buffers to be created", stats.allocated == (POOL_CAPACITY + 2));
+
+	// Reserving what is already there creates nothing.
+	mu_assert("Failed to reserve", !catcierge_image_pool_reserve(&pool, 2, cvSize(320, 240), 8, 1));
+	catcierge_image_pool_get_stats(&pool, &stats);
+	mu_assert("Expected no new buffers", stats.allocated == (POOL_CAPACITY + 2));
+
+	// A small image borrowed first still gets a frame sized buffer.
+	small = catcierge_image_pool_get(&pool, cvSize(100, 50), 8, 1);
+	mu_assert("Expected a frame sized buffer", small && (small->width == 320) && (small->height == 240));
+	catcierge_image_pool_release(&pool, &small);
+
+	// An exact borrow has no ROI.
+	small = catcierge_image_pool_get_exact(&pool, cvSize(320, 240), 8, 1);
+	mu_assert("Expected an exact buffer", small && !small->roi);
+	catcierge_image_pool_release(&pool, &small);
+
+	for (i = 0; i < (POOL_CAPACITY + 2); i++)
+	{
+		imgs[i] = catcierge_image_pool_get(&pool, cvSize(320, 240), 8, 1);
+	}
+
+	catcierge_image_pool_get_stats(&pool, &stats);
+	catcierge_test_STATUS("%u buffers created, %u in use", stats.allocated, stats.used);
+	mu_assert("Expected only reserved buffers", stats.allocated == (POOL_CAPACITY + 2));
+	mu_assert("Expected no images outside the pool", stats.exhausted == 0);
+
+	for (i = 0; i < (POOL_CAPACITY + 2); i++)
+	{
+		catcierge_image_pool_release(&pool, &imgs[i]);
+	}
+
+	catcierge_image_pool_destroy(&pool);
+
+	return NULL;
+}
+
+static char *run_format_tests()
+{
+	int i;
+	IplImage *imgs[3];
+	catcierge_image_pool_t pool;
+	catcierge_image_pool_stats_t stats;
+
+	mu_assert("Failed to init pool", !catcierge_image_pool_init(&pool, 2));
+
+	imgs[0] = catcierge_image_pool_get(&pool, cvSize(64, 48), 8, 1);
+	imgs[1] = catcierge_image_pool_get(&pool, cvSize(64, 48), 8, 1);
+	catcierge_image_pool_release(&pool, &imgs[0]);
+	catcierge_image_pool_release(&pool, &imgs[1]);
+
+	// The free buffers are gray, so the pool grows for color images.
+	imgs[0] = catcierge_image_pool_get(&pool, cvSize(64, 48), 8, 3);
+	imgs[1] = catcierge_image_pool_get(&pool, cvSize(64, 48), 8, 3);
+	catcierge_image_pool_release(&pool, &imgs[0]);
+	catcierge_image_pool_release(&pool, &imgs[1]);
+
+	catcierge_image_pool_get_stats(&pool, &stats);
+	mu_assert("Expected the pool to grow", stats.capacity == (2 * CATCIERGE_IMAGE_POOL_GROWTH));
+	mu_assert("Expected no buffer to be recreated", stats.recreated == 0);
+
+	// Taking turns doesn't create anything new.
+	for (i = 0; i < 10; i++)
+	{
+		imgs[0] = catcierge_image_pool_get(&pool, cvSize(64, 48), 8, (i % 2) ? 3 : 1);
+		catcierge_image_pool_release(&pool, &imgs[0]);
+	}
+
+	catcierge_image_pool_get_stats(&pool, &stats);
+	mu_assert("Expected one buffer for each image", stats.allocated == 4);
+	mu_assert("Expected no buffer to be recreated", stats.recreated == 0);
+
+	// A full pool replaces a free buffer of another format.
+	for (i = 0; i < 3; i++)
+	{
+		imgs[i] = catcierge_image_pool_get(&pool, cvSize(64, 48), 8, 1);
+	}
+
+	catcierge_image_pool_get_stats(&pool, &stats);
+	catcierge_test_STATUS("%u buffers created, %u recreated", stats.allocated, stats.recreated);
+	mu_assert("Expected the pool to stay the same size", stats.capacity == (2 * CATCIERGE_IMAGE_POOL_GROWTH));
+	mu_assert("Expected a color buffer to be recreated", stats.recreated == 1);
+	mu_assert("Expected no images outside the pool", stats.exhausted == 0);
+
+	for (i = 0; i < 3; i++)
+	{
+		catcierge_image_pool_release(&pool, &imgs[i]);
+	}
+
+	catcierge_image_pool_destroy(&pool);
+
+	return NULL;
+}
+
+typedef struct pool_job_s
+{
+	catcierge_image_pool_t *pool;
+	int failed;
+} pool_job_t;
+
+static void pool_job(void *user, size_t job)
+{
+	int i;
+	IplImage *img;
+	pool_job_t *ctx = (pool_job_t *)user;
+
+	for (i = 0; i < 100; i++)
+	{
+		if (!(img = catcierge_image_pool_get(ctx->pool, cvSize(32 + (int)job, 32), 8, 1)))
+		{
+			ctx->failed = 1;
+			return;
+		}
+
+		catcierge_image_pool_release(ctx->pool, &img);
+	}
+}
+
+static char *run_thread_tests()
+{
+	catcierge_image_pool_t pool;
+	catcierge_image_pool_stats_t stats;
+	catcierge_workers_t w;
+	pool_job_t ctx;
+
+	memset(&w, 0, sizeof(w));
+	mu_assert("Failed to init pool", !catcierge_image_pool_init(&pool, POOL_CAPACITY));
+	mu_assert("Failed to init workers", !catcierge_workers_init(&w, 4));
+
+	ctx.pool = &pool;
+	ctx.failed = 0;
+	catcierge_workers_run(&w, pool_job, &ctx, 0, 16);
+	catcierge_workers_destroy(&w);
+
+	catcierge_image_pool_get_stats(&pool, &stats);
+	catcierge_test_STATUS("%u buffers created, peak %u, %u outside the pool",
+		stats.allocated, stats.peak, stats.exhausted);
+	mu_assert("Expected all images", !ctx.failed);
+	mu_assert("Expected nothing in use", stats.used == 0);
+
+	catcierge_image_pool_destroy(&pool);
+
+	return NULL;
+}
+
+int TEST_catcierge_image_pool(int argc, char **argv)
+{
+	int ret = 0;
+	char *e = NULL;
+
+	CATCIERGE_RUN_TEST((e = run_reuse_tests()),
+		"Run image pool reuse tests",
+		"Image pool reuse", &ret);
+
+	CATCIERGE_RUN_TEST((e = run_refcount_tests()),
+		"Run image pool reference count tests",
+		"Image pool reference counts", &ret);
+
+	CATCIERGE_RUN_TEST((e = run_exhausted_tests()),
+		"Run image pool exhaustion tests",
+		"Image pool exhaustion", &ret);
+
+	CATCIERGE_RUN_TEST((e = run_reserve_tests()),
+		"Run image pool reserve tests",
+		"Image pool buffers created up front", &ret);
+
+	CATCIERGE_RUN_TEST((e = run_format_tests()),
+		"Run image pool format tests",
+		"Image pool with several formats", &ret);
+
+	CATCIERGE_RUN_TEST((e = run_thread_tests()),
+		"Run image pool thread tests",
+		"Image pool from several threads", &ret);
+
+	return ret;
+}
@@ -0,0 +1,320 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "catcierge_config.h"
+#include "catcierge_fsm.h"
+#include "catcierge_morph.h"
+#include "catcierge_haar_matcher.h"
+#include "minunit.h"
+#include "catcierge_test_config.h"
+#include "catcierge_test_helpers.h"
+#include "catcierge_test_common.h"
+#include <opencv2/imgproc/imgproc_c.h>
+
+static const int kernel_sizes[] = { 1, 2, 3, 5, 9 };
+
+static IplImage *create_random_image(int width, int height, int binary)
+{
+	int x;
+	int y;
+	unsigned char *p;
+	IplImage *img = cvCreateImage(cvSize(width, height), IPL_DEPTH_8U, 1);
+
+	for (y = 0; y < height; y++)
+	{
+		p = (unsigned char *)img->imageData + y * img->widthStep;
+
+		for (x = 0; x < width; x++)
+		{
+			p[x] = binary ? (((rand() % 100) < 50) ? 255 : 0) : (rand() % 256);
+		}
+	}
+
+	return img;
+}
+
+static int images_equal(IplImage *a, IplImage *b)
+{
+	int y;
+
+	for (y = 0; y < a->height; y++)
+	{
+		if (memcmp(a->imageData + y * a->widthStep,
+				b->imageData + y * b->widthStep, a->width))
+		{
+			return 0;
+		}
+	}
+
+	return 1;
+}
+
+static char *compare_morph(catcierge_morph_t *m, IplImage *img, int kw, int kh)
+{
+	IplImage *expected = cvCloneImage(img);
+	IplImage *dst = cvCloneImage(img);
+	IplConvKernel *kernel = cvCreateStructuringElementEx(kw, kh, kw / 2, kh / 2, CV_SHAPE_RECT, NULL);
+	char *e = NULL;
+
+	cvErode(img, expected, kernel, 1);
+	catcierge_morph_erode(m, (unsigned char *)img->imageData, img->widthStep,
+		(unsigned char *)dst->imageData, dst->widthStep, img->width, img->height, kw, kh, 0);
+
+	if (!images_equal(expected, dst))
+	{
+		e = "Expected the same result as cvErode";
+		goto fail;
+	}
+
+	cvDilate(img, expected, kernel, 1);
+	cvNot(expected, expected);
+	cvCopy(img, dst, NULL);
+
+	// In place and inverted.
+	catcierge_morph_dilate(m, (unsigned char *)dst->imageData, dst->widthStep,
+		(unsigned char *)dst->imageData, dst->widthStep, img->width, img->height, kw, kh, 1);
+
+	if (!images_equal(expected, dst))
+	{
+		e = "Expected the same result as an inverted cvDilate";
+		goto fail;
+	}
+
+fail:
+	if (e)
+	{
+		catcierge_test_STATUS("%dx%d image, %dx%d rectangle",
+			img->width, img->height, kw, kh);
+	}
+
+	cvReleaseStructuringElement(&kernel);
+	cvReleaseImage(&expected);
+	cvReleaseImage(&dst);
+
+	return e;
+}
+
+static char *run_morph_tests()
+{
+	int i;
+	size_t kw;
+	size_t kh;
+	IplImage *img = NULL;
+	catcierge_morph_t m;
+	char *e = NULL;
+
+	srand(1234);
+	catcierge_morph_init(&m);
+
+	for (i = 0; (i < 200) && !e; i++)
+	{
+		img = create_random_image(1 + rand() % 80, 1 + rand() % 80, i % 2);
+
+		for (kw = 0; (kw < sizeof(kernel_sizes) / sizeof(kernel_sizes[0])) && !e; kw++)
+		{
+			for (kh = 0; (kh < sizeof(kernel_sizes) / sizeof(kernel_sizes[0])) && !e; kh++)
+			{
+				e = compare_morph(&m, img, kernel_sizes[kw], kernel_sizes[kh]);
+			}
+		}
+
+		cvReleaseImage(&img);
+	}
+
+	catcierge_test_STATUS("Compared %d random images", i);
+
+	mu_assert("Expected empty image to fail",
+		catcierge_morph_erode(&m, NULL, 0, NULL, 0, 0, 0, 3, 3, 0) < 0);
+
+	catcierge_morph_destroy(&m);
+
+	return e;
+}
+
+// Straight forward version of the box mean adaptive threshold.
+static int adaptive_threshold_pixel(IplImage *img, IplImage *mask,
+		int x, int y, int block, int c)
+{
+	int i;
+	int j;
+	long sum = 0;
+	long area = 0;
+	int r = block / 2;
+	unsigned char *p = (unsigned char *)img->imageData;
+
+	if (((unsigned char *)mask->imageData)[y * mask->widthStep + x])
+		return 255;
+
+	for (j = y - r; j <= y + r; j++)
+	{
+		for (i = x - r; i <= x + r; i++)
+		{
+			if ((i < 0) || (j < 0) || (i >= img->width) || (j >= img->height))
+				continue;
+
+			sum += p[j * img->widthStep + i];
+			area++;
+		}
+	}
+
+	return ((p[y * img->widthStep + x] + c) * area <= sum) ? 255 : 0;
+}
+
+static char *run_adaptive_threshold_tests()
+{
+	int i;
+	int x;
+	int y;
+	int block;
+	int c;
+	IplImage *img = NULL;
+	IplImage *mask = NULL;
+	IplImage *dst = NULL;
+	catcierge_morph_t m;
+	char *e = NULL;
+
+	srand(4321);
+	catcierge_morph_init(&m);
+
+	for (i = 0; (i < 200) && !e; i++)
+	{
+		img = create_random_image(1 + rand() % 80, 1 + rand() % 80, 0);
+		mask = create_random_image(img->width, img->height, 1);
+		dst = cvCloneImage(img);
+		block = 3 + 2 * (rand() % 7);
+		c = (rand() % 20) - 5;
+
+		catcierge_morph_adaptive_threshold(&m,
+			(unsigned char *)img->imageData, img->widthStep,
+			(unsigned char *)mask->imageData, mask->widthStep,
+			(unsigned char *)dst->imageData, dst->widthStep,
+			img->width, img->height, block, c);
+
+		for (y = 0; (y < img->height) && !e; y++)
+		{
+			for (x = 0; x < img->width; x++)
+			{
+				if (((unsigned char *)dst->imageData)[y * dst->widthStep + x]
+					!= adaptive_threshold_pixel(img, mask, x, y, block, c))
+				{
+					catcierge_test_STATUS("%dx%d image, block %d, c %d at %d,%d",
+						img->width, img->height, block, c, x, y);
+					e = "Expected the same adaptive threshold";
+					break;
+				}
+			}
+		}
+
+		cvReleaseImage(&img);
+		cvReleaseImage(&mask);
+		cvReleaseImage(&dst);
+	}
+
+	catcierge_morph_destroy(&m);
+
+	return e;
+}
+
+// Compares the prey decision of the fast and the adaptive method.
+static char *run_prey_method_tests()
+{
+	int j;
+	int i;
+	int same = 0;
+	int total = 0;
+	int adaptive;
+	int fast;
+	match_result_t result;
+	catcierge_matcher_t *matcher = NULL;
+	catcierge_haar_matcher_t *ctx = NULL;
+	catcierge_haar_matcher_args_t args;
+	IplImage *img = NULL;
+	IplImage *thr_img = NULL;
+	char *e = NULL;
+
+	catcierge_haar_matcher_args_init(&args);
+	args.cascade = CATCIERGE_CASCADE;
+	memset(&result, 0, sizeof(result));
+
+	if (catcierge_haar_matcher_init(&matcher, (catcierge_matcher_args_t *)&args))
+	{
+		e = "Failed to init haar matcher";
+		goto fail;
+	}
+
+	ctx = (catcierge_haar_matcher_t *)matcher;
+
+	// White background split in two by a dark band, like a cat with prey.
+	img = cvCreateImage(cvSize(120, 80), IPL_DEPTH_8U, 1);
+	thr_img = cvCreateImage(cvGetSize(img), IPL_DEPTH_8U, 1);
+	cvSet(img, cvScalarAll(255), NULL);
+	cvRectangle(img, cvPoint(0, 30), cvPoint(119, 50), cvScalarAll(0), CV_FILLED, 8, 0);
+	cvThreshold(img, thr_img, 0, 255, CV_THRESH_BINARY_INV | CV_THRESH_OTSU);
+	mu_assert("Expected fast prey",
+		catcierge_haar_matcher_find_prey_fast(ctx, img, thr_img, &result, 0));
+
+	// Without the band there is no prey.
+	cvSet(img, cvScalarAll(255), NULL);
+	cvSetZero(thr_img);
+	mu_assert("Expected no fast prey",
+		!catcierge_haar_matcher_find_prey_fast(ctx, img, thr_img, &result, 0));
+
+	cvReleaseImage(&img);
+	cvReleaseImage(&thr_img);
+
+	// The images used by the haar matcher tests.
+	for (j = 6; (j <= 14) && !e; j++)
+	{
+		for (i = 1; i <= 4; i++)
+		{
+			if (!(img = open_test_image(j, i)))
+			{
+				e = "Failed to load test image";
+				break;
+			}
+
+			thr_img = cvCreateImage(cvGetSize(img), IPL_DEPTH_8U, 1);
+			cvThreshold(img, thr_img, 0, 255, CV_THRESH_BINARY_INV | CV_THRESH_OTSU);
+
+			adaptive = catcierge_haar_matcher_find_prey_adaptive(ctx, img, thr_img, &result, 0);
+			fast = catcierge_haar_matcher_find_prey_fast(ctx, img, thr_img, &result, 0);
+
+			if (adaptive == fast)
+				same++;
+
+			total++;
+
+			cvReleaseImage(&img);
+			cvReleaseImage(&thr_img);
+		}
+	}
+
+	catcierge_test_STATUS("Fast and adaptive prey methods agree on %d of %d images", same, total);
+
+fail:
+	if (img) cvReleaseImage(&img);
+	if (thr_img) cvReleaseImage(&thr_img);
+	catcierge_matcher_destroy(&matcher);
+
+	return e;
+}
+
+int TEST_catcierge_morph(int argc, char **argv)
+{
+	int ret = 0;
+	char *e = NULL;
+
+	CATCIERGE_RUN_TEST((e = run_morph_tests()),
+		"Run morphology tests",
+		"Same result as cvErode and cvDilate", &ret);
+
+	CATCIERGE_RUN_TEST((e = run_adaptive_threshold_tests()),
+		"Run box mean adaptive threshold tests",
+		"Adaptive threshold", &ret);
+
+	CATCIERGE_RUN_TEST((e = run_prey_method_tests()),
+		"Run fast prey method tests",
+		"Fast prey method", &ret);
+
+	return ret;
+}
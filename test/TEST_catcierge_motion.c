@@ -0,0 +1,165 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "catcierge_motion.h"
+#include "minunit.h"
+#include "catcierge_test_helpers.h"
+
+static char *run_thumbnail_tests()
+{
+	int i;
+	unsigned char thumb[CATCIERGE_MOTION_CELLS];
+	IplImage *img = cvCreateImage(cvSize(320, 240), IPL_DEPTH_8U, 3);
+
+	cvSet(img, cvScalarAll(123), NULL);
+	catcierge_motion_thumbnail(img, thumb);
+
+	for (i = 0; i < CATCIERGE_MOTION_CELLS; i++)
+	{
+		mu_assert("Expected uniform thumbnail", thumb[i] == 123);
+	}
+
+	cvReleaseImage(&img);
+
+	// Smaller than the thumbnail must work too.
+	img = cvCreateImage(cvSize(7, 5), IPL_DEPTH_8U, 1);
+	cvSet(img, cvScalarAll(45), NULL);
+	catcierge_motion_thumbnail(img, thumb);
+	mu_assert("Expected small image thumbnail", (thumb[0] == 45) && (thumb[CATCIERGE_MOTION_CELLS - 1] == 45));
+	cvReleaseImage(&img);
+
+	return NULL;
+}
+
+static char *run_sad_tests()
+{
+	int i;
+	int n;
+	unsigned char a[CATCIERGE_MOTION_CELLS + 7];
+	unsigned char b[CATCIERGE_MOTION_CELLS + 7];
+	unsigned int sad;
+	unsigned int ref;
+
+	srand(4321);
+
+	for (i = 0; i < (int)sizeof(a); i++)
+	{
+		a[i] = rand() % 256;
+		b[i] = rand() % 256;
+	}
+
+	for (n = 0; n <= (int)sizeof(a); n += 13)
+	{
+		ref = catcierge_motion_sad_scalar(a, b, n);
+		sad = catcierge_motion_sad(a, b, n);
+		mu_assert("Expected SIMD SAD to equal scalar SAD", sad == ref);
+	}
+
+	memset(a, 255, sizeof(a));
+	memset(b, 0, sizeof(b));
+	mu_assert("Expected max SAD", catcierge_motion_sad(a, b, sizeof(a)) == (255 * sizeof(a)));
+
+	return NULL;
+}
+
+static char *run_gate_tests()
+{
+	catcierge_motion_args_t args;
+	catcierge_motion_t m;
+	IplImage *img = cvCreateImage(cvSize(320, 240), IPL_DEPTH_8U, 1);
+	IplImage *small = cvCreateImage(cvSize(160, 120), IPL_DEPTH_8U, 1);
+
+	catcierge_motion_args_init(&args);
+	catcierge_motion_init(&m, &args);
+
+	cvSet(img, cvScalarAll(200), NULL);
+	mu_assert("Expected disabled gate to evaluate", catcierge_motion_check(&m, img, 0.0));
+	mu_assert("Expected disabled gate to not count", (m.gated == 0) && (m.evaluated == 0));
+
+	args.enabled = 1;
+	args.threshold = 4.0;
+	args.watchdog = 1.0;
+
+	mu_assert("Expected first frame to be evaluated", catcierge_motion_check(&m, img, 10.0));
+	mu_assert("Expected same frame to be gated", !catcierge_motion_check(&m, img, 10.1));
+
+	// Small change, below the threshold.
+	cvSet(img, cvScalarAll(202), NULL);
+	mu_assert("Expected small change to be gated", !catcierge_motion_check(&m, img, 10.2));
+	mu_assert("Expected no motion", !m.moved);
+
+	// Watchdog.
+	mu_assert("Expected watchdog to evaluate", catcierge_motion_check(&m, img, 11.0));
+	mu_assert("Expected no motion on watchdog", !m.moved);
+	mu_assert("Expected gated after watchdog", !catcierge_motion_check(&m, img, 11.1));
+
+	// Something dark appears.
+	cvSet(img, cvScalarAll(40), NULL);
+	mu_assert("Expected motion to evaluate", catcierge_motion_check(&m, img, 11.2));
+	mu_assert("Expected motion", m.moved);
+	mu_assert("Expected unchanged to be gated", !catcierge_motion_check(&m, img, 11.3));
+
+	// New frame size.
+	cvSet(small, cvScalarAll(40), NULL);
+	mu_assert("Expected new size to evaluate", catcierge_motion_check(&m, small, 11.4));
+
+	catcierge_motion_reset(&m);
+	mu_assert("Expected evaluate after reset", catcierge_motion_check(&m, small, 11.5));
+
+	catcierge_test_STATUS("Gated %lu, evaluated %lu (%lu motion, %lu watchdog)",
+		m.gated, m.evaluated, m.motion_count, m.watchdog_count);
+
+	mu_assert("Expected gated count", m.gated == 4);
+	mu_assert("Expected evaluated count", m.evaluated == 5);
+	mu_assert("Expected motion count", m.motion_count == 1);
+	mu_assert("Expected watchdog count", m.watchdog_count == 1);
+
+	cvReleaseImage(&img);
+	cvReleaseImage(&small);
+
+	return NULL;
+}
+
+static char *run_parse_tests()
+{
+	catcierge_motion_args_t args;
+	char *val = "2.5";
+	char *bad = "300";
+
+	catcierge_motion_args_init(&args);
+
+	mu_assert("Expected --motion_gate to be parsed", !catcierge_motion_parse_args(&args, "motion_gate", NULL, 0));
+	mu_assert("Expected motion gate enabled", args.enabled);
+	mu_assert("Expected --motion_threshold to be parsed", !catcierge_motion_parse_args(&args, "motion_threshold", &val, 1));
+	mu_assert("Expected --motion_threshold value", args.threshold == 2.5);
+	mu_assert("Expected invalid --motion_threshold to fail", catcierge_motion_parse_args(&args, "motion_threshold", &bad, 1) < 0);
+	mu_assert("Expected --motion_watchdog to be parsed", !catcierge_motion_parse_args(&args, "motion_watchdog", &val, 1));
+	mu_assert("Expected --motion_watchdog value", args.watchdog == 2.5);
+	mu_assert("Expected unknown key to be passed on", catcierge_motion_parse_args(&args, "show", NULL, 0) == 1);
+
+	return NULL;
+}
+
+int TEST_catcierge_motion(int argc, char **argv)
+{
+	int ret = 0;
+	char *e = NULL;
+
+	CATCIERGE_RUN_TEST((e = run_thumbnail_tests()),
+		"Run motion thumbnail tests",
+		"Motion thumbnail", &ret);
+
+	CATCIERGE_RUN_TEST((e = run_sad_tests()),
+		"Run motion SAD tests",
+		"Motion SAD", &ret);
+
+	CATCIERGE_RUN_TEST((e = run_gate_tests()),
+		"Run motion gate tests",
+		"Motion gate", &ret);
+
+	CATCIERGE_RUN_TEST((e = run_parse_tests()),
+		"Run motion args tests",
+		"Motion args", &ret);
+
+	return ret;
+}
@@ -0,0 +1,203 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "catcierge_matcher.h"
+#include "catcierge_obstruct.h"
+#include "minunit.h"
+#include "catcierge_test_helpers.h"
+
+// Threshold + sum using OpenCV, this is what the obstruct kernel must match.
+static int reference_count(IplImage *img)
+{
+	int sum;
+	IplImage *gray = img;
+	IplImage *bin = cvCreateImage(cvGetSize(img), IPL_DEPTH_8U, 1);
+
+	if (img->nChannels != 1)
+	{
+		gray = cvCreateImage(cvGetSize(img), IPL_DEPTH_8U, 1);
+		cvCvtColor(img, gray, (img->nChannels == 4) ? CV_BGRA2GRAY : CV_BGR2GRAY);
+	}
+
+	cvThreshold(gray, bin, CATCIERGE_OBSTRUCT_LEVEL, 255, CV_THRESH_BINARY_INV);
+	sum = (int)cvSum(bin).val[0] / 255;
+
+	if (gray != img)
+		cvReleaseImage(&gray);
+
+	cvReleaseImage(&bin);
+
+	return sum;
+}
+
+// Random pixels, mostly close to the obstruct level to catch off by one errors.
+static IplImage *create_random_image(int width, int height, int channels)
+{
+	int x;
+	int y;
+	unsigned char *row;
+	IplImage *img = cvCreateImage(cvSize(width, height), IPL_DEPTH_8U, channels);
+
+	for (y = 0; y < height; y++)
+	{
+		row = (unsigned char *)img->imageData + y * img->widthStep;
+
+		for (x = 0; x < (width * channels); x++)
+		{
+			row[x] = (rand() % 4) ? (CATCIERGE_OBSTRUCT_LEVEL - 12 + rand() % 25) : (rand() % 256);
+		}
+	}
+
+	return img;
+}
+
+static char *run_kernel_tests(int width, int height, int channels)
+{
+	int ref;
+	int count;
+	int scalar;
+	IplImage *img = create_random_image(width, height, channels);
+
+	ref = reference_count(img);
+
+	scalar = catcierge_obstruct_count_scalar((unsigned char *)img->imageData,
+		img->widthStep, width, height, channels, CATCIERGE_OBSTRUCT_LEVEL, -1);
+	count = catcierge_obstruct_count((unsigned char *)img->imageData,
+		img->widthStep, width, height, channels, CATCIERGE_OBSTRUCT_LEVEL, -1);
+
+	catcierge_test_STATUS("%dx%dx%d: Reference %d, scalar %d, %s %d",
+		width, height, channels, ref, scalar, catcierge_obstruct_simd_str(), count);
+
+	mu_assert("Scalar count differs from reference", scalar == ref);
+	mu_assert("SIMD count differs from reference", count == ref);
+
+	// With a limit we only need to know that we went past it.
+	count = catcierge_obstruct_count((unsigned char *)img->imageData,
+		img->widthStep, width, height, channels, CATCIERGE_OBSTRUCT_LEVEL, ref / 2);
+	mu_assert("Expected limited count to be past the limit", (ref == 0) || (count > (ref / 2)));
+	mu_assert("Expected limited count to not be more than total", count <= ref);
+
+	count = catcierge_obstruct_count((unsigned char *)img->imageData,
+		img->widthStep, width, height, channels, CATCIERGE_OBSTRUCT_LEVEL, ref);
+	mu_assert("Expected exact count when limit is not passed", count == ref);
+
+	cvReleaseImage(&img);
+
+	return NULL;
+}
+
+static char *run_obstruct_sum_tests(int width, int height, int channels)
+{
+	int ref;
+	int sum;
+	int obstructed;
+	CvRect rect;
+	IplImage *img = create_random_image(width, height, channels);
+
+	rect.width = (int)(width * 0.5);
+	rect.height = (int)(height * 0.1);
+	rect.x = (width - rect.width) / 2;
+	rect.y = (height - rect.height) / 2;
+
+	cvSetImageROI(img, rect);
+	ref = reference_count(img);
+	cvResetImageROI(img);
+
+	sum = catcierge_get_obstruct_sum(img, 0);
+	obstructed = catcierge_is_frame_obstructed(img, 0);
+
+	catcierge_test_STATUS("%dx%dx%d: Reference %d, obstruct sum %d, obstructed %d",
+		width, height, channels, ref, sum, obstructed);
+
+	mu_assert("Obstruct sum differs from reference", sum == ref);
+	mu_assert("Obstructed differs from reference", obstructed == (ref > CATCIERGE_OBSTRUCT_THRESHOLD));
+	mu_assert("Expected ROI to be left untouched", img->roi == NULL);
+
+	cvReleaseImage(&img);
+
+	return NULL;
+}
+
+static char *run_clear_and_obstructed_tests()
+{
+	IplImage *img = cvCreateImage(cvSize(320, 240), IPL_DEPTH_8U, 1);
+
+	cvSet(img, cvScalarAll(255), NULL);
+	mu_assert("Expected white frame to be clear", catcierge_is_frame_obstructed(img, 0) == 0);
+	mu_assert("Expected obstruct sum 0", catcierge_get_obstruct_sum(img, 0) == 0);
+
+	cvSet(img, cvScalarAll(0), NULL);
+	mu_assert("Expected black frame to be obstructed", catcierge_is_frame_obstructed(img, 0) == 1);
+	mu_assert("Expected full obstruct sum", catcierge_get_obstruct_sum(img, 0) == (160 * 24));
+	mu_assert("Expected early exit", catcierge_get_obstruct_sum_limit(img, 200, 0) < (160 * 24));
+
+	cvReleaseImage(&img);
+
+	return NULL;
+}
+
+static char *run_invalid_tests()
+{
+	unsigned char data[16];
+	IplImage *img;
+
+	memset(data, 0, sizeof(data));
+
+	mu_assert("Expected NULL data to fail",
+		catcierge_obstruct_count(NULL, 4, 4, 4, 1, CATCIERGE_OBSTRUCT_LEVEL, -1) == -1);
+	mu_assert("Expected 2 channels to fail",
+		catcierge_obstruct_count(data, 4, 2, 2, 2, CATCIERGE_OBSTRUCT_LEVEL, -1) == -1);
+	mu_assert("Expected too small step to fail",
+		catcierge_obstruct_count(data, 2, 4, 4, 1, CATCIERGE_OBSTRUCT_LEVEL, -1) == -1);
+	mu_assert("Expected negative level to count nothing",
+		catcierge_obstruct_count(data, 4, 4, 4, 1, -1, -1) == 0);
+
+	img = cvCreateImage(cvSize(320, 240), IPL_DEPTH_32F, 1);
+	mu_assert("Expected non 8-bit image to fail", catcierge_get_obstruct_sum(img, 0) == -1);
+	cvReleaseImage(&img);
+
+	return NULL;
+}
+
+int TEST_catcierge_obstruct(int argc, char **argv)
+{
+	int ret = 0;
+	int i;
+	char *e = NULL;
+	int sizes[][2] = { { 320, 240 }, { 17, 3 }, { 15, 1 }, { 4099, 2 }, { 161, 24 }, { 1, 1 } };
+	int channels[] = { 1, 3, 4 };
+	int c;
+
+	srand(1234);
+
+	CATCIERGE_RUN_TEST((e = run_clear_and_obstructed_tests()),
+		"Run clear and obstructed tests",
+		"Clear and obstructed frames", &ret);
+
+	for (i = 0; i < (int)(sizeof(sizes) / sizeof(sizes[0])); i++)
+	{
+		for (c = 0; c < (int)(sizeof(channels) / sizeof(channels[0])); c++)
+		{
+			CATCIERGE_RUN_TEST((e = run_kernel_tests(sizes[i][0], sizes[i][1], channels[c])),
+				"Run kernel tests",
+				"Kernel count matches OpenCV", &ret);
+		}
+	}
+
+	for (c = 0; c < (int)(sizeof(channels) / sizeof(channels[0])); c++)
+	{
+		CATCIERGE_RUN_TEST((e = run_obstruct_sum_tests(320, 240, channels[c])),
+			"Run obstruct sum tests",
+			"Obstruct sum matches OpenCV", &ret);
+
+		CATCIERGE_RUN_TEST((e = run_obstruct_sum_tests(641, 479, channels[c])),
+			"Run obstruct sum tests",
+			"Obstruct sum matches OpenCV for odd sizes", &ret);
+	}
+
+	CATCIERGE_RUN_TEST((e = run_invalid_tests()),
+		"Run invalid input tests",
+		"Invalid input", &ret);
+
+	return ret;
+}
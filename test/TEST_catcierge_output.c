@@ -105,8 +105,14 @@ static char *run_generate_tests()
 			{ "%match_count%", "3" },
 			{ "%match_group_count%", "3" },
 			{ "%match_group_final_decision%", "1" },
+			{ "%match_group_latency%", "12.5" },
+			{ "%match_group_frames_used%", "3" },
+			{ "%match_group_early_decision%", "1" },
 			{ "%match_group_success_count%", "3" },
-			{ "%match_group_max_count%", _XSTR(MATCH_MAX_COUNT) },
+			{ "%match_group_max_count%", _XSTR(DEFAULT_MATCH_GROUP_SIZE) },
+			{ "%image_pool_used%", "0" },
+			{ "%image_pool_exhausted%", "0" },
+			{ "%image_pool_recreated%", "0" },
 			{ "%match_group_id%", "34aa973cd4c4daa4f61eeb2bdbad27316534016f" },
 			{ "%match_group_id:4%", "34aa" },
 			{ "%match_group_id:10%", "34aa973cd4" },
@@ -165,18 +171,20 @@ static char *run_generate_tests()
 		grb.args.ok_matches_needed = 4;
 		grb.args.max_consecutive_lockout_count = 20;
 		grb.args.consecutive_lockout_delay = 2.44;
-		strcpy(grb.match_group.matches[0].result.steps[0].path, "some/step/path");
+		grb.match_group.matches[0].result.steps[0].path = "some/step/path";
 		grb.match_group.success_count = 3;
 		grb.match_group.final_decision = 1;
+		grb.match_group.decision_latency = 0.0125;
+		grb.match_group.early_decision = 1;
 		grb.match_group.matches[0].result.steps[1].name = "the_step_name";
 		grb.match_group.matches[1].result.steps[6].description = "Step description";
 		grb.match_group.matches[1].result.step_img_count = 8;
 		strcpy(grb.match_group.description, "hej");
 		strcpy(grb.match_group.matches[1].result.description, "prey found");
-		strcpy(grb.match_group.matches[0].path, "/some/path/omg1");
-		strcpy(grb.match_group.matches[1].path, "/some/path/omg2");
-		strcpy(grb.match_group.matches[2].path, "/some/path/omg3");
-		strcpy(grb.match_group.matches[3].path, "/some/path/omg4");
+		grb.match_group.matches[0].path = "/some/path/omg1";
+		grb.match_group.matches[1].path = "/some/path/omg2";
+		grb.match_group.matches[2].path = "/some/path/omg3";
+		grb.match_group.matches[3].path = "/some/path/omg4";
 		grb.match_group.matches[0].result.success = 4;
 		grb.match_group.matches[2].result.direction = MATCH_DIR_IN;
 		grb.match_group.matches[2].result.result = 0.8;
@@ -305,13 +313,13 @@ static char *run_add_and_generate_tests()
 			grb.match_group.end_time = time(NULL);
 			gettimeofday(&grb.match_group.end_tv, NULL);
 
-			strcpy(grb.match_group.matches[1].filename, "blafile.png");
-			strcpy(grb.match_group.matches[1].path, "tut/blafile.png");
+			grb.match_group.matches[1].filename = "blafile.png";
+			grb.match_group.matches[1].path = "tut/blafile.png";
 			grb.match_group.match_count = 3;
 
 			grb.match_group.obstruct_time = time(NULL);
 			gettimeofday(&grb.match_group.obstruct_tv, NULL);
-			strcpy(grb.match_group.obstruct_path, "obstruct_path");
+			grb.match_group.obstruct_path = "obstruct_path";
 
 			if (catcierge_output_add_template(o,
 				"%!event all\n"
@@ -345,7 +353,7 @@ static char *run_add_and_generate_tests()
 			const char *named_template_path = NULL;
 			const char *default_template_path = NULL;
 			grb.match_group.matches[1].time = time(NULL);
-			strcpy(grb.match_group.matches[1].path, "thematchpath");
+			grb.match_group.matches[1].path = "thematchpath";
 			grb.match_group.match_count = 2;
 
 			if (catcierge_output_add_template(o,
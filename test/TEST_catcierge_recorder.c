@@ -0,0 +1,204 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "catcierge_recorder.h"
+#include "catcierge_frame_source.h"
+#include "minunit.h"
+#include "catcierge_test_helpers.h"
+
+#define TEST_REC_PATH "recorder_test.rec"
+#define TEST_WIDTH 32
+#define TEST_HEIGHT 24
+#define TEST_SLOT_SIZE (sizeof(catcierge_record_frame_header_t) + TEST_WIDTH * TEST_HEIGHT)
+#define TEST_SLOT_COUNT 8
+
+// Writes count frames, where every pixel in frame i has the value i.
+static char *write_recording(int count, int channels)
+{
+	int i;
+	IplImage *img;
+	catcierge_recorder_t rec;
+
+	mu_assert("Failed to open recorder", !catcierge_recorder_open(&rec, TEST_REC_PATH,
+		CATCIERGE_RECORD_HEADER_SIZE + TEST_SLOT_COUNT * TEST_SLOT_SIZE,
+		TEST_WIDTH, TEST_HEIGHT));
+	mu_assert("Expected slot count to fit the size budget",
+		rec.header->slot_count == TEST_SLOT_COUNT);
+
+	img = cvCreateImage(cvSize(TEST_WIDTH, TEST_HEIGHT), IPL_DEPTH_8U, channels);
+
+	for (i = 1; i <= count; i++)
+	{
+		cvSet(img, cvScalarAll(i), NULL);
+		mu_assert("Failed to write frame", !catcierge_recorder_write(&rec, img,
+			i * 10, i * 0.5, RECORD_STATE_WAITING + (i % 4), i * 2));
+	}
+
+	cvReleaseImage(&img);
+
+	// Wrong size frames must be refused.
+	img = cvCreateImage(cvSize(TEST_WIDTH * 2, TEST_HEIGHT), IPL_DEPTH_8U, 1);
+	mu_assert("Expected wrong frame size to fail", catcierge_recorder_write(&rec, img, 0, 0.0, 0, 0));
+	cvReleaseImage(&img);
+
+	catcierge_recorder_close(&rec);
+
+	return NULL;
+}
+
+static char *check_recording(int count)
+{
+	int i;
+	int first;
+	catcierge_record_reader_t reader;
+	catcierge_record_frame_t frame;
+
+	mu_assert("Failed to open reader", !catcierge_record_reader_open(&reader, TEST_REC_PATH));
+
+	// Only the last TEST_SLOT_COUNT frames are left after wrapping.
+	first = (count > TEST_SLOT_COUNT) ? (count - TEST_SLOT_COUNT + 1) : 1;
+
+	for (i = first; i <= count; i++)
+	{
+		mu_assert("Expected a frame", !catcierge_record_reader_next(&reader, &frame));
+		mu_assert("Expected frames in order", frame.seq == (uint64_t)i);
+		mu_assert("Expected frame seq", frame.frame_seq == (uint64_t)(i * 10));
+		mu_assert("Expected timestamp", frame.timestamp == (i * 0.5));
+		mu_assert("Expected state", frame.state == (catcierge_record_state_t)(RECORD_STATE_WAITING + (i % 4)));
+		mu_assert("Expected obstruct sum", frame.obstruct_sum == (i * 2));
+		mu_assert("Expected frame size",
+			(frame.img->width == TEST_WIDTH) && (frame.img->height == TEST_HEIGHT));
+		mu_assert("Expected frame pixels",
+			((unsigned char *)frame.img->imageData)[TEST_WIDTH * TEST_HEIGHT - 1] == i);
+	}
+
+	mu_assert("Expected end of recording", catcierge_record_reader_next(&reader, &frame) == 1);
+
+	catcierge_record_reader_rewind(&reader);
+	mu_assert("Expected a frame after rewind", !catcierge_record_reader_next(&reader, &frame));
+	mu_assert("Expected first frame after rewind", frame.seq == (uint64_t)first);
+
+	catcierge_record_reader_close(&reader);
+
+	return NULL;
+}
+
+static char *run_record_tests(int count, int channels)
+{
+	char *e;
+
+	if ((e = write_recording(count, channels))) return e;
+	if ((e = check_recording(count))) return e;
+
+	return NULL;
+}
+
+static char *run_torn_frame_tests()
+{
+	char *e;
+	FILE *f;
+	uint64_t zero = 0;
+	catcierge_record_reader_t reader;
+	catcierge_record_frame_t frame;
+
+	if ((e = write_recording(3, 1))) return e;
+
+	// Simulate a crash in the middle of writing frame 2.
+	mu_assert("Failed to open recording", (f = fopen(TEST_REC_PATH, "r+b")));
+	fseek(f, CATCIERGE_RECORD_HEADER_SIZE + ((TEST_SLOT_SIZE + 7) & ~7), SEEK_SET);
+	fwrite(&zero, sizeof(zero), 1, f);
+	fclose(f);
+
+	mu_assert("Failed to open reader", !catcierge_record_reader_open(&reader, TEST_REC_PATH));
+	mu_assert("Expected frame 1", !catcierge_record_reader_next(&reader, &frame) && (frame.seq == 1));
+	mu_assert("Expected frame 3", !catcierge_record_reader_next(&reader, &frame) && (frame.seq == 3));
+	mu_assert("Expected end of recording", catcierge_record_reader_next(&reader, &frame) == 1);
+	catcierge_record_reader_close(&reader);
+
+	return NULL;
+}
+
+static char *run_source_tests()
+{
+	int i;
+	char *e;
+	IplImage *img;
+	catcierge_frame_source_t src;
+	catcierge_frame_source_args_t args;
+
+	if ((e = write_recording(5, 1))) return e;
+
+	catcierge_frame_source_args_init(&args);
+	args.type = FRAME_SOURCE_RECORDING;
+	args.path = TEST_REC_PATH;
+	args.fps = 0.0;
+
+	mu_assert("Failed to init rec source", !catcierge_frame_source_init(&src, &args));
+	mu_assert("Failed to open rec source", !catcierge_frame_source_open(&src));
+
+	for (i = 1; i <= 5; i++)
+	{
+		img = catcierge_frame_source_next(&src);
+		mu_assert("Expected a frame", img);
+		mu_assert("Expected frame pixels", ((unsigned char *)img->imageData)[0] == i);
+		catcierge_frame_source_release(&src, img);
+	}
+
+	mu_assert("Expected no more frames", !catcierge_frame_source_next(&src));
+	mu_assert("Expected end of replay", src.eof);
+	catcierge_frame_source_close(&src);
+
+	return NULL;
+}
+
+static char *run_invalid_tests()
+{
+	FILE *f;
+	catcierge_record_reader_t reader;
+	catcierge_recorder_t rec;
+
+	mu_assert("Failed to create file", (f = fopen(TEST_REC_PATH, "wb")));
+	fprintf(f, "This is not a recording, but it is long enough to be mistaken for one"
+		" if we didn't check the magic at the start of the header.");
+	fclose(f);
+
+	mu_assert("Expected invalid recording to fail",
+		catcierge_record_reader_open(&reader, TEST_REC_PATH));
+
+	mu_assert("Expected too small size budget to fail",
+		catcierge_recorder_open(&rec, TEST_REC_PATH, TEST_SLOT_SIZE, TEST_WIDTH, TEST_HEIGHT));
+
+	return NULL;
+}
+
+int TEST_catcierge_recorder(int argc, char **argv)
+{
+	int ret = 0;
+	char *e = NULL;
+
+	CATCIERGE_RUN_TEST((e = run_record_tests(5, 1)),
+		"Run recorder tests",
+		"Record without wrapping", &ret);
+
+	CATCIERGE_RUN_TEST((e = run_record_tests(TEST_SLOT_COUNT * 2 + 3, 1)),
+		"Run recorder tests",
+		"Record with wrapping", &ret);
+
+	CATCIERGE_RUN_TEST((e = run_record_tests(3, 3)),
+		"Run recorder tests",
+		"Record color frames", &ret);
+
+	CATCIERGE_RUN_TEST((e = run_torn_frame_tests()),
+		"Run torn frame tests",
+		"Skip half written frames", &ret);
+
+	CATCIERGE_RUN_TEST((e = run_source_tests()),
+		"Run rec frame source tests",
+		"Replay recording as frame source", &ret);
+
+	CATCIERGE_RUN_TEST((e = run_invalid_tests()),
+		"Run invalid recording tests",
+		"Invalid recordings", &ret);
+
+	return ret;
+}
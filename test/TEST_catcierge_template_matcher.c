@@ -0,0 +1,610 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include "catcierge_fsm.h"
+#include "catcierge_template_matcher.h"
+#include "minunit.h"
+#include "catcierge_test_config.h"
+#include "catcierge_test_helpers.h"
+#include "catcierge_test_common.h"
+
+static char *run_alloc_tests(int series, int i)
+{
+	int j;
+	int allocs;
+	double res;
+	double first_res;
+	catcierge_matcher_t *matcher = NULL;
+	catcierge_template_matcher_args_t args;
+	catcierge_frame_ctx_t frame;
+	match_result_t result;
+	IplImage *img = NULL;
+	char *e = NULL;
+
+	catcierge_template_matcher_args_init(&args);
+	args.snout_paths[0] = CATCIERGE_SNOUT1_PATH;
+	args.snout_paths[1] = CATCIERGE_SNOUT2_PATH;
+	args.snout_count = 2;
+	catcierge_frame_ctx_init(&frame);
+	memset(&result, 0, sizeof(result));
+
+	catcierge_test_image_alloc_hook(1);
+
+	if (catcierge_template_matcher_init(&matcher, (catcierge_matcher_args_t *)&args))
+	{
+		e = "Failed to init template matcher";
+		goto fail;
+	}
+
+	catcierge_test_STATUS("Init did %d image allocations", catcierge_test_image_alloc_count());
+
+	if (!(img = open_test_image(series, i)))
+	{
+		e = "Failed to load test image";
+		goto fail;
+	}
+
+	// The first frame sets up the frame context planes.
+	catcierge_frame_ctx_set(&frame, img);
+	first_res = matcher->match(matcher, &frame, &result, 0);
+
+	allocs = catcierge_test_image_alloc_count();
+
+	for (j = 0; j < 10; j++)
+	{
+		catcierge_frame_ctx_set(&frame, img);
+		res = matcher->match(matcher, &frame, &result, 0);
+
+		if (res != first_res)
+		{
+			e = "Expected the same match result every time";
+			goto fail;
+		}
+	}
+
+	allocs = catcierge_test_image_alloc_count() - allocs;
+	catcierge_test_STATUS("10 matches (%f) did %d image allocations", first_res, allocs);
+
+	if (allocs != 0)
+	{
+		e = "Expected no image allocations when matching";
+	}
+
+fail:
+	if (img)
+		cvReleaseImage(&img);
+
+	catcierge_frame_ctx_destroy(&frame);
+	catcierge_matcher_destroy(&matcher);
+	catcierge_test_image_alloc_hook(0);
+
+	return e;
+}
+
+static double match_image(int workers, int both, catcierge_template_method_t method,
+		int pyramid, IplImage *img, match_result_t *result)
+{
+	double res = -1.0;
+	catcierge_matcher_t *matcher = NULL;
+	catcierge_template_matcher_args_t args;
+	catcierge_frame_ctx_t frame;
+
+	catcierge_template_matcher_args_init(&args);
+	args.snout_paths[0] = CATCIERGE_SNOUT1_PATH;
+	args.snout_paths[1] = CATCIERGE_SNOUT2_PATH;
+	args.snout_paths[2] = CATCIERGE_SNOUT1_PATH;
+	args.snout_paths[3] = CATCIERGE_SNOUT2_PATH;
+	args.snout_count = 4;
+	args.match_workers = workers;
+	args.match_both = both;
+	args.method = method;
+	args.pyramid = pyramid;
+	catcierge_frame_ctx_init(&frame);
+	memset(result, 0, sizeof(match_result_t));
+
+	if (!catcierge_template_matcher_init(&matcher, (catcierge_matcher_args_t *)&args))
+	{
+		catcierge_frame_ctx_set(&frame, img);
+		res = matcher->match(matcher, &frame, result, 0);
+	}
+
+	catcierge_frame_ctx_destroy(&frame);
+	catcierge_matcher_destroy(&matcher);
+
+	return res;
+}
+
+static char *run_parallel_tests()
+{
+	int i;
+	size_t j;
+	double serial_res;
+	double res;
+	match_result_t serial;
+	match_result_t result;
+	IplImage *img;
+
+	for (i = 1; i <= 5; i++)
+	{
+		mu_assert("Failed to load test image", (img = open_test_image(1, i)));
+
+		serial_res = match_image(1, 0, TEMPLATE_METHOD_SPATIAL, 0, img, &serial);
+		mu_assert("Serial match failed", serial_res >= 0.0);
+
+		res = match_image(4, 0, TEMPLATE_METHOD_SPATIAL, 0, img, &result);
+		catcierge_test_STATUS("Serial %f, 4 workers %f", serial_res, res);
+		mu_assert("Expected same result with workers", res == serial_res);
+		mu_assert("Expected same direction with workers", result.direction == serial.direction);
+
+		for (j = 0; j < serial.rect_count; j++)
+		{
+			mu_assert("Expected same match rects with workers",
+				!memcmp(&result.match_rects[j], &serial.match_rects[j], sizeof(CvRect)));
+		}
+
+		res = match_image(4, 1, TEMPLATE_METHOD_SPATIAL, 0, img, &result);
+		mu_assert("Expected same result when matching both", res == serial_res);
+		mu_assert("Expected same direction when matching both", result.direction == serial.direction);
+
+		for (j = 0; j < serial.rect_count; j++)
+		{
+			mu_assert("Expected same match rects when matching both",
+				!memcmp(&result.match_rects[j], &serial.match_rects[j], sizeof(CvRect)));
+		}
+
+		cvReleaseImage(&img);
+	}
+
+	return NULL;
+}
+
+static char *run_method_tests(catcierge_template_method_t method)
+{
+	int i;
+	int j;
+	double spatial_res;
+	double res;
+	match_result_t spatial;
+	match_result_t result;
+	IplImage *img;
+
+	for (i = 1; i <= 5; i++)
+	{
+		mu_assert("Failed to load test image", (img = open_test_image(1, i)));
+
+		spatial_res = match_image(1, 0, TEMPLATE_METHOD_SPATIAL, 0, img, &spatial);
+		mu_assert("Spatial match failed", spatial_res >= 0.0);
+
+		for (j = 1; j <= 4; j *= 4)
+		{
+			res = match_image(j, 1, method, 0, img, &result);
+			catcierge_test_STATUS("Spatial %f, %s %f (%d workers)",
+				spatial_res, catcierge_template_method_str(method), res, j);
+			mu_assert("Expected result within tolerance", fabs(res - spatial_res) < 0.0001);
+			mu_assert("Expected same direction", result.direction == spatial.direction);
+		}
+
+		cvReleaseImage(&img);
+	}
+
+	return NULL;
+}
+
+static char *run_pyramid_tests()
+{
+	int i;
+	int levels;
+	size_t j;
+	double full_res;
+	double res;
+	match_result_t full;
+	match_result_t result;
+	IplImage *img;
+
+	for (i = 1; i <= 5; i++)
+	{
+		mu_assert("Failed to load test image", (img = open_test_image(1, i)));
+
+		full_res = match_image(1, 0, TEMPLATE_METHOD_SPATIAL, 0, img, &full);
+		mu_assert("Full search failed", full_res >= 0.0);
+
+		for (levels = 1; levels <= MAX_TEMPLATE_PYRAMID; levels++)
+		{
+			res = match_image(1, 0, TEMPLATE_METHOD_SPATIAL, levels, img, &result);
+			catcierge_test_STATUS("Full search %f, pyramid %d levels %f", full_res, levels, res);
+
+			// Only a subset of the positions are scored, so it can never be better.
+			mu_assert("Expected pyramid result to not beat the full search", res <= (full_res + 0.00001));
+			mu_assert("Expected pyramid result close to the full search", (full_res - res) < 0.1);
+
+			for (j = 0; (res == full_res) && (j < full.rect_count); j++)
+			{
+				mu_assert("Expected same match rects for the same result",
+					!memcmp(&result.match_rects[j], &full.match_rects[j], sizeof(CvRect)));
+			}
+		}
+
+		cvReleaseImage(&img);
+	}
+
+	return NULL;
+}
+
+static char *run_hint_tests()
+{
+	int i;
+	int hits = 0;
+	size_t j;
+	double full_res;
+	double res;
+	match_result_t full;
+	match_result_t result;
+	catcierge_matcher_t *matcher = NULL;
+	catcierge_template_matcher_args_t args;
+	catcierge_frame_ctx_t frame;
+	IplImage *img;
+	char *e = NULL;
+
+	catcierge_template_matcher_args_init(&args);
+	args.snout_paths[0] = CATCIERGE_SNOUT1_PATH;
+	args.snout_paths[1] = CATCIERGE_SNOUT2_PATH;
+	args.snout_count = 2;
+	args.hint = 8;
+	catcierge_frame_ctx_init(&frame);
+
+	// The hint window is only matched spatially.
+	args.method = TEMPLATE_METHOD_FFT;
+	mu_assert("Expected the hint to be rejected with FFT matching",
+		catcierge_template_matcher_init(&matcher, (catcierge_matcher_args_t *)&args));
+	catcierge_matcher_destroy(&matcher);
+	args.method = TEMPLATE_METHOD_SPATIAL;
+
+	mu_assert("Failed to init template matcher",
+		!catcierge_template_matcher_init(&matcher, (catcierge_matcher_args_t *)&args));
+
+	for (i = 1; i <= 5; i++)
+	{
+		if (!(img = open_test_image(1, i)))
+		{
+			e = "Failed to load test image";
+			goto fail;
+		}
+
+		catcierge_frame_ctx_set(&frame, img);
+
+		// No hint, full search.
+		memset(&full, 0, sizeof(full));
+		full_res = matcher->match(matcher, &frame, &full, 0);
+
+		if (full.hint_hit || full.hint_miss)
+		{
+			e = "Expected no hint to be used without hint rects";
+			goto fail;
+		}
+
+		if (!full.success)
+		{
+			cvReleaseImage(&img);
+			continue;
+		}
+
+		// Hint where the snouts were found.
+		memset(&result, 0, sizeof(result));
+		memcpy(result.hint_rects, full.match_rects, sizeof(result.hint_rects));
+		result.hint_count = full.rect_count;
+		result.hint_direction = full.direction;
+		res = matcher->match(matcher, &frame, &result, 0);
+
+		catcierge_test_STATUS("Full search %f, with hint %f (hit %d)", full_res, res, result.hint_hit);
+
+		if (!result.hint_hit || (fabs(res - full_res) > 0.0001) || (result.direction != full.direction))
+		{
+			e = "Expected a hint hit with the same result";
+			goto fail;
+		}
+
+		for (j = 0; j < full.rect_count; j++)
+		{
+			if (memcmp(&result.match_rects[j], &full.match_rects[j], sizeof(CvRect)))
+			{
+				e = "Expected the same match rects with a hint";
+				goto fail;
+			}
+		}
+
+		// A hint far away should fall back to a full search.
+		memset(&result, 0, sizeof(result));
+
+		for (j = 0; j < full.rect_count; j++)
+		{
+			result.hint_rects[j] = full.match_rects[j];
+			result.hint_rects[j].x = (full.match_rects[j].x > 100) ? 0 : 200;
+		}
+
+		result.hint_count = full.rect_count;
+		result.hint_direction = full.direction;
+		res = matcher->match(matcher, &frame, &result, 0);
+
+		catcierge_test_STATUS("Full search %f, with bad hint %f (miss %d)", full_res, res, result.hint_miss);
+
+		if ((result.hint_hit && (res < args.match_threshold))
+		 || (result.hint_miss && (fabs(res - full_res) > 0.0001)))
+		{
+			e = "Expected a hint miss to give the full search result";
+			goto fail;
+		}
+
+		hits++;
+		cvReleaseImage(&img);
+	}
+
+	img = NULL;
+
+	if (hits == 0)
+	{
+		e = "Expected at least one successful match to test the hint with";
+	}
+
+fail:
+	if (img)
+		cvReleaseImage(&img);
+
+	catcierge_frame_ctx_destroy(&frame);
+	catcierge_matcher_destroy(&matcher);
+
+	return e;
+}
+
+static char *run_resolution_tests()
+{
+	int i;
+	size_t k;
+	double res;
+	double big_res;
+	double work_res;
+	double wide_res;
+	match_result_t result;
+	match_result_t big_result;
+	catcierge_matcher_t *matcher = NULL;
+	catcierge_matcher_t *work_matcher = NULL;
+	catcierge_template_matcher_args_t args;
+	catcierge_template_matcher_args_t work_args;
+	catcierge_frame_ctx_t frame;
+	catcierge_frame_ctx_t big_frame;
+	IplImage *img = NULL;
+	IplImage *big = NULL;
+	IplImage *wide = NULL;
+	char *e = NULL;
+
+	catcierge_template_matcher_args_init(&args);
+	args.snout_paths[0] = CATCIERGE_SNOUT1_PATH;
+	args.snout_paths[1] = CATCIERGE_SNOUT2_PATH;
+	args.snout_count = 2;
+	work_args = args;
+	work_args.match_width = 320;
+	work_args.match_height = 240;
+	catcierge_frame_ctx_init(&frame);
+	catcierge_frame_ctx_init(&big_frame);
+
+	if (catcierge_template_matcher_init(&matcher, (catcierge_matcher_args_t *)&args)
+	 || catcierge_template_matcher_init(&work_matcher, (catcierge_matcher_args_t *)&work_args))
+	{
+		e = "Failed to init template matcher";
+		goto fail;
+	}
+
+	for (i = 1; i <= 5; i++)
+	{
+		if (!(img = open_test_image(1, i)))
+		{
+			e = "Failed to load test image";
+			goto fail;
+		}
+
+		big = cvCreateImage(cvSize(640, 480), IPL_DEPTH_8U, img->nChannels);
+		cvResize(img, big, CV_INTER_LINEAR);
+
+		catcierge_frame_ctx_set(&frame, img);
+		catcierge_frame_ctx_set(&big_frame, big);
+		memset(&result, 0, sizeof(result));
+		memset(&big_result, 0, sizeof(big_result));
+
+		res = matcher->match(matcher, &frame, &result, 0);
+		big_res = matcher->match(matcher, &big_frame, &big_result, 0);
+
+		catcierge_test_STATUS("320x240 %f, 640x480 with scaled snouts %f", res, big_res);
+
+		if ((big_res < 0.0) || (fabs(big_res - res) > 0.1))
+		{
+			e = "Expected about the same result with scaled snouts";
+			goto fail;
+		}
+
+		// Scale the frame down to the match resolution instead.
+		memset(&big_result, 0, sizeof(big_result));
+		work_res = work_matcher->match(work_matcher, &big_frame, &big_result, 0);
+
+		catcierge_test_STATUS("640x480 matched at 320x240 %f", work_res);
+
+		if ((work_res < 0.0) || (fabs(work_res - res) > 0.05))
+		{
+			e = "Expected about the same result when matching at a lower resolution";
+			goto fail;
+		}
+
+		// The match rects are in capture coordinates.
+		for (k = 0; k < result.rect_count; k++)
+		{
+			if ((big_result.match_rects[k].width != (2 * result.match_rects[k].width))
+			 || (abs(big_result.match_rects[k].x - 2 * result.match_rects[k].x) > 4)
+			 || (abs(big_result.match_rects[k].y - 2 * result.match_rects[k].y) > 4))
+			{
+				e = "Expected match rects scaled to the capture resolution";
+				goto fail;
+			}
+		}
+
+		// A 16:9 camera sees more to the sides, the cat is scaled the
+		// same on both axes. The sides are filled with a stretched copy.
+		wide = cvCreateImage(cvSize(640, 360), IPL_DEPTH_8U, img->nChannels);
+		cvResize(img, wide, CV_INTER_LINEAR);
+		cvSetImageROI(wide, cvRect(80, 0, 480, 360));
+		cvResize(img, wide, CV_INTER_LINEAR);
+		cvResetImageROI(wide);
+
+		catcierge_frame_ctx_set(&big_frame, wide);
+		memset(&big_result, 0, sizeof(big_result));
+		wide_res = matcher->match(matcher, &big_frame, &big_result, 0);
+
+		catcierge_test_STATUS("640x360 with scaled snouts %f", wide_res);
+
+		if ((wide_res < 0.0) || (fabs(wide_res - res) > 0.1))
+		{
+			e = "Expected about the same result at 16:9 with scaled snouts";
+			goto fail;
+		}
+
+		for (k = 0; k < result.rect_count; k++)
+		{
+			if ((abs(2 * big_result.match_rects[k].width - 3 * result.match_rects[k].width) > 2)
+			 || (abs(2 * big_result.match_rects[k].height - 3 * result.match_rects[k].height) > 2))
+			{
+				e = "Expected the snouts to be scaled the same on both axes at 16:9";
+				goto fail;
+			}
+		}
+
+		cvReleaseImage(&wide);
+		cvReleaseImage(&big);
+		cvReleaseImage(&img);
+	}
+
+fail:
+	if (img) cvReleaseImage(&img);
+	if (big) cvReleaseImage(&big);
+	if (wide) cvReleaseImage(&wide);
+	catcierge_frame_ctx_destroy(&frame);
+	catcierge_frame_ctx_destroy(&big_frame);
+	catcierge_matcher_destroy(&matcher);
+	catcierge_matcher_destroy(&work_matcher);
+
+	return e;
+}
+
+static char *run_resolution_cache_tests()
+{
+	int j;
+	int allocs;
+	match_result_t result;
+	catcierge_matcher_t *matcher = NULL;
+	catcierge_template_matcher_args_t args;
+	catcierge_frame_ctx_t frame;
+	catcierge_frame_ctx_t big_frame;
+	IplImage *img = NULL;
+	IplImage *big = NULL;
+	char *e = NULL;
+
+	catcierge_template_matcher_args_init(&args);
+	args.snout_paths[0] = CATCIERGE_SNOUT1_PATH;
+	args.snout_paths[1] = CATCIERGE_SNOUT2_PATH;
+	args.snout_count = 2;
+	catcierge_frame_ctx_init(&frame);
+	catcierge_frame_ctx_init(&big_frame);
+	memset(&result, 0, sizeof(result));
+
+	catcierge_test_image_alloc_hook(1);
+
+	if (catcierge_template_matcher_init(&matcher, (catcierge_matcher_args_t *)&args))
+	{
+		e = "Failed to init template matcher";
+		goto fail;
+	}
+
+	if (!(img = open_test_image(1, 2)))
+	{
+		e = "Failed to load test image";
+		goto fail;
+	}
+
+	big = cvCreateImage(cvSize(640, 480), IPL_DEPTH_8U, img->nChannels);
+	cvResize(img, big, CV_INTER_LINEAR);
+
+	// Prepare both resolutions.
+	catcierge_frame_ctx_set(&frame, img);
+	matcher->match(matcher, &frame, &result, 0);
+	catcierge_frame_ctx_set(&big_frame, big);
+	matcher->match(matcher, &big_frame, &result, 0);
+
+	allocs = catcierge_test_image_alloc_count();
+
+	for (j = 0; j < 5; j++)
+	{
+		catcierge_frame_ctx_set(&frame, img);
+		matcher->match(matcher, &frame, &result, 0);
+		catcierge_frame_ctx_set(&big_frame, big);
+		matcher->match(matcher, &big_frame, &result, 0);
+	}
+
+	allocs = catcierge_test_image_alloc_count() - allocs;
+	catcierge_test_STATUS("Switching resolution 10 times did %d image allocations", allocs);
+
+	if (allocs != 0)
+	{
+		e = "Expected cached resolutions to not allocate";
+	}
+
+fail:
+	if (img) cvReleaseImage(&img);
+	if (big) cvReleaseImage(&big);
+	catcierge_frame_ctx_destroy(&frame);
+	catcierge_frame_ctx_destroy(&big_frame);
+	catcierge_matcher_destroy(&matcher);
+	catcierge_test_image_alloc_hook(0);
+
+	return e;
+}
+
+int TEST_catcierge_template_matcher(int argc, char **argv)
+{
+	int ret = 0;
+	char *e = NULL;
+
+	CATCIERGE_RUN_TEST((e = run_alloc_tests(1, 5)),
+		"Run template matcher allocation tests (clear frame)",
+		"No allocations when matching clear frame", &ret);
+
+	CATCIERGE_RUN_TEST((e = run_alloc_tests(1, 2)),
+		"Run template matcher allocation tests (cat)",
+		"No allocations when matching cat", &ret);
+
+	CATCIERGE_RUN_TEST((e = run_parallel_tests()),
+		"Run parallel template matcher tests",
+		"Same result with parallel matching", &ret);
+
+	CATCIERGE_RUN_TEST((e = run_method_tests(TEMPLATE_METHOD_FFT)),
+		"Run FFT template matcher tests",
+		"Same result with FFT matching", &ret);
+
+	CATCIERGE_RUN_TEST((e = run_method_tests(TEMPLATE_METHOD_BINARY)),
+		"Run binary template matcher tests",
+		"Same result with binary matching", &ret);
+
+	CATCIERGE_RUN_TEST((e = run_pyramid_tests()),
+		"Run pyramid template matcher tests",
+		"Pyramid search close to full search", &ret);
+
+	CATCIERGE_RUN_TEST((e = run_hint_tests()),
+		"Run template matcher search hint tests",
+		"Search hint hit and miss", &ret);
+
+	CATCIERGE_RUN_TEST((e = run_resolution_tests()),
+		"Run template matcher resolution tests",
+		"Matching at other resolutions", &ret);
+
+	CATCIERGE_RUN_TEST((e = run_resolution_cache_tests()),
+		"Run template matcher resolution cache tests",
+		"Cached resolutions", &ret);
+
+	return ret;
+}
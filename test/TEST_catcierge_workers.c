@@ -0,0 +1,101 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "catcierge_workers.h"
+#include "catcierge_timer.h"
+#include "minunit.h"
+#include "catcierge_test_helpers.h"
+
+#define JOB_COUNT 64
+
+typedef struct workers_test_s
+{
+	int runs[JOB_COUNT];
+	int sleep_ms;
+} workers_test_t;
+
+static void workers_test_job(void *user, size_t job)
+{
+	workers_test_t *t = (workers_test_t *)user;
+
+	if (t->sleep_ms)
+		catcierge_thread_sleep_ms(t->sleep_ms);
+
+	catcierge_atomic_add(&t->runs[job], 1);
+}
+
+static char *run_jobs_test(int worker_count)
+{
+	int i;
+	int batch;
+	catcierge_workers_t w;
+	workers_test_t t;
+
+	memset(&t, 0, sizeof(t));
+	mu_assert("Failed to init workers", !catcierge_workers_init(&w, worker_count));
+
+	catcierge_test_STATUS("%d workers", catcierge_workers_count(&w));
+
+	for (batch = 0; batch < 100; batch++)
+	{
+		catcierge_workers_run(&w, workers_test_job, &t, 0, JOB_COUNT / 2);
+		catcierge_workers_run(&w, workers_test_job, &t, JOB_COUNT / 2, JOB_COUNT / 2);
+		catcierge_workers_run(&w, workers_test_job, &t, 0, 0);
+	}
+
+	catcierge_workers_destroy(&w);
+
+	for (i = 0; i < JOB_COUNT; i++)
+	{
+		mu_assert("Expected every job to run once per batch", t.runs[i] == 100);
+	}
+
+	return NULL;
+}
+
+static char *run_parallel_test()
+{
+	double start;
+	double elapsed;
+	catcierge_workers_t w;
+	workers_test_t t;
+
+	memset(&t, 0, sizeof(t));
+	t.sleep_ms = 50;
+	mu_assert("Failed to init workers", !catcierge_workers_init(&w, 4));
+
+	start = catcierge_timer_now();
+	catcierge_workers_run(&w, workers_test_job, &t, 0, 4);
+	elapsed = catcierge_timer_now() - start;
+
+	catcierge_workers_destroy(&w);
+
+	catcierge_test_STATUS("4 jobs of 50ms on 4 workers took %0.3f seconds", elapsed);
+	mu_assert("Expected the jobs to run in parallel", elapsed < 0.15);
+
+	return NULL;
+}
+
+int TEST_catcierge_workers(int argc, char **argv)
+{
+	int ret = 0;
+	char *e = NULL;
+
+	CATCIERGE_RUN_TEST((e = run_jobs_test(1)),
+		"Run jobs without workers",
+		"Jobs without workers", &ret);
+
+	CATCIERGE_RUN_TEST((e = run_jobs_test(4)),
+		"Run jobs with 4 workers",
+		"Jobs with 4 workers", &ret);
+
+	CATCIERGE_RUN_TEST((e = run_jobs_test(0)),
+		"Run jobs with one worker per CPU",
+		"Jobs with one worker per CPU", &ret);
+
+	CATCIERGE_RUN_TEST((e = run_parallel_test()),
+		"Run parallel workers test",
+		"Parallel workers", &ret);
+
+	return ret;
+}
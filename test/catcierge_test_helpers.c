@@ -9,6 +9,7 @@
 #include <Windows.h>
 #include <io.h>
 #endif
+#include <opencv2/core/core_c.h>
 #include "catcierge_test_helpers.h"
 
 static int verbose;
@@ -264,4 +265,114 @@ void *catcierge_test_realloc(void *ptr, size_t sz)
 	return realloc(ptr, sz);
 }
 
+static int image_alloc_count;
 
+static IplImage * CV_STDCALL catcierge_test_create_image_header(int channels,
+	int alpha_channel, int depth, char *color_model, char *channel_seq,
+	int data_order, int origin, int align, int width, int height,
+	IplROI *roi, IplImage *mask_roi, void *image_id, IplTileInfo *tile_info)
+{
+	IplImage *img;
+
+	image_alloc_count++;
+
+	if (!(img = (IplImage *)malloc(sizeof(IplImage))))
+		return NULL;
+
+	return cvInitImageHeader(img, cvSize(width, height), depth, channels, origin, align);
+}
+
+static void CV_STDCALL catcierge_test_allocate_image_data(IplImage *img, int fill, int value)
+{
+	image_alloc_count++;
+	img->imageData = img->imageDataOrigin = (char *)calloc(1, img->imageSize);
+}
+
+static void CV_STDCALL catcierge_test_deallocate(IplImage *img, int flags)
+{
+	if (flags & IPL_IMAGE_DATA)
+	{
+		free(img->imageDataOrigin);
+		img->imageData = img->imageDataOrigin = NULL;
+	}
+
+	if (flags & IPL_IMAGE_ROI)
+	{
+		free(img->roi);
+		img->roi = NULL;
+	}
+
+	if (flags & IPL_IMAGE_HEADER)
+	{
+		free(img->roi);
+		free(img);
+	}
+}
+
+static IplROI * CV_STDCALL catcierge_test_create_roi(int coi, int x, int y, int width, int height)
+{
+	IplROI *roi;
+
+	image_alloc_count++;
+
+	if (!(roi = (IplROI *)malloc(sizeof(IplROI))))
+		return NULL;
+
+	roi->coi = coi;
+	roi->xOffset = x;
+	roi->yOffset = y;
+	roi->width = width;
+	roi->height = height;
+
+	return roi;
+}
+
+static IplImage * CV_STDCALL catcierge_test_clone_image(const IplImage *src)
+{
+	IplImage *img;
+
+	image_alloc_count++;
+
+	if (!(img = (IplImage *)malloc(sizeof(IplImage))))
+		return NULL;
+
+	memcpy(img, src, sizeof(IplImage));
+	img->roi = NULL;
+	img->imageData = img->imageDataOrigin = NULL;
+
+	if (src->roi)
+	{
+		img->roi = catcierge_test_create_roi(src->roi->coi,
+			src->roi->xOffset, src->roi->yOffset,
+			src->roi->width, src->roi->height);
+	}
+
+	if (src->imageData)
+	{
+		catcierge_test_allocate_image_data(img, 0, 0);
+		memcpy(img->imageData, src->imageData, src->imageSize);
+	}
+
+	return img;
+}
+
+void catcierge_test_image_alloc_hook(int enable)
+{
+	image_alloc_count = 0;
+
+	if (enable)
+	{
+		cvSetIPLAllocators(catcierge_test_create_image_header,
+			catcierge_test_allocate_image_data, catcierge_test_deallocate,
+			catcierge_test_create_roi, catcierge_test_clone_image);
+	}
+	else
+	{
+		cvSetIPLAllocators(NULL, NULL, NULL, NULL, NULL);
+	}
+}
+
+int catcierge_test_image_alloc_count()
+{
+	return image_alloc_count;
+}
@@ -33,6 +33,12 @@ void *catcierge_test_malloc(size_t sz);
 void catcierge_test_set_realloc_fail_count(int count);
 void *catcierge_test_realloc(void *ptr, size_t sz);
 
+// Counts OpenCV image allocations (headers, pixel data, ROIs and clones).
+// Must be turned on before any image is created, and off again only
+// after all of them have been released.
+void catcierge_test_image_alloc_hook(int enable);
+int catcierge_test_image_alloc_count();
+
 #define CATCIERGE_RUN_TEST(err, headline, success, ret) \
 	do \
 	{ \